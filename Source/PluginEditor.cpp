@@ -10,9 +10,52 @@
 #include "PluginEditor.h"
 
 
+//==============================================================================
+BandSelector::BandSelector(AFEQAudioProcessorEditor* parent, BandParams* bandparams, int index)
+    : processor(parent->getAudioProcessor()), bandParams(bandparams)
+{
+    jassert(bandParams != nullptr);
+    select.setButtonText(juce::String(index + 1));
+    select.onClick = [parent, this]() { parent->setActiveBand(bandParams); };
+    parent->addAndMakeVisible(select);
+
+    bandParams->enabledParam->addListener(this);
+    bandParams->routingParam->addListener(this);
+    updateEnableColour();
+}
+
+BandSelector::~BandSelector()
+{
+    bandParams->enabledParam->removeListener(this);
+    bandParams->routingParam->removeListener(this);
+}
+
+void BandSelector::parameterValueChanged(int /*parameterIndex*/, float /*newValue*/)
+{
+    // a restore ends with syncWithProcessor()
+    if (! processor.isRestoringState())
+        updateEnableColour();
+}
+
+void BandSelector::updateEnableColour()
+{
+    auto& lnf = select.getLookAndFeel();
+    const auto rt = bandParams->routingParam->getIndex();
+    const auto colId = rt == 1 ? AFEQLookAndFeel::responseColourLeft
+        : rt == 2 ? AFEQLookAndFeel::responseColourRight
+        : rt == 3 ? AFEQLookAndFeel::responseColourMid
+        : rt == 4 ? AFEQLookAndFeel::responseColourSide
+        : AFEQLookAndFeel::responseColourStereo;
+    const auto en = bandParams->enabledParam->get();
+    const auto col = lnf.isColourSpecified(colId) ? lnf.findColour(colId).withAlpha(en ? 0.3f : 0.f) : juce::Colours::transparentBlack;
+
+    select.setColour(juce::TextButton::buttonColourId, lnf.findColour(juce::TextButton::buttonColourId).overlaidWith(col));
+    select.setColour(juce::TextButton::buttonOnColourId, lnf.findColour(juce::TextButton::buttonOnColourId).overlaidWith(col));
+}
+
 //==============================================================================
 BandControls::BandControls(AFEQAudioProcessorEditor* parent, BandParams* bandparams)
-    : bandParams(bandparams)
+    : processor(parent->getAudioProcessor()), bandParams(bandparams)
 {
     auto& apvts = parent->getAPValueTreeState();
     freq.setSliderStyle(juce::Slider::RotaryVerticalDrag);
@@ -28,8 +71,6 @@ BandControls::BandControls(AFEQAudioProcessorEditor* parent, BandParams* bandpar
     {
         for (int i = 1; i <= bandParams->maxOrder; ++i)
             order.addItem(juce::String(6 * i) + " dB/oct", i);
-
-        parent->addAndMakeVisible(select);
     }
     else
     {
@@ -46,18 +87,8 @@ BandControls::BandControls(AFEQAudioProcessorEditor* parent, BandParams* bandpar
 
     if (bandParams != nullptr)
     {
-        parent->comboboxAttachments.add(std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(apvts, bandParams->typeId.toString(), type));
-        parent->comboboxAttachments.add(std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(apvts, bandParams->routingId.toString(), routing));
-        parent->comboboxAttachments.add(std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(apvts, bandParams->orderId.toString(), order));
-        parent->buttonAttachments.add(std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(apvts, bandParams->enableId.toString(), enabled));
-        parent->sliderAttachments.add(std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(apvts, bandParams->freqId.toString(), freq));
-        parent->sliderAttachments.add(std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(apvts, bandParams->gainId.toString(), gain));
-        parent->sliderAttachments.add(std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(apvts, bandParams->qId.toString(), qfactor));
-
+        attach(apvts);
         bandParams->typeParam->addListener(this);
-        bandParams->enabledParam->addListener(this);
-        bandParams->routingParam->addListener(this);
-        select.onClick = [parent, this]() { parent->setActiveBand(bandParams); };
     }
     else
     {
@@ -97,11 +128,23 @@ BandControls::BandControls(AFEQAudioProcessorEditor* parent, BandParams* bandpar
 BandControls::~BandControls()
 {
     if (bandParams != nullptr)
-    {
         bandParams->typeParam->removeListener(this);
-        bandParams->enabledParam->removeListener(this);
-        bandParams->routingParam->removeListener(this);
-    }
+}
+
+void BandControls::attach(juce::AudioProcessorValueTreeState& apvts)
+{
+    using APVTS = juce::AudioProcessorValueTreeState;
+
+    if (bandParams == nullptr)
+        return;
+
+    typeAttachment = std::make_unique<APVTS::ComboBoxAttachment>(apvts, bandParams->typeId.toString(), type);
+    routingAttachment = std::make_unique<APVTS::ComboBoxAttachment>(apvts, bandParams->routingId.toString(), routing);
+    orderAttachment = std::make_unique<APVTS::ComboBoxAttachment>(apvts, bandParams->orderId.toString(), order);
+    enabledAttachment = std::make_unique<APVTS::ButtonAttachment>(apvts, bandParams->enableId.toString(), enabled);
+    freqAttachment = std::make_unique<APVTS::SliderAttachment>(apvts, bandParams->freqId.toString(), freq);
+    gainAttachment = std::make_unique<APVTS::SliderAttachment>(apvts, bandParams->gainId.toString(), gain);
+    qAttachment = std::make_unique<APVTS::SliderAttachment>(apvts, bandParams->qId.toString(), qfactor);
 }
 
 void BandControls::setSelected(bool selected)
@@ -113,20 +156,13 @@ void BandControls::setSelected(bool selected)
     type.setVisible(selected);
     routing.setVisible(selected);
     order.setVisible(selected);
-    select.setToggleState(selected, juce::dontSendNotification);
     updateEnablement();
 }
 
 void BandControls::parameterValueChanged(int parameterIndex, float /*newValue*/)
 {
-    const bool isType = (parameterIndex % 7) == 1;
-    const bool isEnabled = (parameterIndex % 7) == 0;
-    const bool isRouting = (parameterIndex % 7) == 2;
-    if (isType)
+    if (parameterIndex == bandParams->typeParam->getParameterIndex() && ! processor.isRestoringState())
         updateEnablement();
-
-    if (isEnabled || isRouting)
-        updateEnableColour();
 }
 
 void BandControls::updateEnablement()
@@ -144,22 +180,6 @@ void BandControls::updateEnablement()
     order.setEnabled(hasOrder);
 }
 
-void BandControls::updateEnableColour()
-{
-    auto& lnf = enabled.getLookAndFeel();
-    const auto rt = bandParams->routingParam->getIndex();
-    const auto colId = rt == 1 ? AFEQLookAndFeel::responseColourLeft
-        : rt == 2 ? AFEQLookAndFeel::responseColourRight
-        : rt == 3 ? AFEQLookAndFeel::responseColourMid
-        : rt == 4 ? AFEQLookAndFeel::responseColourSide
-        : AFEQLookAndFeel::responseColourStereo;
-    const auto en = bandParams->enabledParam->get();
-    const auto col = lnf.isColourSpecified(colId) ? lnf.findColour(colId).withAlpha(en ? 0.3f : 0.f) : juce::Colours::transparentBlack;
-
-    select.setColour(juce::TextButton::buttonColourId, lnf.findColour(juce::TextButton::buttonColourId).overlaidWith(col));
-    select.setColour(juce::TextButton::buttonOnColourId, lnf.findColour(juce::TextButton::buttonOnColourId).overlaidWith(col));
-}
-
 //==============================================================================
 AFEQAudioProcessorEditor::AFEQAudioProcessorEditor (AFEQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p), eqView(*this, p.eqBands)
@@ -185,10 +205,9 @@ AFEQAudioProcessorEditor::AFEQAudioProcessorEditor (AFEQAudioProcessor& p)
     };
 
     for (auto b : audioProcessor.eqBands)
-    {
-        auto bc = bandControls.add(std::make_unique<BandControls>(this, &(b->getBandParams())));
-        bc->select.setButtonText(juce::String(bandControls.size()));
-    }
+        bandSelectors.add(std::make_unique<BandSelector>(this, &(b->getBandParams()), bandSelectors.size()));
+
+    bandControls.insertMultiple(-1, nullptr, bandSelectors.size());
 
     bcNoSel = std::make_unique<BandControls>(this, nullptr);
     if (auto c = getConstrainer())
@@ -197,15 +216,15 @@ AFEQAudioProcessorEditor::AFEQAudioProcessorEditor (AFEQAudioProcessor& p)
     setScale(p.guiScale, false);
     setResizeLimits(400, 300, 4000, 3000);
     setActiveBand(nullptr);
+    setWantsKeyboardFocus(true);
 }
 
 AFEQAudioProcessorEditor::~AFEQAudioProcessorEditor()
 {
     setLookAndFeel(nullptr);
 
-    comboboxAttachments.clear();
-    sliderAttachments.clear();
-    buttonAttachments.clear();
+    bandControls.clear();
+    bcNoSel.reset();
 }
 
 void AFEQAudioProcessorEditor::setScale(float scale, bool updateSize)
@@ -309,8 +328,7 @@ void AFEQAudioProcessorEditor::resized()
 
         const auto selDist = (yBot - yFreq - 4 * textBoxHeight) / 3;
         const auto wSel = (wCbBut - 2 * dist) / 3;
-        auto index = 0;
-        const auto numBands = bandControls.size();
+        const auto numBands = bandSelectors.size();
 
         rectLeft = juce::Rectangle<int>(xSelect, yFreq, wCbBut, yOrder + textBoxHeight - yFreq).expanded(textBoxHeight, textBoxHeight/4);
         rectRight = juce::Rectangle<int>(xBandSet, yFreq, wCbBut, yOrder + textBoxHeight - yFreq).expanded(textBoxHeight, textBoxHeight/4);
@@ -327,22 +345,55 @@ void AFEQAudioProcessorEditor::resized()
             b->type.setBounds(xBandSet, yType, wCbBut, textBoxHeight);
             b->routing.setBounds(xBandSet, yRouting, wCbBut, textBoxHeight);
             b->order.setBounds(xBandSet, yOrder, wCbBut, textBoxHeight);
+        };
 
+        for (int index = 0; index < numBands; ++index)
+        {
             const auto xSel = xSelect + (index % (numBands / 4)) * (wSel + dist);
             const auto ySel = index < numBands / 2 ? yFreq + (index / (numBands / 4)) * (textBoxHeight + selDist)
                 : yBot - textBoxHeight - (3 - index / (numBands / 4)) * (textBoxHeight + selDist);
-            b->select.setBounds(xSel, ySel, wSel, textBoxHeight);
-            ++index;
-        };
+            bandSelectors[index]->select.setBounds(xSel, ySel, wSel, textBoxHeight);
+        }
 
         for (auto b : bandControls)
-            setControlBounds(b);
+            if (b != nullptr)
+                setControlBounds(b);
 
         if (bcNoSel != nullptr)
             setControlBounds(bcNoSel.get());
     }
 }
 
+bool AFEQAudioProcessorEditor::keyPressed(const juce::KeyPress& key)
+{
+    const auto cmd = juce::ModifierKeys::commandModifier;
+
+    if (key == juce::KeyPress('z', cmd, 0))
+    {
+        audioProcessor.undo();
+        return true;
+    }
+
+    if (key == juce::KeyPress('z', cmd | juce::ModifierKeys::shiftModifier, 0) || key == juce::KeyPress('y', cmd, 0))
+    {
+        audioProcessor.redo();
+        return true;
+    }
+
+    // Ctrl/Cmd+1 to 4 store a snapshot, the curve's menu recalls them; plain
+    // keys are left to the host
+    for (int slot = 0; slot < SnapshotBank::numSlots; ++slot)
+    {
+        if (key == juce::KeyPress('1' + slot, cmd, 0))
+        {
+            audioProcessor.storeSnapshot(slot);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void AFEQAudioProcessorEditor::responseChanged()
 {
     eqView.responseChanged();
@@ -353,16 +404,52 @@ void AFEQAudioProcessorEditor::syncWithProcessor()
     setScale(audioProcessor.guiScale, true);
     analyserPre.setToggleState(audioProcessor.analyserProc == AFEQAudioProcessor::kAnalyserPre, juce::dontSendNotification);
     analyserPost.setToggleState(audioProcessor.analyserProc == AFEQAudioProcessor::kAnalyserPost, juce::dontSendNotification);
+
+    for (auto selector : bandSelectors)
+        selector->updateEnableColour();
+
+    for (auto controls : bandControls)
+        if (controls != nullptr)
+            controls->updateEnablement();
+}
+
+void AFEQAudioProcessorEditor::refreshAfterParameterEvents()
+{
+    // parameter events notify nobody, the attachments read the values again
+    const auto numEvents = audioProcessor.getNumAppliedParameterEvents();
+
+    if (numEvents == numShownParameterEvents)
+        return;
+
+    numShownParameterEvents = numEvents;
+
+    for (auto selector : bandSelectors)
+        selector->updateEnableColour();
+
+    for (auto controls : bandControls)
+    {
+        if (controls != nullptr)
+        {
+            controls->attach(getAPValueTreeState());
+            controls->updateEnablement();
+        }
+    }
 }
 
 void AFEQAudioProcessorEditor::setActiveBand(BandParams* bc)
 {
     curBandControls = bcNoSel.get();
 
-    for (int i = 0; i < bandControls.size(); ++i)
+    for (int i = 0; i < bandSelectors.size(); ++i)
     {
-        const auto isSelected = bc == bandControls[i]->bandParams;
-        bandControls[i]->setSelected(isSelected);
+        const auto isSelected = bc == bandSelectors[i]->bandParams;
+        bandSelectors[i]->select.setToggleState(isSelected, juce::dontSendNotification);
+
+        if (isSelected && bandControls[i] == nullptr)
+            bandControls.set(i, std::make_unique<BandControls>(this, bc).release());
+
+        if (auto controls = bandControls[i])
+            controls->setSelected(isSelected);
 
         if (isSelected)
             curBandControls = bandControls[i];
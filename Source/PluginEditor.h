@@ -81,20 +81,38 @@ public:
 private:
 };
 
+// Band selection button. It is cheap, so one exists per band at all times and
+// shows the band's enabled state and routing colour.
+struct BandSelector : public juce::AudioProcessorParameter::Listener
+{
+    BandSelector(AFEQAudioProcessorEditor* parent, BandParams* bandparams, int index);
+    ~BandSelector();
+
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int /*parameterIndex*/, bool /*gestureIsStarting*/) override {}
+    void updateEnableColour();
+
+    const AFEQAudioProcessor& processor;
+    BandParams* bandParams;
+    juce::TextButton select;
+};
+
+// Settings widgets of a band. These are only created once a band is selected.
 struct BandControls : public juce::AudioProcessorParameter::Listener
 {
     BandControls(AFEQAudioProcessorEditor* parent, BandParams* bandparams);
     ~BandControls();
 
     void setSelected(bool selected);
+    // (Re)creates the attachments, which read the parameters' values.
+    void attach(juce::AudioProcessorValueTreeState& apvts);
     void parameterValueChanged(int parameterIndex, float newValue) override;
     void parameterGestureChanged(int /*parameterIndex*/, bool /*gestureIsStarting*/) override {}
     void updateEnablement();
-    void updateEnableColour();
 
+    const AFEQAudioProcessor& processor;
     BandParams* bandParams;
 
-    juce::TextButton select;
     juce::TextButton enabled;
     juce::Slider freq;
     juce::Slider gain;
@@ -102,6 +120,14 @@ struct BandControls : public juce::AudioProcessorParameter::Listener
     juce::ComboBox type;
     RoutingSelector routing;
     juce::ComboBox order;
+
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> typeAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> routingAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> orderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> enabledAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> freqAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> gainAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> qAttachment;
 };
 
 
@@ -118,9 +144,12 @@ public:
     //==============================================================================
     void paint (juce::Graphics&) override;
     void resized() override;
+    bool keyPressed(const juce::KeyPress& key) override;
 
     void responseChanged();
     void syncWithProcessor();
+    // Shows the values parameter events set, from the view's timer.
+    void refreshAfterParameterEvents();
     void setActiveBand(BandParams* bc);
     BandParams* getActiveBand() const;
     juce::AudioProcessorValueTreeState& getAPValueTreeState();
@@ -128,17 +157,14 @@ public:
     bool isAnalyserEnabled() const;
     AFEQAudioProcessor& getAudioProcessor();
 
-    juce::OwnedArray<juce::AudioProcessorValueTreeState::ComboBoxAttachment> comboboxAttachments;
-    juce::OwnedArray<juce::AudioProcessorValueTreeState::ButtonAttachment> buttonAttachments;
-    juce::OwnedArray<juce::AudioProcessorValueTreeState::SliderAttachment> sliderAttachments;
-
 private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     AFEQAudioProcessor& audioProcessor;
 
     EQView eqView;
-    juce::OwnedArray<BandControls> bandControls;
+    juce::OwnedArray<BandSelector> bandSelectors;
+    juce::OwnedArray<BandControls> bandControls;    // one slot per band, filled on first selection
     std::unique_ptr<BandControls> bcNoSel;
     BandControls* curBandControls = nullptr;
     AFEQLookAndFeel afeqLookAndFeel;
@@ -149,5 +175,6 @@ private:
 
     juce::Rectangle<int> rectLeft;
     juce::Rectangle<int> rectRight;
+    juce::uint32 numShownParameterEvents = 0;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AFEQAudioProcessorEditor)
 };
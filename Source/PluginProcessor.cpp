@@ -8,57 +8,179 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "dsp/SharedTables.h"
 
+static std::shared_ptr<const juce::dsp::FFT> getSharedFFT(int fftOrder)
+{
+    static SharedTableRegistry<int, juce::dsp::FFT> registry;
+    return registry.get(fftOrder, [fftOrder]() { return std::make_unique<juce::dsp::FFT>(fftOrder); });
+}
+
+static size_t getFFTMemoryBytes(int fftOrder)
+{
+    // twiddle factors and permutation tables of the fallback engine
+    return sizeof(juce::dsp::FFT) + (static_cast<size_t> (1) << fftOrder) * (sizeof(std::complex<float>) + sizeof(int));
+}
+
+
+namespace
+{
+    // Ranges, converters and identifiers are identical for every instance, so
+    // they are built once per process and copied into each new layout.
+    struct ParameterTables
+    {
+        ParameterTables()
+            : freqRange(20.f, 20e3f,
+                [](float s, float e, float v) { return juce::jlimit(s, e, s * std::exp(std::log(e / s) * v)); },
+                [](float s, float e, float v) { return juce::jlimit(0.f, 1.f, std::log(v / s) / std::log(e / s)); },
+                [](float s, float e, float v) { v = juce::jlimit(s, e, v); return v < 1000 ? 0.1f * std::round(10.f * v) : std::round(v); }),
+            gainRange(-24.f, 24.f, 0.1f),
+            qRange(0.1f, 10.f,
+                [](float s, float e, float v) { return juce::jlimit(s, e, s * std::exp(std::log(e / s) * v)); },
+                [](float s, float e, float v) { return juce::jlimit(0.f, 1.f, std::log(v / s) / std::log(e / s)); },
+                [](float s, float e, float v) { v = juce::jlimit(s, e, v); return 0.01f * std::round(100.f * v); }),
+            thresholdRange(-60.f, 0.f, 0.1f),
+            ratioRange(1.f, 20.f, 0.01f, 0.4f),
+            attackRange(0.1f, 200.f, 0.1f, 0.3f),
+            releaseRange(5.f, 2000.f, 1.f, 0.3f),
+            types(BandParams::getTypeNames()),
+            routings(BandParams::getRoutingNames()),
+            engines(BandParams::getEngineNames())
+        {
+            for (int i = 0; i < AFEQAudioProcessor::numBands; ++i)
+            {
+                bandIds.emplace_back("Band " + juce::String(i + 1));
+                groupIds.add("band" + juce::String(i));
+            }
+        }
+
+        static const ParameterTables& get()
+        {
+            static const ParameterTables tables;
+            return tables;
+        }
+
+        juce::NormalisableRange<float> freqRange;
+        juce::NormalisableRange<float> gainRange;
+        juce::NormalisableRange<float> qRange;
+        juce::NormalisableRange<float> thresholdRange;
+        juce::NormalisableRange<float> ratioRange;
+        juce::NormalisableRange<float> attackRange;
+        juce::NormalisableRange<float> releaseRange;
+        juce::StringArray types;
+        juce::StringArray routings;
+        juce::StringArray engines;
+        std::vector<BandParams::Ids> bandIds;
+        juce::StringArray groupIds;
+
+        std::function<juce::String(float, int)> freqToStr = [](float v, int /*maxLen*/) {
+            return v < 1e3f ? juce::String(static_cast<int> (v)) : juce::String(v*0.001f, 2) + "k"; 
+        };
+        std::function<float(const juce::String&)> strToFreq = [](const juce::String& s) {
+            const auto s2 = s.replace("k", "."); 
+            const auto factor = s2.contains(".") ? 1000.f : 1.f;
+            return s2.getFloatValue() * factor;
+        };
+        std::function<juce::String(float, int)> qToStr = [](float v, int) { return juce::String(v, 3); };
+        std::function<juce::String(int, int)> orderToStr = [](int v, int) { return juce::String(6 * v); };
+        std::function<int(const juce::String&)> strToOrder = [](const juce::String& s) {
+            return juce::jlimit(1, AFEQAudioProcessor::maxOrder, s.getIntValue() / 6);
+        };
+    };
+
+    // Bands whose effect is over well below maxFreq, so nothing of it is lost
+    // above the pass band of the low rate.
+    bool fitsLowRate(const BandParams& bp, double maxFreq)
+    {
+        switch (bp.getType())
+        {
+        case BandParams::bandLoShelf:
+        case BandParams::bandHiPass:
+        case BandParams::bandVOHiPass:
+        case BandParams::bandVOLoShelf:
+            return bp.getFreq() <= maxFreq;
+        case BandParams::bandPeak:
+        case BandParams::bandVOBandShelf:
+            // wide bells reach far above their frequency
+            return bp.getQ() >= 0.5f && bp.getFreq() <= maxFreq;
+        default:
+            return false;
+        }
+    }
+
+    // Bands on channel subsets commute, mid and side mix the pair and only
+    // commute with each other and with bands on all channels.
+    bool routingsCommute(BandParams::Routing a, BandParams::Routing b)
+    {
+        const auto isMidSide = [](BandParams::Routing r) { return r == BandParams::routeMid || r == BandParams::routeSide; };
+        return a == BandParams::routeStereo || b == BandParams::routeStereo || isMidSide(a) == isMidSide(b);
+    }
+}
 
 juce::AudioProcessorValueTreeState::ParameterLayout AFEQAudioProcessor::getLayout()
 {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    const auto& tables = ParameterTables::get();
+    eqBands.ensureStorageAllocated(numBands);
 
-    auto freqRange = juce::NormalisableRange<float>(20.f, 20e3f,
-        [](float s, float e, float v) { return juce::jlimit(s, e, s * std::exp(std::log(e / s) * v)); },
-        [](float s, float e, float v) { return juce::jlimit(0.f, 1.f, std::log(v / s) / std::log(e / s)); },
-        [](float s, float e, float v) { v = juce::jlimit(s, e, v); return v < 1000 ? 0.1f * std::round(10.f * v) : std::round(v); });
-    auto gainRange = juce::NormalisableRange<float>(-24.f, 24.f, 0.1f);
-    auto qRange = juce::NormalisableRange<float>(0.1f, 10.f,
-        [](float s, float e, float v) { return juce::jlimit(s, e, s * std::exp(std::log(e / s) * v)); },
-        [](float s, float e, float v) { return juce::jlimit(0.f, 1.f, std::log(v / s) / std::log(e / s)); },
-        [](float s, float e, float v) { v = juce::jlimit(s, e, v); return 0.01f * std::round(100.f * v); });
-
-    auto freqToStr = [](float v, int /*maxLen*/) {
-        return v < 1e3f ? juce::String(static_cast<int> (v)) : juce::String(v*0.001f, 2) + "k"; 
-    };
-    auto strToFreq = [](const juce::String& s) {
-        const auto s2 = s.replace("k", "."); 
-        const auto factor = s2.contains(".") ? 1000.f : 1.f;
-        return s2.getFloatValue() * factor;
+    // The parameter pointers are handed to BandParams right here, so nothing
+    // has to look them up again once the value tree state owns them.
+    auto addParam = [](juce::AudioProcessorParameterGroup& grp, auto param, auto*& target) {
+        target = param.get();
+        grp.addChild(std::move(param));
     };
-    const auto types = BandParams::getTypeNames();
-    const auto routings = BandParams::getRoutingNames();
 
     for (int i = 0; i < numBands; ++i)
     {
         auto eqBand = eqBands.add(std::make_unique<EqBandDsp>(maxOrder, freqResBase, i+1));
         auto& bp = eqBand->getBandParams();
-        bp.setBandId("Band " + juce::String(i + 1));
-        auto grp = std::make_unique<juce::AudioProcessorParameterGroup>("band"+juce::String(i), bp.getBandId(), "|");
-        grp->addChild(std::make_unique<juce::AudioParameterBool> (juce::ParameterID(bp.enableId.toString(), 1), bp.enableId.toString(), false));
-        grp->addChild(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(bp.typeId.toString(), 1), bp.typeId.toString(), types, 0));
-        grp->addChild(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(bp.routingId.toString(), 1), bp.routingId.toString(), routings, 0));
-        grp->addChild(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.freqId.toString(), 1), bp.freqId.toString(),
-            freqRange, 1000.f, "Hz", juce::AudioProcessorParameter::genericParameter, freqToStr, strToFreq));
-        grp->addChild(std::make_unique<juce::AudioParameterFloat> (juce::ParameterID(bp.gainId.toString(), 1), bp.gainId.toString(),
-            gainRange, 0.f, "dB"));
-        grp->addChild(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.qId.toString(), 1), bp.qId.toString(),
-            qRange, 0.707f, "", juce::AudioProcessorParameter::genericParameter, 
-            [](float v, int) { return juce::String(v, 3); }));
-        grp->addChild(std::make_unique<juce::AudioParameterInt>(juce::ParameterID(bp.orderId.toString(), 1), bp.orderId.toString(),
-            1, AFEQAudioProcessor::maxOrder, 2, "db/Oct",
-            [](int v, int) { return juce::String(6 * v); },
-            [](const juce::String& s) { return juce::jlimit(1, AFEQAudioProcessor::maxOrder, s.getIntValue() / 6); }));
+        bp.setIds(tables.bandIds[static_cast<size_t> (i)]);
+        bp.holdDesign = &restoreSequence;
+        auto grp = std::make_unique<juce::AudioProcessorParameterGroup>(tables.groupIds[i], bp.getBandId(), "|");
+        addParam(*grp, std::make_unique<juce::AudioParameterBool> (juce::ParameterID(bp.enableId.toString(), 1), bp.enableId.toString(), false),
+            bp.enabledParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(bp.typeId.toString(), 1), bp.typeId.toString(), tables.types, 0),
+            bp.typeParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(bp.routingId.toString(), 1), bp.routingId.toString(), tables.routings, 0),
+            bp.routingParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.freqId.toString(), 1), bp.freqId.toString(),
+            tables.freqRange, 1000.f, "Hz", juce::AudioProcessorParameter::genericParameter, tables.freqToStr, tables.strToFreq),
+            bp.freqParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterFloat> (juce::ParameterID(bp.gainId.toString(), 1), bp.gainId.toString(),
+            tables.gainRange, 0.f, "dB"),
+            bp.gainParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.qId.toString(), 1), bp.qId.toString(),
+            tables.qRange, 0.707f, "", juce::AudioProcessorParameter::genericParameter, tables.qToStr),
+            bp.qParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterInt>(juce::ParameterID(bp.orderId.toString(), 1), bp.orderId.toString(),
+            1, AFEQAudioProcessor::maxOrder, 2, "db/Oct", tables.orderToStr, tables.strToOrder),
+            bp.orderParam);
+
+        // added after the first release, hosts need the later version hint
+        addParam(*grp, std::make_unique<juce::AudioParameterBool>(juce::ParameterID(bp.dynamicId.toString(), 2), bp.dynamicId.toString(), false),
+            bp.dynamicParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.thresholdId.toString(), 2), bp.thresholdId.toString(),
+            tables.thresholdRange, -20.f, "dB"),
+            bp.thresholdParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.ratioId.toString(), 2), bp.ratioId.toString(),
+            tables.ratioRange, 2.f, ":1"),
+            bp.ratioParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.attackId.toString(), 2), bp.attackId.toString(),
+            tables.attackRange, 10.f, "ms"),
+            bp.attackParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bp.releaseId.toString(), 2), bp.releaseId.toString(),
+            tables.releaseRange, 100.f, "ms"),
+            bp.releaseParam);
+        addParam(*grp, std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(bp.engineId.toString(), 2), bp.engineId.toString(), tables.engines, 0),
+            bp.engineParam);
 
         layout.add(std::move(grp));
     }
 
+    auto morphPosition = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Morph", 2), "Morph", 0.f, 1.f, 0.f);
+    morphParam = morphPosition.get();
+    layout.add(std::move(morphPosition));
+
     return layout;
 }
 
@@ -66,14 +188,47 @@ juce::AudioProcessorValueTreeState::ParameterLayout AFEQAudioProcessor::getLayou
 AFEQAudioProcessor::AFEQAudioProcessor()
     : AudioProcessor (BusesProperties().withInput  ("Input",  juce::AudioChannelSet::stereo(), true).withOutput ("Output", juce::AudioChannelSet::stereo(), true))
 {
-    state = std::make_unique<juce::AudioProcessorValueTreeState>(*this, &undoManager, "STATE", getLayout());
-    
-    for (auto band : eqBands)
-        band->getBandParams().syncParameters(*state);
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    state = std::make_unique<juce::AudioProcessorValueTreeState>(*this, nullptr, "STATE", getLayout());
+    addListener(this);
+    parameterEvents.reserve(maxParameterEvents);
+
+    constructionTime = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+}
+
+double AFEQAudioProcessor::getConstructionTime() const
+{
+    return constructionTime;
+}
+
+double AFEQAudioProcessor::getRestoreTime() const
+{
+    return restoreTime;
+}
+
+void AFEQAudioProcessor::beginRestore()
+{
+    restoreSequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void AFEQAudioProcessor::endRestore()
+{
+    restoreSequence.fetch_add(1, std::memory_order_release);
+}
+
+bool AFEQAudioProcessor::isRestoringState() const
+{
+    return (restoreSequence.load(std::memory_order_acquire) & 1) != 0;
 }
 
 AFEQAudioProcessor::~AFEQAudioProcessor()
 {
+    removeListener(this);
+    designer.release();
+    workerPool.reset();
+    linearPhaseEq.reset();
     state.reset();
 }
 
@@ -130,42 +285,197 @@ void AFEQAudioProcessor::changeProgramName (int /*index*/, const juce::String& /
 //==============================================================================
 void AFEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    procBuffer.setSize(2, samplesPerBlock);
-    freqResBase.setSampleRate(static_cast<float> (sampleRate));
+    const auto layout = getChannelLayoutOfBus(true, 0);
+    const auto previousNumChannels = procBuffer.getNumChannels();
+    procBuffer.setSize(juce::jmax(1, getTotalNumInputChannels(), getTotalNumOutputChannels()), samplesPerBlock);
+    parameterEvents.clear();
+    blockStartSample = 0;
+
+    const auto previousOptions = activeOptions;
+
+    {
+        const juce::ScopedLock sl(optionsLock);
+        activeOptions = options;
+    }
+
+    // Only what a changed setting needs is rebuilt; with unchanged settings the
+    // objects and their threads stay and only start over, without allocating.
+    const auto firstPrepare = preparedSampleRate <= 0.0;
+    const auto rateChanged = firstPrepare || sampleRate != preparedSampleRate;
+    const auto blockChanged = firstPrepare || samplesPerBlock != preparedBlockSize;
+    const auto layoutChanged = firstPrepare || layout != preparedLayout || procBuffer.getNumChannels() != previousNumChannels;
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = samplesPerBlock;
+    preparedLayout = layout;
+
+    prepared = true;
+    const auto oversamplingFactor = juce::jlimit(1, 8, juce::nextPowerOfTwo(activeOptions.oversamplingFactor));
+    const auto linearPhaseEnabled = activeOptions.linearPhaseEnabled;
+    const auto svfEngineEnabled = activeOptions.svfEngineEnabled;
+
+    // the linear phase mode runs at the host rate
+    const auto factor = linearPhaseEnabled ? 1 : oversamplingFactor;
+    const auto previousFactor = previousOptions.linearPhaseEnabled ? 1 : juce::jlimit(1, 8, juce::nextPowerOfTwo(previousOptions.oversamplingFactor));
+
+    if (factor == 1)
+    {
+        oversampling.reset();
+    }
+    else if (oversampling == nullptr || blockChanged || layoutChanged || factor != previousFactor
+             || activeOptions.oversamplingLinearPhase != previousOptions.oversamplingLinearPhase)
+    {
+        const auto filterType = activeOptions.oversamplingLinearPhase ? juce::dsp::Oversampling<double>::filterHalfBandFIREquiripple
+                                                        : juce::dsp::Oversampling<double>::filterHalfBandPolyphaseIIR;
+        oversampling = std::make_unique<juce::dsp::Oversampling<double>>(static_cast<size_t> (procBuffer.getNumChannels()),
+            static_cast<size_t> (juce::roundToInt(std::log2(factor))), filterType, true, true);
+        oversampling->initProcessing(static_cast<size_t> (samplesPerBlock));
+        oversampledChannels.assign(static_cast<size_t> (procBuffer.getNumChannels()), nullptr);
+    }
+    else
+    {
+        oversampling->reset();
+    }
+
+    // the response curve shows the bands as designed at the oversampled rate
+    processSampleRate = sampleRate * factor;
+    const auto processBlockSize = samplesPerBlock * factor;
+    freqResBase.setSampleRate(static_cast<float> (processSampleRate));
+
+    const auto bandsChanged = rateChanged || blockChanged || layoutChanged || factor != previousFactor
+        || svfEngineEnabled != previousOptions.svfEngineEnabled;
+    const auto groupsChanged = firstPrepare || layoutChanged || activeOptions.numWorkers != previousOptions.numWorkers
+        || linearPhaseEnabled != previousOptions.linearPhaseEnabled;
+
+    // The bands keep their filters when their layout stays; in kept channel
+    // groups the first group's layout is theirs.
+    const auto bandLayout = groupsChanged || groupChains.isEmpty() ? layout : groupChains.getFirst()->layout;
 
     for (auto b : eqBands)
     {
-        b->setBlockSize(samplesPerBlock);
-        b->setSampleRate(sampleRate);
+        b->setBlockSize(processBlockSize);
+        b->setSampleRate(processSampleRate);
+        b->setChannelLayout(bandLayout);
+        b->setSvfForced(svfEngineEnabled);
+    }
+    const auto multirateChanged = bandsChanged || groupsChanged || activeOptions.multirateEnabled != previousOptions.multirateEnabled;
+
+    prepareChannelGroups(layout, processSampleRate, processBlockSize, groupsChanged);
+    prepareMultirate(layout, processSampleRate, processBlockSize, multirateChanged);
+
+    if (bandsChanged || groupsChanged || multirateChanged)
+    {
+        std::vector<EqBandDsp*> designed(eqBands.begin(), eqBands.end());
+
+        for (auto g : groupChains)
+            designed.insert(designed.end(), g->ownedBands.begin(), g->ownedBands.end());
+
+        designed.insert(designed.end(), lowBands.begin(), lowBands.end());
+        designer.setActive(! isNonRealtime());
+        designer.prepare(designed);
+    }
+    else
+    {
+        designer.setActive(! isNonRealtime());
+    }
+
+    if (bandsChanged)
+    {
+        snapshots.prepare(processSampleRate, processBlockSize, layout, svfEngineEnabled);
+        morph.prepare(processSampleRate, processBlockSize, layout, svfEngineEnabled);
+    }
+
+    // only the inline chain runs as a parallel form, at the bands' section capacity
+    if (activeOptions.parallelFormEnabled && ! linearPhaseEnabled && ! multirateActive && groupChains.isEmpty())
+    {
+        if (parallelChain == nullptr || bandsChanged)
+        {
+            parallelChain = std::make_unique<ParallelBandChain>(numBands, 2 * ((maxOrder + 1) / 2));
+            parallelChain->prepare(processSampleRate, processBlockSize, layout.size());
+        }
+        else
+        {
+            parallelChain->reset();
+        }
+    }
+    else
+    {
+        parallelChain.reset();
+    }
+
+    if (oversampling != nullptr)
+        setLatencySamples(juce::roundToInt(oversampling->getLatencyInSamples()));
+
+    if (! linearPhaseEnabled)
+    {
+        linearPhaseEq.reset();
     }
+    else if (linearPhaseEq == nullptr || rateChanged || layoutChanged
+             || activeOptions.linearPhasePartitionSize != previousOptions.linearPhasePartitionSize
+             || activeOptions.linearPhaseNonUniform != previousOptions.linearPhaseNonUniform)
+    {
+        EqBandDspGroup designBands;
+
+        for (int i = 0; i < numBands; ++i)
+            addBoundBand(designBands, i);
+
+        const auto partitionSize = juce::jlimit(32, 8192, juce::nextPowerOfTwo(activeOptions.linearPhasePartitionSize));
+        linearPhaseEq = std::make_unique<LinearPhaseEq>();
+        linearPhaseEq->prepare(designBands, layout, sampleRate, partitionSize, activeOptions.linearPhaseNonUniform);
+    }
+    else
+    {
+        linearPhaseEq->reset();
+    }
+
+    if (linearPhaseEq != nullptr)
+        setLatencySamples(linearPhaseEq->getLatency());
 
     {
         const int fftOrder = 13;
         const int numAnalyserBands = 61;
         const int overlap = 4;
-        fftAnalyser = std::make_unique<FFTAnalyser>(fftOrder, overlap, numAnalyserBands, 0.3f, static_cast<int> (sampleRate));
-        fft = std::make_unique<juce::dsp::FFT>(fftOrder);
-        fftBuffer.resize(1 << (fftOrder + 1));
-
-        fftAnalyser->performFFT = [this](float* data, int size) {
-            juce::FloatVectorOperations::copy(fftBuffer.data(), data, size);
-            fft->performRealOnlyForwardTransform(fftBuffer.data(), true);
-            const auto gain = std::sqrt(static_cast<float> (size) / static_cast<float> (1 << 14)) / static_cast<float> (std::sqrt(size));
-            juce::FloatVectorOperations::copyWithMultiply(data, fftBuffer.data(), gain, size);
-        };
+
+        if (fftAnalyser == nullptr)
+        {
+            fftAnalyser = std::make_unique<FFTAnalyser>();
+            fftAnalyser->performFFT = [this](float* data, int size) {
+                juce::FloatVectorOperations::copy(fftBuffer.data(), data, size);
+                fft->performRealOnlyForwardTransform(fftBuffer.data(), true);
+                const auto gain = std::sqrt(static_cast<float> (size) / static_cast<float> (1 << 14)) / static_cast<float> (std::sqrt(size));
+                juce::FloatVectorOperations::copyWithMultiply(data, fftBuffer.data(), gain, size);
+            };
+        }
+
+        fftAnalyser->prepare(FFTAnalyser::getPlan(fftOrder, overlap, numAnalyserBands, 0.3f, static_cast<int> (sampleRate)));
+
+        if (fft == nullptr || fft->getSize() != (1 << fftOrder))
+        {
+            fft = getSharedFFT(fftOrder);
+            fftBuffer.resize(1 << (fftOrder + 1));
+        }
     }
 }
 
 void AFEQAudioProcessor::releaseResources()
 {
+    // The objects keep their threads, which idle until the next prepareToPlay
+    // reuses them or the destructor stops them.
+    prepared = false;
+
+    if (oversampling != nullptr)
+        oversampling->reset();
+}
+
+void AFEQAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    designer.setActive(! isNonRealtime);
 }
 
 bool AFEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout, the band routings look up their channels by type.
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -177,20 +487,26 @@ bool AFEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) con
 
 void AFEQAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    jassert(buffer.getNumSamples() <= procBuffer.getNumSamples() && buffer.getNumChannels() <= procBuffer.getNumChannels());
+
+    // Only the channels and samples of this call, the filters must not run over
+    // stale data when the host passes a shorter block or a mono buffer.
+    juce::AudioBuffer<double> procBlock(procBuffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples());
+
     for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
     {
         const auto in = buffer.getReadPointer(ch);
-        auto out = procBuffer.getWritePointer(ch);
+        auto out = procBlock.getWritePointer(ch);
 
         for (int i = 0; i < buffer.getNumSamples(); ++i)
             out[i] = static_cast<double> (in[i]);
     }
 
-    processBlock(procBuffer, midiMessages);
+    processBlock(procBlock, midiMessages);
 
     for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
     {
-        const auto in = procBuffer.getReadPointer(ch);
+        const auto in = procBlock.getReadPointer(ch);
         auto out = buffer.getWritePointer(ch);
 
         for (int i = 0; i < buffer.getNumSamples(); ++i)
@@ -214,8 +530,22 @@ void AFEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::
     if (analyserProc == kAnalyserPre)
         fftAnalyser->processBlock(chL, chR, numSamples);
 
-    for (auto b : eqBands)
-        b->processBlock(chL, chR, numSamples);
+    if (oversampling != nullptr)
+    {
+        juce::dsp::AudioBlock<double> block(buffer);
+        const auto upBlock = oversampling->processSamplesUp(block);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            oversampledChannels[static_cast<size_t> (ch)] = upBlock.getChannelPointer(static_cast<size_t> (ch));
+
+        juce::AudioBuffer<double> upBuffer(oversampledChannels.data(), numChannels, static_cast<int> (upBlock.getNumSamples()));
+        processBandsAtEvents(upBuffer, static_cast<int> (oversampling->getOversamplingFactor()));
+        oversampling->processSamplesDown(block);
+    }
+    else
+    {
+        processBandsAtEvents(buffer, 1);
+    }
 
     if (dspResponseChanged())
         updateGlobalResponse();
@@ -224,6 +554,128 @@ void AFEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::
         fftAnalyser->processBlock(chL, chR, numSamples);
 }
 
+bool AFEQAudioProcessor::addParameterEvent(int parameterIndex, float normalisedValue, int sampleOffset)
+{
+    if (parameterEvents.size() == parameterEvents.capacity() || ! juce::isPositiveAndBelow(parameterIndex, getParameters().size()))
+        return false;
+
+    const ParameterEvent e { blockStartSample + juce::jmax(0, sampleOffset), parameterIndex, juce::jlimit(0.f, 1.f, normalisedValue) };
+
+    // hosts send the changes of each parameter in order, this only passes
+    // later changes of other parameters
+    auto pos = parameterEvents.end();
+
+    while (pos != parameterEvents.begin() && (pos - 1)->time > e.time)
+        --pos;
+
+    parameterEvents.insert(pos, e);
+    return true;
+}
+
+juce::uint32 AFEQAudioProcessor::getNumAppliedParameterEvents() const
+{
+    return numAppliedParameterEvents.load(std::memory_order_acquire);
+}
+
+juce::int64 AFEQAudioProcessor::getDueSample(const ParameterEvent& e)
+{
+    return (e.time + automationInterval - 1) / automationInterval * automationInterval;
+}
+
+void AFEQAudioProcessor::processBandsAtEvents(juce::AudioBuffer<double>& buffer, int factor)
+{
+    const auto numSamples = buffer.getNumSamples() / factor;
+
+    if (numSamples == 0)
+        return;
+
+    if (parameterEvents.empty())
+    {
+        processBands(buffer);
+        blockStartSample += numSamples;
+        return;
+    }
+
+    const auto& params = getParameters();
+    size_t numApplied = 0;
+    int pos = 0;
+
+    while (pos < numSamples)
+    {
+        // everything due by now applies together, so the bands see it as one change
+        while (numApplied < parameterEvents.size() && getDueSample(parameterEvents[numApplied]) <= blockStartSample + pos)
+        {
+            // the bands read the parameter; its listeners include the host's,
+            // which would report the change back as an edit
+            const auto& e = parameterEvents[numApplied++];
+            params[e.index]->setValue(e.value);
+            numAppliedParameterEvents.fetch_add(1, std::memory_order_release);
+        }
+
+        auto end = numSamples;
+
+        if (numApplied < parameterEvents.size())
+            end = static_cast<int> (juce::jmin(static_cast<juce::int64> (numSamples), getDueSample(parameterEvents[numApplied]) - blockStartSample));
+
+        juce::AudioBuffer<double> part(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), pos * factor, (end - pos) * factor);
+        processBands(part);
+        pos = end;
+    }
+
+    // changes due after this block wait for the next one
+    parameterEvents.erase(parameterEvents.begin(), parameterEvents.begin() + static_cast<std::ptrdiff_t> (numApplied));
+    blockStartSample += numSamples;
+}
+
+void AFEQAudioProcessor::processBands(juce::AudioBuffer<double>& buffer)
+{
+    if (linearPhaseEq != nullptr)
+    {
+        // the bands only keep the response current
+        for (auto b : eqBands)
+            b->update();
+
+        linearPhaseEq->process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples());
+    }
+    else if (multirateActive)
+    {
+        processMultirate(buffer);
+    }
+    else if (groupChains.isEmpty())
+    {
+        const auto channels = buffer.getArrayOfWritePointers();
+
+        if (morph.process(eqBands, channels, buffer.getNumChannels(), buffer.getNumSamples(), morphParam->get()))
+        {
+            // the bands only keep the response current
+            for (auto b : eqBands)
+                b->update();
+
+            if (parallelChain != nullptr)
+                parallelChain->suspend(eqBands);
+        }
+        else
+        {
+            // a snapshot switch fades out the bands' own cascades
+            if (parallelChain != nullptr && snapshots.isSwitching())
+                parallelChain->suspend(eqBands);
+
+            if (! snapshots.process(eqBands, channels, buffer.getNumChannels(), buffer.getNumSamples()))
+            {
+                if (parallelChain != nullptr)
+                    parallelChain->process(eqBands, channels, buffer.getNumChannels(), buffer.getNumSamples());
+                else
+                    for (auto b : eqBands)
+                        b->processBlock(channels, buffer.getNumChannels(), buffer.getNumSamples());
+            }
+        }
+    }
+    else
+    {
+        processChannelGroups(buffer);
+    }
+}
+
 //==============================================================================
 bool AFEQAudioProcessor::hasEditor() const
 {
@@ -244,30 +696,342 @@ juce::AudioProcessorEditor* AFEQAudioProcessor::createEditor()
 
 //==============================================================================
 void AFEQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    captureState().writeTo(destData);
+}
+
+void AFEQAudioProcessor::getXmlStateInformation(juce::MemoryBlock& destData)
 {
     auto s2 = state->copyState();
+
+    // parameter events don't reach the tree, the copy takes the parameters' values
+    for (auto child : s2)
+        if (auto param = dynamic_cast<juce::RangedAudioParameter*> (state->getParameter(child.getProperty("id").toString())))
+            child.setProperty("value", param->convertFrom0to1(param->getValue()), nullptr);
     std::unique_ptr<juce::XmlElement> xml(std::make_unique<juce::XmlElement> ("AFEQSTATE"));
     xml->setAttribute("scale", guiScale);
     xml->setAttribute("analyser", analyserProc);
+    const auto o = getProcessingOptions();
+    xml->setAttribute("workers", o.numWorkers);
+    xml->setAttribute("multirate", o.multirateEnabled);
+    xml->setAttribute("oversampling", o.oversamplingFactor);
+    xml->setAttribute("linearPhase", o.oversamplingLinearPhase);
+    xml->setAttribute("linearPhaseEq", o.linearPhaseEnabled);
+    xml->setAttribute("partitionSize", o.linearPhasePartitionSize);
+    xml->setAttribute("nonUniform", o.linearPhaseNonUniform);
+    xml->setAttribute("svf", o.svfEngineEnabled);
+    xml->setAttribute("parallel", o.parallelFormEnabled);
     xml->addChildElement(s2.createXml().release());
     copyXmlToBinary(*xml, destData);
 }
 
 void AFEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    auto restored = false;
 
-    if (xmlState.get() != nullptr && xmlState->hasTagName("AFEQSTATE"))
+    if (PluginState::isBinaryState(data, sizeInBytes))
     {
-        if (auto vtState = xmlState->getChildByName(state->state.getType()))
-            state->replaceState(juce::ValueTree::fromXml(*vtState));
+        PluginState ps;
+        restored = ps.readFrom(data, sizeInBytes);
 
-        guiScale = static_cast<float> (xmlState->getDoubleAttribute("scale"));
-        analyserProc = static_cast<AnalyserProcessing> (xmlState->getIntAttribute("analyser", static_cast<int> (analyserProc)));
+        if (restored)
+            applyState(ps);
+    }
+    else
+    {
+        restored = setXmlStateInformation(data, sizeInBytes);
+    }
+
+    if (restored)
+    {
+        undoHistory.clear();
 
         if (auto ed = dynamic_cast<AFEQAudioProcessorEditor*>(getActiveEditor()))
             juce::MessageManager::callAsync([ed, this]() { ed->syncWithProcessor(); });
     }
+
+    restoreTime = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+}
+
+bool AFEQAudioProcessor::setXmlStateInformation(const void* data, int sizeInBytes)
+{
+    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+
+    if (xmlState.get() == nullptr || ! xmlState->hasTagName("AFEQSTATE"))
+        return false;
+
+    // The values arrive one parameter at a time. Every band keeps its
+    // design until all are in and redesigns once in the next block.
+    beginRestore();
+
+    if (auto vtState = xmlState->getChildByName(state->state.getType()))
+        state->replaceState(juce::ValueTree::fromXml(*vtState));
+
+    endRestore();
+
+    guiScale = static_cast<float> (xmlState->getDoubleAttribute("scale"));
+    analyserProc = static_cast<AnalyserProcessing> (xmlState->getIntAttribute("analyser", static_cast<int> (analyserProc)));
+    auto o = getProcessingOptions();
+    o.numWorkers = xmlState->getIntAttribute("workers", o.numWorkers);
+    o.multirateEnabled = xmlState->getBoolAttribute("multirate", o.multirateEnabled);
+    o.oversamplingFactor = xmlState->getIntAttribute("oversampling", o.oversamplingFactor);
+    o.oversamplingLinearPhase = xmlState->getBoolAttribute("linearPhase", o.oversamplingLinearPhase);
+    o.linearPhaseEnabled = xmlState->getBoolAttribute("linearPhaseEq", o.linearPhaseEnabled);
+    o.linearPhasePartitionSize = xmlState->getIntAttribute("partitionSize", o.linearPhasePartitionSize);
+    o.linearPhaseNonUniform = xmlState->getBoolAttribute("nonUniform", o.linearPhaseNonUniform);
+    o.svfEngineEnabled = xmlState->getBoolAttribute("svf", o.svfEngineEnabled);
+    o.parallelFormEnabled = xmlState->getBoolAttribute("parallel", o.parallelFormEnabled);
+    restoreProcessingOptions(o);
+    return true;
+}
+
+PluginState AFEQAudioProcessor::captureState() const
+{
+    PluginState ps;
+    ps.bands = captureBands();
+    ps.scale = guiScale;
+    ps.analyser = static_cast<int> (analyserProc);
+    const auto o = getProcessingOptions();
+    ps.workers = o.numWorkers;
+    ps.multirate = o.multirateEnabled;
+    ps.oversampling = o.oversamplingFactor;
+    ps.oversamplingLinearPhase = o.oversamplingLinearPhase;
+    ps.linearPhase = o.linearPhaseEnabled;
+    ps.partitionSize = o.linearPhasePartitionSize;
+    ps.nonUniform = o.linearPhaseNonUniform;
+    ps.svf = o.svfEngineEnabled;
+    ps.parallel = o.parallelFormEnabled;
+
+    for (int slot = 0; slot < SnapshotBank::numSlots; ++slot)
+        ps.snapshots.push_back(snapshots.getValues(slot));
+
+    ps.morph = morphParam->get();
+    ps.morphA = morphSlotA;
+    ps.morphB = morphSlotB;
+    return ps;
+}
+
+void AFEQAudioProcessor::applyState(const PluginState& ps)
+{
+    applyBands(ps.bands);
+
+    guiScale = ps.scale;
+    analyserProc = static_cast<AnalyserProcessing> (juce::jlimit(0, 2, ps.analyser));
+    ProcessingOptions o;
+    o.numWorkers = ps.workers;
+    o.multirateEnabled = ps.multirate;
+    o.oversamplingFactor = ps.oversampling;
+    o.oversamplingLinearPhase = ps.oversamplingLinearPhase;
+    o.linearPhaseEnabled = ps.linearPhase;
+    o.linearPhasePartitionSize = ps.partitionSize;
+    o.linearPhaseNonUniform = ps.nonUniform;
+    o.svfEngineEnabled = ps.svf;
+    o.parallelFormEnabled = ps.parallel;
+    restoreProcessingOptions(o);
+
+    for (int slot = 0; slot < SnapshotBank::numSlots; ++slot)
+        snapshots.store(slot, static_cast<size_t> (slot) < ps.snapshots.size() ? ps.snapshots[static_cast<size_t> (slot)] : UndoHistory::Bands());
+
+    if (morphParam->get() != ps.morph)
+        *morphParam = ps.morph;
+
+    if (! setMorphSlots(ps.morphA, ps.morphB))
+        clearMorph();
+}
+
+UndoHistory::Bands AFEQAudioProcessor::captureBands() const
+{
+    UndoHistory::Bands bands(static_cast<size_t> (numBands));
+
+    for (int i = 0; i < numBands; ++i)
+    {
+        const auto& bp = eqBands[i]->getBandParams();
+        auto& b = bands[static_cast<size_t> (i)];
+        b.enabled = bp.enabledParam->get();
+        b.type = bp.typeParam->getIndex();
+        b.routing = bp.routingParam->getIndex();
+        b.freq = bp.freqParam->get();
+        b.gain = bp.gainParam->get();
+        b.q = bp.qParam->get();
+        b.order = bp.orderParam->get();
+        b.dynamic = bp.dynamicParam->get();
+        b.threshold = bp.thresholdParam->get();
+        b.ratio = bp.ratioParam->get();
+        b.attack = bp.attackParam->get();
+        b.release = bp.releaseParam->get();
+        b.engine = bp.engineParam->getIndex();
+    }
+
+    return bands;
+}
+
+void AFEQAudioProcessor::applyBands(const UndoHistory::Bands& bands)
+{
+    // Only changed parameters notify the host and the listeners, and the
+    // bands hold their designs until all are set.
+    beginRestore();
+
+    const auto num = juce::jmin(numBands, static_cast<int> (bands.size()));
+
+    for (int i = 0; i < num; ++i)
+    {
+        const auto& bp = eqBands[i]->getBandParams();
+        const auto& b = bands[static_cast<size_t> (i)];
+
+        if (bp.enabledParam->get() != b.enabled)
+            *bp.enabledParam = b.enabled;
+        if (bp.typeParam->getIndex() != b.type)
+            *bp.typeParam = b.type;
+        if (bp.routingParam->getIndex() != b.routing)
+            *bp.routingParam = b.routing;
+        if (bp.freqParam->get() != b.freq)
+            *bp.freqParam = b.freq;
+        if (bp.gainParam->get() != b.gain)
+            *bp.gainParam = b.gain;
+        if (bp.qParam->get() != b.q)
+            *bp.qParam = b.q;
+        if (bp.orderParam->get() != b.order)
+            *bp.orderParam = b.order;
+        if (bp.dynamicParam->get() != b.dynamic)
+            *bp.dynamicParam = b.dynamic;
+        if (bp.thresholdParam->get() != b.threshold)
+            *bp.thresholdParam = b.threshold;
+        if (bp.ratioParam->get() != b.ratio)
+            *bp.ratioParam = b.ratio;
+        if (bp.attackParam->get() != b.attack)
+            *bp.attackParam = b.attack;
+        if (bp.releaseParam->get() != b.release)
+            *bp.releaseParam = b.release;
+        if (bp.engineParam->getIndex() != b.engine)
+            *bp.engineParam = b.engine;
+    }
+
+    endRestore();
+}
+
+bool AFEQAudioProcessor::undo()
+{
+    auto bands = captureBands();
+
+    if (! undoHistory.undo(bands))
+        return false;
+
+    clearMorph();
+    applyBands(bands);
+    syncEditor();
+    return true;
+}
+
+bool AFEQAudioProcessor::redo()
+{
+    auto bands = captureBands();
+
+    if (! undoHistory.redo(bands))
+        return false;
+
+    clearMorph();
+    applyBands(bands);
+    syncEditor();
+    return true;
+}
+
+const UndoHistory& AFEQAudioProcessor::getUndoHistory() const
+{
+    return undoHistory;
+}
+
+void AFEQAudioProcessor::storeSnapshot(int slot)
+{
+    snapshots.store(slot, captureBands());
+
+    if (slot == morphSlotA || slot == morphSlotB)
+        setMorphSlots(morphSlotA, morphSlotB);
+}
+
+bool AFEQAudioProcessor::recallSnapshot(int slot)
+{
+    if (! snapshots.isStored(slot))
+        return false;
+
+    clearMorph();
+
+    // The switch is requested before the parameters change, so the audio
+    // thread takes it instead of designing for the new values.
+    if (linearPhaseEq == nullptr && ! multirateActive && groupChains.isEmpty())
+        snapshots.requestSwitch(slot);
+
+    applyBands(snapshots.getValues(slot));
+    syncEditor();
+    return true;
+}
+
+bool AFEQAudioProcessor::isSnapshotStored(int slot) const
+{
+    return snapshots.isStored(slot);
+}
+
+bool AFEQAudioProcessor::isSnapshotReady(int slot) const
+{
+    return snapshots.isReady(slot);
+}
+
+bool AFEQAudioProcessor::setMorphSlots(int a, int b)
+{
+    if (! snapshots.isStored(a) || ! snapshots.isStored(b))
+        return false;
+
+    morphSlotA = a;
+    morphSlotB = b;
+    morph.setSources(snapshots.getValues(a), snapshots.getValues(b));
+    return true;
+}
+
+void AFEQAudioProcessor::clearMorph()
+{
+    morphSlotA = -1;
+    morphSlotB = -1;
+    morph.clearSources();
+}
+
+bool AFEQAudioProcessor::isMorphing() const
+{
+    return morph.hasSources();
+}
+
+bool AFEQAudioProcessor::isMorphReady() const
+{
+    return morph.isReady();
+}
+
+int AFEQAudioProcessor::getMorphSlotA() const
+{
+    return morphSlotA;
+}
+
+int AFEQAudioProcessor::getMorphSlotB() const
+{
+    return morphSlotB;
+}
+
+void AFEQAudioProcessor::syncEditor()
+{
+    if (auto ed = dynamic_cast<AFEQAudioProcessorEditor*>(getActiveEditor()))
+        ed->syncWithProcessor();
+}
+
+void AFEQAudioProcessor::audioProcessorParameterChangeGestureBegin(juce::AudioProcessor*, int parameterIndex)
+{
+    // the morph plays instead of the bands, an edit of them would only be drawn
+    if (parameterIndex != morphParam->getParameterIndex())
+        clearMorph();
+
+    undoHistory.beginGesture(captureBands());
+}
+
+void AFEQAudioProcessor::audioProcessorParameterChangeGestureEnd(juce::AudioProcessor*, int)
+{
+    undoHistory.endGesture(captureBands());
 }
 
 bool AFEQAudioProcessor::dspResponseChanged() const
@@ -306,6 +1070,7 @@ void AFEQAudioProcessor::updateGlobalResponse()
         {
             const auto routing = b->getBandParamsConst().getRouting();
 
+            // channel group routings are drawn on the main curve
             auto& res = routing == BandParams::routeLeft ? resL
                 : routing == BandParams::routeRight ? resR
                 : routing == BandParams::routeMid ? resM
@@ -325,11 +1090,354 @@ void AFEQAudioProcessor::updateGlobalResponse()
         juce::MessageManager::callAsync([ed, this]() { ed->responseChanged(); });
 }
 
+EqBandDsp* AFEQAudioProcessor::addBoundBand(EqBandDspGroup& bands, int index)
+{
+    auto band = bands.add(std::make_unique<EqBandDsp>(maxOrder, freqResBase, index + 1));
+    band->getBandParams().setIds(ParameterTables::get().bandIds[static_cast<size_t> (index)]);
+    band->getBandParams().syncParameters(*state);
+    band->getBandParams().holdDesign = &restoreSequence;
+    band->setSvfForced(activeOptions.svfEngineEnabled);
+    return band;
+}
+
+void AFEQAudioProcessor::prepareChannelGroups(const juce::AudioChannelSet& layout, double sampleRate, int samplesPerBlock, bool rebuild)
+{
+    inlineBlocksLeft = 0;
+
+    // the same groups and workers, only the bands start over
+    if (! rebuild)
+    {
+        for (auto group : groupChains)
+        {
+            for (auto band : group->bands)
+            {
+                band->setBlockSize(samplesPerBlock);
+                band->setSampleRate(sampleRate);
+                band->setChannelLayout(group->layout);
+            }
+        }
+
+        return;
+    }
+
+    workerPool.reset();
+    groupChains.clear();
+
+    const auto numChannels = layout.size();
+    const auto groupSize = MultiChannelCascade::laneWidth;
+
+    if (activeOptions.numWorkers <= 0 || numChannels <= groupSize || activeOptions.linearPhaseEnabled)
+        return;
+
+    // The stereo pair goes first so mid/side bands find it in one group, the
+    // other channels follow in bus order.
+    ChannelGroups channelTypes;
+    channelTypes.setLayout(layout);
+    std::vector<int> order;
+
+    if (channelTypes.left >= 0 && channelTypes.right >= 0)
+        order = { channelTypes.left, channelTypes.right };
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        if (std::find(order.begin(), order.end(), ch) == order.end())
+            order.push_back(ch);
+
+    for (int first = 0; first < numChannels; first += groupSize)
+    {
+        auto group = groupChains.add(std::make_unique<ChannelGroupChain>());
+
+        for (int i = first; i < juce::jmin(numChannels, first + groupSize); ++i)
+        {
+            group->channels.push_back(order[static_cast<size_t> (i)]);
+            group->layout.addChannel(layout.getTypeOfChannel(order[static_cast<size_t> (i)]));
+        }
+
+        group->pointers.resize(group->channels.size());
+        group->skipsPairRoutings = first > 0 && channelTypes.left >= 0 && channelTypes.right >= 0;
+
+        for (int i = 0; i < numBands; ++i)
+        {
+            auto band = eqBands[i];
+
+            if (first > 0)
+                band = addBoundBand(group->ownedBands, i);
+
+            band->setBlockSize(samplesPerBlock);
+            band->setSampleRate(sampleRate);
+            band->setChannelLayout(group->layout);
+            group->bands.add(band);
+        }
+    }
+
+    // the audio thread takes its share of the groups
+    workerPool = std::make_unique<RealtimeWorkerPool>(juce::jmin(activeOptions.numWorkers, groupChains.size() - 1), groupChains.size(),
+                                                      [this](int groupIndex) { processChannelGroup(groupIndex); });
+}
+
+void AFEQAudioProcessor::processChannelGroups(juce::AudioBuffer<double>& buffer)
+{
+    groupBlockChannels = buffer.getArrayOfWritePointers();
+    groupBlockNumChannels = buffer.getNumChannels();
+    groupBlockNumSamples = buffer.getNumSamples();
+
+    if (workerPool != nullptr && inlineBlocksLeft == 0)
+    {
+        // Waiting for a worker for more than half a block is a missed deadline,
+        // the next second of audio is then processed inline.
+        const auto blockSeconds = groupBlockNumSamples / processSampleRate;
+
+        if (! workerPool->run(0.5 * blockSeconds))
+        {
+            numMissedDeadlines.fetch_add(1, std::memory_order_relaxed);
+            inlineBlocksLeft = juce::jmax(1, static_cast<int> (processSampleRate) / juce::jmax(1, groupBlockNumSamples));
+        }
+
+        return;
+    }
+
+    for (int g = 0; g < groupChains.size(); ++g)
+        processChannelGroup(g);
+
+    inlineBlocksLeft = juce::jmax(0, inlineBlocksLeft - 1);
+}
+
+void AFEQAudioProcessor::processChannelGroup(int groupIndex)
+{
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    auto& group = *groupChains.getUnchecked(groupIndex);
+    int numChannels = 0;
+
+    for (auto ch : group.channels)
+        if (ch < groupBlockNumChannels)
+            group.pointers[static_cast<size_t> (numChannels++)] = groupBlockChannels[ch];
+
+    for (auto b : group.bands)
+    {
+        b->update();
+
+        if (! group.skipsPairRoutings || ! BandParams::isPairRouting(b->getBandParamsConst().routing))
+            b->processDesigned(group.pointers.data(), numChannels, groupBlockNumSamples);
+    }
+
+    const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    group.maxSeconds.store(juce::jmax(seconds, group.maxSeconds.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    group.totalSeconds.store(group.totalSeconds.load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+    group.numBlocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<AFEQAudioProcessor::GroupTiming> AFEQAudioProcessor::getGroupTimings() const
+{
+    std::vector<GroupTiming> timings;
+
+    for (auto g : groupChains)
+    {
+        GroupTiming t;
+        const auto numBlocks = g->numBlocks.load(std::memory_order_relaxed);
+        t.numChannels = static_cast<int> (g->channels.size());
+        t.meanSeconds = numBlocks > 0 ? g->totalSeconds.load(std::memory_order_relaxed) / static_cast<double> (numBlocks) : 0.0;
+        t.maxSeconds = g->maxSeconds.load(std::memory_order_relaxed);
+        timings.push_back(t);
+    }
+
+    return timings;
+}
+
+juce::int64 AFEQAudioProcessor::getNumMissedDeadlines() const
+{
+    return numMissedDeadlines.load(std::memory_order_relaxed);
+}
+
+int AFEQAudioProcessor::getNumLateConvolutionJobs() const
+{
+    return linearPhaseEq != nullptr ? linearPhaseEq->getNumLateJobs() : 0;
+}
+
+bool AFEQAudioProcessor::isParallelFormPlaying() const
+{
+    return parallelChain != nullptr && parallelChain->isParallel();
+}
+
+bool AFEQAudioProcessor::storeProcessingOptions(const ProcessingOptions& newOptions)
+{
+    const juce::ScopedLock sl(optionsLock);
+
+    if (options == newOptions)
+        return false;
+
+    options = newOptions;
+    return true;
+}
+
+void AFEQAudioProcessor::restoreProcessingOptions(const ProcessingOptions& newOptions)
+{
+    // setStateInformation may run while the host plays, and a host doesn't
+    // expect it to prepare; the latency change makes it restart the processor
+    if (storeProcessingOptions(newOptions) && prepared)
+        updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withLatencyChanged(true));
+}
+
+void AFEQAudioProcessor::setProcessingOptions(const ProcessingOptions& newOptions)
+{
+    // A prepared processor switches now, otherwise the next prepareToPlay
+    // picks the options up. Suspending waits for a running callback.
+    if (storeProcessingOptions(newOptions) && prepared)
+    {
+        suspendProcessing(true);
+        prepareToPlay(getSampleRate(), getBlockSize());
+        suspendProcessing(false);
+    }
+}
+
+AFEQAudioProcessor::ProcessingOptions AFEQAudioProcessor::getProcessingOptions() const
+{
+    const juce::ScopedLock sl(optionsLock);
+    return options;
+}
+
+void AFEQAudioProcessor::prepareMultirate(const juce::AudioChannelSet& layout, double sampleRate, int samplesPerBlock, bool rebuild)
+{
+    bandIsLow.fill(false);
+
+    // the same split and low rate bands start over
+    if (! rebuild)
+    {
+        if (! multirateActive)
+        {
+            setLatencySamples(0);
+            return;
+        }
+
+        multirateSplit.reset();
+
+        for (auto band : lowBands)
+            band->setChannelLayout(layout);
+
+        setLatencySamples(multirateSplit.getLatency());
+        return;
+    }
+
+    lowBands.clear();
+
+    const auto factor = MultirateSplit::getFactorForSampleRate(sampleRate);
+    multirateActive = activeOptions.multirateEnabled && factor > 1 && groupChains.isEmpty() && oversampling == nullptr
+        && ! activeOptions.linearPhaseEnabled;
+
+    if (! multirateActive)
+    {
+        setLatencySamples(0);
+        return;
+    }
+
+    multirateSplit.prepare(factor, layout.size(), samplesPerBlock);
+
+    for (int i = 0; i < numBands; ++i)
+    {
+        auto band = addBoundBand(lowBands, i);
+        band->setBlockSize(multirateSplit.getMaxLowBlockSize());
+        band->setSampleRate(sampleRate / factor);
+        band->setChannelLayout(layout);
+    }
+
+    // the split is always in the signal path, so the latency doesn't change with the bands
+    setLatencySamples(multirateSplit.getLatency());
+}
+
+void AFEQAudioProcessor::updateLowRateBands()
+{
+    const auto lowRate = processSampleRate / multirateSplit.getFactor();
+
+    for (int i = 0; i < numBands; ++i)
+    {
+        const auto& bp = eqBands[i]->getBandParamsConst();
+
+        // some hysteresis, so automation around the limit doesn't keep switching
+        const auto maxFreq = lowRate / 48.0 * (bandIsLow[static_cast<size_t> (i)] ? 1.25 : 1.0);
+        auto isLow = bp.getEnabled() && fitsLowRate(bp, maxFreq);
+
+        // the low rate bands run after all others
+        for (int j = 0; j < numBands && isLow; ++j)
+            if (j != i && eqBands[j]->getBandParamsConst().getEnabled())
+                isLow = routingsCommute(bp.getRouting(), eqBands[j]->getBandParamsConst().getRouting());
+
+        if (isLow != bandIsLow[static_cast<size_t> (i)])
+        {
+            bandIsLow[static_cast<size_t> (i)] = isLow;
+            (isLow ? lowBands[i] : eqBands[i])->reset();
+        }
+    }
+}
+
+void AFEQAudioProcessor::processMultirate(juce::AudioBuffer<double>& buffer)
+{
+    const auto numChannels = buffer.getNumChannels();
+    const auto channels = buffer.getArrayOfWritePointers();
+    updateLowRateBands();
+
+    for (int i = 0; i < numBands; ++i)
+    {
+        if (bandIsLow[static_cast<size_t> (i)])
+            eqBands[i]->update();
+        else
+            eqBands[i]->processBlock(channels, numChannels, buffer.getNumSamples());
+    }
+
+    multirateSplit.process(channels, numChannels, buffer.getNumSamples(), [this, numChannels](double* const* low, int numLow) {
+        for (int i = 0; i < numBands; ++i)
+            if (bandIsLow[static_cast<size_t> (i)])
+                lowBands[i]->processBlock(low, numChannels, numLow);
+    });
+}
+
 juce::AudioProcessorValueTreeState& AFEQAudioProcessor::getAPValueTreeState()
 {
     return *state;
 }
 
+AFEQAudioProcessor::MemoryFootprint AFEQAudioProcessor::getMemoryFootprint() const
+{
+    MemoryFootprint footprint;
+    footprint.instanceBytes = sizeof(AFEQAudioProcessor)
+        + static_cast<size_t> (procBuffer.getNumChannels() * procBuffer.getNumSamples()) * sizeof(double)
+        + fftBuffer.capacity() * sizeof(float);
+
+    for (auto b : eqBands)
+        footprint.instanceBytes += b->getMemoryBytes();
+
+    for (auto g : groupChains)
+        for (auto b : g->ownedBands)
+            footprint.instanceBytes += b->getMemoryBytes();
+
+    for (auto b : lowBands)
+        footprint.instanceBytes += b->getMemoryBytes();
+
+    if (multirateActive)
+        footprint.instanceBytes += multirateSplit.getMemoryBytes();
+
+    if (linearPhaseEq != nullptr)
+        footprint.instanceBytes += linearPhaseEq->getMemoryBytes();
+
+    if (parallelChain != nullptr)
+        footprint.instanceBytes += parallelChain->getMemoryBytes();
+
+    footprint.instanceBytes += designer.getMemoryBytes();
+
+    footprint.instanceBytes += undoHistory.getMemoryBytes();
+    footprint.instanceBytes += snapshots.getMemoryBytes() + morph.getMemoryBytes();
+    footprint.instanceBytes += freqResBase.getMemoryBytes();
+    footprint.sharedBytes += freqResBase.getSharedMemoryBytes();
+
+    if (fftAnalyser != nullptr)
+    {
+        footprint.instanceBytes += fftAnalyser->getMemoryBytes();
+        footprint.sharedBytes += fftAnalyser->getSharedMemoryBytes();
+
+        if (auto plan = fftAnalyser->getPlan())
+            footprint.sharedBytes += getSharedBytesPerUser(fft, getFFTMemoryBytes(plan->fftOrder));
+    }
+
+    return footprint;
+}
+
 //==============================================================================
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -11,11 +11,20 @@
 #include <JuceHeader.h>
 #include "dsp/EqBandDsp.h"
 #include "dsp/FFTAnalyser.h"
+#include "dsp/RealtimeWorkerPool.h"
+#include "dsp/MultirateSplit.h"
+#include "dsp/LinearPhaseEq.h"
+#include "dsp/SnapshotBank.h"
+#include "dsp/BandMorph.h"
+#include "dsp/ParallelForm.h"
+#include "dsp/BandDesigner.h"
+#include "PluginState.h"
+#include "UndoHistory.h"
 
 //==============================================================================
 /**
 */
-class AFEQAudioProcessor  : public juce::AudioProcessor
+class AFEQAudioProcessor  : public juce::AudioProcessor, private juce::AudioProcessorListener
 {
 private:
     juce::AudioProcessorValueTreeState::ParameterLayout getLayout();
@@ -37,6 +46,10 @@ public:
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
 
+    // Offline, the bands design in the block that changes them instead of on
+    // the band designer's thread, so a render doesn't depend on its timing.
+    void setNonRealtime (bool isNonRealtime) noexcept override;
+
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
@@ -44,6 +57,24 @@ public:
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
     void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
 
+    // A parameter change at a sample offset into the next processBlock, for
+    // hosts and tools that have the timestamps. Changes apply at the first
+    // multiple of automationInterval samples since prepareToPlay at or after
+    // their time, where the block is split: the result doesn't depend on the
+    // block size, and the bands redesign at most once per interval however
+    // dense the automation is. The parameters take the values on the audio
+    // thread without notifying any listener, so the host doesn't take them
+    // for edits; the editor polls getNumAppliedParameterEvents instead. Call
+    // from the audio thread before processBlock, doesn't allocate. False if
+    // the queue is full.
+    bool addParameterEvent(int parameterIndex, float normalisedValue, int sampleOffset);
+
+    // Parameter events applied so far, from any thread.
+    juce::uint32 getNumAppliedParameterEvents() const;
+
+    static constexpr int automationInterval = 32;
+    static constexpr int maxParameterEvents = 4096;
+
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -66,11 +97,86 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
+
+    // The state is saved in the binary PluginState format. The XML format of
+    // earlier versions still loads and can be written for comparison.
+    void getXmlStateInformation(juce::MemoryBlock& destData);
+    PluginState captureState() const;
+    void applyState(const PluginState& ps);
+
+    // Undo and redo of band edits, one step per parameter gesture. Each
+    // restores all bands it touches at once, they redesign in the next block.
+    // Call from the message thread.
+    bool undo();
+    bool redo();
+    const UndoHistory& getUndoHistory() const;
+
+    // Snapshot slots of the band table for A/B comparisons. Recalling one
+    // writes its values to the parameters. The inline band chain also
+    // switches to filters designed in the background and crossfades to
+    // them, without design work on the audio thread; the other modes design
+    // as for any edit. Call from the message thread.
+    void storeSnapshot(int slot);
+    bool recallSnapshot(int slot);
+    bool isSnapshotStored(int slot) const;
+    bool isSnapshotReady(int slot) const;
+
+    // Morphs the inline band chain from snapshot slot a to slot b with the
+    // Morph parameter, on the designs of BandMorph instead of the band
+    // parameters, which keep their values. Storing either slot updates the
+    // morph. The other modes and the response curve ignore it. False if a
+    // slot is empty. Call from the message thread.
+    bool setMorphSlots(int a, int b);
+    void clearMorph();
+    bool isMorphing() const;
+    bool isMorphReady() const;
+    int getMorphSlotA() const;
+    int getMorphSlotB() const;
+
     bool dspResponseChanged() const;
     void updateGlobalResponse();
 
     juce::AudioProcessorValueTreeState& getAPValueTreeState();
 
+    // Approximate heap and object memory of this instance. Shared tables are
+    // attributed to each user by their current reference count.
+    struct MemoryFootprint
+    {
+        size_t instanceBytes = 0;
+        size_t sharedBytes = 0;
+    };
+
+    MemoryFootprint getMemoryFootprint() const;
+
+    // Seconds spent in the constructor, for profiling project load times.
+    double getConstructionTime() const;
+
+    // Seconds the last setStateInformation took, and whether one is running.
+    // Listeners skip their work while it is, the editor refreshes afterwards.
+    double getRestoreTime() const;
+    bool isRestoringState() const;
+
+    // Processing time of each channel group while the worker pool is active.
+    struct GroupTiming
+    {
+        int numChannels = 0;
+        double meanSeconds = 0.0;
+        double maxSeconds = 0.0;
+    };
+
+    std::vector<GroupTiming> getGroupTimings() const;
+
+    // Blocks after which the pool fell back to inline processing because the
+    // audio thread had to wait too long for a worker.
+    juce::int64 getNumMissedDeadlines() const;
+
+    // Blocks of the non-uniform linear phase convolution whose background
+    // stage wasn't done in time and were left out.
+    int getNumLateConvolutionJobs() const;
+
+    // Whether the parallel form plays the band chain, for the tools.
+    bool isParallelFormPlaying() const;
+
     EqBandDspGroup eqBands;
     std::unique_ptr<FFTAnalyser> fftAnalyser;
     static constexpr int numBands = 12;
@@ -78,16 +184,186 @@ public:
     float guiScale = 1.6f;
     AnalyserProcessing analyserProc = kAnalyserDisabled;
 
+    // Processing modes of the band chain, saved with the state. They aren't
+    // parameters: setting them re-prepares a prepared processor with its
+    // processing suspended, and the audio thread only sees the options of its
+    // last prepareToPlay. Restoring a state only stores them and asks the host
+    // to prepare again. Call from the message thread.
+    struct ProcessingOptions
+    {
+        // Opt-in for wide buses: with more than four channels the channels are split
+        // into groups of up to four, each running its own band chain, and the groups
+        // are processed on this many worker threads. 0 processes everything inline.
+        int numWorkers = 0;
+
+        // Opt-in for sample rates of 88.2 kHz and above: bands well below the low
+        // rate of MultirateSplit run decimated, at the cost of the split's latency.
+        // Not combined with the worker pool.
+        bool multirateEnabled = false;
+
+        // Oversampling of the band chain, 1, 2, 4 or 8, with polyphase IIR (minimum
+        // phase) or equiripple FIR (linear phase) half-band filters. The multirate
+        // split is only used without oversampling.
+        int oversamplingFactor = 1;
+        bool oversamplingLinearPhase = false;
+
+        // Linear phase processing of the whole chain through FIR kernels, redesigned
+        // in the background on parameter changes. The partition size trades latency
+        // for CPU: 256 or 512 for mixing, 2048 and up for mastering. Replaces
+        // oversampling, the multirate split and the worker pool.
+        bool linearPhaseEnabled = false;
+        int linearPhasePartitionSize = 512;
+
+        // Non-uniform partitions for the linear phase mode: only the first one of
+        // linearPhasePartitionSize runs on the audio thread, larger ones for the
+        // rest of the kernels on background threads. Small partitions then cost
+        // about what large uniform ones do.
+        bool linearPhaseNonUniform = false;
+
+        // Runs every band on the state variable filter engine, as if each band's
+        // Engine parameter was set to SVF. Band shelves keep their biquads.
+        bool svfEngineEnabled = false;
+
+        // Runs the inline band chain as one parallel form while all enabled bands
+        // are static cascades on all channels, converted in the background when
+        // they change. Other bands and ill-conditioned conversions run the
+        // cascades. Not combined with the linear phase mode, the multirate split
+        // or the worker pool.
+        bool parallelFormEnabled = false;
+
+        bool operator==(const ProcessingOptions& other) const
+        {
+            return numWorkers == other.numWorkers && multirateEnabled == other.multirateEnabled
+                && oversamplingFactor == other.oversamplingFactor && oversamplingLinearPhase == other.oversamplingLinearPhase
+                && linearPhaseEnabled == other.linearPhaseEnabled && linearPhasePartitionSize == other.linearPhasePartitionSize
+                && linearPhaseNonUniform == other.linearPhaseNonUniform && svfEngineEnabled == other.svfEngineEnabled
+                && parallelFormEnabled == other.parallelFormEnabled;
+        }
+    };
+
+    void setProcessingOptions(const ProcessingOptions& newOptions);
+    ProcessingOptions getProcessingOptions() const;
+
 private:
 
+    // Band chain of one channel group, the first group uses eqBands.
+    struct ChannelGroupChain
+    {
+        std::vector<int> channels;
+        std::vector<double*> pointers;
+        juce::AudioChannelSet layout;
+        juce::Array<EqBandDsp*> bands;
+        EqBandDspGroup ownedBands;
+
+        // the bus has a stereo pair in another group, the pair routings skip this one
+        bool skipsPairRoutings = false;
+
+        // written by the thread that processed the group
+        std::atomic<double> maxSeconds { 0.0 };
+        std::atomic<double> totalSeconds { 0.0 };
+        std::atomic<juce::int64> numBlocks { 0 };
+    };
+
+    void processBands(juce::AudioBuffer<double>& buffer);
+
+    // processBands split at the due parameter events, factor is the ratio of
+    // the buffer's rate to the host rate.
+    void processBandsAtEvents(juce::AudioBuffer<double>& buffer, int factor);
+
+    struct ParameterEvent
+    {
+        juce::int64 time;
+        int index;
+        float value;
+    };
+
+    static juce::int64 getDueSample(const ParameterEvent& e);
+    bool setXmlStateInformation(const void* data, int sizeInBytes);
+    // Stores the options for the next prepareToPlay, true if they changed.
+    bool storeProcessingOptions(const ProcessingOptions& newOptions);
+    // Stores the options of a restored state and has the host re-prepare.
+    void restoreProcessingOptions(const ProcessingOptions& newOptions);
+    UndoHistory::Bands captureBands() const;
+    void applyBands(const UndoHistory::Bands& bands);
+    // Around the parameter writes of a restore, see restoreSequence.
+    void beginRestore();
+    void endRestore();
+    void syncEditor();
+
+    void audioProcessorParameterChanged(juce::AudioProcessor*, int, float) override {}
+    void audioProcessorChanged(juce::AudioProcessor*, const ChangeDetails&) override {}
+    void audioProcessorParameterChangeGestureBegin(juce::AudioProcessor*, int parameterIndex) override;
+    void audioProcessorParameterChangeGestureEnd(juce::AudioProcessor*, int parameterIndex) override;
+
+    // A band bound to the parameters of eqBands[index], for chains that run
+    // in parallel to eqBands.
+    EqBandDsp* addBoundBand(EqBandDspGroup& bands, int index);
+    void prepareChannelGroups(const juce::AudioChannelSet& layout, double sampleRate, int samplesPerBlock, bool rebuild);
+    void processChannelGroups(juce::AudioBuffer<double>& buffer);
+    void processChannelGroup(int groupIndex);
+
+    void prepareMultirate(const juce::AudioChannelSet& layout, double sampleRate, int samplesPerBlock, bool rebuild);
+    void processMultirate(juce::AudioBuffer<double>& buffer);
+    void updateLowRateBands();
+
     FreqResponseBase freqResBase = FreqResponseBase(300, 20.f, 20e3f);
-    juce::UndoManager undoManager;
+    SnapshotBank snapshots { numBands, maxOrder, freqResBase };
+    BandMorph morph { numBands, maxOrder, freqResBase };
+    juce::AudioParameterFloat* morphParam = nullptr;
+    int morphSlotA = -1;
+    int morphSlotB = -1;
+    UndoHistory undoHistory;
     std::unique_ptr<juce::AudioProcessorValueTreeState> state;
     juce::AudioBuffer<double> procBuffer;
 
-    std::unique_ptr<juce::dsp::FFT> fft;
+    std::shared_ptr<const juce::dsp::FFT> fft;
     std::vector<float> fftBuffer;
     AnalyserProcessing prevAnalyserProc = kAnalyserDisabled;
+    double constructionTime = 0.0;
+    double restoreTime = 0.0;
+    // odd while a state is restored, see BandParams::holdDesign
+    std::atomic<juce::uint32> restoreSequence { 0 };
+
+    // sorted by time, host rate samples since prepareToPlay
+    std::vector<ParameterEvent> parameterEvents;
+    std::atomic<juce::uint32> numAppliedParameterEvents { 0 };
+    juce::int64 blockStartSample = 0;
+
+    juce::OwnedArray<ChannelGroupChain> groupChains;
+    double* const* groupBlockChannels = nullptr;
+    int groupBlockNumChannels = 0;
+    int groupBlockNumSamples = 0;
+    int inlineBlocksLeft = 0;
+    std::atomic<juce::int64> numMissedDeadlines { 0 };
+    std::unique_ptr<RealtimeWorkerPool> workerPool;
+
+    // Twins of eqBands at the low rate, the main band of a low rate band only
+    // keeps its parameters and response up to date.
+    MultirateSplit multirateSplit;
+    EqBandDspGroup lowBands;
+    std::array<bool, numBands> bandIsLow {};
+    bool multirateActive = false;
+
+    // the band chain runs at processSampleRate, the host rate times the oversampling factor
+    std::unique_ptr<juce::dsp::Oversampling<double>> oversampling;
+    std::vector<double*> oversampledChannels;
+    double processSampleRate = 44100.0;
+
+    std::unique_ptr<LinearPhaseEq> linearPhaseEq;
+    std::unique_ptr<ParallelBandChain> parallelChain;
+
+    // the options last set, and those of the last prepareToPlay with the
+    // host settings it prepared for
+    ProcessingOptions options;
+    ProcessingOptions activeOptions;
+    double preparedSampleRate = 0.0;
+    int preparedBlockSize = 0;
+    juce::AudioChannelSet preparedLayout;
+    juce::CriticalSection optionsLock;
+    std::atomic<bool> prepared { false };
+
+    // designs eqBands, the group bands and lowBands in the background
+    BandDesigner designer;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AFEQAudioProcessor)
@@ -0,0 +1,216 @@
+#include "PluginState.h"
+
+namespace
+{
+    constexpr int headerSize = 10;
+    constexpr int optionsSize = 12;
+    constexpr int bandRecordSize = 34;
+    constexpr int bandRecordSizeV3 = 33;
+    constexpr int bandRecordSizeV1 = 16;
+
+    enum Flags
+    {
+        flagMultirate = 1,
+        flagOversamplingLinearPhase = 2,
+        flagLinearPhase = 4,
+        flagNonUniform = 8,
+        flagSvf = 16,
+        flagParallel = 32
+    };
+
+    void writeBands(juce::OutputStream& out, const std::vector<PluginState::Band>& bands)
+    {
+        for (const auto& b : bands)
+        {
+            out.writeByte(static_cast<char> (b.enabled ? 1 : 0));
+            out.writeByte(static_cast<char> (b.type));
+            out.writeByte(static_cast<char> (b.routing));
+            out.writeByte(static_cast<char> (b.order));
+            out.writeFloat(b.freq);
+            out.writeFloat(b.gain);
+            out.writeFloat(b.q);
+            out.writeByte(static_cast<char> (b.dynamic ? 1 : 0));
+            out.writeFloat(b.threshold);
+            out.writeFloat(b.ratio);
+            out.writeFloat(b.attack);
+            out.writeFloat(b.release);
+            out.writeByte(static_cast<char> (b.engine));
+        }
+    }
+
+    void readBands(juce::InputStream& in, std::vector<PluginState::Band>& bands, int numBands, int recordSize)
+    {
+        bands.assign(static_cast<size_t> (numBands), PluginState::Band());
+        const auto recordsStart = in.getPosition();
+
+        for (int i = 0; i < numBands; ++i)
+        {
+            auto& b = bands[static_cast<size_t> (i)];
+            in.setPosition(recordsStart + i * recordSize);
+            b.enabled = in.readByte() != 0;
+            b.type = static_cast<juce::uint8> (in.readByte());
+            b.routing = static_cast<juce::uint8> (in.readByte());
+            b.order = static_cast<juce::uint8> (in.readByte());
+            b.freq = in.readFloat();
+            b.gain = in.readFloat();
+            b.q = in.readFloat();
+
+            // appended in version 3
+            if (recordSize >= bandRecordSizeV3)
+            {
+                b.dynamic = in.readByte() != 0;
+                b.threshold = in.readFloat();
+                b.ratio = in.readFloat();
+                b.attack = in.readFloat();
+                b.release = in.readFloat();
+            }
+
+            // appended in version 4
+            if (recordSize >= bandRecordSize)
+                b.engine = static_cast<juce::uint8> (in.readByte());
+        }
+
+        in.setPosition(recordsStart + numBands * recordSize);
+    }
+}
+
+juce::uint32 PluginState::crc32(const void* data, size_t numBytes)
+{
+    static const auto table = []() {
+        std::array<juce::uint32, 256> t {};
+
+        for (juce::uint32 i = 0; i < 256; ++i)
+        {
+            auto c = i;
+
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) != 0 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+            t[i] = c;
+        }
+
+        return t;
+    }();
+
+    auto crc = 0xffffffffu;
+    const auto bytes = static_cast<const juce::uint8*> (data);
+
+    for (size_t i = 0; i < numBytes; ++i)
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+
+    return crc ^ 0xffffffffu;
+}
+
+bool PluginState::isBinaryState(const void* data, int sizeInBytes)
+{
+    return sizeInBytes >= headerSize + 4 && juce::ByteOrder::littleEndianInt(data) == magic;
+}
+
+void PluginState::writeTo(juce::MemoryBlock& dest) const
+{
+    juce::MemoryOutputStream payload(optionsSize + bands.size() * bandRecordSize);
+    const auto flags = (multirate ? flagMultirate : 0) | (oversamplingLinearPhase ? flagOversamplingLinearPhase : 0)
+        | (linearPhase ? flagLinearPhase : 0) | (nonUniform ? flagNonUniform : 0) | (svf ? flagSvf : 0)
+        | (parallel ? flagParallel : 0);
+
+    payload.writeFloat(scale);
+    payload.writeByte(static_cast<char> (analyser));
+    payload.writeByte(static_cast<char> (flags));
+    payload.writeByte(static_cast<char> (oversampling));
+    payload.writeByte(static_cast<char> (workers));
+    payload.writeShort(static_cast<short> (partitionSize));
+    payload.writeByte(static_cast<char> (bands.size()));
+    payload.writeByte(static_cast<char> (bandRecordSize));
+    writeBands(payload, bands);
+
+    payload.writeByte(static_cast<char> (snapshots.size()));
+
+    for (const auto& s : snapshots)
+    {
+        payload.writeByte(static_cast<char> (s.size()));
+        writeBands(payload, s);
+    }
+
+    payload.writeFloat(morph);
+    payload.writeByte(static_cast<char> (morphA));
+    payload.writeByte(static_cast<char> (morphB));
+
+    juce::MemoryOutputStream out(dest, false);
+    out.writeInt(static_cast<int> (magic));
+    out.writeShort(static_cast<short> (version));
+    out.writeInt(static_cast<int> (payload.getDataSize()));
+    out.write(payload.getData(), payload.getDataSize());
+    out.flush();
+    out.writeInt(static_cast<int> (crc32(dest.getData(), dest.getSize())));
+}
+
+bool PluginState::readFrom(const void* data, int sizeInBytes)
+{
+    if (! isBinaryState(data, sizeInBytes))
+        return false;
+
+    juce::MemoryInputStream in(data, static_cast<size_t> (sizeInBytes), false);
+    in.readInt();
+    const auto fileVersion = static_cast<int> (in.readShort());
+    const auto payloadSize = in.readInt();
+
+    if (fileVersion < 1 || payloadSize < optionsSize || payloadSize > sizeInBytes - headerSize - 4)
+        return false;
+
+    const auto checkedSize = static_cast<size_t> (headerSize + payloadSize);
+    const auto stored = juce::ByteOrder::littleEndianInt(static_cast<const char*> (data) + checkedSize);
+
+    if (stored != crc32(data, checkedSize))
+        return false;
+
+    scale = in.readFloat();
+    analyser = static_cast<juce::uint8> (in.readByte());
+    const auto flags = static_cast<juce::uint8> (in.readByte());
+    oversampling = static_cast<juce::uint8> (in.readByte());
+    workers = static_cast<juce::uint8> (in.readByte());
+    partitionSize = static_cast<juce::uint16> (in.readShort());
+    const auto numBands = static_cast<int> (static_cast<juce::uint8> (in.readByte()));
+    const auto recordSize = static_cast<int> (static_cast<juce::uint8> (in.readByte()));
+
+    multirate = (flags & flagMultirate) != 0;
+    oversamplingLinearPhase = (flags & flagOversamplingLinearPhase) != 0;
+    linearPhase = (flags & flagLinearPhase) != 0;
+    nonUniform = (flags & flagNonUniform) != 0;
+    svf = (flags & flagSvf) != 0;
+    parallel = (flags & flagParallel) != 0;
+
+    if (recordSize < bandRecordSizeV1 || optionsSize + numBands * recordSize > payloadSize)
+        return false;
+
+    readBands(in, bands, numBands, recordSize);
+    snapshots.clear();
+    morph = 0.f;
+    morphA = -1;
+    morphB = -1;
+
+    // version 1 ends after the band records
+    const auto payloadEnd = static_cast<juce::int64> (checkedSize);
+
+    if (fileVersion < 2 || in.getPosition() >= payloadEnd)
+        return true;
+
+    snapshots.resize(static_cast<size_t> (static_cast<juce::uint8> (in.readByte())));
+
+    for (auto& s : snapshots)
+    {
+        const auto num = static_cast<int> (static_cast<juce::uint8> (in.readByte()));
+
+        if (in.getPosition() + num * recordSize > payloadEnd)
+            return false;
+
+        readBands(in, s, num, recordSize);
+    }
+
+    if (in.getPosition() + 6 > payloadEnd)
+        return false;
+
+    morph = juce::jlimit(0.f, 1.f, in.readFloat());
+    morphA = static_cast<juce::int8> (in.readByte());
+    morphB = static_cast<juce::int8> (in.readByte());
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "dsp/EqBandDsp.h"
+
+// Everything AFEQAudioProcessor saves: the band table plus the processor
+// options. The binary form is a header with magic, version and payload size,
+// fixed-size band records and a CRC-32 of all bytes before it, a few hundred
+// bytes in place of several kilobytes of XML. Newer versions may only append
+// fields, to the payload or to the records, so older readers skip them.
+struct PluginState
+{
+    using Band = BandValues;
+
+    static constexpr juce::uint32 magic = 0x53514641; // "AFQS"
+    static constexpr int version = 4;
+
+    std::vector<Band> bands;
+    float scale = 1.f;
+    int analyser = 0;
+    int workers = 0;
+    bool multirate = false;
+    int oversampling = 1;
+    bool oversamplingLinearPhase = false;
+    bool linearPhase = false;
+    int partitionSize = 512;
+    bool nonUniform = false;
+    bool svf = false;
+    bool parallel = false;
+
+    // Version 2: the snapshot slots (empty ones without bands) and the morph
+    // between two of them, -1 for none. Version 3 appends the dynamic mode
+    // to the band records, version 4 their engine and the global SVF flag.
+    // The parallel form flag is an unused bit of version 4, older readers
+    // ignore it.
+    std::vector<std::vector<Band>> snapshots;
+    float morph = 0.f;
+    int morphA = -1;
+    int morphB = -1;
+
+    void writeTo(juce::MemoryBlock& dest) const;
+
+    // False for data that isn't a binary state or fails the checksum.
+    bool readFrom(const void* data, int sizeInBytes);
+
+    static bool isBinaryState(const void* data, int sizeInBytes);
+    static juce::uint32 crc32(const void* data, size_t numBytes);
+};
@@ -0,0 +1,263 @@
+#include "UndoHistory.h"
+
+namespace
+{
+    enum Field
+    {
+        fieldEnabled,
+        fieldType,
+        fieldRouting,
+        fieldFreq,
+        fieldGain,
+        fieldQ,
+        fieldOrder,
+        fieldDynamic,
+        fieldThreshold,
+        fieldRatio,
+        fieldAttack,
+        fieldRelease,
+        fieldEngine,
+        numFields
+    };
+
+    float getField(const PluginState::Band& b, int field)
+    {
+        switch (field)
+        {
+        case fieldEnabled:
+            return b.enabled ? 1.f : 0.f;
+        case fieldType:
+            return static_cast<float> (b.type);
+        case fieldRouting:
+            return static_cast<float> (b.routing);
+        case fieldFreq:
+            return b.freq;
+        case fieldGain:
+            return b.gain;
+        case fieldQ:
+            return b.q;
+        case fieldOrder:
+            return static_cast<float> (b.order);
+        case fieldDynamic:
+            return b.dynamic ? 1.f : 0.f;
+        case fieldThreshold:
+            return b.threshold;
+        case fieldRatio:
+            return b.ratio;
+        case fieldAttack:
+            return b.attack;
+        case fieldRelease:
+            return b.release;
+        case fieldEngine:
+            return static_cast<float> (b.engine);
+        default:
+            jassertfalse;
+            return 0.f;
+        }
+    }
+
+    void setField(PluginState::Band& b, int field, float value)
+    {
+        switch (field)
+        {
+        case fieldEnabled:
+            b.enabled = value != 0.f;
+            break;
+        case fieldType:
+            b.type = static_cast<int> (value);
+            break;
+        case fieldRouting:
+            b.routing = static_cast<int> (value);
+            break;
+        case fieldFreq:
+            b.freq = value;
+            break;
+        case fieldGain:
+            b.gain = value;
+            break;
+        case fieldQ:
+            b.q = value;
+            break;
+        case fieldOrder:
+            b.order = static_cast<int> (value);
+            break;
+        case fieldDynamic:
+            b.dynamic = value != 0.f;
+            break;
+        case fieldThreshold:
+            b.threshold = value;
+            break;
+        case fieldRatio:
+            b.ratio = value;
+            break;
+        case fieldAttack:
+            b.attack = value;
+            break;
+        case fieldRelease:
+            b.release = value;
+            break;
+        case fieldEngine:
+            b.engine = static_cast<int> (value);
+            break;
+        default:
+            jassertfalse;
+            break;
+        }
+    }
+}
+
+UndoHistory::UndoHistory(size_t maxbytes)
+    : maxBytes(maxbytes)
+{
+}
+
+void UndoHistory::beginGesture(const Bands& current)
+{
+    if (numOpenGestures++ == 0)
+    {
+        gestureStart = current;
+        gestureStartTime = juce::Time::getMillisecondCounterHiRes();
+    }
+}
+
+void UndoHistory::endGesture(const Bands& current)
+{
+    if (numOpenGestures == 0 || --numOpenGestures > 0)
+        return;
+
+    Step step;
+    const auto num = juce::jmin(current.size(), gestureStart.size());
+
+    for (size_t i = 0; i < num; ++i)
+        for (int f = 0; f < numFields; ++f)
+        {
+            const auto before = getField(gestureStart[i], f);
+            const auto after = getField(current[i], f);
+
+            if (before != after)
+                step.push_back({ static_cast<juce::uint8> (i), static_cast<juce::uint8> (f), before, after });
+        }
+
+    if (step.empty() || coalesce(step))
+        return;
+
+    step.shrink_to_fit();
+
+    for (const auto& s : redoSteps)
+        usedBytes -= getStepBytes(s);
+
+    redoSteps.clear();
+    usedBytes += getStepBytes(step);
+    undoSteps.push_back(std::move(step));
+    canCoalesce = true;
+    lastStepTime = juce::Time::getMillisecondCounterHiRes();
+    trim();
+}
+
+bool UndoHistory::coalesce(const Step& step)
+{
+    if (! canCoalesce || undoSteps.empty() || gestureStartTime - lastStepTime > coalesceMs)
+        return false;
+
+    auto& last = undoSteps.back();
+
+    if (last.size() != step.size())
+        return false;
+
+    for (size_t i = 0; i < step.size(); ++i)
+        if (last[i].band != step[i].band || last[i].field != step[i].field)
+            return false;
+
+    auto unchanged = true;
+
+    for (size_t i = 0; i < step.size(); ++i)
+    {
+        last[i].after = step[i].after;
+        unchanged = unchanged && last[i].before == last[i].after;
+    }
+
+    lastStepTime = juce::Time::getMillisecondCounterHiRes();
+
+    // back where the step started, nothing left to undo
+    if (unchanged)
+    {
+        usedBytes -= getStepBytes(last);
+        undoSteps.pop_back();
+        canCoalesce = false;
+    }
+
+    return true;
+}
+
+bool UndoHistory::isInGesture() const
+{
+    return numOpenGestures > 0;
+}
+
+bool UndoHistory::undo(Bands& bands)
+{
+    if (undoSteps.empty() || isInGesture())
+        return false;
+
+    for (const auto& d : undoSteps.back())
+        if (d.band < bands.size())
+            setField(bands[d.band], d.field, d.before);
+
+    redoSteps.push_back(std::move(undoSteps.back()));
+    undoSteps.pop_back();
+    canCoalesce = false;
+    return true;
+}
+
+bool UndoHistory::redo(Bands& bands)
+{
+    if (redoSteps.empty() || isInGesture())
+        return false;
+
+    for (const auto& d : redoSteps.back())
+        if (d.band < bands.size())
+            setField(bands[d.band], d.field, d.after);
+
+    undoSteps.push_back(std::move(redoSteps.back()));
+    redoSteps.pop_back();
+    canCoalesce = false;
+    return true;
+}
+
+int UndoHistory::getNumUndoSteps() const
+{
+    return static_cast<int> (undoSteps.size());
+}
+
+int UndoHistory::getNumRedoSteps() const
+{
+    return static_cast<int> (redoSteps.size());
+}
+
+size_t UndoHistory::getMemoryBytes() const
+{
+    return usedBytes;
+}
+
+void UndoHistory::clear()
+{
+    undoSteps.clear();
+    redoSteps.clear();
+    usedBytes = 0;
+    canCoalesce = false;
+}
+
+size_t UndoHistory::getStepBytes(const Step& step)
+{
+    return sizeof(Step) + step.capacity() * sizeof(Delta);
+}
+
+void UndoHistory::trim()
+{
+    // the newest step always stays
+    while (usedBytes > maxBytes && undoSteps.size() > 1)
+    {
+        usedBytes -= getStepBytes(undoSteps.front());
+        undoSteps.pop_front();
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginState.h"
+
+// Undo history of the band table with one step per edit gesture. A step only
+// keeps the parameters that changed, as before/after pairs, and the oldest
+// steps are dropped once the history exceeds its memory budget. A gesture
+// that changes the same parameters as the previous step and starts less than
+// coalesceMs after it extends that step instead, so a run of mouse wheel
+// ticks undoes as one. Not thread safe: gestures, undo and redo all come from
+// the message thread.
+class UndoHistory
+{
+public:
+
+    using Bands = std::vector<PluginState::Band>;
+
+    static constexpr double coalesceMs = 500.0;
+
+    explicit UndoHistory(size_t maxbytes = 64 * 1024);
+
+    // Gestures may overlap, e.g. frequency and gain of a dragged band. A step
+    // starts with the first one and is recorded when the last one ends.
+    void beginGesture(const Bands& current);
+    void endGesture(const Bands& current);
+    bool isInGesture() const;
+
+    // Write the values before respectively after the next step into bands.
+    // False if there is none or a gesture is open.
+    bool undo(Bands& bands);
+    bool redo(Bands& bands);
+
+    int getNumUndoSteps() const;
+    int getNumRedoSteps() const;
+    size_t getMemoryBytes() const;
+    void clear();
+
+private:
+
+    struct Delta
+    {
+        juce::uint8 band;
+        juce::uint8 field;
+        float before;
+        float after;
+    };
+
+    using Step = std::vector<Delta>;
+
+    static size_t getStepBytes(const Step& step);
+    bool coalesce(const Step& step);
+    void trim();
+
+    const size_t maxBytes;
+    std::deque<Step> undoSteps;
+    std::deque<Step> redoSteps;
+    Bands gestureStart;
+    int numOpenGestures = 0;
+    double gestureStartTime = 0.0;
+    // the newest undo step was recorded at lastStepTime, not undone or redone since
+    bool canCoalesce = false;
+    double lastStepTime = 0.0;
+    size_t usedBytes = 0;
+};
@@ -0,0 +1,144 @@
+#include "BandDesigner.h"
+#include "RealtimeSemaphore.h"
+
+class BandDesigner::DesignThread : public juce::Thread
+{
+public:
+
+    explicit DesignThread(BandDesigner& o)
+        : juce::Thread("AFEQ band designer"), owner(o)
+    {
+    }
+
+    ~DesignThread() override
+    {
+        signalThreadShouldExit();
+        wake();
+        stopThread(1000);
+    }
+
+    void wake()
+    {
+        semaphore.post();
+    }
+
+    void run() override
+    {
+        for (;;)
+        {
+            semaphore.wait();
+
+            if (threadShouldExit())
+                return;
+
+            owner.designPending();
+        }
+    }
+
+private:
+
+    BandDesigner& owner;
+    RealtimeSemaphore semaphore;
+};
+
+BandDesigner::BandDesigner() = default;
+
+BandDesigner::~BandDesigner()
+{
+    release();
+}
+
+void BandDesigner::prepare(const std::vector<EqBandDsp*>& newBands)
+{
+    release();
+
+    for (auto b : newBands)
+    {
+        // the first design runs here, the band plays it from the first block
+        b->update();
+
+        auto slot = std::make_unique<Slot>();
+        slot->twin = std::make_unique<EqBandDsp>(b->getBandParamsConst().maxOrder, b->getFreqResBase(), b->getBandIndex());
+        slot->twin->prepareAs(*b);
+        slots.add(std::move(slot));
+
+        b->setDesigner(this, slots.size() - 1);
+        bands.push_back(b);
+    }
+
+    thread = std::make_unique<DesignThread>(*this);
+    thread->startThread(juce::Thread::Priority::high);
+}
+
+void BandDesigner::release()
+{
+    thread.reset();
+
+    for (auto b : bands)
+        b->setDesigner(nullptr, -1);
+
+    bands.clear();
+    slots.clear();
+}
+
+void BandDesigner::setActive(bool shouldBeActive)
+{
+    active.store(shouldBeActive, std::memory_order_release);
+}
+
+bool BandDesigner::isActive() const
+{
+    return active.load(std::memory_order_acquire);
+}
+
+bool BandDesigner::post(int slot, const BandValues& values)
+{
+    auto s = slots[slot];
+
+    if (s == nullptr || thread == nullptr || s->state.load(std::memory_order_acquire) != Slot::idle)
+        return false;
+
+    s->values = values;
+    s->state.store(Slot::pending, std::memory_order_release);
+    thread->wake();
+    return true;
+}
+
+const EqBandDsp* BandDesigner::getResult(int slot) const
+{
+    auto s = slots[slot];
+    return s != nullptr && s->state.load(std::memory_order_acquire) == Slot::ready ? s->twin.get() : nullptr;
+}
+
+void BandDesigner::finish(int slot)
+{
+    if (auto s = slots[slot])
+    {
+        jassert(s->state.load() == Slot::ready);
+        s->state.store(Slot::idle, std::memory_order_release);
+    }
+}
+
+void BandDesigner::designPending()
+{
+    for (auto s : slots)
+    {
+        auto expected = static_cast<int> (Slot::pending);
+
+        if (! s->state.compare_exchange_strong(expected, Slot::designing, std::memory_order_acquire))
+            continue;
+
+        s->twin->setValues(s->values);
+        s->state.store(Slot::ready, std::memory_order_release);
+    }
+}
+
+size_t BandDesigner::getMemoryBytes() const
+{
+    auto bytes = sizeof(BandDesigner) + bands.capacity() * sizeof(EqBandDsp*);
+
+    for (auto s : slots)
+        bytes += sizeof(Slot) + s->twin->getMemoryBytes();
+
+    return bytes;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "EqBandDsp.h"
+
+// Designs the processor's bands on a background thread. An attached band
+// posts its values when its parameters change and keeps playing its previous
+// design until a twin of it, prepared the same way, has designed the new
+// values; the band then takes the twin's coefficients over and keeps its own
+// filter state. The section fits and dynamic tables don't run on the audio
+// thread that way. While the designer is inactive, for offline rendering,
+// the bands design in the block that changes them.
+class BandDesigner
+{
+public:
+
+    BandDesigner();
+    ~BandDesigner();
+
+    // Designs each band once, attaches them and starts the thread. The bands
+    // must be prepared and stay until release. Not realtime safe.
+    void prepare(const std::vector<EqBandDsp*>& newBands);
+    void release();
+
+    void setActive(bool shouldBeActive);
+    bool isActive() const;
+
+    // The band side, from the thread that processes the band. A slot takes
+    // one post at a time: false while the previous one is pending, or while
+    // its result hasn't been finished.
+    bool post(int slot, const BandValues& values);
+    const EqBandDsp* getResult(int slot) const;
+    void finish(int slot);
+
+    size_t getMemoryBytes() const;
+
+private:
+
+    class DesignThread;
+
+    struct Slot
+    {
+        enum State
+        {
+            idle,
+            pending,
+            designing,
+            ready
+        };
+
+        std::unique_ptr<EqBandDsp> twin;
+        BandValues values;
+        std::atomic<int> state { idle };
+    };
+
+    void designPending();
+
+    std::vector<EqBandDsp*> bands;
+    juce::OwnedArray<Slot> slots;
+    std::unique_ptr<DesignThread> thread;
+    std::atomic<bool> active { true };
+};
@@ -0,0 +1,185 @@
+#include "BandDynamics.h"
+
+BandDynamics::BandDynamics(int maxsections)
+    : maxSections(maxsections), table(static_cast<size_t> (numSteps * maxsections)), current(static_cast<size_t> (maxsections))
+{
+    setMaxChannels(2);
+    setSampleRate(sampleRate);
+}
+
+void BandDynamics::setMaxChannels(int numChannels)
+{
+    detector.setMaxChannels(numChannels);
+    scratch.assign(static_cast<size_t> (numChannels * controlInterval), 0.0);
+    scratchPointers.resize(static_cast<size_t> (numChannels));
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        scratchPointers[static_cast<size_t> (ch)] = scratch.data() + ch * controlInterval;
+}
+
+void BandDynamics::setSampleRate(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    const auto attack = attackMs;
+    attackMs = -1.f;
+    setTimes(attack, releaseMs);
+}
+
+void BandDynamics::setCurve(float thresholdDb, float ratio)
+{
+    threshold = thresholdDb;
+    slope = 1.f - 1.f / juce::jmax(1.f, ratio);
+}
+
+void BandDynamics::setTimes(float attack, float release)
+{
+    if (attack == attackMs && release == releaseMs)
+        return;
+
+    attackMs = attack;
+    releaseMs = release;
+    attackCoeff = std::exp(-1000.0 / (juce::jmax(0.01, static_cast<double> (attack)) * sampleRate));
+    releaseCoeff = std::exp(-1000.0 / (juce::jmax(0.01, static_cast<double> (release)) * sampleRate));
+}
+
+BiquadCoeffs* BandDynamics::getTableRow(int step)
+{
+    jassert(juce::isPositiveAndBelow(step, numSteps));
+    return table.data() + step * maxSections;
+}
+
+void BandDynamics::setTable(int numsections, bool valid)
+{
+    numSections = juce::jmin(numsections, maxSections);
+    tableValid = valid;
+    reduction = -1.f;
+}
+
+void BandDynamics::setDetector(const BiquadCoeffs& first, const BiquadCoeffs& second)
+{
+    detectorCoeffs = { first, second };
+    detector.setCoefficients(detectorCoeffs.data(), 2);
+}
+
+bool BandDynamics::hasTable() const
+{
+    return tableValid;
+}
+
+bool BandDynamics::process(double* const* channels, int numChannels, int numSamples)
+{
+    jassert(numSamples <= controlInterval);
+    numChannels = juce::jmin(numChannels, static_cast<int> (scratchPointers.size()));
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        std::copy(channels[ch], channels[ch] + numSamples, scratchPointers[static_cast<size_t> (ch)]);
+
+    detector.process(scratchPointers.data(), numChannels, numSamples);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        auto peak = 0.0;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            peak = juce::jmax(peak, std::abs(scratchPointers[static_cast<size_t> (ch)][i]));
+
+        const auto coeff = peak > envelope ? attackCoeff : releaseCoeff;
+        envelope = peak + coeff * (envelope - peak);
+    }
+
+    const auto level = juce::Decibels::gainToDecibels(static_cast<float> (envelope), -120.f);
+    const auto newReduction = juce::jlimit(0.f, maxReductionDb, (level - threshold) * slope);
+
+    // steps below 0.01 dB aren't worth new coefficients
+    if (std::abs(newReduction - reduction) < 0.01f)
+        return false;
+
+    reduction = newReduction;
+    const auto pos = reduction / stepDb;
+    const auto step = juce::jmin(numSteps - 2, static_cast<int> (pos));
+    const auto frac = static_cast<double> (pos - static_cast<float> (step));
+    const auto lower = table.data() + step * maxSections;
+    const auto upper = lower + maxSections;
+
+    for (int s = 0; s < numSections; ++s)
+    {
+        auto& c = current[static_cast<size_t> (s)];
+        c.b0 = lower[s].b0 + frac * (upper[s].b0 - lower[s].b0);
+        c.b1 = lower[s].b1 + frac * (upper[s].b1 - lower[s].b1);
+        c.b2 = lower[s].b2 + frac * (upper[s].b2 - lower[s].b2);
+        c.a1 = lower[s].a1 + frac * (upper[s].a1 - lower[s].a1);
+        c.a2 = lower[s].a2 + frac * (upper[s].a2 - lower[s].a2);
+    }
+
+    return true;
+}
+
+const BiquadCoeffs* BandDynamics::getCoefficients() const
+{
+    return current.data();
+}
+
+int BandDynamics::getNumSections() const
+{
+    return numSections;
+}
+
+float BandDynamics::getReductionDb() const
+{
+    return juce::jmax(0.f, reduction);
+}
+
+void BandDynamics::reset()
+{
+    detector.reset();
+    envelope = 0.0;
+    reduction = -1.f;
+}
+
+void BandDynamics::copyStateFrom(const BandDynamics& other)
+{
+    detector.copyStateFrom(other.detector);
+    envelope = other.envelope;
+    reduction = -1.f;
+}
+
+void BandDynamics::copyFrom(const BandDynamics& other)
+{
+    jassert(maxSections == other.maxSections && scratch.size() == other.scratch.size());
+
+    numSections = other.numSections;
+    tableValid = other.tableValid;
+    std::copy(other.table.begin(), other.table.end(), table.begin());
+    std::copy(other.current.begin(), other.current.end(), current.begin());
+    detectorCoeffs = other.detectorCoeffs;
+    detector.setCoefficients(detectorCoeffs.data(), 2);
+    detector.copyStateFrom(other.detector);
+    threshold = other.threshold;
+    slope = other.slope;
+    attackMs = other.attackMs;
+    releaseMs = other.releaseMs;
+    attackCoeff = other.attackCoeff;
+    releaseCoeff = other.releaseCoeff;
+    envelope = other.envelope;
+    reduction = other.reduction;
+}
+
+void BandDynamics::copyTableFrom(const BandDynamics& other)
+{
+    jassert(maxSections == other.maxSections);
+
+    numSections = other.numSections;
+    tableValid = other.tableValid;
+    std::copy(other.table.begin(), other.table.end(), table.begin());
+    detectorCoeffs = other.detectorCoeffs;
+    detector.setCoefficients(detectorCoeffs.data(), 2);
+
+    // the next process picks the coefficients for the current level
+    reduction = -1.f;
+}
+
+size_t BandDynamics::getMemoryBytes() const
+{
+    return sizeof(BandDynamics) + (table.capacity() + current.capacity()) * sizeof(BiquadCoeffs) + detector.getMemoryBytes()
+        + scratch.capacity() * sizeof(double) + scratchPointers.capacity() * sizeof(double*);
+}
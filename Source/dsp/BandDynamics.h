@@ -0,0 +1,87 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "BiquadKernel.h"
+
+// Gain computer of a dynamic band. A two section detector filter picks the
+// band's frequency region from its input, a peak follower with attack and
+// release tracks the loudest routed channel, and above the threshold the
+// band's gain is reduced by the ratio, up to maxReductionDb.
+//
+// The owner designs the band at numSteps gains stepDb apart, the audio
+// thread blends the neighbouring coefficients of the current reduction every
+// controlInterval samples. Blending direct form coefficients of stable
+// sections stays stable, and nothing is designed while the gain moves.
+class BandDynamics
+{
+public:
+
+    static constexpr int controlInterval = 32;
+    static constexpr int numSteps = 9;
+    static constexpr float stepDb = 3.f;
+    static constexpr float maxReductionDb = (numSteps - 1) * stepDb;
+
+    explicit BandDynamics(int maxsections);
+
+    // Allocates, not realtime safe.
+    void setMaxChannels(int numChannels);
+    void setSampleRate(double newSampleRate);
+
+    void setCurve(float thresholdDb, float ratio);
+    void setTimes(float attackMs, float releaseMs);
+
+    // Row of numSections coefficients designed with step * stepDb less gain.
+    // A table with a row that couldn't be measured stays invalid.
+    BiquadCoeffs* getTableRow(int step);
+    void setTable(int numsections, bool valid);
+    void setDetector(const BiquadCoeffs& first, const BiquadCoeffs& second);
+    bool hasTable() const;
+
+    // Tracks the level of up to controlInterval samples of the band's input.
+    // True if the coefficients for the new reduction differ from the last
+    // ones. Audio thread.
+    bool process(double* const* channels, int numChannels, int numSamples);
+    const BiquadCoeffs* getCoefficients() const;
+    int getNumSections() const;
+    float getReductionDb() const;
+
+    void reset();
+
+    // Takes over the table, settings and state of one with the same
+    // capacity, doesn't allocate.
+    void copyFrom(const BandDynamics& other);
+
+    // Takes over only the table and detector filter of one with the same
+    // capacity, for a new design of a band that keeps playing. The settings
+    // and the level state stay. Doesn't allocate.
+    void copyTableFrom(const BandDynamics& other);
+
+    // Takes over only the detector and level state, for a design that
+    // continues where another band's left off. Doesn't allocate.
+    void copyStateFrom(const BandDynamics& other);
+
+    size_t getMemoryBytes() const;
+
+private:
+
+    const int maxSections;
+    double sampleRate = 48000.0;
+    int numSections = 0;
+    bool tableValid = false;
+    std::vector<BiquadCoeffs> table;
+    std::vector<BiquadCoeffs> current;
+
+    std::array<BiquadCoeffs, 2> detectorCoeffs;
+    MultiChannelCascade detector { 2 };
+    std::vector<double> scratch;
+    std::vector<double*> scratchPointers;
+
+    float threshold = -20.f;
+    float slope = 0.5f;
+    float attackMs = 10.f;
+    float releaseMs = 100.f;
+    double attackCoeff = 0.0;
+    double releaseCoeff = 0.0;
+    double envelope = 0.0;
+    float reduction = -1.f;
+};
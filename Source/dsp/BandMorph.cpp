@@ -0,0 +1,389 @@
+#include "BandMorph.h"
+
+class BandMorph::DesignThread : public juce::Thread
+{
+public:
+
+    explicit DesignThread(BandMorph& o)
+        : juce::Thread("AFEQ morph"), owner(o)
+    {
+    }
+
+    ~DesignThread() override
+    {
+        stopThread(1000);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            owner.designPending();
+            wait(20);
+        }
+    }
+
+private:
+
+    BandMorph& owner;
+};
+
+BandMorph::BandMorph(int numbands, int maxorder, const FreqResponseBase& freqresbase)
+    : numBands(numbands), maxOrder(maxorder), maxSections(2 * ((maxorder + 1) / 2)), freqResBase(freqresbase)
+{
+}
+
+BandMorph::~BandMorph()
+{
+    release();
+}
+
+void BandMorph::prepare(double sampleRate, int blockSize, const juce::AudioChannelSet& layout, bool svfForced)
+{
+    release();
+
+    {
+        const juce::ScopedLock sl(lock);
+        preparedSampleRate = sampleRate;
+        preparedBlockSize = blockSize;
+        preparedLayout = layout;
+        preparedSvfForced = svfForced;
+        dirty = ! sourceA.empty();
+    }
+
+    // designs for the old rate are rebuilt
+    for (auto& d : designs)
+    {
+        for (auto b : d.bands)
+        {
+            prepareBand(*b->a);
+            prepareBand(*b->b);
+        }
+
+        d.state = Design::unused;
+    }
+
+    pendingDesign = -1;
+    activeDesign = -1;
+    lastPosition = -1.f;
+    playing = false;
+    fadeBuffer.setSize(juce::jmax(2, layout.size()), blockSize);
+    subChannels.assign(static_cast<size_t> (fadeBuffer.getNumChannels()), nullptr);
+
+    thread = std::make_unique<DesignThread>(*this);
+    thread->startThread();
+}
+
+void BandMorph::release()
+{
+    thread.reset();
+}
+
+void BandMorph::setSources(const std::vector<BandValues>& a, const std::vector<BandValues>& b)
+{
+    {
+        const juce::ScopedLock sl(lock);
+        sourceA = a;
+        sourceB = b;
+        dirty = true;
+    }
+
+    engaged = true;
+
+    if (thread != nullptr)
+        thread->notify();
+}
+
+void BandMorph::clearSources()
+{
+    engaged = false;
+}
+
+bool BandMorph::hasSources() const
+{
+    return engaged;
+}
+
+bool BandMorph::isReady() const
+{
+    return engaged && ! dirty && (activeDesign >= 0 || pendingDesign >= 0);
+}
+
+bool BandMorph::canInterpolate(const BandValues& a, const BandValues& b)
+{
+    // dynamic bands set their own coefficients
+    return a.enabled == b.enabled && a.type == b.type && a.order == b.order && a.routing == b.routing
+        && ! a.dynamic && ! b.dynamic;
+}
+
+BandValues BandMorph::interpolate(const BandValues& a, const BandValues& b, float position)
+{
+    const auto logLerp = [position](float x, float y) {
+        return std::exp((1.f - position) * std::log(x) + position * std::log(y));
+    };
+
+    auto values = a;
+    values.freq = logLerp(a.freq, b.freq);
+    values.q = logLerp(a.q, b.q);
+    values.gain = (1.f - position) * a.gain + position * b.gain;
+    return values;
+}
+
+void BandMorph::prepareBand(EqBandDsp& band)
+{
+    band.setBlockSize(preparedBlockSize);
+    band.setSampleRate(preparedSampleRate);
+    band.setChannelLayout(preparedLayout);
+    band.setSvfForced(preparedSvfForced);
+}
+
+void BandMorph::designPending()
+{
+    if (! dirty)
+        return;
+
+    std::vector<BandValues> a;
+    std::vector<BandValues> b;
+
+    {
+        const juce::ScopedLock sl(lock);
+        a = sourceA;
+        b = sourceB;
+        dirty = false;
+    }
+
+    // the design the audio thread doesn't play, a ready one it hasn't taken
+    // yet is replaced
+    for (auto& d : designs)
+    {
+        for (auto expected : { static_cast<int> (Design::unused), static_cast<int> (Design::ready) })
+        {
+            if (d.state.compare_exchange_strong(expected, Design::building))
+            {
+                build(d, a, b);
+                d.state = Design::ready;
+                pendingDesign = static_cast<int> (&d - designs.data());
+                return;
+            }
+        }
+    }
+
+    dirty = true;
+}
+
+void BandMorph::build(Design& design, const std::vector<BandValues>& a, const std::vector<BandValues>& b)
+{
+    while (design.bands.size() < numBands)
+    {
+        auto band = design.bands.add(std::make_unique<Band>());
+        band->a = std::make_unique<EqBandDsp>(maxOrder, freqResBase, design.bands.size());
+        band->b = std::make_unique<EqBandDsp>(maxOrder, freqResBase, design.bands.size());
+        prepareBand(*band->a);
+        prepareBand(*band->b);
+    }
+
+    std::vector<BiquadCoeffs> sections;
+
+    for (int i = 0; i < numBands; ++i)
+    {
+        auto& band = *design.bands[i];
+        const auto va = static_cast<size_t> (i) < a.size() ? a[static_cast<size_t> (i)] : BandValues();
+        const auto vb = static_cast<size_t> (i) < b.size() ? b[static_cast<size_t> (i)] : BandValues();
+
+        band.step = -1;
+        band.a->setValues(va);
+        band.a->reset();
+        band.b->reset();
+
+        if (va == vb || (! va.enabled && ! vb.enabled))
+        {
+            band.mode = Band::single;
+            continue;
+        }
+
+        // the steps run on a's cascade, SVF bands have none
+        band.mode = canInterpolate(va, vb) && ! band.a->isSvfActive() && band.a->getSectionCoefficients(sections)
+            ? Band::table : Band::crossfade;
+
+        if (band.mode == Band::table)
+        {
+            band.coeffs.resize(static_cast<size_t> ((numSteps + 1) * maxSections));
+            band.numSections.resize(static_cast<size_t> (numSteps + 1));
+
+            for (int s = 0; s <= numSteps && band.mode == Band::table; ++s)
+            {
+                band.b->setValues(interpolate(va, vb, static_cast<float> (s) / numSteps));
+
+                if (band.b->getSectionCoefficients(sections))
+                {
+                    const auto n = juce::jmin(maxSections, static_cast<int> (sections.size()));
+                    std::copy(sections.begin(), sections.begin() + n, band.coeffs.begin() + s * maxSections);
+                    band.numSections[static_cast<size_t> (s)] = n;
+                }
+                else
+                {
+                    band.mode = Band::crossfade;
+                }
+            }
+        }
+
+        if (band.mode == Band::crossfade)
+        {
+            band.coeffs.clear();
+            band.numSections.clear();
+        }
+
+        band.b->setValues(vb);
+        band.b->reset();
+    }
+}
+
+void BandMorph::copyState(Design& to, const Design& from)
+{
+    const auto num = juce::jmin(to.bands.size(), from.bands.size());
+
+    for (int i = 0; i < num; ++i)
+    {
+        to.bands[i]->a->copyStateFrom(*from.bands[i]->a);
+        to.bands[i]->b->copyStateFrom(*from.bands[i]->b);
+    }
+}
+
+bool BandMorph::process(EqBandDspGroup& live, double* const* channels, int numChannels, int numSamples, float position)
+{
+    if (! engaged)
+    {
+        // the live bands continue from the morph's filters
+        if (playing)
+        {
+            const auto& design = designs[static_cast<size_t> (activeDesign.load())];
+            const auto num = juce::jmin(live.size(), design.bands.size());
+
+            for (int i = 0; i < num; ++i)
+                live[i]->copyStateFrom(*design.bands[i]->a);
+
+            playing = false;
+        }
+
+        return false;
+    }
+
+    const auto pending = pendingDesign.exchange(-1, std::memory_order_acquire);
+
+    if (pending >= 0)
+    {
+        auto expected = static_cast<int> (Design::ready);
+
+        if (designs[static_cast<size_t> (pending)].state.compare_exchange_strong(expected, Design::active))
+        {
+            const auto previous = activeDesign.load();
+
+            // before the design thread may rebuild the previous one
+            if (previous >= 0 && playing)
+                copyState(designs[static_cast<size_t> (pending)], designs[static_cast<size_t> (previous)]);
+
+            if (previous >= 0)
+                designs[static_cast<size_t> (previous)].state = Design::unused;
+
+            activeDesign = pending;
+        }
+    }
+
+    const auto active = activeDesign.load();
+
+    if (active < 0)
+        return false;
+
+    jassert(numSamples <= fadeBuffer.getNumSamples());
+    auto& design = designs[static_cast<size_t> (active)];
+
+    // the morph takes over from the live bands' filters
+    if (! playing)
+    {
+        const auto num = juce::jmin(live.size(), design.bands.size());
+
+        for (int i = 0; i < num; ++i)
+        {
+            design.bands[i]->a->copyStateFrom(*live[i]);
+            design.bands[i]->b->copyStateFrom(*live[i]);
+        }
+
+        playing = true;
+    }
+
+    position = juce::jlimit(0.f, 1.f, position);
+    const auto startPosition = lastPosition < 0.f ? position : lastPosition;
+    lastPosition = position;
+    const auto numFadeChannels = juce::jmin(numChannels, fadeBuffer.getNumChannels());
+
+    for (auto band : design.bands)
+    {
+        switch (band->mode)
+        {
+        case Band::single:
+            band->a->processDesigned(channels, numChannels, numSamples);
+            break;
+        case Band::table:
+            for (int pos = 0; pos < numSamples; pos += controlInterval)
+            {
+                const auto n = juce::jmin(controlInterval, numSamples - pos);
+                const auto t = startPosition + (position - startPosition) * static_cast<float> (pos) / static_cast<float> (numSamples);
+                const auto step = juce::roundToInt(t * numSteps);
+
+                if (step != band->step)
+                {
+                    band->step = step;
+                    band->a->setSectionCoefficients(band->coeffs.data() + step * maxSections, band->numSections[static_cast<size_t> (step)]);
+                }
+
+                const auto numSub = juce::jmin(numChannels, static_cast<int> (subChannels.size()));
+
+                for (int ch = 0; ch < numSub; ++ch)
+                    subChannels[static_cast<size_t> (ch)] = channels[ch] + pos;
+
+                band->a->processDesigned(subChannels.data(), numSub, n);
+            }
+            break;
+        case Band::crossfade:
+        {
+            for (int ch = 0; ch < numFadeChannels; ++ch)
+                juce::FloatVectorOperations::copy(fadeBuffer.getWritePointer(ch), channels[ch], numSamples);
+
+            band->a->processDesigned(channels, numChannels, numSamples);
+            band->b->processDesigned(fadeBuffer.getArrayOfWritePointers(), numFadeChannels, numSamples);
+
+            const auto delta = (position - startPosition) / static_cast<float> (numSamples);
+
+            for (int ch = 0; ch < numFadeChannels; ++ch)
+            {
+                auto out = channels[ch];
+                const auto in = fadeBuffer.getReadPointer(ch);
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const auto w = static_cast<double> (startPosition + delta * static_cast<float> (i));
+                    out[i] += w * (in[i] - out[i]);
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    return true;
+}
+
+size_t BandMorph::getMemoryBytes() const
+{
+    auto bytes = sizeof(BandMorph) + static_cast<size_t> (fadeBuffer.getNumChannels() * fadeBuffer.getNumSamples()) * sizeof(double)
+        + subChannels.capacity() * sizeof(double*);
+
+    for (const auto& d : designs)
+        for (auto b : d.bands)
+            bytes += sizeof(Band) + b->a->getMemoryBytes() + b->b->getMemoryBytes()
+                + b->coeffs.capacity() * sizeof(BiquadCoeffs) + b->numSections.capacity() * sizeof(int);
+
+    return bytes;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "EqBandDsp.h"
+
+// Band chain morphing between two band tables. Frequency and Q move on a log
+// scale and gain in dB. Bands whose enabled state, type, order or routing
+// differ, and dynamic bands, can't be interpolated, they run both designs
+// and crossfade.
+//
+// The position is quantised to numSteps and the designs of all steps are
+// computed on a background thread whenever the sources change, so the audio
+// thread only swaps in coefficients every controlInterval samples and never
+// designs. Bands equal in both tables run a single design.
+//
+// The filter state carries over wherever the sections allow it: from the
+// live bands when the morph starts playing, from the previous design when a
+// new one is swapped in, and back to the live bands when it stops.
+class BandMorph
+{
+public:
+
+    static constexpr int numSteps = 128;
+    static constexpr int controlInterval = 32;
+
+    BandMorph(int numbands, int maxorder, const FreqResponseBase& freqresbase);
+    ~BandMorph();
+
+    // Allocates and starts the design thread, not realtime safe. The
+    // freqresbase grid must not change until release. svfForced is passed on
+    // to the bands, see EqBandDsp::setSvfForced.
+    void prepare(double sampleRate, int blockSize, const juce::AudioChannelSet& layout, bool svfForced = false);
+    void release();
+
+    // Message thread. Until the new sources are designed the previous ones
+    // keep playing, or process() returns false if there were none.
+    void setSources(const std::vector<BandValues>& a, const std::vector<BandValues>& b);
+    void clearSources();
+    bool hasSources() const;
+    bool isReady() const;
+
+    static bool canInterpolate(const BandValues& a, const BandValues& b);
+    static BandValues interpolate(const BandValues& a, const BandValues& b, float position);
+
+    // Processes the block with the position moving linearly from the one of
+    // the previous call. False without designed sources, the block is then
+    // left to the live bands. Audio thread.
+    bool process(EqBandDspGroup& live, double* const* channels, int numChannels, int numSamples, float position);
+
+    size_t getMemoryBytes() const;
+
+private:
+
+    class DesignThread;
+
+    struct Band
+    {
+        enum Mode
+        {
+            single,
+            table,
+            crossfade
+        };
+
+        Mode mode = single;
+        std::unique_ptr<EqBandDsp> a;
+        std::unique_ptr<EqBandDsp> b;
+
+        // numSteps + 1 rows of maxSections sections
+        std::vector<BiquadCoeffs> coeffs;
+        std::vector<int> numSections;
+        int step = -1;
+    };
+
+    // Designs are double buffered between the design thread and the audio
+    // thread, which takes a ready one at the start of a block.
+    struct Design
+    {
+        enum State
+        {
+            unused,
+            building,
+            ready,
+            active
+        };
+
+        juce::OwnedArray<Band> bands;
+        std::atomic<int> state { unused };
+    };
+
+    void designPending();
+    void build(Design& design, const std::vector<BandValues>& a, const std::vector<BandValues>& b);
+    void prepareBand(EqBandDsp& band);
+    static void copyState(Design& to, const Design& from);
+
+    const int numBands;
+    const int maxOrder;
+    const int maxSections;
+    const FreqResponseBase& freqResBase;
+    double preparedSampleRate = 0.0;
+    int preparedBlockSize = 0;
+    juce::AudioChannelSet preparedLayout;
+    bool preparedSvfForced = false;
+
+    juce::CriticalSection lock;
+    std::vector<BandValues> sourceA;
+    std::vector<BandValues> sourceB;
+    std::atomic<bool> engaged { false };
+    std::atomic<bool> dirty { false };
+    std::unique_ptr<DesignThread> thread;
+
+    std::array<Design, 2> designs;
+    std::atomic<int> pendingDesign { -1 };
+    std::atomic<int> activeDesign { -1 };
+    juce::AudioBuffer<double> fadeBuffer;
+    std::vector<double*> subChannels;
+    float lastPosition = -1.f;
+    // the active design's bands processed the last block
+    bool playing = false;
+};
@@ -0,0 +1,335 @@
+#include "BiquadKernel.h"
+
+namespace
+{
+    // Transposed direct form II over all sections per sample, the state is
+    // laid out like the tiled loop's, so both can take over from each other.
+    template <int numSections, int numLanes>
+    void processFixed(const BiquadCoeffs* coeffs, double* const* channels, double* groupState, int numSamples)
+    {
+        constexpr auto laneWidth = MultiChannelCascade::laneWidth;
+        BiquadCoeffs c[numSections];
+        double z1[numSections][numLanes];
+        double z2[numSections][numLanes];
+        double* ch[numLanes];
+
+        for (int s = 0; s < numSections; ++s)
+        {
+            c[s] = coeffs[s];
+
+            for (int l = 0; l < numLanes; ++l)
+            {
+                z1[s][l] = groupState[s * 2 * laneWidth + l];
+                z2[s][l] = groupState[s * 2 * laneWidth + laneWidth + l];
+            }
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+            ch[l] = channels[l];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            double x[numLanes];
+
+            for (int l = 0; l < numLanes; ++l)
+                x[l] = ch[l][i];
+
+            for (int s = 0; s < numSections; ++s)
+            {
+                for (int l = 0; l < numLanes; ++l)
+                {
+                    const auto out = c[s].b0 * x[l] + z1[s][l];
+                    z1[s][l] = c[s].b1 * x[l] - c[s].a1 * out + z2[s][l];
+                    z2[s][l] = c[s].b2 * x[l] - c[s].a2 * out;
+                    x[l] = out;
+                }
+            }
+
+            for (int l = 0; l < numLanes; ++l)
+                ch[l][i] = x[l];
+        }
+
+        for (int s = 0; s < numSections; ++s)
+        {
+            for (int l = 0; l < numLanes; ++l)
+            {
+                groupState[s * 2 * laneWidth + l] = z1[s][l];
+                groupState[s * 2 * laneWidth + laneWidth + l] = z2[s][l];
+            }
+        }
+    }
+
+    template <int numSections>
+    constexpr std::array<MultiChannelCascade::Kernel, MultiChannelCascade::laneWidth> makeKernelRow()
+    {
+        static_assert(MultiChannelCascade::laneWidth == 4, "one kernel per lane count");
+        return { &processFixed<numSections, 1>, &processFixed<numSections, 2>, &processFixed<numSections, 3>, &processFixed<numSections, 4> };
+    }
+
+    // [sections - 1][lanes - 1]
+    constexpr std::array<std::array<MultiChannelCascade::Kernel, MultiChannelCascade::laneWidth>, MultiChannelCascade::maxFixedSections> fixedKernels {
+        makeKernelRow<1>(), makeKernelRow<2>(), makeKernelRow<3>(), makeKernelRow<4>()
+    };
+}
+
+double BiquadCoeffs::getMagnitude(double omega) const
+{
+    const auto c1 = std::cos(omega);
+    const auto s1 = std::sin(omega);
+    const auto c2 = std::cos(2.0 * omega);
+    const auto s2 = std::sin(2.0 * omega);
+
+    const auto numRe = b0 + b1 * c1 + b2 * c2;
+    const auto numIm = b1 * s1 + b2 * s2;
+    const auto denRe = 1.0 + a1 * c1 + a2 * c2;
+    const auto denIm = a1 * s1 + a2 * s2;
+
+    return std::sqrt((numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm));
+}
+
+BiquadProbe::BiquadProbe()
+    : probe(1, 1)
+{
+    juce::Random random(0x4146);
+
+    for (auto& x : excitation)
+        x = 2.0 * random.nextDouble() - 1.0;
+
+    response = excitation;
+}
+
+bool BiquadProbe::fit(int order, BiquadCoeffs& coeffs) const
+{
+    // y[n] = sum b_k x[n-k] - sum a_k y[n-k], one row per sample from n = 2 on,
+    // solved in the least squares sense with Householder reflections.
+    constexpr int numRows = numProbeSamples - 2;
+    const auto numCols = 2 * order + 1;
+    const auto& x = excitation;
+    const auto& y = response;
+
+    double a[numRows][5];
+    double rhs[numRows];
+    double diag[5];
+
+    for (int r = 0; r < numRows; ++r)
+    {
+        const auto n = static_cast<size_t> (r + 2);
+
+        for (int k = 0; k <= order; ++k)
+            a[r][k] = x[n - static_cast<size_t> (k)];
+
+        for (int k = 1; k <= order; ++k)
+            a[r][order + k] = -y[n - static_cast<size_t> (k)];
+
+        rhs[r] = y[n];
+    }
+
+    for (int k = 0; k < numCols; ++k)
+    {
+        auto norm = 0.0;
+        for (int r = k; r < numRows; ++r)
+            norm += a[r][k] * a[r][k];
+
+        norm = std::sqrt(norm);
+
+        if (norm == 0.0)
+            return false;
+
+        diag[k] = a[k][k] > 0.0 ? -norm : norm;
+        a[k][k] -= diag[k];
+
+        auto vv = 0.0;
+        for (int r = k; r < numRows; ++r)
+            vv += a[r][k] * a[r][k];
+
+        for (int j = k + 1; j < numCols; ++j)
+        {
+            auto dot = 0.0;
+            for (int r = k; r < numRows; ++r)
+                dot += a[r][k] * a[r][j];
+
+            const auto f = 2.0 * dot / vv;
+            for (int r = k; r < numRows; ++r)
+                a[r][j] -= f * a[r][k];
+        }
+
+        auto dot = 0.0;
+        for (int r = k; r < numRows; ++r)
+            dot += a[r][k] * rhs[r];
+
+        const auto f = 2.0 * dot / vv;
+        for (int r = k; r < numRows; ++r)
+            rhs[r] -= f * a[r][k];
+    }
+
+    double theta[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+    for (int k = numCols - 1; k >= 0; --k)
+    {
+        auto sum = rhs[k];
+        for (int j = k + 1; j < numCols; ++j)
+            sum -= a[k][j] * theta[j];
+
+        theta[k] = sum / diag[k];
+    }
+
+    BiquadCoeffs c;
+    c.b0 = theta[0];
+    c.b1 = order >= 1 ? theta[1] : 0.0;
+    c.b2 = order >= 2 ? theta[2] : 0.0;
+    c.a1 = order >= 1 ? theta[order + 1] : 0.0;
+    c.a2 = order >= 2 ? theta[order + 2] : 0.0;
+
+    // stability triangle
+    if (! (std::abs(c.a2) < 1.0 && std::abs(c.a1) < 1.0 + c.a2))
+        return false;
+
+    // The lower order fits must reproduce the probe to rounding, anything
+    // else means a higher order or a section that isn't a plain biquad.
+    auto scale = 0.0;
+    auto maxError = 0.0;
+
+    for (size_t n = 2; n < static_cast<size_t> (numProbeSamples); ++n)
+    {
+        const auto pred = c.b0 * x[n] + c.b1 * x[n - 1] + c.b2 * x[n - 2] - c.a1 * y[n - 1] - c.a2 * y[n - 2];
+        maxError = juce::jmax(maxError, std::abs(y[n] - pred));
+        scale = juce::jmax(scale, std::abs(x[n]), std::abs(y[n]));
+    }
+
+    if (! (maxError <= 1e-11 * scale))
+        return false;
+
+    coeffs = c;
+    return true;
+}
+
+MultiChannelCascade::MultiChannelCascade(int maxsections)
+    : maxSections(maxsections), coeffs(static_cast<size_t> (maxsections))
+{
+    setMaxChannels(2);
+}
+
+void MultiChannelCascade::setMaxChannels(int numChannels)
+{
+    maxChannels = numChannels;
+    const auto numGroups = (numChannels + laneWidth - 1) / laneWidth;
+    state.assign(static_cast<size_t> (numGroups * maxSections * 2 * laneWidth), 0.0);
+}
+
+int MultiChannelCascade::getMaxChannels() const
+{
+    return maxChannels;
+}
+
+void MultiChannelCascade::setCoefficients(const BiquadCoeffs* newCoeffs, int numsections)
+{
+    jassert(numsections <= maxSections);
+    const auto newCount = juce::jmin(numsections, maxSections);
+    std::copy(newCoeffs, newCoeffs + newCount, coeffs.begin());
+
+    if (newCount != numSections)
+    {
+        numSections = newCount;
+        updateKernels();
+    }
+}
+
+void MultiChannelCascade::setFixedKernelsEnabled(bool shouldBeEnabled)
+{
+    fixedKernelsEnabled = shouldBeEnabled;
+    updateKernels();
+}
+
+void MultiChannelCascade::updateKernels()
+{
+    if (fixedKernelsEnabled && numSections >= 1 && numSections <= maxFixedSections)
+        kernels = fixedKernels[static_cast<size_t> (numSections - 1)];
+    else
+        kernels.fill(nullptr);
+}
+
+void MultiChannelCascade::reset()
+{
+    std::fill(state.begin(), state.end(), 0.0);
+}
+
+void MultiChannelCascade::copyStateFrom(const MultiChannelCascade& other)
+{
+    jassert(maxSections == other.maxSections && state.size() == other.state.size());
+    std::copy(other.state.begin(), other.state.begin() + static_cast<std::ptrdiff_t> (juce::jmin(state.size(), other.state.size())), state.begin());
+}
+
+void MultiChannelCascade::process(double* const* channels, int numChannels, int numSamples)
+{
+    numChannels = juce::jmin(numChannels, maxChannels);
+    const auto groupStride = maxSections * 2 * laneWidth;
+
+    for (int first = 0; first < numChannels; first += laneWidth)
+    {
+        const auto numLanes = juce::jmin(laneWidth, numChannels - first);
+        const auto groupState = state.data() + (first / laneWidth) * groupStride;
+
+        if (auto kernel = kernels[static_cast<size_t> (numLanes - 1)])
+            kernel(coeffs.data(), channels + first, groupState, numSamples);
+        else
+            processGroup(channels + first, numLanes, groupState, numSamples);
+    }
+}
+
+void MultiChannelCascade::processGroup(double* const* channels, int numLanes, double* groupState, int numSamples)
+{
+    alignas(32) double tile[tileSize][laneWidth];
+
+    for (int pos = 0; pos < numSamples; pos += tileSize)
+    {
+        const auto n = juce::jmin(tileSize, numSamples - pos);
+
+        // unused lanes run on silence
+        for (int i = 0; i < n; ++i)
+            for (int l = 0; l < laneWidth; ++l)
+                tile[i][l] = l < numLanes ? channels[l][pos + i] : 0.0;
+
+        for (int s = 0; s < numSections; ++s)
+        {
+            const auto c = coeffs[static_cast<size_t> (s)];
+            auto z = groupState + s * 2 * laneWidth;
+
+            alignas(32) double z1[laneWidth];
+            alignas(32) double z2[laneWidth];
+
+            for (int l = 0; l < laneWidth; ++l)
+            {
+                z1[l] = z[l];
+                z2[l] = z[laneWidth + l];
+            }
+
+            // transposed direct form II
+            for (int i = 0; i < n; ++i)
+            {
+                for (int l = 0; l < laneWidth; ++l)
+                {
+                    const auto in = tile[i][l];
+                    const auto out = c.b0 * in + z1[l];
+                    z1[l] = c.b1 * in - c.a1 * out + z2[l];
+                    z2[l] = c.b2 * in - c.a2 * out;
+                    tile[i][l] = out;
+                }
+            }
+
+            for (int l = 0; l < laneWidth; ++l)
+            {
+                z[l] = z1[l];
+                z[laneWidth + l] = z2[l];
+            }
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int i = 0; i < n; ++i)
+                channels[l][pos + i] = tile[i][l];
+    }
+}
+
+size_t MultiChannelCascade::getMemoryBytes() const
+{
+    return sizeof(MultiChannelCascade) + coeffs.capacity() * sizeof(BiquadCoeffs) + state.capacity() * sizeof(double);
+}
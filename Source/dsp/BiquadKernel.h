@@ -0,0 +1,123 @@
+#pragma once
+
+#include "../AudioFilter/src/FilterInstance.h"
+
+#include "JuceHeader.h"
+
+#include <array>
+
+// Direct form coefficients of one biquad section, normalised to a0 = 1.
+struct BiquadCoeffs
+{
+    double b0 = 1.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    double a1 = 0.0;
+    double a2 = 0.0;
+
+    // |H| at omega in radians per sample.
+    double getMagnitude(double omega) const;
+};
+
+// AudioFilter keeps the coefficients of a section inside its filter
+// implementation, so they are measured on a probe instance instead. From the
+// second sample on, every output sample is linear in the coefficients and
+// independent of the probe's state, which gives an overdetermined system for
+// a short noise excitation. Lower orders are tried first, so first order and
+// pure gain sections come out exact. Doesn't allocate once constructed.
+class BiquadProbe
+{
+public:
+
+    BiquadProbe();
+
+    // False if the section doesn't behave like a stable biquad over the probe.
+    template <typename Section>
+    bool measure(const Section& section, BiquadCoeffs& coeffs)
+    {
+        probe.setParams(section);
+        response = excitation;
+
+        double* data = response.data();
+        probe.processBlock(&data, const_cast<const double**> (&data), numProbeSamples);
+
+        for (int order = 0; order <= 2; ++order)
+            if (fit(order, coeffs))
+                return true;
+
+        return false;
+    }
+
+private:
+
+    bool fit(int order, BiquadCoeffs& coeffs) const;
+
+    static constexpr int numProbeSamples = 64;
+    AudioFilter::FilterInstance<double> probe;
+    std::array<double, numProbeSamples> excitation;
+    std::array<double, numProbeSamples> response;
+};
+
+// Biquad cascade with shared coefficients for any number of channels. The
+// channels are processed in groups of laneWidth: each group is transposed
+// into a short interleaved tile and every section runs over the tile with the
+// lanes as the inner loop. That loop has a fixed trip count and independent
+// lanes so the compiler can vectorise it; whether it does depends on the
+// compiler and flags, the "kernel" group of afeq_benchmark times it against
+// the fixed kernels.
+//
+// Up to maxFixedSections sections, groups run on kernels compiled for their
+// section and lane count instead, picked from a table when the section count
+// changes: the loops unroll, coefficients and state stay in registers for the
+// whole block, and groups of fewer than laneWidth channels don't pay for the
+// silent lanes.
+class MultiChannelCascade
+{
+public:
+
+    static constexpr int laneWidth = 4;
+    static constexpr int maxFixedSections = 4;
+
+    explicit MultiChannelCascade(int maxsections);
+
+    // Allocates the filter state, not realtime safe.
+    void setMaxChannels(int numChannels);
+    int getMaxChannels() const;
+
+    // Keeps the state, like FilterInstance::setParams.
+    void setCoefficients(const BiquadCoeffs* newCoeffs, int numsections);
+    void reset();
+
+    // Takes over the state of a cascade with the same section and channel
+    // capacity, doesn't allocate.
+    void copyStateFrom(const MultiChannelCascade& other);
+
+    // Processes in place. The state of a lane belongs to its position in
+    // channels, channels beyond getMaxChannels() are left untouched.
+    void process(double* const* channels, int numChannels, int numSamples);
+
+    size_t getMemoryBytes() const;
+
+    // The tiled loop for every section count, for comparisons.
+    void setFixedKernelsEnabled(bool shouldBeEnabled);
+
+    using Kernel = void (*)(const BiquadCoeffs* coeffs, double* const* channels, double* groupState, int numSamples);
+
+private:
+
+    void processGroup(double* const* channels, int numLanes, double* groupState, int numSamples);
+    void updateKernels();
+
+    static constexpr int tileSize = 64;
+    int maxSections;
+    int numSections = 0;
+    int maxChannels = 0;
+    std::vector<BiquadCoeffs> coeffs;
+
+    // by number of lanes minus one, null for the tiled loop
+    std::array<Kernel, laneWidth> kernels {};
+    bool fixedKernelsEnabled = true;
+
+    // [group][section][z1, z2][lane]
+    std::vector<double> state;
+};
@@ -1,17 +1,149 @@
 #include "EqBandDsp.h"
+#include "BandDesigner.h"
+#include "SharedTables.h"
 #include "../AudioFilter/src/ParametricCreator.h"
 
+size_t FreqResponseBase::getMemoryBytes() const
+{
+    const auto resBytes = [](const ResponseData& r) { return r.res.capacity() * sizeof(float); };
+
+    return sizeof(FreqResponseBase) + resBytes(resStereo) + resBytes(resLeft) + resBytes(resRight)
+        + resBytes(resMid) + resBytes(resSide);
+}
+
+size_t FreqResponseBase::getSharedMemoryBytes() const
+{
+    return getSharedBytesPerUser(grid, sizeof(Grid) + static_cast<size_t> (numFreqs) * sizeof(float));
+}
+
+std::shared_ptr<const FreqResponseBase::Grid> FreqResponseBase::getSharedGrid(int numfreqs, float startfreq, float endfreq, float sampleRate)
+{
+    using Key = std::tuple<int, float, float, float>;
+    static SharedTableRegistry<Key, Grid> registry;
 
+    return registry.get(Key(numfreqs, startfreq, endfreq, sampleRate), [&]() {
+        auto newGrid = std::make_unique<Grid>(numfreqs, startfreq, endfreq);
+
+        if (sampleRate > 0.f)
+            newGrid->setSampleRate(sampleRate);
+
+        return newGrid;
+    });
+}
+
+ChannelGroups::ChannelGroups()
+{
+    setLayout(juce::AudioChannelSet::stereo());
+}
+
+void ChannelGroups::setLayout(const juce::AudioChannelSet& layout)
+{
+    numChannels = layout.size();
+    left = -1;
+    right = -1;
+    all.clear();
+    lcr.clear();
+    surrounds.clear();
+    heights.clear();
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        all.push_back(ch);
+
+        switch (layout.getTypeOfChannel(ch))
+        {
+        case juce::AudioChannelSet::left:
+            left = left < 0 ? ch : left;
+            lcr.push_back(ch);
+            break;
+        case juce::AudioChannelSet::right:
+            right = right < 0 ? ch : right;
+            lcr.push_back(ch);
+            break;
+        case juce::AudioChannelSet::centre:
+            lcr.push_back(ch);
+            break;
+        case juce::AudioChannelSet::leftSurround:
+        case juce::AudioChannelSet::rightSurround:
+        case juce::AudioChannelSet::centreSurround:
+        case juce::AudioChannelSet::leftSurroundSide:
+        case juce::AudioChannelSet::rightSurroundSide:
+        case juce::AudioChannelSet::leftSurroundRear:
+        case juce::AudioChannelSet::rightSurroundRear:
+            surrounds.push_back(ch);
+            break;
+        case juce::AudioChannelSet::topMiddle:
+        case juce::AudioChannelSet::topFrontLeft:
+        case juce::AudioChannelSet::topFrontCentre:
+        case juce::AudioChannelSet::topFrontRight:
+        case juce::AudioChannelSet::topRearLeft:
+        case juce::AudioChannelSet::topRearCentre:
+        case juce::AudioChannelSet::topRearRight:
+        case juce::AudioChannelSet::topSideLeft:
+        case juce::AudioChannelSet::topSideRight:
+            heights.push_back(ch);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Discrete layouts use their first two channels, also when they are only
+    // a part of a layout.
+    if (left < 0 || right < 0)
+    {
+        left = -1;
+        right = -1;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto index = layout.getTypeOfChannel(ch) - juce::AudioChannelSet::discreteChannel0;
+            left = index == 0 ? ch : left;
+            right = index == 1 ? ch : right;
+        }
+    }
+}
+
+const std::vector<int>& ChannelGroups::getChannels(BandParams::Routing routing) const
+{
+    switch (routing)
+    {
+    case BandParams::routeLCR:
+        return lcr;
+    case BandParams::routeSurrounds:
+        return surrounds;
+    case BandParams::routeHeights:
+        return heights;
+    default:
+        return all;
+    }
+}
+
+
+EqBandDsp::Filters::Filters(int maxorder, int numsections)
+    : sectionCoeffs(static_cast<size_t> (numsections)), cascade(numsections),
+    filterInstance(std::make_unique<AudioFilter::FilterInstance<double>>(2, numsections)), biquads(numsections),
+    bwCreator(numsections), dynamics(numsections), dynamicBiquads(numsections), detectorBiquads(2), svf(maxorder),
+    svfCoeffs(static_cast<size_t> (maxorder))
+{
+}
 
 EqBandDsp::EqBandDsp(int maxOrder, const FreqResponseBase& freqresbase, int index)
-    : bandIndex(index), filterInstance(2, 2*((maxOrder+1)/2)), biquads(2 * ((maxOrder+1)/2)), bwCreator(2 * ((maxOrder+1)/2)), freqResBase(freqresbase)
+    : bandIndex(index), numSections(2 * ((maxOrder+1)/2)), procBuffers(2, nullptr), freqResBase(freqresbase)
 {
     freqRes.resize(freqResBase.getNumPoints());
     bandParams.maxOrder = maxOrder;
 }
 
+void EqBandDsp::allocateFilters()
+{
+    if (filters == nullptr)
+        filters = std::make_unique<Filters>(bandParams.maxOrder, numSections);
+}
+
 void EqBandDsp::setBlockSize(int blockSize)
 {
+    allocateFilters();
     dataMain.resize(blockSize);
     dataAux.resize(blockSize);
 }
@@ -20,6 +152,32 @@ void EqBandDsp::setSampleRate(double newSampleRate)
 {
     jassert(newSampleRate > 40000);
     sampleRate = newSampleRate;
+    allocateFilters();
+    filters->dynamics.setSampleRate(newSampleRate);
+}
+
+void EqBandDsp::setChannelLayout(const juce::AudioChannelSet& layout)
+{
+    // the filters of a layout that didn't change only start over
+    if (filters != nullptr && layout == preparedLayout && ! layout.isDisabled())
+    {
+        reset();
+        redesign = true;
+        return;
+    }
+
+    allocateFilters();
+    preparedLayout = layout;
+    channelGroups.setLayout(layout);
+
+    const auto numChannels = juce::jmax(2, channelGroups.numChannels);
+    procBuffers.assign(static_cast<size_t> (numChannels), nullptr);
+    subBuffers.assign(static_cast<size_t> (numChannels), nullptr);
+    filters->cascade.setMaxChannels(numChannels);
+    filters->dynamics.setMaxChannels(numChannels);
+    filters->svf.setMaxChannels(numChannels);
+    filters->filterInstance = std::make_unique<AudioFilter::FilterInstance<double>>(numChannels, numSections);
+    redesign = true;
 }
 
 int EqBandDsp::getBandIndex() const
@@ -27,6 +185,14 @@ int EqBandDsp::getBandIndex() const
     return bandIndex;
 }
 
+void EqBandDsp::prepareAs(const EqBandDsp& other)
+{
+    setBlockSize(0);
+    setSampleRate(other.sampleRate);
+    setChannelLayout(other.preparedLayout);
+    setSvfForced(other.svfForced);
+}
+
 const BandParams& EqBandDsp::getBandParamsConst() const
 {
     return bandParams;
@@ -37,29 +203,192 @@ BandParams& EqBandDsp::getBandParams()
     return bandParams;
 }
 
+namespace
+{
+    // Values with the same coefficients, the detector settings don't change them.
+    bool hasSameDesign(const BandValues& a, const BandValues& b)
+    {
+        return a.enabled == b.enabled && a.type == b.type && a.routing == b.routing && a.freq == b.freq
+            && a.gain == b.gain && a.q == b.q && a.order == b.order && a.dynamic == b.dynamic && a.engine == b.engine;
+    }
+}
+
 void EqBandDsp::syncParameters()
 {
-    const auto newType = bandParams.getType();
-    const auto paramOrder = juce::jlimit(bandParams.getMinOrderForType(newType), bandParams.getMaxOrderForType(newType), bandParams.getOrder());
+    if (bandParams.enabledParam == nullptr || filters == nullptr)
+        return;
+
+    const auto sequence = bandParams.getDesignSequence();
+
+    if ((sequence & 1) != 0)
+        return;
+
+    const auto values = readParameters();
+
+    if (bandParams.isDesignHeld(sequence))
+        return;
+    bandParams.threshold = values.threshold;
+    bandParams.ratio = values.ratio;
+    bandParams.attack = values.attack;
+    bandParams.release = values.release;
+    filters->dynamics.setCurve(values.threshold, values.ratio);
+    filters->dynamics.setTimes(values.attack, values.release);
+
+    if (designer != nullptr && designer->isActive())
+    {
+        syncDesigner(values);
+        return;
+    }
 
-    if (bandParams.getEnabled() == bandParams.enabled && bandParams.getType() == bandParams.type && 
-        bandParams.getRouting() == bandParams.routing && bandParams.getFreq() == bandParams.freq &&
-        bandParams.getGain() == bandParams.gain && bandParams.getQ() == bandParams.Q && paramOrder == bandParams.order)
+    if (! redesign && hasSameDesign(values, getValues()))
         return;
 
+    bandParams.enabled = values.enabled;
+    bandParams.type = static_cast<BandParams::Type> (values.type);
+    bandParams.routing = static_cast<BandParams::Routing> (values.routing);
+    bandParams.freq = values.freq;
+    bandParams.gain = values.gain;
+    bandParams.Q = values.q;
+    bandParams.order = values.order;
+    bandParams.dynamic = values.dynamic;
+    bandParams.engine = static_cast<BandParams::Engine> (values.engine);
+    postedValues = values;
+    design();
+}
+
+BandValues EqBandDsp::readParameters() const
+{
+    const auto type = bandParams.getType();
+
+    BandValues values;
+    values.enabled = bandParams.getEnabled();
+    values.type = type;
+    values.routing = bandParams.getRouting();
+    values.freq = bandParams.getFreq();
+    values.gain = bandParams.getGain();
+    values.q = bandParams.getQ();
+    values.order = juce::jlimit(bandParams.getMinOrderForType(type), bandParams.getMaxOrderForType(type), bandParams.getOrder());
+    values.dynamic = bandParams.getDynamic();
+    values.threshold = bandParams.getThreshold();
+    values.ratio = bandParams.getRatio();
+    values.attack = bandParams.getAttack();
+    values.release = bandParams.getRelease();
+    values.engine = bandParams.getEngine();
+    return values;
+}
+
+void EqBandDsp::syncDesigner(const BandValues& values)
+{
+    if (auto result = designer->getResult(designerSlot))
+    {
+        // a design of values replaced by adoptDesign in the meantime is dropped
+        if (hasSameDesign(result->getValues(), postedValues))
+        {
+            takeDesign(*result, false);
+            ++numDesigns;
+            numFallbacks += ! useCascade && ! useSvf ? 1 : 0;
+        }
+
+        designer->finish(designerSlot);
+    }
+
+    // the previous design keeps playing until the posted one is ready
+    if ((redesign || ! hasSameDesign(values, postedValues)) && designer->post(designerSlot, values))
+    {
+        postedValues = values;
+        redesign = false;
+    }
+}
+
+void EqBandDsp::setDesigner(BandDesigner* newDesigner, int slot)
+{
+    designer = newDesigner;
+    designerSlot = slot;
+    postedValues = getValues();
+}
+
+void EqBandDsp::setValues(const BandValues& values)
+{
+    jassert(filters != nullptr);
+    const auto newType = static_cast<BandParams::Type> (juce::jlimit(0, BandParams::bandNumTypes - 1, values.type));
+
+    bandParams.enabled = values.enabled;
+    bandParams.type = newType;
+    bandParams.routing = static_cast<BandParams::Routing> (juce::jlimit(0, BandParams::routeNumRoutings - 1, values.routing));
+    bandParams.freq = values.freq;
+    bandParams.gain = values.gain;
+    bandParams.Q = values.q;
+    bandParams.order = juce::jlimit(bandParams.getMinOrderForType(newType), bandParams.getMaxOrderForType(newType), values.order);
+    bandParams.dynamic = values.dynamic;
+    bandParams.threshold = values.threshold;
+    bandParams.ratio = values.ratio;
+    bandParams.attack = values.attack;
+    bandParams.release = values.release;
+    bandParams.engine = static_cast<BandParams::Engine> (juce::jlimit(0, BandParams::engineNumEngines - 1, values.engine));
+    filters->dynamics.setCurve(values.threshold, values.ratio);
+    filters->dynamics.setTimes(values.attack, values.release);
+    design();
+    bandParams.getAndClearChanged();
+    updateResponse();
+}
+
+BandValues EqBandDsp::getValues() const
+{
+    BandValues values;
+    values.enabled = bandParams.enabled;
+    values.type = bandParams.type;
+    values.routing = bandParams.routing;
+    values.freq = bandParams.freq;
+    values.gain = bandParams.gain;
+    values.q = bandParams.Q;
+    values.order = bandParams.order;
+    values.dynamic = bandParams.dynamic;
+    values.threshold = bandParams.threshold;
+    values.ratio = bandParams.ratio;
+    values.attack = bandParams.attack;
+    values.release = bandParams.release;
+    values.engine = bandParams.engine;
+    return values;
+}
+
+void EqBandDsp::design()
+{
+    jassert(filters != nullptr);
+    redesign = false;
+    ++numDesigns;
     bandParams.setChanged();
-    bandParams.enabled = bandParams.getEnabled();
-    bandParams.type = bandParams.getType();
-    bandParams.routing = bandParams.getRouting();
-    bandParams.freq = bandParams.getFreq();
-    bandParams.gain = bandParams.getGain();
-    bandParams.Q = bandParams.getQ();
-    bandParams.order = paramOrder;
-
-    auto createMzti = [this](AudioFilter::FilterType type) {
-        biquads.resize(1);
-        AudioFilter::ParametricCreator::createMZTiStage(biquads[0], bandParams.freq, bandParams.gain, bandParams.Q, type, sampleRate);
-        filterInstance.setParams(biquads[0]);
+    designSections(filters->biquads, bandParams.gain);
+
+    // the band shelf has no closed form SVF design
+    const auto wasSvf = useSvf;
+    useSvf = (svfForced || bandParams.engine == BandParams::engineSvf) && bandParams.type != BandParams::bandVOBandShelf;
+
+    if (useSvf)
+    {
+        // the biquads only draw the response
+        if (! wasSvf)
+            filters->svf.reset();
+
+        designSvf();
+        return;
+    }
+
+    if (BandParams::getGroupForType(bandParams.type) == BandParams::bandMZTi)
+        filters->filterInstance->setParams(filters->biquads[0]);
+    else
+        filters->filterInstance->setParams(filters->biquads);
+
+    updateKernel();
+
+    if (bandParams.dynamic && BandParams::hasGain(bandParams.type))
+        designDynamics();
+}
+
+void EqBandDsp::designSections(AudioFilter::BiquadParamCascade& target, float gain)
+{
+    auto createMzti = [this, &target, gain](AudioFilter::FilterType type) {
+        target.resize(1);
+        AudioFilter::ParametricCreator::createMZTiStage(target[0], bandParams.freq, gain, bandParams.Q, type, sampleRate);
     };
 
     switch (bandParams.type)
@@ -80,24 +409,19 @@ void EqBandDsp::syncParameters()
         createMzti(bandParams.order == 2 ? AudioFilter::afLoPass : AudioFilter::afLoPass6);
         break;
     case BandParams::bandVOHiPass:
-        AudioFilter::QBasedButterworth::createHiLoPass(biquads, bandParams.freq, true, bandParams.order, sampleRate, AudioFilter::filterMZTi);
-        filterInstance.setParams(biquads);
+        AudioFilter::QBasedButterworth::createHiLoPass(target, bandParams.freq, true, bandParams.order, sampleRate, AudioFilter::filterMZTi);
         break;
     case BandParams::bandVOLoPass:
-        AudioFilter::QBasedButterworth::createHiLoPass(biquads, bandParams.freq, false, bandParams.order, sampleRate, AudioFilter::filterMZTi);
-        filterInstance.setParams(biquads);
+        AudioFilter::QBasedButterworth::createHiLoPass(target, bandParams.freq, false, bandParams.order, sampleRate, AudioFilter::filterMZTi);
         break;
     case BandParams::bandVOLoShelf:
-        AudioFilter::QBasedButterworth::createHiLoShelf(biquads, bandParams.freq, bandParams.gain, false, bandParams.order, sampleRate, AudioFilter::filterMZTi);
-        filterInstance.setParams(biquads);
+        AudioFilter::QBasedButterworth::createHiLoShelf(target, bandParams.freq, gain, false, bandParams.order, sampleRate, AudioFilter::filterMZTi);
         break;
     case BandParams::bandVOHiShelf:
-        AudioFilter::QBasedButterworth::createHiLoShelf(biquads, bandParams.freq, bandParams.gain, true, bandParams.order, sampleRate, AudioFilter::filterMZTi);
-        filterInstance.setParams(biquads);
+        AudioFilter::QBasedButterworth::createHiLoShelf(target, bandParams.freq, gain, true, bandParams.order, sampleRate, AudioFilter::filterMZTi);
         break;
     case BandParams::bandVOBandShelf:
-        bwCreator.createBandShelf(biquads, bandParams.freq, bandParams.Q, bandParams.gain, bandParams.order, sampleRate);
-        filterInstance.setParams(biquads);
+        filters->bwCreator.createBandShelf(target, bandParams.freq, bandParams.Q, gain, bandParams.order, sampleRate);
         break;
     default:
         jassertfalse;
@@ -105,23 +429,368 @@ void EqBandDsp::syncParameters()
     }
 }
 
-void EqBandDsp::processBlock(double* chL, double* chR, int numSamples)
+void EqBandDsp::designSvf()
 {
-    jassert(dataMain.size() == dataAux.size() && dataMain.size() >= static_cast<size_t>(numSamples));
+    const auto freq = static_cast<double> (bandParams.freq);
+    const auto gain = juce::Decibels::decibelsToGain(static_cast<double> (bandParams.gain));
+    const auto k = 1.0 / juce::jmax(0.01, static_cast<double> (bandParams.Q));
+    const auto order = bandParams.order;
+    const auto secondOrder = order == 2;
+    int n = 0;
+
+    // Butterworth sections of a variable order filter, plus a first order
+    // one for odd orders. Shelves split the gain evenly between them.
+    const auto addButterworth = [&](auto&& pairSection, auto&& firstOrderSection) {
+        for (int pair = 1; pair <= order / 2; ++pair)
+            filters->svfCoeffs[static_cast<size_t> (n++)] = pairSection(SvfCoeffs::getButterworthDamping(pair, order));
+
+        if (order % 2 == 1)
+            filters->svfCoeffs[static_cast<size_t> (n++)] = firstOrderSection();
+    };
+
+    const auto sectionGain = std::pow(gain, 2.0 / order);
+    const auto firstOrderGain = std::pow(gain, 1.0 / order);
+
+    switch (bandParams.type)
+    {
+    case BandParams::bandPeak:
+        filters->svfCoeffs[static_cast<size_t> (n++)] = SvfCoeffs::bell(freq, k, gain, sampleRate);
+        break;
+    case BandParams::bandLoShelf:
+        filters->svfCoeffs[static_cast<size_t> (n++)] = secondOrder ? SvfCoeffs::lowShelf(freq, k, gain, sampleRate) : SvfCoeffs::lowShelf1(freq, gain, sampleRate);
+        break;
+    case BandParams::bandHighShelf:
+        filters->svfCoeffs[static_cast<size_t> (n++)] = secondOrder ? SvfCoeffs::highShelf(freq, k, gain, sampleRate) : SvfCoeffs::highShelf1(freq, gain, sampleRate);
+        break;
+    case BandParams::bandHiPass:
+        filters->svfCoeffs[static_cast<size_t> (n++)] = secondOrder ? SvfCoeffs::highPass(freq, k, sampleRate) : SvfCoeffs::highPass1(freq, sampleRate);
+        break;
+    case BandParams::bandLoPass:
+        filters->svfCoeffs[static_cast<size_t> (n++)] = secondOrder ? SvfCoeffs::lowPass(freq, k, sampleRate) : SvfCoeffs::lowPass1(freq, sampleRate);
+        break;
+    case BandParams::bandVOHiPass:
+        addButterworth([&](double damping) { return SvfCoeffs::highPass(freq, damping, sampleRate); },
+            [&]() { return SvfCoeffs::highPass1(freq, sampleRate); });
+        break;
+    case BandParams::bandVOLoPass:
+        addButterworth([&](double damping) { return SvfCoeffs::lowPass(freq, damping, sampleRate); },
+            [&]() { return SvfCoeffs::lowPass1(freq, sampleRate); });
+        break;
+    case BandParams::bandVOLoShelf:
+        addButterworth([&](double damping) { return SvfCoeffs::lowShelf(freq, damping, sectionGain, sampleRate); },
+            [&]() { return SvfCoeffs::lowShelf1(freq, firstOrderGain, sampleRate); });
+        break;
+    case BandParams::bandVOHiShelf:
+        addButterworth([&](double damping) { return SvfCoeffs::highShelf(freq, damping, sectionGain, sampleRate); },
+            [&]() { return SvfCoeffs::highShelf1(freq, firstOrderGain, sampleRate); });
+        break;
+    default:
+        jassertfalse;
+        break;
+    }
+
+    filters->svf.setCoefficients(filters->svfCoeffs.data(), n);
+}
+
+void EqBandDsp::designDynamics()
+{
+    const auto numDesigned = juce::jmin(static_cast<int> (filters->biquads.size()), numSections);
+    auto valid = useCascade;
+
+    if (valid)
+        std::copy(filters->sectionCoeffs.begin(), filters->sectionCoeffs.begin() + numDesigned, filters->dynamics.getTableRow(0));
+
+    for (int step = 1; step < BandDynamics::numSteps && valid; ++step)
+    {
+        designSections(filters->dynamicBiquads, bandParams.gain - static_cast<float> (step) * BandDynamics::stepDb);
+        auto row = filters->dynamics.getTableRow(step);
+
+        for (int s = 0; s < numDesigned && valid; ++s)
+            valid = filters->probe.measure(filters->dynamicBiquads[static_cast<size_t> (s)], row[s]);
+    }
+
+    // Shelves listen to their side of the corner, bells and band shelves
+    // to a band pass of about their bandwidth.
+    const auto nyquist = 0.5f * static_cast<float> (sampleRate);
+    const auto octaves = 2.f / std::log(2.f) * std::asinh(0.5f / juce::jmax(0.1f, bandParams.Q));
+    const auto edge = std::pow(2.f, 0.5f * octaves);
+    const auto lowEdge = bandParams.freq / edge;
+    const auto highEdge = juce::jmin(0.9f * nyquist, bandParams.freq * edge);
+    const auto isLowShelf = bandParams.type == BandParams::bandLoShelf || bandParams.type == BandParams::bandVOLoShelf;
+    const auto isHighShelf = bandParams.type == BandParams::bandHighShelf || bandParams.type == BandParams::bandVOHiShelf;
+    const auto sqrtHalf = std::sqrt(0.5f);
+    BiquadCoeffs detector[2];
+    filters->detectorBiquads.resize(2);
+
+    AudioFilter::ParametricCreator::createMZTiStage(filters->detectorBiquads[0], isLowShelf ? 10.f : (isHighShelf ? bandParams.freq : lowEdge),
+        0.f, sqrtHalf, AudioFilter::afHiPass, sampleRate);
+    AudioFilter::ParametricCreator::createMZTiStage(filters->detectorBiquads[1], isHighShelf ? 0.9f * nyquist : (isLowShelf ? bandParams.freq : highEdge),
+        0.f, sqrtHalf, AudioFilter::afLoPass, sampleRate);
 
+    for (int s = 0; s < 2 && valid; ++s)
+        valid = filters->probe.measure(filters->detectorBiquads[static_cast<size_t> (s)], detector[s]);
+
+    if (valid)
+        filters->dynamics.setDetector(detector[0], detector[1]);
+
+    filters->dynamics.setTable(numDesigned, valid);
+}
+
+void EqBandDsp::updateKernel()
+{
+    const auto numDesigned = juce::jmin(static_cast<int> (filters->biquads.size()), numSections);
+    useCascade = true;
+
+    for (int s = 0; s < numDesigned && useCascade; ++s)
+        useCascade = filters->probe.measure(filters->biquads[static_cast<size_t> (s)], filters->sectionCoeffs[static_cast<size_t> (s)]);
+
+    if (useCascade)
+        filters->cascade.setCoefficients(filters->sectionCoeffs.data(), numDesigned);
+    else
+        ++numFallbacks;
+}
+
+void EqBandDsp::update()
+{
     syncParameters();
     if (bandParams.getAndClearChanged())
         updateResponse();
+}
+
+void EqBandDsp::reset()
+{
+    if (filters == nullptr)
+        return;
+
+    filters->cascade.reset();
+    filters->dynamics.reset();
+    filters->svf.reset();
+}
+
+void EqBandDsp::copyStateFrom(const EqBandDsp& other)
+{
+    jassert(filters != nullptr && other.filters != nullptr);
+
+    // the same sections on the same channels, only the coefficients differ
+    const auto sameLayout = other.bandParams.enabled && bandParams.type == other.bandParams.type
+        && bandParams.order == other.bandParams.order && bandParams.routing == other.bandParams.routing
+        && useSvf == other.useSvf && useCascade == other.useCascade;
+
+    if (! sameLayout || ! (useSvf || useCascade))
+    {
+        reset();
+        return;
+    }
+
+    if (useSvf)
+        filters->svf.copyStateFrom(other.filters->svf);
+    else
+        filters->cascade.copyStateFrom(other.filters->cascade);
+
+    filters->dynamics.copyStateFrom(other.filters->dynamics);
+}
+
+bool EqBandDsp::getSectionCoefficients(std::vector<BiquadCoeffs>& coeffs) const
+{
+    if (useSvf)
+    {
+        const auto num = static_cast<size_t> (filters->svf.getNumSections());
+        coeffs.resize(num);
+
+        for (size_t s = 0; s < num; ++s)
+            coeffs[s] = filters->svfCoeffs[s].toBiquad();
+
+        return true;
+    }
+
+    if (! useCascade)
+        return false;
+
+    const auto numDesigned = juce::jmin(static_cast<int> (filters->biquads.size()), numSections);
+    coeffs.assign(filters->sectionCoeffs.begin(), filters->sectionCoeffs.begin() + numDesigned);
+    return true;
+}
+
+void EqBandDsp::getImpulseResponse(std::vector<double>& dest) const
+{
+    jassert(filters != nullptr);
+    std::fill(dest.begin(), dest.end(), 0.0);
 
-    if (! bandParams.getEnabled())
+    if (dest.empty())
         return;
 
+    dest[0] = 1.0;
+    auto data = dest.data();
+    const auto numSamples = static_cast<int> (dest.size());
+
+    AudioFilter::FilterInstance<double> instance(1, numSections);
+
+    if (BandParams::getGroupForType(bandParams.type) == BandParams::bandMZTi)
+        instance.setParams(filters->biquads[0]);
+    else
+        instance.setParams(filters->biquads);
+
+    instance.processBlock(&data, const_cast<const double**> (&data), numSamples);
+}
+
+bool EqBandDsp::setSectionCoefficients(const BiquadCoeffs* coeffs, int numsections)
+{
+    if (! useCascade || useSvf)
+        return false;
+
+    filters->cascade.setCoefficients(coeffs, juce::jmin(numsections, numSections));
+    return true;
+}
+
+void EqBandDsp::processBlock(double* chL, double* chR, int numSamples)
+{
+    double* channels[2] = { chL, chR };
+    processBlock(channels, chR == nullptr ? 1 : 2, numSamples);
+}
+
+void EqBandDsp::processBlock(double* const* channels, int numChannels, int numSamples)
+{
+    update();
+    processDesigned(channels, numChannels, numSamples);
+}
+
+void EqBandDsp::processDesigned(double* const* channels, int numChannels, int numSamples)
+{
+    jassert(dataMain.size() == dataAux.size() && dataMain.size() >= static_cast<size_t>(numSamples));
+
+    // the designed state, which lags the parameter while a restore holds it
+    if (! bandParams.enabled)
+        return;
+
+    // channels beyond the prepared layout pass through
+    numChannels = juce::jmin(numChannels, channelGroups.numChannels);
+
     const auto curRouting = bandParams.routing;
-    processRoutingIn(curRouting, chL, chR, numSamples);
-    
-    filterInstance.processBlock(procBuffers, const_cast<const double**> (procBuffers), numSamples);
-    
-    processRoutingOut(curRouting, chL, chR, numSamples);
+    const auto numRouted = processRoutingIn(curRouting, channels, numChannels, numSamples);
+
+    if (numRouted > 0)
+    {
+        if (useSvf)
+            filters->svf.process(procBuffers.data(), numRouted, numSamples);
+        else if (isDynamicActive())
+            processDynamic(numRouted, numSamples);
+        else if (useCascade)
+            filters->cascade.process(procBuffers.data(), numRouted, numSamples);
+        else
+            filters->filterInstance->processBlock(procBuffers.data(), const_cast<const double**> (procBuffers.data()), numSamples);
+    }
+
+    processRoutingOut(curRouting, channels, numChannels, numSamples);
+}
+
+bool EqBandDsp::isDynamicActive() const
+{
+    return bandParams.dynamic && useCascade && ! useSvf && filters->dynamics.hasTable() && BandParams::hasGain(bandParams.type);
+}
+
+void EqBandDsp::processDynamic(int numRouted, int numSamples)
+{
+    // the detector looks at each sub-block before the band filters it
+    for (int pos = 0; pos < numSamples; pos += BandDynamics::controlInterval)
+    {
+        const auto n = juce::jmin(BandDynamics::controlInterval, numSamples - pos);
+
+        for (int ch = 0; ch < numRouted; ++ch)
+            subBuffers[static_cast<size_t> (ch)] = procBuffers[static_cast<size_t> (ch)] + pos;
+
+        if (filters->dynamics.process(subBuffers.data(), numRouted, n))
+            filters->cascade.setCoefficients(filters->dynamics.getCoefficients(), filters->dynamics.getNumSections());
+
+        filters->cascade.process(subBuffers.data(), numRouted, n);
+    }
+}
+
+void EqBandDsp::adoptDesign(const EqBandDsp& other)
+{
+    takeDesign(other, true);
+
+    // a design still running for the designer is stale now
+    postedValues = getValues();
+}
+
+void EqBandDsp::takeDesign(const EqBandDsp& other, bool withState)
+{
+    jassert(filters != nullptr && other.filters != nullptr);
+    jassert(numSections == other.numSections && freqRes.size() == other.freqRes.size());
+
+    bandParams.enabled = other.bandParams.enabled;
+    bandParams.type = other.bandParams.type;
+    bandParams.routing = other.bandParams.routing;
+    bandParams.freq = other.bandParams.freq;
+    bandParams.gain = other.bandParams.gain;
+    bandParams.Q = other.bandParams.Q;
+    bandParams.order = other.bandParams.order;
+    bandParams.dynamic = other.bandParams.dynamic;
+    bandParams.engine = other.bandParams.engine;
+
+    // a band keeping its state also keeps its detector settings
+    if (withState)
+    {
+        bandParams.threshold = other.bandParams.threshold;
+        bandParams.ratio = other.bandParams.ratio;
+        bandParams.attack = other.bandParams.attack;
+        bandParams.release = other.bandParams.release;
+    }
+
+    // values that went through a parameter's normalisation
+    const auto adoptRounded = [](const juce::AudioParameterFloat* param, float& value) {
+        if (param != nullptr && std::abs(param->get() - value) <= 1e-4f * std::abs(value))
+            value = param->get();
+    };
+
+    adoptRounded(bandParams.freqParam, bandParams.freq);
+    adoptRounded(bandParams.gainParam, bandParams.gain);
+    adoptRounded(bandParams.qParam, bandParams.Q);
+
+    filters->biquads = other.filters->biquads;
+    std::copy(other.filters->sectionCoeffs.begin(), other.filters->sectionCoeffs.end(), filters->sectionCoeffs.begin());
+    std::copy(other.freqRes.begin(), other.freqRes.end(), freqRes.begin());
+    const auto wasSvf = useSvf;
+    useCascade = other.useCascade;
+    useSvf = other.useSvf;
+    redesign = false;
+    responseUpdateFlag = true;
+
+    if (withState)
+        filters->dynamics.copyFrom(other.filters->dynamics);
+    else
+        filters->dynamics.copyTableFrom(other.filters->dynamics);
+
+    if (useSvf)
+    {
+        std::copy(other.filters->svfCoeffs.begin(), other.filters->svfCoeffs.end(), filters->svfCoeffs.begin());
+
+        if (withState)
+        {
+            filters->svf.copyFrom(other.filters->svf);
+        }
+        else
+        {
+            if (! wasSvf)
+                filters->svf.reset();
+
+            filters->svf.setCoefficients(filters->svfCoeffs.data(), other.filters->svf.getNumSections());
+        }
+    }
+    else if (useCascade)
+    {
+        if (withState && isDynamicActive())
+            filters->cascade.setCoefficients(filters->dynamics.getCoefficients(), filters->dynamics.getNumSections());
+        else
+            filters->cascade.setCoefficients(filters->sectionCoeffs.data(), juce::jmin(static_cast<int> (filters->biquads.size()), numSections));
+
+        if (withState)
+            filters->cascade.copyStateFrom(other.filters->cascade);
+    }
+    else
+    {
+        filters->filterInstance->setParams(filters->biquads);
+    }
 }
 
 const std::vector<float>& EqBandDsp::getResponse() const
@@ -138,7 +807,10 @@ void EqBandDsp::updateResponse()
 {
     responseUpdateFlag = true;
     AudioFilter::Response::initGains(freqRes, freqRes.size());
-    freqResBase.getResponse(biquads, freqRes, bandParams.getFreq());
+
+    // flat until the band is prepared
+    if (filters != nullptr)
+        freqResBase.getResponse(filters->biquads, freqRes, bandParams.freq);
 }
 
 bool EqBandDsp::getAndClearResUpdate()
@@ -148,71 +820,105 @@ bool EqBandDsp::getAndClearResUpdate()
     return ret;
 }
 
-void EqBandDsp::processRoutingIn(BandParams::Routing routing, double* chL, double* chR, int numSamples)
+size_t EqBandDsp::getMemoryBytes() const
 {
-    if (chR == nullptr || bandParams.routing == BandParams::routeStereo)
-    {
-        procBuffers[0] = chL;
-        procBuffers[1] = chR;
-        return;
-    }
+    auto bytes = sizeof(EqBandDsp) + (dataMain.capacity() + dataAux.capacity()) * sizeof(double) + freqRes.capacity() * sizeof(float)
+        + procBuffers.capacity() * sizeof(double*) + subBuffers.capacity() * sizeof(double*);
 
-    switch (routing)
+    if (filters != nullptr)
+        bytes += sizeof(Filters) + filters->sectionCoeffs.capacity() * sizeof(BiquadCoeffs) + filters->cascade.getMemoryBytes()
+            + filters->dynamics.getMemoryBytes() + filters->svf.getMemoryBytes() + filters->svfCoeffs.capacity() * sizeof(SvfCoeffs);
+
+    return bytes;
+}
+
+int EqBandDsp::getNumDesigns() const
+{
+    return numDesigns;
+}
+
+int EqBandDsp::getNumFallbacks() const
+{
+    return numFallbacks;
+}
+
+void EqBandDsp::setSvfForced(bool shouldForce)
+{
+    if (svfForced != shouldForce)
+        redesign = true;
+
+    svfForced = shouldForce;
+}
+
+bool EqBandDsp::isSvfActive() const
+{
+    return useSvf;
+}
+
+bool EqBandDsp::hasStereoPair(int numChannels) const
+{
+    return channelGroups.left >= 0 && channelGroups.right >= 0
+        && channelGroups.left < numChannels && channelGroups.right < numChannels;
+}
+
+int EqBandDsp::processRoutingIn(BandParams::Routing routing, double* const* channels, int numChannels, int numSamples)
+{
+    std::fill(procBuffers.begin(), procBuffers.end(), nullptr);
+
+    const auto pairRouting = BandParams::isPairRouting(routing);
+
+    if (pairRouting && hasStereoPair(numChannels))
     {
-    default:
-        jassertfalse;
-    case BandParams::routeLeft:
-        procBuffers[0] = chL;
-        procBuffers[1] = nullptr;
-        break;
-    case BandParams::routeRight:
-        procBuffers[0] = chR;
-        procBuffers[1] = nullptr;
-        break;
-    case BandParams::routeMid:
-        for (int i = 0; i < numSamples; ++i)
-            dataMain[i] = 0.5 * (chL[i] + chR[i]);
+        const auto chL = channels[channelGroups.left];
+        const auto chR = channels[channelGroups.right];
 
-        for (int i = 0; i < numSamples; ++i)
-            dataAux[i] = 0.5 * (chL[i] - chR[i]);
+        switch (routing)
+        {
+        default:
+            jassertfalse;
+        case BandParams::routeLeft:
+            procBuffers[0] = chL;
+            break;
+        case BandParams::routeRight:
+            procBuffers[0] = chR;
+            break;
+        case BandParams::routeMid:
+        case BandParams::routeSide:
+            for (int i = 0; i < numSamples; ++i)
+                dataMain[i] = 0.5 * (chL[i] + chR[i]);
 
-        procBuffers[0] = dataMain.data();
-        procBuffers[1] = nullptr;
-        break;
-    case BandParams::routeSide:
-        for (int i = 0; i < numSamples; ++i)
-            dataMain[i] = 0.5 * (chL[i] + chR[i]);
+            for (int i = 0; i < numSamples; ++i)
+                dataAux[i] = 0.5 * (chL[i] - chR[i]);
 
-        for (int i = 0; i < numSamples; ++i)
-            dataAux[i] = 0.5 * (chL[i] - chR[i]);
+            procBuffers[0] = routing == BandParams::routeMid ? dataMain.data() : dataAux.data();
+            break;
+        }
 
-        procBuffers[0] = dataAux.data();
-        procBuffers[1] = nullptr;
-        break;
+        return 1;
     }
+
+    // without a stereo pair the pair routings process everything, like mono did
+    const auto& routed = pairRouting ? channelGroups.all : channelGroups.getChannels(routing);
+    int numRouted = 0;
+
+    for (auto ch : routed)
+        if (ch < numChannels)
+            procBuffers[static_cast<size_t> (numRouted++)] = channels[ch];
+
+    return numRouted;
 }
 
-void EqBandDsp::processRoutingOut(BandParams::Routing routing, double* chL, double* chR, int numSamples)
+void EqBandDsp::processRoutingOut(BandParams::Routing routing, double* const* channels, int numChannels, int numSamples)
 {
-    if (chR == nullptr || bandParams.routing == BandParams::routeStereo)
+    if ((routing != BandParams::routeMid && routing != BandParams::routeSide) || ! hasStereoPair(numChannels))
         return;
 
-    switch (routing)
-    {
-    default:
-        jassertfalse;
-    case BandParams::routeLeft:
-        break;
-    case BandParams::routeRight:
-        break;
-    case BandParams::routeMid:
-    case BandParams::routeSide:
-        for (int i = 0; i < numSamples; ++i)
-            chL[i] = dataMain[i] + dataAux[i];
+    auto chL = channels[channelGroups.left];
+    auto chR = channels[channelGroups.right];
 
-        for (int i = 0; i < numSamples; ++i)
-            chR[i] = dataMain[i] - dataAux[i];
+    for (int i = 0; i < numSamples; ++i)
+        chL[i] = dataMain[i] + dataAux[i];
 
-        break;
-    }
-}
\ No newline at end of file
+    for (int i = 0; i < numSamples; ++i)
+        chR[i] = dataMain[i] - dataAux[i];
+}
@@ -3,6 +3,9 @@
 #include "../AudioFilter/src/FilterInstance.h"
 #include "../AudioFilter/src/ButterworthCreator.h"
 #include "../AudioFilter/src/Response.h"
+#include "BiquadKernel.h"
+#include "BandDynamics.h"
+#include "SvfKernel.h"
 
 #include "JuceHeader.h"
 
@@ -42,10 +45,21 @@ struct BandParams
         routeRight,
         routeMid,
         routeSide,
+        routeLCR,
+        routeSurrounds,
+        routeHeights,
 
         routeNumRoutings
     };
 
+    enum Engine
+    {
+        engineBiquad,
+        engineSvf,
+
+        engineNumEngines
+    };
+
     static juce::String getNameForType(Type t)
     {
         switch (t)
@@ -93,6 +107,12 @@ struct BandParams
             return "Mid";
         case routeSide:
             return "Side";
+        case routeLCR:
+            return "LCR";
+        case routeSurrounds:
+            return "Surrounds";
+        case routeHeights:
+            return "Heights";
         }
     }
 
@@ -109,6 +129,17 @@ struct BandParams
         return ret;
     }
 
+    // The routings that process the stereo pair, or all channels without one.
+    static bool isPairRouting(Routing r)
+    {
+        return r == routeLeft || r == routeRight || r == routeMid || r == routeSide;
+    }
+
+    static juce::StringArray getEngineNames()
+    {
+        return { "Biquad", "SVF" };
+    }
+
     static juce::StringArray getRoutingNames()
     {
         juce::StringArray ret;
@@ -228,12 +259,12 @@ struct BandParams
             return false;
         }
     }
-    int getMinOrderForType(Type t)
+    int getMinOrderForType(Type t) const
     {
         return t == bandPeak ? 2 : 1;
     }
 
-    int getMaxOrderForType(Type t)
+    int getMaxOrderForType(Type t) const
     {
         const auto group = getGroupForType(t);
         return group == bandMZTi ? 2 : maxOrder;
@@ -247,6 +278,16 @@ struct BandParams
     float Q = std::sqrt(0.5f);
     int order = 2;
 
+    // Dynamic mode of the gain types: above the threshold the band's gain
+    // is reduced by the ratio, with attack and release in ms.
+    bool dynamic = false;
+    float threshold = -20.f;
+    float ratio = 2.f;
+    float attack = 10.f;
+    float release = 100.f;
+
+    Engine engine = engineBiquad;
+
     bool getEnabled() const
     {
         jassert(enabledParam != nullptr);
@@ -289,19 +330,89 @@ struct BandParams
         return orderParam->get();
     }
 
+    bool getDynamic() const
+    {
+        jassert(dynamicParam != nullptr);
+        return dynamicParam->get();
+    }
+
+    float getThreshold() const
+    {
+        jassert(thresholdParam != nullptr);
+        return thresholdParam->get();
+    }
+
+    float getRatio() const
+    {
+        jassert(ratioParam != nullptr);
+        return ratioParam->get();
+    }
+
+    float getAttack() const
+    {
+        jassert(attackParam != nullptr);
+        return attackParam->get();
+    }
+
+    float getRelease() const
+    {
+        jassert(releaseParam != nullptr);
+        return releaseParam->get();
+    }
+
+    Engine getEngine() const
+    {
+        jassert(engineParam != nullptr);
+        return static_cast<Engine> (engineParam->getIndex());
+    }
+
     int maxOrder = 8;
 
-    void setBandId(const juce::String& newBandId)
+    // Parameter identifiers of one band. Building them concatenates and interns
+    // several strings, so callers create them once and share them.
+    struct Ids
+    {
+        explicit Ids(const juce::String& bandid)
+            : bandId(bandid), enableId(bandId + " Enabled"), typeId(bandId + " Type"), routingId(bandId + " Routing"),
+            freqId(bandId + " Freq"), gainId(bandId + " Gain"), qId(bandId + " Q"), orderId(bandId + " Order"),
+            dynamicId(bandId + " Dynamic"), thresholdId(bandId + " Threshold"), ratioId(bandId + " Ratio"),
+            attackId(bandId + " Attack"), releaseId(bandId + " Release"), engineId(bandId + " Engine")
+        {
+        }
+
+        juce::String bandId;
+        juce::Identifier enableId;
+        juce::Identifier typeId;
+        juce::Identifier routingId;
+        juce::Identifier freqId;
+        juce::Identifier gainId;
+        juce::Identifier qId;
+        juce::Identifier orderId;
+        juce::Identifier dynamicId;
+        juce::Identifier thresholdId;
+        juce::Identifier ratioId;
+        juce::Identifier attackId;
+        juce::Identifier releaseId;
+        juce::Identifier engineId;
+    };
+
+    void setIds(const Ids& ids)
     {
         jassert(bandId.isEmpty());
-        bandId = newBandId;
-        enableId = bandId + " Enabled";
-        typeId = bandId + " Type";
-        routingId = bandId + " Routing";
-        freqId = bandId + " Freq";
-        gainId = bandId + " Gain";
-        qId = bandId + " Q";
-        orderId = bandId + " Order";
+        bandId = ids.bandId;
+        enableId = ids.enableId;
+        typeId = ids.typeId;
+        routingId = ids.routingId;
+        freqId = ids.freqId;
+        gainId = ids.gainId;
+        qId = ids.qId;
+        orderId = ids.orderId;
+        dynamicId = ids.dynamicId;
+        thresholdId = ids.thresholdId;
+        ratioId = ids.ratioId;
+        attackId = ids.attackId;
+        releaseId = ids.releaseId;
+        engineId = ids.engineId;
     }
 
     juce::String getBandId() const
@@ -315,6 +426,12 @@ struct BandParams
     juce::Identifier gainId;
     juce::Identifier qId;
     juce::Identifier orderId;
+    juce::Identifier dynamicId;
+    juce::Identifier thresholdId;
+    juce::Identifier ratioId;
+    juce::Identifier attackId;
+    juce::Identifier releaseId;
+    juce::Identifier engineId;
 
     juce::AudioParameterBool* enabledParam = nullptr;
     juce::AudioParameterChoice* typeParam = nullptr;
@@ -323,6 +440,12 @@ struct BandParams
     juce::AudioParameterFloat* gainParam = nullptr;
     juce::AudioParameterFloat* qParam = nullptr;
     juce::AudioParameterInt* orderParam = nullptr;
+    juce::AudioParameterBool* dynamicParam = nullptr;
+    juce::AudioParameterFloat* thresholdParam = nullptr;
+    juce::AudioParameterFloat* ratioParam = nullptr;
+    juce::AudioParameterFloat* attackParam = nullptr;
+    juce::AudioParameterFloat* releaseParam = nullptr;
+    juce::AudioParameterChoice* engineParam = nullptr;
 
     void syncParameters(juce::AudioProcessorValueTreeState& apvst)
     {
@@ -333,6 +456,30 @@ struct BandParams
         gainParam = dynamic_cast<juce::AudioParameterFloat*> (apvst.getParameter(gainId));
         qParam = dynamic_cast<juce::AudioParameterFloat*> (apvst.getParameter(qId));
         orderParam = dynamic_cast<juce::AudioParameterInt*> (apvst.getParameter(orderId));
+        dynamicParam = dynamic_cast<juce::AudioParameterBool*> (apvst.getParameter(dynamicId));
+        thresholdParam = dynamic_cast<juce::AudioParameterFloat*> (apvst.getParameter(thresholdId));
+        ratioParam = dynamic_cast<juce::AudioParameterFloat*> (apvst.getParameter(ratioId));
+        attackParam = dynamic_cast<juce::AudioParameterFloat*> (apvst.getParameter(attackId));
+        releaseParam = dynamic_cast<juce::AudioParameterFloat*> (apvst.getParameter(releaseId));
+        engineParam = dynamic_cast<juce::AudioParameterChoice*> (apvst.getParameter(engineId));
+    }
+
+    // Counted up by the owner before and after it restores a state, odd
+    // while the values arrive: the bands keep their design until all are in.
+    // A band compares the count before and after reading its values, so it
+    // never designs from a mix of old and restored ones.
+    const std::atomic<juce::uint32>* holdDesign = nullptr;
+
+    juce::uint32 getDesignSequence() const
+    {
+        return holdDesign != nullptr ? holdDesign->load(std::memory_order_acquire) : 0;
+    }
+
+    // True while a restore runs or if one started since sequence was read.
+    bool isDesignHeld(juce::uint32 sequence) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (sequence & 1) != 0 || getDesignSequence() != sequence;
     }
 
     void setChanged()
@@ -352,8 +499,63 @@ private:
     bool changedFlag = true;
 };
 
-struct FreqResponseBase : AudioFilter::Response::ResponseBase
+// Plain values of one band's parameters, for bands that aren't bound to
+// parameters and for stored states.
+struct BandValues
 {
+    bool enabled = false;
+    int type = BandParams::bandPeak;
+    int routing = BandParams::routeStereo;
+    float freq = 1000.f;
+    float gain = 0.f;
+    float q = 0.707f;
+    int order = 2;
+    bool dynamic = false;
+    float threshold = -20.f;
+    float ratio = 2.f;
+    float attack = 10.f;
+    float release = 100.f;
+    int engine = BandParams::engineBiquad;
+
+    bool operator==(const BandValues& other) const
+    {
+        return enabled == other.enabled && type == other.type && routing == other.routing && freq == other.freq
+            && gain == other.gain && q == other.q && order == other.order && dynamic == other.dynamic
+            && threshold == other.threshold && ratio == other.ratio && attack == other.attack && release == other.release
+            && engine == other.engine;
+    }
+};
+
+// Channel indices of the routing targets in one bus layout. Left/right/mid/side
+// use the first left and right channels, or the first two of a discrete
+// layout; without a pair they fall back to all channels. The group routings
+// pick channels by type and do nothing if the layout has none of them.
+struct ChannelGroups
+{
+    ChannelGroups();
+
+    // Allocates, not realtime safe.
+    void setLayout(const juce::AudioChannelSet& layout);
+
+    // Channel list of a group routing, or of routeStereo (all channels).
+    const std::vector<int>& getChannels(BandParams::Routing routing) const;
+
+    int numChannels = 0;
+    int left = -1;
+    int right = -1;
+    std::vector<int> all;
+    std::vector<int> lcr;
+    std::vector<int> surrounds;
+    std::vector<int> heights;
+};
+
+// Log-frequency response grid plus the per-instance combined responses. The
+// grid itself is read-only and shared between all instances at the same
+// sample rate.
+struct FreqResponseBase
+{
+    using Grid = AudioFilter::Response::ResponseBase;
+
     struct ResponseData
     {
         ResponseData(int size) : res(size) {}
@@ -362,11 +564,39 @@ struct FreqResponseBase : AudioFilter::Response::ResponseBase
     };
 
     FreqResponseBase(int numfreqs, float startfreq, float endfreq)
-        :ResponseBase(numfreqs, startfreq, endfreq), resStereo(numfreqs),
-        resLeft(numfreqs), resRight(numfreqs), resMid(numfreqs), resSide(numfreqs)
+        :numFreqs(numfreqs), startFreq(startfreq), endFreq(endfreq), grid(getSharedGrid(numfreqs, startfreq, endfreq, 0.f)),
+        resStereo(numfreqs), resLeft(numfreqs), resRight(numfreqs), resMid(numfreqs), resSide(numfreqs)
     {
     }
 
+    void setSampleRate(float newSampleRate)
+    {
+        grid = getSharedGrid(numFreqs, startFreq, endFreq, newSampleRate);
+    }
+
+    auto getNumPoints() const { return grid->getNumPoints(); }
+    auto getStartFreq() const { return grid->getStartFreq(); }
+    auto getEndFreq() const { return grid->getEndFreq(); }
+
+    template <typename BiquadCascade>
+    void getResponse(const BiquadCascade& biquads, std::vector<float>& res, float freq) const
+    {
+        grid->getResponse(biquads, res, freq);
+    }
+
+    size_t getMemoryBytes() const;
+    size_t getSharedMemoryBytes() const;
+
+    // A sample rate of 0 keeps the grid's default rate.
+    static std::shared_ptr<const Grid> getSharedGrid(int numfreqs, float startfreq, float endfreq, float sampleRate);
+
+private:
+    int numFreqs;
+    float startFreq;
+    float endFreq;
+    std::shared_ptr<const Grid> grid;
+
+public:
     ResponseData resStereo;
     ResponseData resLeft;
     ResponseData resRight;
@@ -374,39 +604,164 @@ struct FreqResponseBase : AudioFilter::Response::ResponseBase
     ResponseData resSide;
 };
 
+class BandDesigner;
+
 class EqBandDsp
 {
 public:
 
     EqBandDsp(int maxOrder, const FreqResponseBase& freqresbase, int index);
+
+    // Prepare calls, not realtime safe. The first one allocates the filters.
     void setBlockSize(int blockSize);
     void setSampleRate(double newSampleRate);
+    void setChannelLayout(const juce::AudioChannelSet& layout);
     int getBandIndex() const; 
 
+    // Prepares for the sample rate, channel layout and engine of another
+    // band, without processing buffers, for designs that band takes over.
+    void prepareAs(const EqBandDsp& other);
+
     const BandParams& getBandParamsConst() const;
     BandParams& getBandParams();
+
+    // Designs for changed parameters. A band without parameters keeps the
+    // values it was last given. An attached band posts them to its designer
+    // instead and takes the design over once it's ready.
     void syncParameters();
 
+    // Attaches the band to a slot of a designer, or detaches it with nullptr.
+    // Not realtime safe.
+    void setDesigner(BandDesigner* newDesigner, int slot);
+
+    // Designs for fixed values, including the response, once the band is
+    // prepared. For a band without parameters, doesn't allocate.
+    void setValues(const BandValues& values);
+    BandValues getValues() const;
+
+    // Parameters and response without processing, for a band whose audio runs
+    // in another chain.
+    void update();
+
+    // Clears the cascade's filter state.
+    void reset();
+
+    // Takes over the filter state of a band prepared the same way and keeps
+    // the own design, so a chain switching to this band starts where the
+    // other one's filters are instead of from silence. Bands that differ in
+    // type, order, routing or engine, or from a disabled band, reset
+    // instead. Doesn't allocate.
+    void copyStateFrom(const EqBandDsp& other);
+
+    // The sections the band runs as biquads: those of the cascade, or the
+    // equivalents of the SVF sections. False if the band uses the filter
+    // instance because a section couldn't be measured.
+    bool getSectionCoefficients(std::vector<BiquadCoeffs>& coeffs) const;
+
+    // The impulse response of the design on one channel, as many samples as
+    // dest holds, from a copy of the filter instance. For bands whose sections
+    // getSectionCoefficients can't give. Allocates.
+    void getImpulseResponse(std::vector<double>& dest) const;
+
+    // Runs the cascade on other sections of the same count, keeping its
+    // state. The values and response stay those of the last design. False
+    // if the band doesn't run the cascade. Doesn't allocate.
+    bool setSectionCoefficients(const BiquadCoeffs* coeffs, int numsections);
+
     void processBlock(double* chL, double* chR, int numSamples);
+    void processBlock(double* const* channels, int numChannels, int numSamples);
+
+    // Processes with the current design, without syncing the parameters.
+    void processDesigned(double* const* channels, int numChannels, int numSamples);
+
+    // Takes over the design, response and filter state of a band prepared
+    // the same way, instead of designing. Parameters that differ from the
+    // taken values only by rounding count as designed. Doesn't allocate.
+    void adoptDesign(const EqBandDsp& other);
     const std::vector<float>& getResponse() const;
     const FreqResponseBase& getFreqResBase() const;
     void updateResponse();
     bool getAndClearResUpdate();
+    size_t getMemoryBytes() const;
+
+    // Coefficient designs since construction, and those of them that run
+    // on the filter instance because a section couldn't be measured.
+    int getNumDesigns() const;
+    int getNumFallbacks() const;
+
+    // Runs every band type the SVF engine supports on it, whatever the
+    // band's engine parameter says.
+    void setSvfForced(bool shouldForce);
+    bool isSvfActive() const;
 
 private:
 
-    void processRoutingIn(BandParams::Routing routing, double* chL, double* chR, int numSamples);
-    void processRoutingOut(BandParams::Routing routing, double* chL, double* chR, int numSamples);
+    int processRoutingIn(BandParams::Routing routing, double* const* channels, int numChannels, int numSamples);
+    void processRoutingOut(BandParams::Routing routing, double* const* channels, int numChannels, int numSamples);
+    void design();
+    void designSections(AudioFilter::BiquadParamCascade& target, float gain);
+    void designDynamics();
+    void designSvf();
+    void processDynamic(int numRouted, int numSamples);
+    bool isDynamicActive() const;
+    void updateKernel();
+    BandValues readParameters() const;
+    void syncDesigner(const BandValues& values);
+    void takeDesign(const EqBandDsp& other, bool withState);
+    bool hasStereoPair(int numChannels) const;
     BandParams bandParams;
     double sampleRate;
     int bandIndex;
+    int numSections;
+    bool redesign = false;
+    int numDesigns = 0;
+    int numFallbacks = 0;
+
+    // the values last posted to the designer, or last designed without it
+    BandDesigner* designer = nullptr;
+    int designerSlot = -1;
+    BandValues postedValues;
 
     std::vector<double> dataMain;
     std::vector<double> dataAux;
-    double* procBuffers[2] = { nullptr, nullptr };
-    AudioFilter::FilterInstance<double> filterInstance;
-    AudioFilter::BiquadParamCascade biquads;
-    AudioFilter::ButterworthCreator bwCreator;
+    ChannelGroups channelGroups;
+    std::vector<double*> procBuffers;
+    std::vector<double*> subBuffers;
+
+    // The filters and their designs. They're created by the first of the
+    // prepare calls, so constructing a processor doesn't allocate them for
+    // bands that never play.
+    struct Filters
+    {
+        Filters(int maxorder, int numsections);
+
+        // The cascade runs on coefficients measured from the designed sections,
+        // the filter instance only takes over if a section can't be measured.
+        BiquadProbe probe;
+        std::vector<BiquadCoeffs> sectionCoeffs;
+        MultiChannelCascade cascade;
+        std::unique_ptr<AudioFilter::FilterInstance<double>> filterInstance;
+        AudioFilter::BiquadParamCascade biquads;
+        AudioFilter::ButterworthCreator bwCreator;
+
+        // Designs of the gain steps and the detector of the dynamic mode.
+        BandDynamics dynamics;
+        AudioFilter::BiquadParamCascade dynamicBiquads;
+        AudioFilter::BiquadParamCascade detectorBiquads;
+        // Closed form state variable sections, their coefficients ramp over a
+        // block instead of switching, so automation runs without a probe fit.
+        SvfCascade svf;
+        std::vector<SvfCoeffs> svfCoeffs;
+    };
+
+    void allocateFilters();
+
+    std::unique_ptr<Filters> filters;
+    juce::AudioChannelSet preparedLayout;
+    bool useCascade = false;
+    bool useSvf = false;
+    bool svfForced = false;
+
     const FreqResponseBase& freqResBase;
     std::vector<float> freqRes;
     bool responseUpdateFlag = false;
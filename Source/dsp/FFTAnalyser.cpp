@@ -1,11 +1,14 @@
 #include "FFTAnalyser.h"
+#include "SharedTables.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <tuple>
 
 
-FFTAnalyser::FFTAnalyser(int fftOrder, int overlapratio, int numbands, float releaseTime, int sampleRate)
-    :fftSize(static_cast<size_t>(1) << fftOrder), overlapRatio(overlapratio), buffer(fftSize), window(fftSize), procBuffer(fftSize),
-    freqs(numbands), mags(numbands), peakMags(numbands), bandBorders(numbands), downSamplingFactor(std::max(1, sampleRate / 44100))
+FFTAnalyser::Plan::Plan(int fftorder, int overlapratio, int numbands, float releaseTime, int sampleRate)
+    :fftOrder(fftorder), fftSize(static_cast<size_t>(1) << fftorder), overlapRatio(overlapratio),
+    downSamplingFactor(std::max(1, sampleRate / 44100)), window(fftSize), freqs(numbands), bandBorders(numbands)
 {
     sampleRate /= downSamplingFactor;
 
@@ -48,13 +51,60 @@ FFTAnalyser::FFTAnalyser(int fftOrder, int overlapratio, int numbands, float rel
         const auto nextIdx = std::min(static_cast<int> (fftSize / 2 - 1), static_cast<int> (fftSize * nextFreq / sampleRate + 0.5f));
         bandBorders[numbands-1] = nextIdx;
     }
+}
+
+size_t FFTAnalyser::Plan::getMemoryBytes() const
+{
+    return sizeof(Plan) + window.size() * sizeof(float) + freqs.size() * sizeof(float) + bandBorders.size() * sizeof(int);
+}
+
+std::shared_ptr<const FFTAnalyser::Plan> FFTAnalyser::getPlan(int fftOrder, int overlapratio, int numbands, float releaseTime, int sampleRate)
+{
+    using Key = std::tuple<int, int, int, float, int>;
+    static SharedTableRegistry<Key, Plan> registry;
+
+    return registry.get(Key(fftOrder, overlapratio, numbands, releaseTime, sampleRate), [&]() {
+        return std::make_unique<Plan>(fftOrder, overlapratio, numbands, releaseTime, sampleRate);
+    });
+}
+
+FFTAnalyser::FFTAnalyser(int fftOrder, int overlapratio, int numbands, float releaseTime, int sampleRate)
+{
+    prepare(getPlan(fftOrder, overlapratio, numbands, releaseTime, sampleRate));
+}
+
+void FFTAnalyser::prepare(std::shared_ptr<const Plan> newPlan)
+{
+    if (newPlan != plan)
+    {
+        plan = std::move(newPlan);
+        buffer.resize(plan->fftSize);
+        procBuffer.resize(plan->fftSize);
+        mags.resize(plan->freqs.size());
+        peakMags.resize(plan->freqs.size());
+    }
 
     clear();
 }
 
+const FFTAnalyser::Plan* FFTAnalyser::getPlan() const
+{
+    return plan.get();
+}
+
+size_t FFTAnalyser::getMemoryBytes() const
+{
+    return sizeof(FFTAnalyser) + (buffer.capacity() + procBuffer.capacity() + mags.capacity() + peakMags.capacity()) * sizeof(float);
+}
+
+size_t FFTAnalyser::getSharedMemoryBytes() const
+{
+    return getSharedBytesPerUser(plan, plan != nullptr ? plan->getMemoryBytes() : 0);
+}
+
 int FFTAnalyser::getDownsamplingFactor() const
 {
-    return downSamplingFactor;
+    return plan != nullptr ? plan->downSamplingFactor : 1;
 }
 
 void FFTAnalyser::clear()
@@ -105,6 +155,12 @@ void FFTAnalyser::processBlock(const double* inL, const double* inR, int numSamp
 
 void FFTAnalyser::processBlock(const float* inL, const float* inR, int numSamples)
 {
+    if (plan == nullptr)
+        return;
+
+    const auto downSamplingFactor = plan->downSamplingFactor;
+    const auto overlapRatio = plan->overlapRatio;
+
     while (numSamples > 0)
     {
         const auto curNumSamples = std::min(numSamples, static_cast<int> (procBuffer.size()));
@@ -116,7 +172,7 @@ void FFTAnalyser::processBlock(const float* inL, const float* inR, int numSample
         }
         else
         {
-            memcpy(procBuffer.data(), inL, numSamples * sizeof(float));
+            memcpy(procBuffer.data(), inL, curNumSamples * sizeof(float));
         }
 
         if (downSamplingFactor == 1)
@@ -169,7 +225,7 @@ bool FFTAnalyser::hasNewData()
 
 const std::vector<float>& FFTAnalyser::getFreqs()
 {
-    return freqs;
+    return plan->freqs;
 }
 
 const std::vector<float>& FFTAnalyser::getMags()
@@ -184,10 +240,14 @@ const std::vector<float>& FFTAnalyser::getPeakMags()
 
 void FFTAnalyser::processFft()
 {
+    const auto& window = plan->window;
+    const auto& freqs = plan->freqs;
+    const auto& bandBorders = plan->bandBorders;
+
     for (size_t i = 0; i < buffer.size(); ++i)
         procBuffer[i] = buffer[i] * window[i];
 
-    const auto sampleOverlap = buffer.size() / overlapRatio;
+    const auto sampleOverlap = buffer.size() / plan->overlapRatio;
     const auto numSamplesToCopy = buffer.size() - sampleOverlap;
     for (size_t i = 0; i < numSamplesToCopy; ++i)
         buffer[i] = buffer[i + sampleOverlap];
@@ -210,7 +270,7 @@ void FFTAnalyser::processFft()
 
             const auto gain = std::sqrt(freqs[i] / 1000.f);
             const auto curMag = gain * val / (bandBorders[i] + 1 - lastIdx);
-            mags[i] = curMag > mags[i] ? curMag : mags[i] + (curMag - mags[i])*magRel;
+            mags[i] = curMag > mags[i] ? curMag : mags[i] + (curMag - mags[i])*plan->magRel;
             peakMags[i] = std::max(mags[i], peakMags[i]);
             lastIdx = bandBorders[i] + 1;
         }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <vector>
 
 // Simple FFT analyser that creates log-spaced bands from the FFT bins.
@@ -8,8 +9,33 @@ class FFTAnalyser
 {
 public:
 
+    // Immutable window and band tables for one analyser configuration.
+    // Plans are shared between all analysers with the same configuration, so
+    // re-preparing with unchanged settings only resets the per-instance state.
+    struct Plan
+    {
+        Plan(int fftorder, int overlapratio, int numbands, float releaseTime, int sampleRate);
+        size_t getMemoryBytes() const;
+
+        int fftOrder;
+        size_t fftSize;
+        size_t overlapRatio;
+        int downSamplingFactor;
+        float magRel;
+        std::vector<float> window;
+        std::vector<float> freqs;
+        std::vector<int> bandBorders;
+    };
+
+    static std::shared_ptr<const Plan> getPlan(int fftOrder, int overlapratio, int numbands, float releaseTime, int sampleRate);
+
+    FFTAnalyser() = default;
     FFTAnalyser(int fftOrder, int overlapratio, int numbands, float releaseTime, int sampleRate);
+    void prepare(std::shared_ptr<const Plan> newPlan);
+    const Plan* getPlan() const;
     int getDownsamplingFactor() const;
+    size_t getMemoryBytes() const;
+    size_t getSharedMemoryBytes() const;
     void clear();
     void clearPeaks();
     void processBlock(const double* inL, const double* inR, int numSamples);
@@ -26,18 +52,12 @@ public:
 private:
 
     void processFft();
-    size_t fftSize;
-    size_t overlapRatio;
-    float magRel;
+    std::shared_ptr<const Plan> plan;
     std::vector<float> buffer;
-    std::vector<float> window;
     std::vector<float> procBuffer;
-    std::vector<float> freqs;
     std::vector<float> mags;
     std::vector<float> peakMags;
-    std::vector<int> bandBorders;
-    int downSamplingFactor;
     int downSamplingIndex = 0;
     size_t bufferIndex = 0;
     bool newDataAvailable = false;
-};
\ No newline at end of file
+};
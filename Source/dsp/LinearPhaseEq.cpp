@@ -0,0 +1,290 @@
+#include "LinearPhaseEq.h"
+#include "NonUniformConvolver.h"
+#include "UniformConvolver.h"
+
+class LinearPhaseEq::DesignThread : public juce::Thread
+{
+public:
+
+    explicit DesignThread(LinearPhaseEq& o)
+        : juce::Thread("AFEQ linear phase"), owner(o)
+    {
+    }
+
+    ~DesignThread() override
+    {
+        stopThread(1000);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            owner.design();
+            wait(20);
+        }
+    }
+
+private:
+
+    LinearPhaseEq& owner;
+};
+
+LinearPhaseEq::LinearPhaseEq() = default;
+
+LinearPhaseEq::~LinearPhaseEq()
+{
+    release();
+}
+
+int LinearPhaseEq::getKernelLengthForSampleRate(double sampleRate)
+{
+    return juce::nextPowerOfTwo(juce::roundToInt(sampleRate / 6.0));
+}
+
+void LinearPhaseEq::prepare(EqBandDspGroup& designbands, const juce::AudioChannelSet& layout, double sampleRate, int partitionSize, bool nonUniform)
+{
+    release();
+    bands.clear();
+    bands.swapWith(designbands);
+    channelGroups.setLayout(layout);
+    kernelLength = getKernelLengthForSampleRate(sampleRate);
+
+    for (auto b : bands)
+    {
+        b->setSampleRate(sampleRate);
+        b->setChannelLayout(layout);
+    }
+
+    // a stereo pair with mid/side bands needs four kernels for its two channels
+    const auto numChannels = juce::jmax(1, channelGroups.numChannels);
+
+    if (nonUniform)
+        convolver = std::make_unique<NonUniformConvolver>();
+    else
+        convolver = std::make_unique<UniformConvolver>();
+
+    convolver->prepare(numChannels, partitionSize, kernelLength, numChannels + 2, numChannels + 2);
+
+    const auto numDesignBins = static_cast<size_t> (kernelLength / 2 + 1);
+    designFft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(kernelLength)));
+    channelMags.assign(static_cast<size_t> (numChannels), std::vector<double>(numDesignBins));
+    midMag.resize(numDesignBins);
+    sideMag.resize(numDesignBins);
+    bandMag.resize(numDesignBins);
+    kernelMag.resize(numDesignBins);
+    impulse.resize(static_cast<size_t> (kernelLength));
+    designBuffer.assign(static_cast<size_t> (2 * kernelLength), 0.f);
+    taps.resize(static_cast<size_t> (kernelLength));
+    window.resize(static_cast<size_t> (kernelLength));
+    paths.reserve(static_cast<size_t> (numChannels + 2));
+
+    // Blackman, centred on the kernel's middle tap
+    for (size_t n = 0; n < window.size(); ++n)
+    {
+        const auto phase = juce::MathConstants<double>::twoPi * static_cast<double> (n) / kernelLength;
+        window[n] = static_cast<float> (0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase));
+    }
+
+    // the first kernels are there before the audio starts
+    dirty = true;
+    design();
+
+    thread = std::make_unique<DesignThread>(*this);
+    thread->startThread();
+}
+
+void LinearPhaseEq::release()
+{
+    thread.reset();
+}
+
+void LinearPhaseEq::reset()
+{
+    convolver->reset();
+}
+
+int LinearPhaseEq::getLatency() const
+{
+    return convolver->getLatency() + kernelLength / 2;
+}
+
+int LinearPhaseEq::getKernelLength() const
+{
+    return kernelLength;
+}
+
+int LinearPhaseEq::getNumLateJobs() const
+{
+    return convolver != nullptr ? convolver->getNumLateJobs() : 0;
+}
+
+size_t LinearPhaseEq::getMemoryBytes() const
+{
+    auto numDoubles = midMag.capacity() + sideMag.capacity() + bandMag.capacity() + kernelMag.capacity() + impulse.capacity();
+
+    for (const auto& m : channelMags)
+        numDoubles += m.capacity();
+
+    auto bytes = sizeof(LinearPhaseEq) + convolver->getMemoryBytes() + numDoubles * sizeof(double)
+        + (designBuffer.capacity() + taps.capacity() + window.capacity()) * sizeof(float);
+
+    for (auto b : bands)
+        bytes += b->getMemoryBytes();
+
+    return bytes;
+}
+
+void LinearPhaseEq::process(double* const* channels, int numChannels, int numSamples)
+{
+    convolver->process(channels, numChannels, numSamples);
+}
+
+void LinearPhaseEq::design()
+{
+    for (auto b : bands)
+    {
+        b->syncParameters();
+        dirty = b->getBandParams().getAndClearChanged() || dirty;
+    }
+
+    // without a free slot the audio thread is still fading, try again next time
+    if (! dirty || ! convolver->beginKernels())
+        return;
+
+    const auto numDesignBins = midMag.size();
+
+    for (auto& m : channelMags)
+        std::fill(m.begin(), m.end(), 1.0);
+
+    std::fill(midMag.begin(), midMag.end(), 1.0);
+    std::fill(sideMag.begin(), sideMag.end(), 1.0);
+
+    const auto hasPair = channelGroups.left >= 0 && channelGroups.right >= 0;
+    auto hasMidSide = false;
+
+    for (auto b : bands)
+    {
+        const auto& bp = b->getBandParamsConst();
+
+        if (! bp.enabled)
+            continue;
+
+        if (b->getSectionCoefficients(coeffs))
+        {
+            for (size_t k = 0; k < numDesignBins; ++k)
+            {
+                const auto omega = juce::MathConstants<double>::pi * static_cast<double> (k) / static_cast<double> (numDesignBins - 1);
+                auto mag = 1.0;
+
+                for (const auto& c : coeffs)
+                    mag *= c.getMagnitude(omega);
+
+                bandMag[k] = mag;
+            }
+        }
+        else
+        {
+            // the filters the band runs, measured over one kernel length
+            b->getImpulseResponse(impulse);
+            std::fill(designBuffer.begin(), designBuffer.end(), 0.f);
+
+            for (size_t n = 0; n < impulse.size(); ++n)
+                designBuffer[n] = static_cast<float> (impulse[n]);
+
+            designFft->performFrequencyOnlyForwardTransform(designBuffer.data());
+
+            for (size_t k = 0; k < numDesignBins; ++k)
+                bandMag[k] = static_cast<double> (designBuffer[k]);
+        }
+
+        const auto multiply = [this, numDesignBins](std::vector<double>& target) {
+            for (size_t k = 0; k < numDesignBins; ++k)
+                target[k] *= bandMag[k];
+        };
+
+        const auto pairRouting = BandParams::isPairRouting(bp.routing);
+
+        if (pairRouting && hasPair)
+        {
+            switch (bp.routing)
+            {
+            case BandParams::routeLeft:
+                multiply(channelMags[static_cast<size_t> (channelGroups.left)]);
+                break;
+            case BandParams::routeRight:
+                multiply(channelMags[static_cast<size_t> (channelGroups.right)]);
+                break;
+            case BandParams::routeMid:
+                multiply(midMag);
+                hasMidSide = true;
+                break;
+            default:
+                multiply(sideMag);
+                hasMidSide = true;
+                break;
+            }
+
+            continue;
+        }
+
+        // without a stereo pair the pair routings process everything, like EqBandDsp
+        for (auto ch : pairRouting ? channelGroups.all : channelGroups.getChannels(bp.routing))
+            multiply(channelMags[static_cast<size_t> (ch)]);
+    }
+
+    paths.clear();
+    auto numKernels = 0;
+
+    for (int ch = 0; ch < static_cast<int> (channelMags.size()); ++ch)
+    {
+        if (hasMidSide && (ch == channelGroups.left || ch == channelGroups.right))
+            continue;
+
+        writeKernel(numKernels, channelMags[static_cast<size_t> (ch)]);
+        paths.push_back({ ch, ch, numKernels++ });
+    }
+
+    if (hasMidSide)
+    {
+        // L' = (M + S) / 2 * L + (M - S) / 2 * R, R' = (M - S) / 2 * L + (M + S) / 2 * R
+        const auto l = channelGroups.left;
+        const auto r = channelGroups.right;
+        const int matrix[4][2] = { { l, l }, { r, l }, { l, r }, { r, r } };
+
+        for (const auto& entry : matrix)
+        {
+            const auto input = entry[0];
+            const auto output = entry[1];
+            const auto sideSign = input == output ? 0.5 : -0.5;
+            const auto& inputMag = channelMags[static_cast<size_t> (input)];
+
+            for (size_t k = 0; k < numDesignBins; ++k)
+                kernelMag[k] = (0.5 * midMag[k] + sideSign * sideMag[k]) * inputMag[k];
+
+            writeKernel(numKernels, kernelMag);
+            paths.push_back({ input, output, numKernels++ });
+        }
+    }
+
+    convolver->setPaths(paths);
+    convolver->publishKernels();
+    dirty = false;
+}
+
+void LinearPhaseEq::writeKernel(int index, const std::vector<double>& spectrum)
+{
+    // A real spectrum gives a zero-phase impulse response around sample 0. It
+    // is rotated to the middle of the kernel and windowed.
+    std::fill(designBuffer.begin(), designBuffer.end(), 0.f);
+
+    for (size_t k = 0; k < spectrum.size(); ++k)
+        designBuffer[2 * k] = static_cast<float> (spectrum[k]);
+
+    designFft->performRealOnlyInverseTransform(designBuffer.data());
+
+    for (int n = 0; n < kernelLength; ++n)
+        taps[static_cast<size_t> (n)] = designBuffer[static_cast<size_t> ((n + kernelLength / 2) % kernelLength)] * window[static_cast<size_t> (n)];
+
+    convolver->setKernel(index, taps.data(), kernelLength);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "EqBandDsp.h"
+#include "PartitionedConvolver.h"
+
+#include "JuceHeader.h"
+
+// Linear-phase version of a band chain. A background thread keeps its own
+// bands designed from the same parameters, multiplies their magnitude
+// responses (from their sections, or from their impulse responses where the
+// sections aren't available) per channel the way the routings apply them and
+// turns the products into symmetric FIR kernels for a PartitionedConvolver.
+// Bands on single channels apply before mid/side bands, whose 2x2 matrix is
+// folded into the kernels of the stereo pair. The latency is the partition
+// size plus half the kernel length.
+class LinearPhaseEq
+{
+public:
+
+    LinearPhaseEq();
+    ~LinearPhaseEq();
+
+    // Takes over designbands, bands bound to the parameters of the processed
+    // chain that are only designed, never processed. Designs the first kernels
+    // and starts the thread; allocates, not realtime safe. nonUniform selects
+    // the NonUniformConvolver, with partitionSize as its first partition.
+    void prepare(EqBandDspGroup& designbands, const juce::AudioChannelSet& layout, double sampleRate, int partitionSize, bool nonUniform);
+    void release();
+
+    // Clears the convolution state and keeps the kernels, for a prepare with
+    // unchanged settings. Not while process() runs.
+    void reset();
+
+    int getLatency() const;
+    int getKernelLength() const;
+    // Convolution blocks of background stages that missed their deadline.
+    int getNumLateJobs() const;
+    size_t getMemoryBytes() const;
+
+    // Processes in place, channels beyond the prepared layout pass through.
+    void process(double* const* channels, int numChannels, int numSamples);
+
+    // Power of two of about 170 ms.
+    static int getKernelLengthForSampleRate(double sampleRate);
+
+private:
+
+    class DesignThread;
+
+    // Called on the design thread, publishes new kernels when a band changed.
+    void design();
+    void writeKernel(int index, const std::vector<double>& spectrum);
+
+    EqBandDspGroup bands;
+    ChannelGroups channelGroups;
+    std::unique_ptr<PartitionedConvolver> convolver;
+    int kernelLength = 0;
+    bool dirty = true;
+
+    // design thread only
+    std::unique_ptr<juce::dsp::FFT> designFft;
+    std::vector<std::vector<double>> channelMags;
+    std::vector<double> midMag;
+    std::vector<double> sideMag;
+    std::vector<double> bandMag;
+    std::vector<double> kernelMag;
+    std::vector<double> impulse;
+    std::vector<BiquadCoeffs> coeffs;
+    std::vector<float> designBuffer;
+    std::vector<float> taps;
+    std::vector<float> window;
+    std::vector<PartitionedConvolver::Path> paths;
+
+    std::unique_ptr<DesignThread> thread;
+};
@@ -0,0 +1,261 @@
+#include "MultirateSplit.h"
+
+int MultirateSplit::getFactorForSampleRate(double sampleRate)
+{
+    int f = 1;
+
+    while (sampleRate / (2 * f) >= 44100.0)
+        f *= 2;
+
+    return f;
+}
+
+MultirateSplit::HalfBand MultirateSplit::designHalfBand(double transitionWidth)
+{
+    // Kaiser windowed sinc, length from Kaiser's estimate for the attenuation
+    constexpr double attenuation = 100.0;
+    const auto beta = 0.1102 * (attenuation - 8.7);
+    const auto order = (attenuation - 8.0) / (2.285 * juce::MathConstants<double>::twoPi * transitionWidth);
+    const auto halfOrder = juce::jmax(0, static_cast<int> (std::ceil((0.5 * order - 1.0) / 2.0)));
+    const auto m = 2 * halfOrder + 1;
+
+    const auto bessel = [](double x) {
+        auto sum = 1.0;
+        auto term = 1.0;
+
+        for (int k = 1; k < 64; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    };
+
+    HalfBand hb;
+    auto sum = 0.0;
+
+    for (int q = 0; q <= halfOrder; ++q)
+    {
+        const auto n = 2 * q + 1;
+        const auto ratio = static_cast<double> (n) / m;
+        const auto window = bessel(beta * std::sqrt(1.0 - ratio * ratio)) / bessel(beta);
+        const auto sign = q % 2 == 0 ? 1.0 : -1.0;
+        hb.taps.push_back(sign / (juce::MathConstants<double>::pi * n) * window);
+        sum += hb.taps.back();
+    }
+
+    // unity gain at DC, which keeps the half-band symmetry around a quarter of the rate
+    for (auto& t : hb.taps)
+        t *= 0.25 / sum;
+
+    return hb;
+}
+
+void MultirateSplit::prepare(int newFactor, int numChannels, int maxblocksize)
+{
+    jassert(juce::isPowerOfTwo(newFactor) && newFactor >= 2);
+
+    factor = newFactor;
+    maxBlockSize = maxblocksize;
+    filters.clear();
+
+    // The pass band edge in units of the low rate. A stage's stop band starts
+    // where its aliases would fold into the final pass band.
+    constexpr double passBand = 0.42;
+
+    // decimation is complete every factor samples, the fifo evens that out
+    latency = factor - 1;
+
+    for (int rate = factor, shift = 1; rate > 1; rate /= 2, ++shift)
+    {
+        const auto outRate = 0.5 * rate;
+        filters.push_back(designHalfBand((outRate - 2.0 * passBand) / rate));
+
+        // Decimation delays by K samples of its output rate, interpolation by
+        // K + 1 samples of its input rate.
+        latency += (2 * filters.back().getHalfOrder() + 1) << shift;
+    }
+
+    phases.assign(filters.size(), 0);
+    channelStates.resize(static_cast<size_t> (numChannels));
+    lowPointers.assign(static_cast<size_t> (numChannels), nullptr);
+
+    for (auto& state : channelStates)
+    {
+        state.stages.resize(filters.size());
+        auto maxIn = maxBlockSize + 1;
+
+        for (size_t s = 0; s < filters.size(); ++s)
+        {
+            const auto& hb = filters[s];
+            state.stages[s].decimHistory.assign(static_cast<size_t> (hb.getLength() - 1 + maxIn), 0.0);
+            maxIn = maxIn / 2 + 1;
+            state.stages[s].interpHistory.assign(static_cast<size_t> (2 * hb.getHalfOrder() + 1 + maxIn), 0.0);
+        }
+
+        state.low.assign(static_cast<size_t> (getMaxLowBlockSize()), 0.0);
+        state.lowDry.assign(state.low.size(), 0.0);
+        state.bufferA.assign(static_cast<size_t> (maxBlockSize + 2), 0.0);
+        state.bufferB.assign(state.bufferA.size(), 0.0);
+        state.delay.assign(static_cast<size_t> (latency), 0.0);
+        state.fifo.assign(static_cast<size_t> (maxBlockSize + 2 * factor), 0.0);
+    }
+
+    reset();
+}
+
+void MultirateSplit::reset()
+{
+    std::fill(phases.begin(), phases.end(), 0);
+
+    for (auto& state : channelStates)
+    {
+        for (auto& stage : state.stages)
+        {
+            std::fill(stage.decimHistory.begin(), stage.decimHistory.end(), 0.0);
+            std::fill(stage.interpHistory.begin(), stage.interpHistory.end(), 0.0);
+        }
+
+        std::fill(state.delay.begin(), state.delay.end(), 0.0);
+        std::fill(state.fifo.begin(), state.fifo.end(), 0.0);
+        state.delayPos = 0;
+        state.fifoFill = factor - 1;
+    }
+}
+
+int MultirateSplit::getFactor() const
+{
+    return factor;
+}
+
+int MultirateSplit::getLatency() const
+{
+    return latency;
+}
+
+int MultirateSplit::getMaxLowBlockSize() const
+{
+    return maxBlockSize / factor + 1;
+}
+
+size_t MultirateSplit::getMemoryBytes() const
+{
+    auto numValues = lowPointers.capacity();
+
+    for (const auto& state : channelStates)
+    {
+        for (const auto& stage : state.stages)
+            numValues += stage.decimHistory.capacity() + stage.interpHistory.capacity();
+
+        numValues += state.low.capacity() + state.lowDry.capacity() + state.bufferA.capacity() + state.bufferB.capacity()
+            + state.delay.capacity() + state.fifo.capacity();
+    }
+
+    for (const auto& hb : filters)
+        numValues += hb.taps.capacity();
+
+    return sizeof(MultirateSplit) + numValues * sizeof(double) + channelStates.capacity() * sizeof(ChannelState);
+}
+
+double* MultirateSplit::decimate(ChannelState& state, const double* in, int numSamples)
+{
+    const double* src = in;
+    auto count = numSamples;
+
+    for (size_t s = 0; s < filters.size(); ++s)
+    {
+        const auto& taps = filters[s].taps;
+        const auto halfOrder = filters[s].getHalfOrder();
+        const auto m = 2 * halfOrder + 1;
+        auto& history = state.stages[s].decimHistory;
+        auto dst = s + 1 == filters.size() ? state.low.data() : (s % 2 == 0 ? state.bufferA.data() : state.bufferB.data());
+
+        std::copy(src, src + count, history.begin() + 2 * m);
+
+        // outputs at the odd input samples, centred m samples back
+        int numOut = 0;
+
+        for (int i = (phases[s] + 1) & 1; i < count; i += 2)
+        {
+            const auto centre = history.data() + m + i;
+            auto sum = 0.5 * centre[0];
+
+            for (int q = 0; q <= halfOrder; ++q)
+                sum += taps[static_cast<size_t> (q)] * (centre[2 * q + 1] + centre[-2 * q - 1]);
+
+            dst[numOut++] = sum;
+        }
+
+        std::copy(history.begin() + count, history.begin() + count + 2 * m, history.begin());
+        src = dst;
+        count = numOut;
+    }
+
+    numLowSamples = count;
+    std::copy(state.low.begin(), state.low.begin() + count, state.lowDry.begin());
+    return state.low.data();
+}
+
+void MultirateSplit::recombine(ChannelState& state, double* io, int numSamples, int numLow)
+{
+    for (size_t i = 0; i < static_cast<size_t> (numLow); ++i)
+        state.low[i] -= state.lowDry[i];
+
+    const double* src = state.low.data();
+    auto count = numLow;
+
+    for (auto s = filters.size(); s-- > 0;)
+    {
+        const auto& taps = filters[s].taps;
+        const auto halfOrder = filters[s].getHalfOrder();
+        const auto historySize = 2 * halfOrder + 1;
+        auto& history = state.stages[s].interpHistory;
+        auto dst = s == 0 ? state.fifo.data() + state.fifoFill : (s % 2 == 0 ? state.bufferA.data() : state.bufferB.data());
+
+        std::copy(src, src + count, history.begin() + historySize);
+
+        // the even output is the input K + 1 samples back, the odd one is interpolated around it
+        for (int k = 0; k < count; ++k)
+        {
+            const auto u = history.data() + historySize + k - halfOrder;
+            auto sum = 0.0;
+
+            for (int j = 0; j <= halfOrder; ++j)
+                sum += taps[static_cast<size_t> (j)] * (u[-1 - j] + u[j]);
+
+            dst[2 * k] = u[-1];
+            dst[2 * k + 1] = 2.0 * sum;
+        }
+
+        std::copy(history.begin() + count, history.begin() + count + historySize, history.begin());
+        src = dst;
+        count *= 2;
+    }
+
+    state.fifoFill += count;
+    jassert(state.fifoFill >= numSamples);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const auto delayed = state.delay[static_cast<size_t> (state.delayPos)];
+        state.delay[static_cast<size_t> (state.delayPos)] = io[i];
+        state.delayPos = state.delayPos + 1 == latency ? 0 : state.delayPos + 1;
+        io[i] = delayed + state.fifo[static_cast<size_t> (i)];
+    }
+
+    state.fifoFill -= numSamples;
+    std::copy(state.fifo.begin() + numSamples, state.fifo.begin() + numSamples + state.fifoFill, state.fifo.begin());
+}
+
+void MultirateSplit::advancePhases(int numSamples)
+{
+    auto count = numSamples;
+
+    for (auto& phase : phases)
+    {
+        const auto numOut = (count + phase) / 2;
+        phase = (phase + count) & 1;
+        count = numOut;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+// Decimated side path for bands far below the Nyquist frequency. The input
+// is decimated by a power of two, the bands run on that low rate copy, and
+// only the difference they make, F(x) - x, is interpolated and added to the
+// input, delayed by the latency of the two filter cascades. Without bands
+// the output is the input delayed by getLatency() samples, bit for bit.
+//
+// Decimation and interpolation are cascades of linear-phase half-band FIRs
+// with the pass band up to 0.42 of the low rate and 100 dB stop band, so with
+// the low rate at 44.1 kHz or above, the bands' effect is reproduced up to
+// 18.5 kHz and aliases and images stay above that.
+class MultirateSplit
+{
+public:
+
+    // Largest power of two that keeps the low rate at 44.1 kHz or above, 1 if
+    // the sample rate is too low to split.
+    static int getFactorForSampleRate(double sampleRate);
+
+    // Allocates, not realtime safe.
+    void prepare(int factor, int numChannels, int maxBlockSize);
+    void reset();
+
+    int getFactor() const;
+    int getLatency() const;
+
+    // Upper bound of the low rate samples per block, for sizing the band
+    // buffers.
+    int getMaxLowBlockSize() const;
+
+    size_t getMemoryBytes() const;
+
+    // Processes numSamples in place. processLow(double* const* channels, int
+    // numSamples) receives the decimated block and filters it in place.
+    template <typename ProcessLow>
+    void process(double* const* channels, int numChannels, int numSamples, ProcessLow&& processLow)
+    {
+        jassert(numChannels <= static_cast<int> (channelStates.size()) && numSamples <= maxBlockSize);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            lowPointers[static_cast<size_t> (ch)] = decimate(channelStates[static_cast<size_t> (ch)], channels[ch], numSamples);
+
+        const auto numLow = numLowSamples;
+        processLow(lowPointers.data(), numLow);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            recombine(channelStates[static_cast<size_t> (ch)], channels[ch], numSamples, numLow);
+
+        advancePhases(numSamples);
+    }
+
+private:
+
+    // Odd taps of one half-band filter, h[1], h[3], ..., h[2K+1]; the centre
+    // is 0.5 and the other even taps are 0.
+    struct HalfBand
+    {
+        std::vector<double> taps;
+        int getHalfOrder() const { return static_cast<int> (taps.size()) - 1; }
+        int getLength() const { return 4 * getHalfOrder() + 3; }
+    };
+
+    struct StageState
+    {
+        // last samples before the current block, followed by the block
+        std::vector<double> decimHistory;
+        std::vector<double> interpHistory;
+    };
+
+    struct ChannelState
+    {
+        std::vector<StageState> stages;
+        std::vector<double> low;
+        std::vector<double> lowDry;
+        std::vector<double> bufferA;
+        std::vector<double> bufferB;
+        std::vector<double> delay;
+        int delayPos = 0;
+        std::vector<double> fifo;
+        int fifoFill = 0;
+    };
+
+    static HalfBand designHalfBand(double transitionWidth);
+    double* decimate(ChannelState& state, const double* in, int numSamples);
+    void recombine(ChannelState& state, double* io, int numSamples, int numLow);
+    void advancePhases(int numSamples);
+
+    int factor = 1;
+    int latency = 0;
+    int maxBlockSize = 0;
+    int numLowSamples = 0;
+    std::vector<HalfBand> filters;
+
+    // parity of the next input sample of each decimation stage
+    std::vector<int> phases;
+    std::vector<ChannelState> channelStates;
+    std::vector<double*> lowPointers;
+};
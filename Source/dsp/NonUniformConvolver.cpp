@@ -0,0 +1,537 @@
+#include "NonUniformConvolver.h"
+#include "RealtimeSemaphore.h"
+
+class NonUniformConvolver::StageThread : public juce::Thread
+{
+public:
+
+    StageThread(NonUniformConvolver& o, Stage& s)
+        : juce::Thread("AFEQ convolution " + juce::String(s.size)), owner(o), stage(s)
+    {
+    }
+
+    ~StageThread() override
+    {
+        signalThreadShouldExit();
+        wake();
+        stopThread(1000);
+    }
+
+    void wake()
+    {
+        semaphore.post();
+    }
+
+    void run() override
+    {
+        for (;;)
+        {
+            semaphore.wait();
+
+            if (threadShouldExit())
+                return;
+
+            juce::ScopedNoDenormals noDenormals;
+            owner.runQueuedJobs(stage);
+        }
+    }
+
+private:
+
+    NonUniformConvolver& owner;
+    Stage& stage;
+    RealtimeSemaphore semaphore;
+};
+
+NonUniformConvolver::Stage::Stage() = default;
+NonUniformConvolver::Stage::~Stage() = default;
+
+NonUniformConvolver::NonUniformConvolver() = default;
+
+NonUniformConvolver::~NonUniformConvolver()
+{
+    stages.clear();
+}
+
+void NonUniformConvolver::setUseBackgroundThreads(bool shouldUse)
+{
+    useBackgroundThreads = shouldUse;
+}
+
+void NonUniformConvolver::prepare(int numchannels, int partitionsize, int maxKernelLength, int maxkernels, int maxPaths)
+{
+    jassert(juce::isPowerOfTwo(partitionsize));
+
+    stages.clear();
+    numChannels = numchannels;
+    partitionSize = partitionsize;
+    maxKernels = maxkernels;
+
+    // each stage ends where the next, larger one may start
+    auto size = partitionSize;
+    auto firstTap = 0;
+    auto numFloats = static_cast<size_t> (0);
+
+    for (;;)
+    {
+        const auto nextSize = juce::jmin(4 * size, juce::jmax(maxStageSize, partitionSize));
+        const auto nextFirstTap = 2 * nextSize - partitionSize;
+        const auto isLast = nextSize == size || maxKernelLength - nextFirstTap < 2 * nextSize;
+        const auto end = isLast ? maxKernelLength : nextFirstTap;
+
+        auto stage = stages.add(std::make_unique<Stage>());
+        stage->index = stages.size() - 1;
+        stage->size = size;
+        stage->firstTap = firstTap;
+        stage->numPartitions = juce::jmax(1, (end - firstTap + size - 1) / size);
+        stage->numBins = size + 1;
+        stage->delayBlocks = stage->index == 0 ? 1 : 2;
+        stage->kernelOffset = numFloats;
+        numFloats += static_cast<size_t> (maxKernels * stage->numPartitions * 2 * stage->numBins);
+
+        const auto fftOrder = juce::roundToInt(std::log2(2 * size));
+        stage->fft = std::make_unique<juce::dsp::FFT>(fftOrder);
+        stage->writerFft = std::make_unique<juce::dsp::FFT>(fftOrder);
+
+        const auto blockSize = static_cast<size_t> (numChannels * size);
+        stage->inputBlocks.assign(numJobSlots * blockSize, 0.f);
+        stage->frames.assign(2 * blockSize, 0.f);
+        stage->spectra.assign(static_cast<size_t> (numChannels * stage->numPartitions * 2 * stage->numBins), 0.f);
+        stage->outputBlocks.assign(numJobSlots * blockSize, 0.f);
+
+        // the real-only transforms work on twice the transform size
+        stage->fftBuffer.assign(static_cast<size_t> (4 * size), 0.f);
+        stage->fadeBuffer.assign(static_cast<size_t> (size), 0.f);
+
+        if (isLast)
+            break;
+
+        size = nextSize;
+        firstTap = nextFirstTap;
+    }
+
+    prepareKernelSets(numFloats, stages.size(), maxPaths);
+    writerBuffer.assign(stages.getLast()->fftBuffer.size(), 0.f);
+    inFifo.assign(static_cast<size_t> (numChannels * partitionSize), 0.0);
+    outFifo.assign(inFifo.size(), 0.0);
+    activeSet = -1;
+    fadeFrom = -1;
+    fadeLength = stages.getLast()->size;
+    numLateJobs.store(0);
+    reset();
+
+    if (useBackgroundThreads)
+    {
+        for (int i = 1; i < stages.size(); ++i)
+        {
+            auto stage = stages.getUnchecked(i);
+            stage->thread = std::make_unique<StageThread>(*this, *stage);
+            stage->thread->startRealtimeThread(juce::Thread::RealtimeOptions());
+        }
+    }
+}
+
+void NonUniformConvolver::reset()
+{
+    for (auto stage : stages)
+    {
+        cancelJobs(*stage);
+        stage->outputReady = false;
+        stage->inputBlocked = false;
+        std::fill(stage->inputBlocks.begin(), stage->inputBlocks.end(), 0.f);
+        std::fill(stage->frames.begin(), stage->frames.end(), 0.f);
+        std::fill(stage->spectra.begin(), stage->spectra.end(), 0.f);
+        std::fill(stage->outputBlocks.begin(), stage->outputBlocks.end(), 0.f);
+        stage->spectrumPos = 0;
+    }
+
+    std::fill(inFifo.begin(), inFifo.end(), 0.0);
+    std::fill(outFifo.begin(), outFifo.end(), 0.0);
+    fifoPos = 0;
+    time = 0;
+}
+
+int NonUniformConvolver::getLatency() const
+{
+    return partitionSize;
+}
+
+int NonUniformConvolver::getPartitionSize() const
+{
+    return partitionSize;
+}
+
+size_t NonUniformConvolver::getMemoryBytes() const
+{
+    auto numFloats = writerBuffer.capacity();
+
+    for (auto stage : stages)
+        numFloats += stage->inputBlocks.capacity() + stage->frames.capacity() + stage->spectra.capacity()
+            + stage->outputBlocks.capacity() + stage->fftBuffer.capacity() + stage->fadeBuffer.capacity();
+
+    return sizeof(NonUniformConvolver) + static_cast<size_t> (stages.size()) * sizeof(Stage) + getKernelSetBytes()
+        + numFloats * sizeof(float) + (inFifo.capacity() + outFifo.capacity()) * sizeof(double);
+}
+
+int NonUniformConvolver::getNumStages() const
+{
+    return stages.size();
+}
+
+int NonUniformConvolver::getStageSize(int stage) const
+{
+    return stages[stage]->size;
+}
+
+int NonUniformConvolver::getStageFirstTap(int stage) const
+{
+    return stages[stage]->firstTap;
+}
+
+int NonUniformConvolver::getNumLateJobs() const
+{
+    return numLateJobs.load(std::memory_order_relaxed);
+}
+
+void NonUniformConvolver::setKernel(int index, const float* taps, int numTaps)
+{
+    jassert(index < maxKernels);
+    auto& set = getWritingSet();
+
+    for (auto stage : stages)
+    {
+        for (int p = 0; p < stage->numPartitions; ++p)
+        {
+            const auto first = stage->firstTap + p * stage->size;
+            const auto count = juce::jlimit(0, stage->size, numTaps - first);
+            const auto spectrumSize = static_cast<std::ptrdiff_t> (2 * stage->numBins);
+            auto dst = set.spectra.begin() + static_cast<std::ptrdiff_t> (stage->kernelOffset)
+                + (index * stage->numPartitions + p) * spectrumSize;
+
+            if (count == 0)
+            {
+                std::fill(dst, dst + spectrumSize, 0.f);
+                continue;
+            }
+
+            std::fill(writerBuffer.begin(), writerBuffer.end(), 0.f);
+            std::copy(taps + first, taps + first + count, writerBuffer.begin());
+            stage->writerFft->performRealOnlyForwardTransform(writerBuffer.data(), true);
+            std::copy(writerBuffer.begin(), writerBuffer.begin() + spectrumSize, dst);
+
+            auto& used = set.numPartitions[static_cast<size_t> (stage->index)];
+            used = juce::jmax(used, p + 1);
+        }
+    }
+}
+
+void NonUniformConvolver::process(double* const* channels, int numchannels, int numSamples)
+{
+    numchannels = juce::jmin(numchannels, numChannels);
+
+    for (int pos = 0; pos < numSamples;)
+    {
+        const auto n = juce::jmin(numSamples - pos, partitionSize - fifoPos);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto fifo = static_cast<std::ptrdiff_t> (ch * partitionSize + fifoPos);
+
+            if (ch >= numchannels)
+            {
+                std::fill(inFifo.begin() + fifo, inFifo.begin() + fifo + n, 0.0);
+                continue;
+            }
+
+            std::copy(channels[ch] + pos, channels[ch] + pos + n, inFifo.begin() + fifo);
+            std::copy(outFifo.begin() + fifo, outFifo.begin() + fifo + n, channels[ch] + pos);
+        }
+
+        fifoPos += n;
+        pos += n;
+
+        if (fifoPos == partitionSize)
+        {
+            processBoundary();
+            fifoPos = 0;
+        }
+    }
+}
+
+void NonUniformConvolver::processBoundary()
+{
+    // the partition that just completed started at blockStart
+    const auto blockStart = time;
+    time += partitionSize;
+
+    // a new set waits for the previous fade, and its own fade starts where
+    // no queued job has decided for the old set yet
+    if (fadeFrom < 0)
+    {
+        const auto next = takePendingSet();
+
+        if (next >= 0)
+        {
+            if (activeSet >= 0)
+            {
+                fadeFrom = activeSet;
+                fadeStart = (time + 2 * fadeLength - 1) / fadeLength * fadeLength;
+            }
+
+            activeSet = next;
+        }
+    }
+
+    for (auto stage : stages)
+    {
+        const auto size = static_cast<juce::int64> (stage->size);
+        const auto block = blockStart / size;
+        const auto fill = static_cast<int> (blockStart % size);
+
+        if (! stage->inputBlocked)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto in = inFifo.data() + ch * partitionSize;
+                auto dst = stage->inputBlocks.data() + ((block % numJobSlots) * numChannels + ch) * size + fill;
+
+                for (int i = 0; i < partitionSize; ++i)
+                    dst[i] = static_cast<float> (in[i]);
+            }
+        }
+
+        if (time % size != 0)
+            continue;
+
+        if (! stage->inputBlocked)
+            postJob(*stage, block);
+
+        const auto due = time / size - stage->delayBlocks;
+        stage->outputReady = due >= 0 && collectJob(*stage, due);
+        stage->inputBlocked = ! claimSlot(*stage, time / size);
+    }
+
+    // the output of every stage for [time, time + partitionSize)
+    std::fill(outFifo.begin(), outFifo.end(), 0.0);
+
+    for (auto stage : stages)
+    {
+        if (! stage->outputReady)
+            continue;
+
+        const auto size = static_cast<juce::int64> (stage->size);
+        const auto block = time / size - stage->delayBlocks;
+        const auto offset = time % size;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto src = stage->outputBlocks.data() + ((block % numJobSlots) * numChannels + ch) * size + offset;
+            auto dst = outFifo.data() + ch * partitionSize;
+
+            for (int i = 0; i < partitionSize; ++i)
+                dst[i] += static_cast<double> (src[i]);
+        }
+    }
+
+    // late jobs may still read the old set after its fade
+    if (fadeFrom >= 0 && time >= fadeStart + fadeLength && ! isSetInUse(fadeFrom))
+    {
+        freeSet(fadeFrom);
+        fadeFrom = -1;
+    }
+}
+
+void NonUniformConvolver::postJob(Stage& stage, juce::int64 block)
+{
+    const auto size = static_cast<juce::int64> (stage.size);
+    const auto outputStart = (block + stage.delayBlocks) * size;
+    auto& job = stage.jobs[static_cast<size_t> (block % numJobSlots)];
+
+    job.block.store(block, std::memory_order_relaxed);
+    job.set = activeSet;
+    job.fadeFrom = -1;
+
+    if (fadeFrom >= 0 && outputStart + size <= fadeStart)
+        job.set = fadeFrom;
+    else if (fadeFrom >= 0 && outputStart < fadeStart + fadeLength)
+        job.fadeFrom = fadeFrom;
+
+    job.fadeOffset = outputStart - fadeStart;
+    job.state.store(jobQueued, std::memory_order_release);
+
+    if (stage.thread != nullptr)
+        stage.thread->wake();
+}
+
+bool NonUniformConvolver::collectJob(Stage& stage, juce::int64 block)
+{
+    auto& job = stage.jobs[static_cast<size_t> (block % numJobSlots)];
+
+    // not posted if its slot was still busy
+    if (job.block.load(std::memory_order_relaxed) == block && job.state.load(std::memory_order_acquire) != jobIdle)
+    {
+        if (stage.thread == nullptr)
+            runQueuedJobs(stage);
+
+        if (job.state.load(std::memory_order_acquire) == jobDone)
+            return true;
+    }
+
+    numLateJobs.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool NonUniformConvolver::claimSlot(Stage& stage, juce::int64 block)
+{
+    auto& job = stage.jobs[static_cast<size_t> (block % numJobSlots)];
+
+    // a job that is still queued a whole ring later is dropped, one that is
+    // running keeps its buffers and the block is skipped
+    auto expected = static_cast<int> (jobQueued);
+    job.state.compare_exchange_strong(expected, jobIdle, std::memory_order_acquire);
+
+    if (job.state.load(std::memory_order_acquire) == jobRunning)
+        return false;
+
+    job.state.store(jobIdle, std::memory_order_relaxed);
+    return true;
+}
+
+bool NonUniformConvolver::isSetInUse(int set) const
+{
+    for (auto stage : stages)
+    {
+        for (const auto& job : stage->jobs)
+        {
+            const auto state = job.state.load(std::memory_order_acquire);
+
+            if ((state == jobQueued || state == jobRunning) && (job.set == set || job.fadeFrom == set))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void NonUniformConvolver::cancelJobs(Stage& stage)
+{
+    // not realtime safe, waits for a running job
+    for (auto& job : stage.jobs)
+    {
+        auto expected = static_cast<int> (jobQueued);
+        job.state.compare_exchange_strong(expected, jobIdle, std::memory_order_acquire);
+
+        while (job.state.load(std::memory_order_acquire) == jobRunning)
+            juce::Thread::sleep(1);
+
+        job.block.store(-1, std::memory_order_relaxed);
+        job.state.store(jobIdle, std::memory_order_relaxed);
+    }
+}
+
+void NonUniformConvolver::runQueuedJobs(Stage& stage)
+{
+    // oldest first, each block's spectrum goes into the next partition slot
+    for (;;)
+    {
+        Job* next = nullptr;
+
+        for (auto& job : stage.jobs)
+            if (job.state.load(std::memory_order_acquire) == jobQueued
+                && (next == nullptr || job.block.load(std::memory_order_relaxed) < next->block.load(std::memory_order_relaxed)))
+                next = &job;
+
+        if (next == nullptr)
+            return;
+
+        auto expected = static_cast<int> (jobQueued);
+
+        if (next->state.compare_exchange_strong(expected, jobRunning, std::memory_order_acquire))
+        {
+            runJob(stage, *next);
+            next->state.store(jobDone, std::memory_order_release);
+        }
+    }
+}
+
+void NonUniformConvolver::runJob(Stage& stage, Job& job)
+{
+    const auto size = stage.size;
+    const auto spectrumSize = 2 * stage.numBins;
+    const auto slot = static_cast<int> (job.block.load(std::memory_order_relaxed) % numJobSlots);
+    stage.spectrumPos = stage.spectrumPos + 1 == stage.numPartitions ? 0 : stage.spectrumPos + 1;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        // the frame holds the previous block and the new one
+        auto frame = stage.frames.data() + ch * 2 * size;
+        const auto in = stage.inputBlocks.data() + (slot * numChannels + ch) * size;
+        std::copy(frame + size, frame + 2 * size, frame);
+        std::copy(in, in + size, frame + size);
+
+        std::copy(frame, frame + 2 * size, stage.fftBuffer.begin());
+        std::fill(stage.fftBuffer.begin() + 2 * size, stage.fftBuffer.end(), 0.f);
+        stage.fft->performRealOnlyForwardTransform(stage.fftBuffer.data(), true);
+        std::copy(stage.fftBuffer.begin(), stage.fftBuffer.begin() + spectrumSize,
+                  stage.spectra.begin() + (ch * stage.numPartitions + stage.spectrumPos) * spectrumSize);
+    }
+
+    for (int out = 0; out < numChannels; ++out)
+    {
+        auto dst = stage.outputBlocks.data() + (slot * numChannels + out) * size;
+
+        if (job.set < 0)
+        {
+            std::fill(dst, dst + size, 0.f);
+            continue;
+        }
+
+        convolveOutput(stage, sets[job.set], out, dst);
+
+        if (job.fadeFrom < 0)
+            continue;
+
+        convolveOutput(stage, sets[job.fadeFrom], out, stage.fadeBuffer.data());
+
+        for (int i = 0; i < size; ++i)
+        {
+            const auto t = juce::jlimit(0.f, 1.f, (static_cast<float> (job.fadeOffset + i) + 0.5f) / static_cast<float> (fadeLength));
+            dst[i] = stage.fadeBuffer[static_cast<size_t> (i)] + t * (dst[i] - stage.fadeBuffer[static_cast<size_t> (i)]);
+        }
+    }
+}
+
+void NonUniformConvolver::convolveOutput(Stage& stage, const KernelSet& set, int output, float* dst)
+{
+    const auto spectrumSize = 2 * stage.numBins;
+    const auto numPartitions = set.numPartitions[static_cast<size_t> (stage.index)];
+    std::fill(stage.fftBuffer.begin(), stage.fftBuffer.end(), 0.f);
+    auto acc = stage.fftBuffer.data();
+
+    for (const auto& path : set.paths)
+    {
+        if (path.output != output)
+            continue;
+
+        const auto inputSpectra = stage.spectra.data() + path.input * stage.numPartitions * spectrumSize;
+        const auto kernelSpectra = set.spectra.data() + stage.kernelOffset
+            + static_cast<size_t> (path.kernel * stage.numPartitions * spectrumSize);
+
+        for (int p = 0; p < numPartitions; ++p)
+        {
+            const auto pos = stage.spectrumPos - p < 0 ? stage.spectrumPos - p + stage.numPartitions : stage.spectrumPos - p;
+            const auto x = inputSpectra + pos * spectrumSize;
+            const auto h = kernelSpectra + p * spectrumSize;
+
+            for (int k = 0; k < spectrumSize; k += 2)
+            {
+                acc[k] += x[k] * h[k] - x[k + 1] * h[k + 1];
+                acc[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+            }
+        }
+    }
+
+    // overlap-save: the second half of the frame is free of wrap-around
+    stage.fft->performRealOnlyInverseTransform(acc);
+    std::copy(acc + stage.size, acc + 2 * stage.size, dst);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "PartitionedConvolver.h"
+
+// Non-uniformly partitioned overlap-save convolution for long kernels at low
+// latency. The head of the kernels runs on the audio thread in partitions of
+// partitionSize samples, which sets the latency. The rest is split into stages
+// of four times larger partitions, up to maxStageSize, and a stage of size N
+// starts at tap 2N - partitionSize: its job for a block is due one whole block
+// after the input is complete. Each stage runs on its own realtime thread,
+// which works through up to numJobSlots queued blocks in order. The audio
+// thread never waits for one: a block that isn't done at its deadline is left
+// out of the output and counted, and a slot whose job is still running when
+// its input is due again skips that block.
+//
+// A new kernel set fades in over one block of the largest stage, starting at
+// the first such block that no queued job has committed to yet.
+class NonUniformConvolver : public PartitionedConvolver
+{
+public:
+
+    static constexpr int maxStageSize = 8192;
+    static constexpr int numJobSlots = 4;
+
+    NonUniformConvolver();
+    ~NonUniformConvolver() override;
+
+    // Without background threads the audio thread runs every job at its
+    // deadline, which shows the total cost and never misses one. Takes effect
+    // at the next prepare().
+    void setUseBackgroundThreads(bool shouldUse);
+
+    void prepare(int numChannels, int partitionSize, int maxKernelLength, int maxKernels, int maxPaths) override;
+    void reset() override;
+
+    int getLatency() const override;
+    int getPartitionSize() const override;
+    size_t getMemoryBytes() const override;
+
+    void setKernel(int index, const float* taps, int numTaps) override;
+    void process(double* const* channels, int numChannels, int numSamples) override;
+
+    int getNumStages() const;
+    int getStageSize(int stage) const;
+    int getStageFirstTap(int stage) const;
+
+    int getNumLateJobs() const override;
+
+private:
+
+    class StageThread;
+
+    enum JobState
+    {
+        jobIdle,
+        jobQueued,
+        jobRunning,
+        jobDone
+    };
+
+    struct Job
+    {
+        // written by the audio thread before the job is queued
+        std::atomic<juce::int64> block { -1 };
+        int set = -1;
+        int fadeFrom = -1;
+        juce::int64 fadeOffset = 0;
+        std::atomic<int> state { jobIdle };
+    };
+
+    struct Stage
+    {
+        Stage();
+        ~Stage();
+
+        int index = 0;
+        int size = 0;
+        int firstTap = 0;
+        int numPartitions = 0;
+        int numBins = 0;
+        // blocks between the start of an input block and the output it is due for
+        int delayBlocks = 1;
+        // of this stage's [kernel][partition][bin re, im] in a kernel set
+        size_t kernelOffset = 0;
+
+        std::unique_ptr<juce::dsp::FFT> fft;
+        std::unique_ptr<juce::dsp::FFT> writerFft;
+
+        // [job slot][channel][sample] and [channel][partition][bin re, im]
+        std::vector<float> inputBlocks;
+        std::vector<float> frames;
+        std::vector<float> spectra;
+        std::vector<float> outputBlocks;
+        std::vector<float> fftBuffer;
+        std::vector<float> fadeBuffer;
+        int spectrumPos = 0;
+
+        // [block % numJobSlots]
+        std::array<Job, numJobSlots> jobs;
+
+        // audio thread: the output block read now is complete, the input
+        // block written now has no slot
+        bool outputReady = false;
+        bool inputBlocked = false;
+
+        std::unique_ptr<StageThread> thread;
+    };
+
+    void processBoundary();
+    void postJob(Stage& stage, juce::int64 block);
+    bool collectJob(Stage& stage, juce::int64 block);
+    bool claimSlot(Stage& stage, juce::int64 block);
+    bool isSetInUse(int set) const;
+    void cancelJobs(Stage& stage);
+    void runQueuedJobs(Stage& stage);
+    void runJob(Stage& stage, Job& job);
+    void convolveOutput(Stage& stage, const KernelSet& set, int output, float* dst);
+
+    bool useBackgroundThreads = true;
+    int numChannels = 0;
+    int partitionSize = 0;
+    int maxKernels = 0;
+    juce::OwnedArray<Stage> stages;
+    std::vector<float> writerBuffer;
+
+    // audio thread
+    std::vector<double> inFifo;
+    std::vector<double> outFifo;
+    int fifoPos = 0;
+    juce::int64 time = 0;
+    int activeSet = -1;
+    int fadeFrom = -1;
+    juce::int64 fadeStart = 0;
+    int fadeLength = 0;
+
+    std::atomic<int> numLateJobs { 0 };
+};
@@ -0,0 +1,813 @@
+#include "ParallelForm.h"
+#include "RealtimeSemaphore.h"
+
+namespace
+{
+    // numerator of a section over the same power of z as its denominator
+    std::complex<double> evaluateNumerator(const BiquadCoeffs& c, std::complex<double> z, bool firstOrder)
+    {
+        return firstOrder ? c.b0 * z + c.b1 : (c.b0 * z + c.b1) * z + c.b2;
+    }
+
+    bool isGain(const BiquadCoeffs& c)
+    {
+        return c.b1 == 0.0 && c.b2 == 0.0 && c.a1 == 0.0 && c.a2 == 0.0;
+    }
+
+    bool isFirstOrder(const BiquadCoeffs& c)
+    {
+        return c.b2 == 0.0 && c.a2 == 0.0;
+    }
+
+    bool isSame(const BiquadCoeffs& a, const BiquadCoeffs& b)
+    {
+        return a.b0 == b.b0 && a.b1 == b.b1 && a.b2 == b.b2 && a.a1 == b.a1 && a.a2 == b.a2;
+    }
+}
+
+ParallelForm::ParallelForm(int maxsections)
+    : maxSections(maxsections), maxPadded(laneWidth * ((maxsections + laneWidth - 1) / laneWidth)),
+    b0(static_cast<size_t> (maxPadded)), b1(static_cast<size_t> (maxPadded)), a1(static_cast<size_t> (maxPadded)),
+    a2(static_cast<size_t> (maxPadded)), impulse(static_cast<size_t> (numCheckSamples)), reference(static_cast<size_t> (numCheckSamples))
+{
+    poles.reserve(static_cast<size_t> (2 * maxsections));
+    setMaxChannels(2);
+}
+
+void ParallelForm::setMaxChannels(int numChannels)
+{
+    maxChannels = numChannels;
+    state.assign(static_cast<size_t> (numChannels * 2 * maxPadded), 0.0);
+}
+
+bool ParallelForm::design(const BiquadCoeffs* cascade, int numsections)
+{
+    jassert(numsections <= maxSections);
+    numSections = 0;
+    direct = 1.0;
+
+    if (numsections <= maxSections && expand(cascade, numsections) && matches(cascade, numsections))
+    {
+        numPadded = laneWidth * ((numSections + laneWidth - 1) / laneWidth);
+        return true;
+    }
+
+    numSections = 0;
+    numPadded = 0;
+    direct = 1.0;
+    return false;
+}
+
+bool ParallelForm::expand(const BiquadCoeffs* cascade, int numsections)
+{
+    poles.clear();
+    auto gain = 1.0;
+
+    for (int s = 0; s < numsections; ++s)
+    {
+        const auto& c = cascade[s];
+
+        if (isGain(c))
+        {
+            gain *= c.b0;
+            continue;
+        }
+
+        // a first order pole with a second order numerator or an FIR section
+        // leaves a polynomial part
+        if (c.a2 == 0.0 && (c.b2 != 0.0 || c.a1 == 0.0))
+            return false;
+
+        if (isFirstOrder(c))
+        {
+            poles.push_back({ -c.a1, 0.0, s });
+            continue;
+        }
+
+        const auto disc = c.a1 * c.a1 - 4.0 * c.a2;
+
+        if (disc < 0.0)
+        {
+            const auto im = 0.5 * std::sqrt(-disc);
+            poles.push_back({ { -0.5 * c.a1, im }, 0.0, s });
+            poles.push_back({ { -0.5 * c.a1, -im }, 0.0, s });
+        }
+        else
+        {
+            const auto root = -0.5 * (c.a1 + std::copysign(std::sqrt(disc), c.a1));
+            poles.push_back({ root, 0.0, s });
+            poles.push_back({ c.a2 / root, 0.0, s });
+        }
+    }
+
+    // H(z) = d + sum r / (1 - p z^-1), with r = N(p) / (p prod (p - q)) for
+    // the numerator N over the same power of z as the denominator
+    auto leading = gain;
+    auto residueSum = 0.0;
+    auto residueScale = 0.0;
+
+    for (int s = 0; s < numsections; ++s)
+        if (! isGain(cascade[s]))
+            leading *= cascade[s].b0;
+
+    for (auto& pole : poles)
+    {
+        if (std::abs(pole.p) < minPoleRadius)
+            return false;
+
+        auto num = std::complex<double>(gain);
+        auto den = pole.p;
+
+        for (int s = 0; s < numsections; ++s)
+            if (! isGain(cascade[s]))
+                num *= evaluateNumerator(cascade[s], pole.p, isFirstOrder(cascade[s]));
+
+        for (const auto& other : poles)
+            if (&other != &pole)
+                den *= pole.p - other.p;
+
+        pole.residue = num / den;
+        residueSum += pole.residue.real();
+        residueScale += std::abs(pole.residue);
+
+        if (! std::isfinite(residueScale))
+            return false;
+    }
+
+    direct = leading - residueSum;
+
+    // large residues cancel each other, their rounding noise wouldn't
+    if (residueScale > maxResidueScale * juce::jmax(1.0, std::abs(leading)))
+        return false;
+
+    // one section per section of the cascade, from its poles
+    numSections = 0;
+
+    for (size_t j = 0; j < poles.size(); ++j)
+    {
+        const auto& p = poles[j];
+
+        if (j + 1 < poles.size() && poles[j + 1].group == p.group)
+        {
+            const auto& q = poles[j + 1];
+            ++j;
+
+            if (p.p.imag() != 0.0)
+            {
+                addSection(2.0 * p.residue.real(), -2.0 * (p.residue * std::conj(p.p)).real(), -2.0 * p.p.real(), std::norm(p.p));
+            }
+            else
+            {
+                const auto rp = p.residue.real();
+                const auto rq = q.residue.real();
+                addSection(rp + rq, -(rp * q.p.real() + rq * p.p.real()), -(p.p.real() + q.p.real()), p.p.real() * q.p.real());
+            }
+        }
+        else
+        {
+            addSection(p.residue.real(), 0.0, -p.p.real(), 0.0);
+        }
+    }
+
+    for (int s = numSections; s < maxPadded; ++s)
+    {
+        b0[static_cast<size_t> (s)] = 0.0;
+        b1[static_cast<size_t> (s)] = 0.0;
+        a1[static_cast<size_t> (s)] = 0.0;
+        a2[static_cast<size_t> (s)] = 0.0;
+    }
+
+    return true;
+}
+
+void ParallelForm::addSection(double nb0, double nb1, double na1, double na2)
+{
+    const auto s = static_cast<size_t> (numSections++);
+    b0[s] = nb0;
+    b1[s] = nb1;
+    a1[s] = na1;
+    a2[s] = na2;
+}
+
+bool ParallelForm::matches(const BiquadCoeffs* cascade, int numsections)
+{
+    std::fill(reference.begin(), reference.end(), 0.0);
+    reference[0] = 1.0;
+
+    for (int s = 0; s < numsections; ++s)
+    {
+        const auto& c = cascade[s];
+        auto z1 = 0.0;
+        auto z2 = 0.0;
+
+        for (auto& x : reference)
+        {
+            const auto y = c.b0 * x + z1;
+            z1 = c.b1 * x - c.a1 * y + z2;
+            z2 = c.b2 * x - c.a2 * y;
+            x = y;
+        }
+    }
+
+    std::fill(impulse.begin(), impulse.end(), 0.0);
+    impulse[0] = direct;
+
+    for (int s = 0; s < numSections; ++s)
+    {
+        const auto i = static_cast<size_t> (s);
+        auto z1 = 0.0;
+        auto z2 = 0.0;
+
+        for (size_t n = 0; n < impulse.size(); ++n)
+        {
+            const auto x = n == 0 ? 1.0 : 0.0;
+            const auto y = b0[i] * x + z1;
+            z1 = b1[i] * x - a1[i] * y + z2;
+            z2 = -a2[i] * y;
+            impulse[n] += y;
+        }
+    }
+
+    auto peak = 0.0;
+    auto maxError = 0.0;
+
+    for (size_t n = 0; n < impulse.size(); ++n)
+    {
+        peak = juce::jmax(peak, std::abs(reference[n]));
+        maxError = juce::jmax(maxError, std::abs(impulse[n] - reference[n]));
+    }
+
+    return maxError <= maxRelativeError * peak;
+}
+
+void ParallelForm::reset()
+{
+    std::fill(state.begin(), state.end(), 0.0);
+}
+
+void ParallelForm::process(double* const* channels, int numChannels, int numSamples)
+{
+    numChannels = juce::jmin(numChannels, maxChannels);
+    alignas(32) double sum[tileSize][laneWidth];
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto data = channels[ch];
+        auto z = state.data() + ch * 2 * maxPadded;
+
+        for (int pos = 0; pos < numSamples; pos += tileSize)
+        {
+            const auto n = juce::jmin(tileSize, numSamples - pos);
+            std::fill(&sum[0][0], &sum[0][0] + tileSize * laneWidth, 0.0);
+
+            // laneWidth sections at a time, all on the same input
+            for (int first = 0; first < numPadded; first += laneWidth)
+            {
+                alignas(32) double cb0[laneWidth];
+                alignas(32) double cb1[laneWidth];
+                alignas(32) double ca1[laneWidth];
+                alignas(32) double ca2[laneWidth];
+                alignas(32) double z1[laneWidth];
+                alignas(32) double z2[laneWidth];
+
+                for (int l = 0; l < laneWidth; ++l)
+                {
+                    const auto s = static_cast<size_t> (first + l);
+                    cb0[l] = b0[s];
+                    cb1[l] = b1[s];
+                    ca1[l] = a1[s];
+                    ca2[l] = a2[s];
+                    z1[l] = z[first + l];
+                    z2[l] = z[maxPadded + first + l];
+                }
+
+                // transposed direct form II without b2
+                for (int i = 0; i < n; ++i)
+                {
+                    const auto in = data[pos + i];
+
+                    for (int l = 0; l < laneWidth; ++l)
+                    {
+                        const auto out = cb0[l] * in + z1[l];
+                        z1[l] = cb1[l] * in - ca1[l] * out + z2[l];
+                        z2[l] = -ca2[l] * out;
+                        sum[i][l] += out;
+                    }
+                }
+
+                for (int l = 0; l < laneWidth; ++l)
+                {
+                    z[first + l] = z1[l];
+                    z[maxPadded + first + l] = z2[l];
+                }
+            }
+
+            for (int i = 0; i < n; ++i)
+                data[pos + i] = direct * data[pos + i] + (sum[i][0] + sum[i][1]) + (sum[i][2] + sum[i][3]);
+        }
+    }
+}
+
+int ParallelForm::getNumSections() const
+{
+    return numSections;
+}
+
+size_t ParallelForm::getMemoryBytes() const
+{
+    return sizeof(ParallelForm) + (b0.capacity() + b1.capacity() + a1.capacity() + a2.capacity() + state.capacity()
+        + impulse.capacity() + reference.capacity()) * sizeof(double) + poles.capacity() * sizeof(Pole);
+}
+
+//==============================================================================
+class ParallelBandChain::DesignThread : public juce::Thread
+{
+public:
+
+    explicit DesignThread(ParallelBandChain& o)
+        : juce::Thread("AFEQ parallel form"), owner(o)
+    {
+    }
+
+    ~DesignThread() override
+    {
+        signalThreadShouldExit();
+        wake();
+        stopThread(1000);
+    }
+
+    void wake()
+    {
+        semaphore.post();
+    }
+
+    void run() override
+    {
+        for (;;)
+        {
+            semaphore.wait();
+
+            if (threadShouldExit())
+                return;
+
+            owner.convertPending();
+        }
+    }
+
+private:
+
+    ParallelBandChain& owner;
+    RealtimeSemaphore semaphore;
+};
+
+ParallelBandChain::ParallelBandChain(int numbands, int maxsections)
+    : numBands(numbands), maxSections(maxsections), gathered(static_cast<size_t> (numbands * maxsections)),
+    lastGathered(static_cast<size_t> (numbands * maxsections)),
+    posted(static_cast<size_t> (numbands * maxsections)), request(static_cast<size_t> (numbands * maxsections))
+{
+    // the playing form, the one fading in and the one being converted
+    for (int i = 0; i < numForms; ++i)
+        forms.add(std::make_unique<Form>(numbands * maxsections));
+
+    bandSections.reserve(static_cast<size_t> (maxsections));
+}
+
+ParallelBandChain::~ParallelBandChain()
+{
+    release();
+}
+
+void ParallelBandChain::prepare(double sampleRate, int blockSize, int numChannels)
+{
+    release();
+
+    maxChannels = juce::jmax(1, numChannels);
+
+    for (auto f : forms)
+    {
+        f->form.setMaxChannels(maxChannels);
+        f->state = Form::unused;
+    }
+
+    fadeLength = juce::jmax(1, juce::roundToInt(fadeSeconds * sampleRate));
+    fadeBuffer.setSize(maxChannels, blockSize);
+    historyLength = juce::jmax(1, juce::roundToInt(warmUpSeconds * sampleRate));
+    history.setSize(maxChannels, historyLength);
+    history.clear();
+    historyPos = 0;
+    historyFill = 0;
+    settleLength = juce::roundToInt(settleSeconds * sampleRate);
+    settledSamples = 0;
+    numLastGathered = -1;
+    currentPath = cascadePath;
+    nextPath = cascadePath;
+    warming = false;
+    fading = false;
+    numPosted = -1;
+    postedId = 0;
+    consumedId = 0;
+    requestState = idle;
+    result = 0;
+
+    thread = std::make_unique<DesignThread>(*this);
+    thread->startThread();
+}
+
+void ParallelBandChain::release()
+{
+    thread.reset();
+}
+
+void ParallelBandChain::reset()
+{
+    if (warming || fading)
+        releasePath(nextPath);
+
+    releasePath(currentPath);
+    currentPath = cascadePath;
+    nextPath = cascadePath;
+    warming = false;
+    fading = false;
+    history.clear();
+    historyPos = 0;
+    historyFill = 0;
+    settledSamples = 0;
+    numLastGathered = -1;
+
+    if (numPosted >= 0)
+    {
+        numPosted = -1;
+        ++postedId;
+    }
+}
+
+void ParallelBandChain::process(EqBandDspGroup& bands, double* const* channels, int numChannels, int numSamples)
+{
+    for (auto b : bands)
+        b->update();
+
+    const auto eligible = gather(bands);
+    const auto changed = takeChange();
+
+    // results still being converted are stale now
+    if ((! eligible || changed) && numPosted >= 0)
+    {
+        numPosted = -1;
+        ++postedId;
+    }
+
+    settledSamples = changed ? 0 : juce::jmin(settleLength, settledSamples + numSamples);
+
+    // a form that is warming up or fading in is stale as well
+    if ((! eligible || changed) && (warming || fading) && nextPath != cascadePath)
+    {
+        if (fading && currentPath == cascadePath)
+        {
+            // the bands kept running, the fade turns around
+            std::swap(currentPath, nextPath);
+            fadePos = fadeLength - fadePos;
+        }
+        else
+        {
+            releasePath(nextPath);
+            nextPath = cascadePath;
+            warming = false;
+            fading = false;
+        }
+    }
+
+    if (! warming && ! fading)
+    {
+        // the bands take new sections over as soon as they caught up, a form
+        // only once the sections settled
+        if (! eligible || changed)
+        {
+            if (currentPath != cascadePath)
+                beginWarmUp(cascadePath, bands);
+        }
+        else
+        {
+            const auto r = result.load(std::memory_order_acquire);
+            const auto id = r >> 8;
+
+            if (id == postedId && id != consumedId)
+            {
+                consumedId = id;
+                const auto index = static_cast<int> (r & 0xff) - 1;
+                auto expected = static_cast<int> (Form::ready);
+
+                if (index < 0)
+                {
+                    if (currentPath != cascadePath)
+                        beginWarmUp(cascadePath, bands);
+                }
+                else if (forms[index]->state.compare_exchange_strong(expected, Form::active))
+                {
+                    beginWarmUp(index, bands);
+                }
+            }
+        }
+    }
+
+    if (eligible && settledSamples >= settleLength && ! isPosted() && requestState.load(std::memory_order_acquire) == idle)
+        post();
+
+    if (warming)
+        continueWarmUp(bands, numChannels, numSamples);
+
+    pushHistory(channels, numChannels, numSamples);
+
+    if (! fading)
+    {
+        runPath(currentPath, bands, channels, numChannels, numSamples);
+        return;
+    }
+
+    jassert(numSamples <= fadeBuffer.getNumSamples());
+    const auto numFadeChannels = juce::jmin(numChannels, fadeBuffer.getNumChannels());
+
+    for (int ch = 0; ch < numFadeChannels; ++ch)
+        juce::FloatVectorOperations::copy(fadeBuffer.getWritePointer(ch), channels[ch], numSamples);
+
+    runPath(currentPath, bands, channels, numChannels, numSamples);
+    runPath(nextPath, bands, fadeBuffer.getArrayOfWritePointers(), numFadeChannels, numSamples);
+
+    // both paths run the same filter, a linear fade keeps the level
+    const auto numFade = juce::jlimit(0, numSamples, fadeLength - fadePos);
+
+    for (int ch = 0; ch < numFadeChannels; ++ch)
+    {
+        auto out = channels[ch];
+        const auto in = fadeBuffer.getReadPointer(ch);
+
+        for (int i = 0; i < numFade; ++i)
+        {
+            const auto g = (fadePos + i + 0.5) / fadeLength;
+            out[i] += g * (in[i] - out[i]);
+        }
+
+        for (int i = numFade; i < numSamples; ++i)
+            out[i] = in[i];
+    }
+
+    fadePos += numSamples;
+
+    if (fadePos >= fadeLength)
+    {
+        releasePath(currentPath);
+        currentPath = nextPath;
+        fading = false;
+    }
+}
+
+void ParallelBandChain::suspend(EqBandDspGroup& bands)
+{
+    if (warming || fading)
+        releasePath(nextPath);
+
+    // the bands' state is stale after the parallel form played, they only
+    // replay the last block of input here to keep this block's cost bounded
+    if (currentPath != cascadePath)
+    {
+        releasePath(currentPath);
+        resetPath(cascadePath, bands);
+        const auto numReplay = juce::jmin(historyFill, fadeBuffer.getNumSamples());
+        replayHistory(cascadePath, bands, maxChannels, numReplay, numReplay);
+    }
+
+    currentPath = cascadePath;
+    nextPath = cascadePath;
+    warming = false;
+    fading = false;
+
+    // the input of the suspended blocks doesn't reach the history
+    historyPos = 0;
+    historyFill = 0;
+
+    // converts the bands again once they run without the caller
+    if (numPosted >= 0)
+    {
+        numPosted = -1;
+        ++postedId;
+    }
+}
+
+bool ParallelBandChain::gather(EqBandDspGroup& bands)
+{
+    numGathered = 0;
+
+    for (auto b : bands)
+    {
+        const auto& params = b->getBandParamsConst();
+
+        if (! params.enabled)
+            continue;
+
+        // SVF bands keep their ramps under automation
+        if (params.routing != BandParams::routeStereo || (params.dynamic && BandParams::hasGain(params.type)) || b->isSvfActive())
+            return false;
+
+        if (! b->getSectionCoefficients(bandSections))
+            return false;
+
+        if (numGathered + static_cast<int> (bandSections.size()) > static_cast<int> (gathered.size()))
+            return false;
+
+        std::copy(bandSections.begin(), bandSections.end(), gathered.begin() + numGathered);
+        numGathered += static_cast<int> (bandSections.size());
+    }
+
+    return true;
+}
+
+bool ParallelBandChain::takeChange()
+{
+    auto changed = numGathered != numLastGathered;
+
+    for (size_t s = 0; s < static_cast<size_t> (numGathered) && ! changed; ++s)
+        changed = ! isSame(gathered[s], lastGathered[s]);
+
+    std::copy(gathered.begin(), gathered.begin() + numGathered, lastGathered.begin());
+    numLastGathered = numGathered;
+    return changed;
+}
+
+bool ParallelBandChain::isPosted() const
+{
+    if (numGathered != numPosted)
+        return false;
+
+    for (size_t s = 0; s < static_cast<size_t> (numGathered); ++s)
+        if (! isSame(gathered[s], posted[s]))
+            return false;
+
+    return true;
+}
+
+void ParallelBandChain::post()
+{
+    std::copy(gathered.begin(), gathered.begin() + numGathered, request.begin());
+    std::copy(gathered.begin(), gathered.begin() + numGathered, posted.begin());
+    requestNumSections = numGathered;
+    numPosted = numGathered;
+    requestId = ++postedId;
+    requestState.store(pending, std::memory_order_release);
+
+    if (thread != nullptr)
+        thread->wake();
+}
+
+void ParallelBandChain::convertPending()
+{
+    auto expected = static_cast<int> (pending);
+
+    if (! requestState.compare_exchange_strong(expected, converting, std::memory_order_acquire))
+        return;
+
+    // a form that is ready but wasn't picked up belongs to an older request
+    int index = -1;
+
+    for (int i = 0; i < forms.size() && index < 0; ++i)
+    {
+        auto state = forms[i]->state.load();
+
+        if ((state == Form::unused || state == Form::ready) && forms[i]->state.compare_exchange_strong(state, Form::building))
+            index = i;
+    }
+
+    jassert(index >= 0);
+    const auto ok = index >= 0 && forms[index]->form.design(request.data(), requestNumSections);
+
+    if (index >= 0)
+        forms[index]->state.store(ok ? Form::ready : Form::unused, std::memory_order_release);
+
+    if (! ok)
+        ++numFallbacks;
+
+    result.store((requestId << 8) | (ok ? index + 1 : 0), std::memory_order_release);
+    requestState.store(idle, std::memory_order_release);
+}
+
+void ParallelBandChain::beginWarmUp(int path, EqBandDspGroup& bands)
+{
+    // the path starts on the oldest input of the history and catches up over
+    // the next blocks, so it fades in with the state it would have had
+    resetPath(path, bands);
+    nextPath = path;
+    warmBehind = historyFill;
+    warming = true;
+}
+
+void ParallelBandChain::continueWarmUp(EqBandDspGroup& bands, int numChannels, int numSamples)
+{
+    // replays a few blocks' worth per callback, this block joins the history
+    // behind them unless the path caught up
+    const auto numReplay = juce::jmin(warmBehind, warmUpSpeed * numSamples);
+    replayHistory(nextPath, bands, numChannels, warmBehind, numReplay);
+    warmBehind -= numReplay;
+
+    if (warmBehind > 0)
+    {
+        warmBehind = juce::jmin(historyLength, warmBehind + numSamples);
+        return;
+    }
+
+    warming = false;
+    fading = true;
+    fadePos = 0;
+}
+
+void ParallelBandChain::resetPath(int path, EqBandDspGroup& bands)
+{
+    if (path == cascadePath)
+    {
+        for (auto b : bands)
+            b->reset();
+    }
+    else
+    {
+        forms[path]->form.reset();
+    }
+}
+
+void ParallelBandChain::replayHistory(int path, EqBandDspGroup& bands, int numChannels, int behind, int numReplay)
+{
+    // in blocks the bands were prepared for, through the fade buffer
+    const auto numReplayChannels = juce::jmin(numChannels, history.getNumChannels());
+    const auto blockSize = fadeBuffer.getNumSamples();
+
+    for (int pos = 0; pos < numReplay; pos += blockSize)
+    {
+        const auto n = juce::jmin(blockSize, numReplay - pos);
+        const auto start = (historyPos + historyLength - behind + pos) % historyLength;
+        const auto numFirst = juce::jmin(n, historyLength - start);
+
+        for (int ch = 0; ch < numReplayChannels; ++ch)
+        {
+            auto dest = fadeBuffer.getWritePointer(ch);
+            juce::FloatVectorOperations::copy(dest, history.getReadPointer(ch, start), numFirst);
+            juce::FloatVectorOperations::copy(dest + numFirst, history.getReadPointer(ch), n - numFirst);
+        }
+
+        runPath(path, bands, fadeBuffer.getArrayOfWritePointers(), numReplayChannels, n);
+    }
+}
+
+void ParallelBandChain::pushHistory(const double* const* channels, int numChannels, int numSamples)
+{
+    // only the last historyLength samples stay
+    const auto skip = juce::jmax(0, numSamples - historyLength);
+    const auto n = numSamples - skip;
+    const auto numFirst = juce::jmin(n, historyLength - historyPos);
+
+    for (int ch = 0; ch < juce::jmin(numChannels, history.getNumChannels()); ++ch)
+    {
+        juce::FloatVectorOperations::copy(history.getWritePointer(ch, historyPos), channels[ch] + skip, numFirst);
+        juce::FloatVectorOperations::copy(history.getWritePointer(ch), channels[ch] + skip + numFirst, n - numFirst);
+    }
+
+    historyPos = (historyPos + n) % historyLength;
+    historyFill = juce::jmin(historyLength, historyFill + n);
+}
+
+void ParallelBandChain::runPath(int path, EqBandDspGroup& bands, double* const* channels, int numChannels, int numSamples)
+{
+    if (path == cascadePath)
+    {
+        for (auto b : bands)
+            b->processDesigned(channels, numChannels, numSamples);
+    }
+    else
+    {
+        forms[path]->form.process(channels, numChannels, numSamples);
+    }
+}
+
+void ParallelBandChain::releasePath(int path)
+{
+    if (path != cascadePath)
+        forms[path]->state.store(Form::unused, std::memory_order_release);
+}
+
+bool ParallelBandChain::isParallel() const
+{
+    return currentPath != cascadePath;
+}
+
+int ParallelBandChain::getNumFallbacks() const
+{
+    return numFallbacks.load();
+}
+
+size_t ParallelBandChain::getMemoryBytes() const
+{
+    auto bytes = sizeof(ParallelBandChain) + (bandSections.capacity() + gathered.capacity() + lastGathered.capacity()
+        + posted.capacity() + request.capacity()) * sizeof(BiquadCoeffs)
+        + static_cast<size_t> (fadeBuffer.getNumChannels() * fadeBuffer.getNumSamples()
+            + history.getNumChannels() * history.getNumSamples()) * sizeof(double);
+
+    for (auto f : forms)
+        bytes += sizeof(Form) + f->form.getMemoryBytes();
+
+    return bytes;
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "EqBandDsp.h"
+
+#include <complex>
+
+// A biquad cascade rewritten as a direct gain plus a sum of second order
+// sections that all see the same input, from a partial fraction expansion
+// over the poles of the cascade's sections. The sections don't depend on
+// each other, so laneWidth of them run per vector instruction and are summed
+// at the end, where the cascade has to run one section after the other.
+class ParallelForm
+{
+public:
+
+    static constexpr int laneWidth = 4;
+
+    explicit ParallelForm(int maxsections);
+
+    // Allocates the filter state, not realtime safe.
+    void setMaxChannels(int numChannels);
+
+    // Expands the cascade, allocates. False if it has repeated poles, poles
+    // at the origin or sections that aren't first or second order, or if
+    // the expansion doesn't reproduce the cascade's impulse response to
+    // about 1e-8 of its peak; the form is invalid then.
+    bool design(const BiquadCoeffs* cascade, int numsections);
+    void reset();
+
+    void process(double* const* channels, int numChannels, int numSamples);
+
+    int getNumSections() const;
+    size_t getMemoryBytes() const;
+
+private:
+
+    bool expand(const BiquadCoeffs* cascade, int numsections);
+    bool matches(const BiquadCoeffs* cascade, int numsections);
+    void addSection(double nb0, double nb1, double na1, double na2);
+
+    static constexpr int tileSize = 64;
+    static constexpr int numCheckSamples = 2048;
+    static constexpr double minPoleRadius = 1e-6;
+    static constexpr double maxResidueScale = 1e8;
+    static constexpr double maxRelativeError = 1e-8;
+
+    int maxSections;
+    int maxPadded;
+    int numSections = 0;
+    int numPadded = 0;
+    int maxChannels = 0;
+    double direct = 0.0;
+
+    // maxPadded each, silent beyond numSections
+    std::vector<double> b0;
+    std::vector<double> b1;
+    std::vector<double> a1;
+    std::vector<double> a2;
+
+    // [channel][z1, z2][maxPadded]
+    std::vector<double> state;
+
+    // expansion scratch, one entry per pole
+    struct Pole
+    {
+        std::complex<double> p;
+        std::complex<double> residue;
+        int group;
+    };
+
+    std::vector<Pole> poles;
+    std::vector<double> impulse;
+    std::vector<double> reference;
+};
+
+// The inline band chain as one parallel form, while every enabled band runs
+// a static biquad cascade on all channels. While the bands' sections change
+// their own cascades play them; once the sections have settled a background
+// thread converts them and the form crossfades in. A path that fades in
+// first catches up on the recent input, a few blocks' worth per callback,
+// so it doesn't start from silence. Bands
+// that can't be converted (other routings, the dynamic mode, the SVF engine)
+// or an ill-conditioned expansion switch to the bands' own cascades.
+class ParallelBandChain
+{
+public:
+
+    ParallelBandChain(int numbands, int maxsections);
+    ~ParallelBandChain();
+
+    // Allocates and starts the conversion thread, not realtime safe.
+    void prepare(double sampleRate, int blockSize, int numChannels);
+    void release();
+
+    // Back to the bands' cascades with an empty history, for a prepare that
+    // keeps the chain. Not while process() runs.
+    void reset();
+
+    // Updates the bands and processes the block. Audio thread.
+    void process(EqBandDspGroup& bands, double* const* channels, int numChannels, int numSamples);
+
+    // Switches to the bands' cascades at once, for blocks in which another
+    // chain processes the bands. Audio thread.
+    void suspend(EqBandDspGroup& bands);
+
+    // Whether the parallel form plays, and expansions that fell back.
+    bool isParallel() const;
+    int getNumFallbacks() const;
+
+    size_t getMemoryBytes() const;
+
+private:
+
+    class DesignThread;
+
+    struct Form
+    {
+        enum State
+        {
+            unused,
+            building,
+            ready,
+            active
+        };
+
+        explicit Form(int maxsections) : form(maxsections) {}
+
+        ParallelForm form;
+        std::atomic<int> state { unused };
+    };
+
+    // no form for the bands' cascades
+    static constexpr int cascadePath = -1;
+    static constexpr int numForms = 3;
+    static constexpr double fadeSeconds = 0.01;
+    static constexpr double warmUpSeconds = 0.05;
+    static constexpr double settleSeconds = 0.05;
+    static constexpr int warmUpSpeed = 3;
+
+    bool gather(EqBandDspGroup& bands);
+    bool takeChange();
+    bool isPosted() const;
+    void post();
+    void convertPending();
+    void beginWarmUp(int path, EqBandDspGroup& bands);
+    void continueWarmUp(EqBandDspGroup& bands, int numChannels, int numSamples);
+    void resetPath(int path, EqBandDspGroup& bands);
+    void replayHistory(int path, EqBandDspGroup& bands, int numChannels, int behind, int numReplay);
+    void pushHistory(const double* const* channels, int numChannels, int numSamples);
+    void runPath(int path, EqBandDspGroup& bands, double* const* channels, int numChannels, int numSamples);
+    void releasePath(int path);
+
+    const int numBands;
+    const int maxSections;
+    int maxChannels = 0;
+    std::unique_ptr<DesignThread> thread;
+    juce::OwnedArray<Form> forms;
+
+    // audio thread: the sections of the enabled bands, the previous block's
+    // and the last ones posted
+    std::vector<BiquadCoeffs> bandSections;
+    std::vector<BiquadCoeffs> gathered;
+    std::vector<BiquadCoeffs> lastGathered;
+    std::vector<BiquadCoeffs> posted;
+    int numGathered = 0;
+    int numLastGathered = -1;
+    int numPosted = -1;
+    int settleLength = 0;
+    int settledSamples = 0;
+    juce::int64 postedId = 0;
+    juce::int64 consumedId = 0;
+
+    // written by the audio thread while idle, read by the thread while pending
+    enum RequestState
+    {
+        idle,
+        pending,
+        converting
+    };
+
+    std::vector<BiquadCoeffs> request;
+    int requestNumSections = 0;
+    juce::int64 requestId = 0;
+    std::atomic<int> requestState { idle };
+
+    // id << 8 | form index + 1, 0 in the low byte for a failed expansion
+    std::atomic<juce::int64> result { 0 };
+    std::atomic<int> numFallbacks { 0 };
+
+    int currentPath = cascadePath;
+    int nextPath = cascadePath;
+    int fadeLength = 1;
+    int fadePos = 0;
+    bool warming = false;
+    bool fading = false;
+    juce::AudioBuffer<double> fadeBuffer;
+
+    // the recent input, a ring of historyLength samples, and how far the
+    // path that warms up is behind the live input
+    juce::AudioBuffer<double> history;
+    int historyLength = 1;
+    int historyPos = 0;
+    int historyFill = 0;
+    int warmBehind = 0;
+};
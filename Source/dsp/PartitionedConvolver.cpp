@@ -0,0 +1,89 @@
+#include "PartitionedConvolver.h"
+
+void PartitionedConvolver::prepareKernelSets(size_t numFloats, int numSegments, int maxPaths)
+{
+    for (auto& set : sets)
+    {
+        set.spectra.assign(numFloats, 0.f);
+        set.paths.clear();
+        set.paths.reserve(static_cast<size_t> (maxPaths));
+        set.numPartitions.assign(static_cast<size_t> (numSegments), 0);
+        set.state.store(slotFree);
+    }
+
+    pendingSet.store(-1);
+    writingSet = -1;
+}
+
+size_t PartitionedConvolver::getKernelSetBytes() const
+{
+    auto bytes = static_cast<size_t> (0);
+
+    for (const auto& set : sets)
+        bytes += set.spectra.capacity() * sizeof(float) + set.paths.capacity() * sizeof(Path)
+            + set.numPartitions.capacity() * sizeof(int);
+
+    return bytes;
+}
+
+bool PartitionedConvolver::beginKernels()
+{
+    jassert(writingSet < 0);
+
+    for (int s = 0; s < 3; ++s)
+    {
+        auto expected = static_cast<int> (slotFree);
+
+        if (sets[s].state.compare_exchange_strong(expected, slotWriting, std::memory_order_acquire))
+        {
+            writingSet = s;
+            std::fill(sets[s].numPartitions.begin(), sets[s].numPartitions.end(), 0);
+            sets[s].paths.clear();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+PartitionedConvolver::KernelSet& PartitionedConvolver::getWritingSet()
+{
+    jassert(writingSet >= 0);
+    return sets[writingSet];
+}
+
+void PartitionedConvolver::setPaths(const std::vector<Path>& paths)
+{
+    auto& set = getWritingSet();
+    jassert(paths.size() <= set.paths.capacity());
+    set.paths = paths;
+}
+
+void PartitionedConvolver::publishKernels()
+{
+    jassert(writingSet >= 0);
+    sets[writingSet].state.store(slotPending, std::memory_order_release);
+
+    // a set the audio thread never picked up is free again
+    const auto previous = pendingSet.exchange(writingSet, std::memory_order_acq_rel);
+
+    if (previous >= 0)
+        sets[previous].state.store(slotFree, std::memory_order_release);
+
+    writingSet = -1;
+}
+
+int PartitionedConvolver::takePendingSet()
+{
+    const auto next = pendingSet.exchange(-1, std::memory_order_acq_rel);
+
+    if (next >= 0)
+        sets[next].state.store(slotActive, std::memory_order_relaxed);
+
+    return next;
+}
+
+void PartitionedConvolver::freeSet(int index)
+{
+    sets[index].state.store(slotFree, std::memory_order_release);
+}
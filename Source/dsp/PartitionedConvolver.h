@@ -0,0 +1,83 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+// Common interface of the partitioned FFT convolution engines, so FIR modes
+// can pick one by their latency and CPU needs. Paths route an input channel
+// through a kernel into an output channel, outputs sum their paths, so a 2x2
+// mid/side matrix costs four paths.
+//
+// Kernel sets are written on another thread into one of three slots and taken
+// over by the audio thread later, crossfading from the previous set. Neither
+// side waits for the other: a writer that finds no free slot tries again later.
+class PartitionedConvolver
+{
+public:
+
+    struct Path
+    {
+        int input = 0;
+        int output = 0;
+        int kernel = 0;
+    };
+
+    virtual ~PartitionedConvolver() = default;
+
+    // Allocates, not realtime safe. Kernels are limited to maxKernelLength
+    // taps, partitionSize is the first (or only) partition and the latency.
+    virtual void prepare(int numChannels, int partitionSize, int maxKernelLength, int maxKernels, int maxPaths) = 0;
+    virtual void reset() = 0;
+
+    virtual int getLatency() const = 0;
+    virtual int getPartitionSize() const = 0;
+    virtual size_t getMemoryBytes() const = 0;
+
+    // Blocks a background thread didn't finish in time, left out of the output.
+    virtual int getNumLateJobs() const { return 0; }
+
+    // Writer side, one thread at a time. beginKernels() claims a free slot and
+    // returns false if there is none, the other calls fill it.
+    bool beginKernels();
+    virtual void setKernel(int index, const float* taps, int numTaps) = 0;
+    void setPaths(const std::vector<Path>& paths);
+    void publishKernels();
+
+    // Audio thread, in place.
+    virtual void process(double* const* channels, int numChannels, int numSamples) = 0;
+
+protected:
+
+    enum SlotState
+    {
+        slotFree,
+        slotWriting,
+        slotPending,
+        slotActive
+    };
+
+    struct KernelSet
+    {
+        std::vector<float> spectra;
+        std::vector<Path> paths;
+        // used partitions per kernel layout segment, partitions beyond are zero
+        std::vector<int> numPartitions;
+        std::atomic<int> state { slotFree };
+    };
+
+    // Sizes and frees all slots, not realtime safe.
+    void prepareKernelSets(size_t numFloats, int numSegments, int maxPaths);
+    size_t getKernelSetBytes() const;
+
+    KernelSet& getWritingSet();
+
+    // Audio thread: the published set or -1, now marked active.
+    int takePendingSet();
+    void freeSet(int index);
+
+    KernelSet sets[3];
+
+private:
+
+    std::atomic<int> pendingSet { -1 };
+    int writingSet = -1;
+};
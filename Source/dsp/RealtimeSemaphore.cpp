@@ -0,0 +1,49 @@
+#include "RealtimeSemaphore.h"
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <cerrno>
+ #include <semaphore.h>
+#endif
+
+struct RealtimeSemaphore::Impl
+{
+   #if JUCE_WINDOWS
+    Impl() : handle(CreateSemaphore(nullptr, 0, LONG_MAX, nullptr)) {}
+    ~Impl() { CloseHandle(handle); }
+    void post() { ReleaseSemaphore(handle, 1, nullptr); }
+    void wait() { WaitForSingleObject(handle, INFINITE); }
+
+    HANDLE handle;
+   #elif JUCE_MAC || JUCE_IOS
+    Impl() : sem(dispatch_semaphore_create(0)) {}
+    ~Impl() { dispatch_release(sem); }
+    void post() { dispatch_semaphore_signal(sem); }
+    void wait() { dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER); }
+
+    dispatch_semaphore_t sem;
+   #else
+    Impl() { sem_init(&sem, 0, 0); }
+    ~Impl() { sem_destroy(&sem); }
+    void post() { sem_post(&sem); }
+    void wait() { while (sem_wait(&sem) != 0 && errno == EINTR) {} }
+
+    sem_t sem;
+   #endif
+};
+
+RealtimeSemaphore::RealtimeSemaphore() : impl(std::make_unique<Impl>()) {}
+RealtimeSemaphore::~RealtimeSemaphore() = default;
+
+void RealtimeSemaphore::post()
+{
+    impl->post();
+}
+
+void RealtimeSemaphore::wait()
+{
+    impl->wait();
+}
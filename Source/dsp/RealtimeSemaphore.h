@@ -0,0 +1,23 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+// Counting semaphore whose post() doesn't take a lock on any of the platforms,
+// unlike juce::WaitableEvent, so the audio thread can wake other threads.
+class RealtimeSemaphore
+{
+public:
+
+    RealtimeSemaphore();
+    ~RealtimeSemaphore();
+
+    void post();
+    void wait();
+
+private:
+
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+    JUCE_DECLARE_NON_COPYABLE(RealtimeSemaphore)
+};
@@ -0,0 +1,103 @@
+#include "RealtimeWorkerPool.h"
+#include "RealtimeSemaphore.h"
+
+class RealtimeWorkerPool::Worker : public juce::Thread
+{
+public:
+
+    Worker(RealtimeWorkerPool& p, int index)
+        : juce::Thread("AFEQ worker " + juce::String(index)), pool(p)
+    {
+    }
+
+    ~Worker() override
+    {
+        signalThreadShouldExit();
+        wake();
+        stopThread(1000);
+    }
+
+    void wake()
+    {
+        semaphore.post();
+    }
+
+    void run() override
+    {
+        for (;;)
+        {
+            semaphore.wait();
+
+            if (threadShouldExit())
+                return;
+
+            juce::ScopedNoDenormals noDenormals;
+            pool.runTasks();
+        }
+    }
+
+private:
+
+    RealtimeWorkerPool& pool;
+    RealtimeSemaphore semaphore;
+};
+
+RealtimeWorkerPool::RealtimeWorkerPool(int numworkers, int numtasks, Task taskfn)
+    : task(std::move(taskfn)), numTasks(numtasks)
+{
+    for (int i = 0; i < numworkers; ++i)
+        workers.add(std::make_unique<Worker>(*this, i))->startRealtimeThread(juce::Thread::RealtimeOptions());
+}
+
+RealtimeWorkerPool::~RealtimeWorkerPool()
+{
+    workers.clear();
+}
+
+int RealtimeWorkerPool::getNumWorkers() const
+{
+    return workers.size();
+}
+
+bool RealtimeWorkerPool::run(double maxWaitSeconds)
+{
+    // A worker woken for the previous block may still be looking for work. It
+    // can't claim anything until nextTask is reset, and what it claims after
+    // that belongs to this block.
+    numDone.store(0, std::memory_order_relaxed);
+    nextTask.store(0, std::memory_order_release);
+
+    for (int i = 0; i < juce::jmin(workers.size(), numTasks - 1); ++i)
+        workers.getUnchecked(i)->wake();
+
+    runTasks();
+
+    if (numDone.load(std::memory_order_acquire) == numTasks)
+        return true;
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    const auto maxWaitTicks = juce::Time::secondsToHighResolutionTicks(maxWaitSeconds);
+    auto inTime = true;
+
+    while (numDone.load(std::memory_order_acquire) < numTasks)
+    {
+        inTime = inTime && juce::Time::getHighResolutionTicks() - startTicks <= maxWaitTicks;
+        juce::Thread::yield();
+    }
+
+    return inTime;
+}
+
+void RealtimeWorkerPool::runTasks()
+{
+    for (;;)
+    {
+        const auto index = nextTask.fetch_add(1, std::memory_order_acq_rel);
+
+        if (index >= numTasks)
+            return;
+
+        task(index);
+        numDone.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+// Fork/join of a fixed set of tasks per audio block on worker threads that are
+// started in advance. run() wakes the workers through semaphores and claims
+// tasks from the same atomic counter as they do, so a task no worker picked up
+// in time runs on the calling thread. The calling thread neither allocates nor
+// locks; it only has to wait for tasks a worker already started.
+class RealtimeWorkerPool
+{
+public:
+
+    using Task = std::function<void(int taskIndex)>;
+
+    // Allocates and starts the threads, not realtime safe.
+    RealtimeWorkerPool(int numworkers, int numtasks, Task taskfn);
+    ~RealtimeWorkerPool();
+
+    int getNumWorkers() const;
+
+    // Runs the tasks [0, numTasks) and returns when all have finished. Returns
+    // false if it had to wait longer than maxWaitSeconds for the workers after
+    // running out of tasks itself.
+    bool run(double maxWaitSeconds);
+
+private:
+
+    class Worker;
+
+    void runTasks();
+
+    Task task;
+    const int numTasks;
+    std::atomic<int> nextTask { 0 };
+    std::atomic<int> numDone { 0 };
+    juce::OwnedArray<Worker> workers;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Process-wide registry for read-only tables that are identical across plugin
+// instances (analyser plans, FFT twiddles, response grids). Entries are
+// reference counted and released together with their last user.
+template <typename Key, typename Table>
+class SharedTableRegistry
+{
+public:
+
+    template <typename Factory>
+    std::shared_ptr<const Table> get(const Key& key, Factory&& create)
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+
+        for (auto it = tables.begin(); it != tables.end();)
+            it = it->second.expired() && it->first != key ? tables.erase(it) : std::next(it);
+
+        auto& entry = tables[key];
+        if (auto existing = entry.lock())
+            return existing;
+
+        std::shared_ptr<const Table> created(create());
+        entry = created;
+        return created;
+    }
+
+    size_t getNumTables() const
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        return static_cast<size_t> (std::count_if(tables.begin(), tables.end(),
+            [](const auto& t) { return ! t.second.expired(); }));
+    }
+
+private:
+
+    mutable std::mutex lock;
+    std::map<Key, std::weak_ptr<const Table>> tables;
+};
+
+// Share of a table's bytes that is attributed to each of its current users.
+template <typename Table>
+size_t getSharedBytesPerUser(const std::shared_ptr<const Table>& table, size_t tableBytes)
+{
+    if (table == nullptr)
+        return 0;
+
+    return tableBytes / static_cast<size_t> (std::max(1L, static_cast<long> (table.use_count())));
+}
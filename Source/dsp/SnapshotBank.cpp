@@ -0,0 +1,278 @@
+#include "SnapshotBank.h"
+
+class SnapshotBank::DesignThread : public juce::Thread
+{
+public:
+
+    explicit DesignThread(SnapshotBank& o)
+        : juce::Thread("AFEQ snapshots"), owner(o)
+    {
+    }
+
+    ~DesignThread() override
+    {
+        stopThread(1000);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            owner.designPending();
+            wait(20);
+        }
+    }
+
+private:
+
+    SnapshotBank& owner;
+};
+
+SnapshotBank::SnapshotBank(int numbands, int maxorder, const FreqResponseBase& freqresbase)
+    : numBands(numbands), maxOrder(maxorder), freqResBase(freqresbase)
+{
+    for (int s = 0; s < numSlots; ++s)
+        slots.add(std::make_unique<Slot>());
+}
+
+SnapshotBank::~SnapshotBank()
+{
+    release();
+}
+
+void SnapshotBank::prepare(double sampleRate, int blockSize, const juce::AudioChannelSet& layout, bool svfForced)
+{
+    release();
+
+    {
+        const juce::ScopedLock sl(lock);
+        preparedSampleRate = sampleRate;
+        preparedBlockSize = blockSize;
+        preparedLayout = layout;
+        preparedSvfForced = svfForced;
+
+        for (auto slot : slots)
+        {
+            prepareBands(*slot);
+            slot->state = slot->values.empty() ? Slot::empty : Slot::designing;
+            slot->dirty = ! slot->values.empty();
+        }
+    }
+
+    const auto fadeLength = juce::jmax(1, juce::roundToInt(fadeSeconds * sampleRate));
+    fadeIn.resize(static_cast<size_t> (fadeLength));
+    fadeOut.resize(static_cast<size_t> (fadeLength));
+
+    for (int i = 0; i < fadeLength; ++i)
+    {
+        const auto phase = juce::MathConstants<double>::halfPi * (i + 0.5) / fadeLength;
+        fadeIn[static_cast<size_t> (i)] = static_cast<float> (std::sin(phase));
+        fadeOut[static_cast<size_t> (i)] = static_cast<float> (std::cos(phase));
+    }
+
+    fadeBuffer.setSize(juce::jmax(2, layout.size()), blockSize);
+    requestedSlot = -1;
+    activeSlot = -1;
+
+    thread = std::make_unique<DesignThread>(*this);
+    thread->startThread();
+}
+
+void SnapshotBank::release()
+{
+    thread.reset();
+}
+
+void SnapshotBank::store(int slot, const std::vector<BandValues>& values)
+{
+    if (! juce::isPositiveAndBelow(slot, numSlots))
+        return;
+
+    {
+        const juce::ScopedLock sl(lock);
+        slots[slot]->values = values;
+        slots[slot]->dirty = true;
+    }
+
+    if (thread != nullptr)
+        thread->notify();
+}
+
+bool SnapshotBank::isStored(int slot) const
+{
+    const juce::ScopedLock sl(lock);
+    return juce::isPositiveAndBelow(slot, numSlots) && ! slots[slot]->values.empty();
+}
+
+bool SnapshotBank::isReady(int slot) const
+{
+    return juce::isPositiveAndBelow(slot, numSlots) && ! slots[slot]->dirty && slots[slot]->state == Slot::ready;
+}
+
+std::vector<BandValues> SnapshotBank::getValues(int slot) const
+{
+    const juce::ScopedLock sl(lock);
+    return juce::isPositiveAndBelow(slot, numSlots) ? slots[slot]->values : std::vector<BandValues>();
+}
+
+bool SnapshotBank::requestSwitch(int slot)
+{
+    if (! isReady(slot))
+        return false;
+
+    requestedSlot.store(slot, std::memory_order_release);
+    return true;
+}
+
+void SnapshotBank::designPending()
+{
+    for (auto slot : slots)
+    {
+        if (! slot->dirty)
+            continue;
+
+        const juce::ScopedLock sl(lock);
+        auto expected = slot->state.load();
+
+        // a slot the audio thread plays is designed once it's done
+        if (expected == Slot::playing || ! slot->state.compare_exchange_strong(expected, Slot::designing))
+            continue;
+
+        slot->dirty = false;
+
+        if (slot->values.empty())
+        {
+            slot->state = Slot::empty;
+            continue;
+        }
+
+        if (slot->bands.isEmpty())
+        {
+            for (int i = 0; i < numBands; ++i)
+                slot->bands.add(std::make_unique<EqBandDsp>(maxOrder, freqResBase, i + 1));
+
+            prepareBands(*slot);
+        }
+
+        const auto num = juce::jmin(slot->bands.size(), static_cast<int> (slot->values.size()));
+
+        for (int i = 0; i < num; ++i)
+            slot->bands[i]->setValues(slot->values[static_cast<size_t> (i)]);
+
+        for (int i = num; i < slot->bands.size(); ++i)
+            slot->bands[i]->setValues(BandValues());
+
+        slot->state = Slot::ready;
+    }
+}
+
+void SnapshotBank::prepareBands(Slot& slot)
+{
+    for (auto b : slot.bands)
+    {
+        b->setBlockSize(preparedBlockSize);
+        b->setSampleRate(preparedSampleRate);
+        b->setChannelLayout(preparedLayout);
+        b->setSvfForced(preparedSvfForced);
+    }
+}
+
+bool SnapshotBank::process(EqBandDspGroup& live, double* const* channels, int numChannels, int numSamples)
+{
+    if (activeSlot < 0)
+    {
+        const auto requested = requestedSlot.exchange(-1, std::memory_order_acquire);
+
+        if (requested < 0)
+            return false;
+
+        auto expected = static_cast<int> (Slot::ready);
+
+        if (! slots[requested]->state.compare_exchange_strong(expected, Slot::playing))
+            return false;
+
+        activeSlot = requested;
+        fadePos = 0;
+
+        // the stored chain fades in from the live filters' state
+        const auto& bands = slots[activeSlot]->bands;
+
+        for (int i = 0; i < bands.size(); ++i)
+        {
+            if (i < live.size())
+                bands[i]->copyStateFrom(*live[i]);
+            else
+                bands[i]->reset();
+        }
+    }
+
+    jassert(numSamples <= fadeBuffer.getNumSamples());
+    auto& slot = *slots[activeSlot];
+    const auto numFadeChannels = juce::jmin(numChannels, fadeBuffer.getNumChannels());
+
+    for (int ch = 0; ch < numFadeChannels; ++ch)
+        juce::FloatVectorOperations::copy(fadeBuffer.getWritePointer(ch), channels[ch], numSamples);
+
+    // the live bands keep their design until the handover
+    for (auto b : live)
+        b->processDesigned(channels, numChannels, numSamples);
+
+    for (auto b : slot.bands)
+        b->processDesigned(fadeBuffer.getArrayOfWritePointers(), numFadeChannels, numSamples);
+
+    const auto fadeLength = static_cast<int> (fadeIn.size());
+    const auto numFade = juce::jlimit(0, numSamples, fadeLength - fadePos);
+
+    for (int ch = 0; ch < numFadeChannels; ++ch)
+    {
+        auto out = channels[ch];
+        const auto in = fadeBuffer.getReadPointer(ch);
+
+        for (int i = 0; i < numFade; ++i)
+            out[i] = out[i] * fadeOut[static_cast<size_t> (fadePos + i)] + in[i] * fadeIn[static_cast<size_t> (fadePos + i)];
+
+        for (int i = numFade; i < numSamples; ++i)
+            out[i] = in[i];
+    }
+
+    fadePos += numSamples;
+
+    if (fadePos >= fadeLength)
+    {
+        const auto num = juce::jmin(live.size(), slot.bands.size());
+
+        for (int i = 0; i < num; ++i)
+            live[i]->adoptDesign(*slot.bands[i]);
+
+        slot.state.store(Slot::ready, std::memory_order_release);
+        activeSlot = -1;
+    }
+
+    return true;
+}
+
+bool SnapshotBank::isSwitching() const
+{
+    return activeSlot >= 0 || requestedSlot.load(std::memory_order_acquire) >= 0;
+}
+
+int SnapshotBank::getFadeLength() const
+{
+    return static_cast<int> (fadeIn.size());
+}
+
+size_t SnapshotBank::getMemoryBytes() const
+{
+    auto bytes = sizeof(SnapshotBank) + (fadeIn.capacity() + fadeOut.capacity()) * sizeof(float)
+        + static_cast<size_t> (fadeBuffer.getNumChannels() * fadeBuffer.getNumSamples()) * sizeof(double);
+
+    for (auto slot : slots)
+    {
+        bytes += sizeof(Slot) + slot->values.capacity() * sizeof(BandValues);
+
+        for (auto b : slot->bands)
+            bytes += b->getMemoryBytes();
+    }
+
+    return bytes;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "EqBandDsp.h"
+
+// Stored band tables whose filters are designed on a background thread, so
+// recalling one switches the audio without any design work: the audio thread
+// crossfades from the live bands to the stored chain with equal power gains,
+// then hands the stored designs and filter states over to the live bands,
+// which continue from there. The stored chain starts from the live bands'
+// filter state, so it fades in without a transient of its own.
+class SnapshotBank
+{
+public:
+
+    static constexpr int numSlots = 4;
+
+    SnapshotBank(int numbands, int maxorder, const FreqResponseBase& freqresbase);
+    ~SnapshotBank();
+
+    // Allocates, redesigns the stored slots and starts the design thread.
+    // Not realtime safe, the freqresbase grid must not change until release.
+    // svfForced is passed on to the bands, see EqBandDsp::setSvfForced.
+    void prepare(double sampleRate, int blockSize, const juce::AudioChannelSet& layout, bool svfForced = false);
+    void release();
+
+    // Stores the values, they are designed in the background.
+    void store(int slot, const std::vector<BandValues>& values);
+    bool isStored(int slot) const;
+    bool isReady(int slot) const;
+    std::vector<BandValues> getValues(int slot) const;
+
+    // Asks the audio thread to switch to the slot in its next block. False if
+    // the design isn't ready, the live bands then design as for any edit.
+    bool requestSwitch(int slot);
+
+    // Processes the block while a switch runs and returns true, otherwise
+    // returns false and leaves the block to the live bands. Audio thread.
+    bool process(EqBandDspGroup& live, double* const* channels, int numChannels, int numSamples);
+
+    // Whether a switch runs or was requested, process then uses the live
+    // bands' filter state. Audio thread.
+    bool isSwitching() const;
+
+    int getFadeLength() const;
+    size_t getMemoryBytes() const;
+
+private:
+
+    class DesignThread;
+
+    struct Slot
+    {
+        enum State
+        {
+            empty,
+            designing,
+            ready,
+            playing
+        };
+
+        std::vector<BandValues> values;
+        EqBandDspGroup bands;   // created with the first design
+        std::atomic<int> state { empty };
+        std::atomic<bool> dirty { false };
+    };
+
+    void designPending();
+    void prepareBands(Slot& slot);
+
+    static constexpr double fadeSeconds = 0.01;
+    const int numBands;
+    const int maxOrder;
+    const FreqResponseBase& freqResBase;
+    double preparedSampleRate = 0.0;
+    int preparedBlockSize = 0;
+    juce::AudioChannelSet preparedLayout;
+    bool preparedSvfForced = false;
+    juce::OwnedArray<Slot> slots;
+    juce::CriticalSection lock;
+    std::unique_ptr<DesignThread> thread;
+
+    juce::AudioBuffer<double> fadeBuffer;
+    std::vector<float> fadeIn;
+    std::vector<float> fadeOut;
+    std::atomic<int> requestedSlot { -1 };
+    int activeSlot = -1;
+    int fadePos = 0;
+};
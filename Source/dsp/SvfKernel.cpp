@@ -0,0 +1,290 @@
+#include "SvfKernel.h"
+
+namespace
+{
+    double prewarp(double freq, double sampleRate)
+    {
+        return std::tan(juce::MathConstants<double>::pi * juce::jlimit(1.0, 0.49 * sampleRate, freq) / sampleRate);
+    }
+
+    SvfCoeffs make(double g, double k, double m0, double m1, double m2, bool firstOrder = false)
+    {
+        SvfCoeffs c;
+        c.g = g;
+        c.k = k;
+        c.m0 = m0;
+        c.m1 = m1;
+        c.m2 = m2;
+        c.firstOrder = firstOrder;
+        return c;
+    }
+}
+
+SvfCoeffs SvfCoeffs::lowPass(double freq, double k, double sampleRate)
+{
+    return make(prewarp(freq, sampleRate), k, 0.0, 0.0, 1.0);
+}
+
+SvfCoeffs SvfCoeffs::highPass(double freq, double k, double sampleRate)
+{
+    return make(prewarp(freq, sampleRate), k, 1.0, -k, -1.0);
+}
+
+SvfCoeffs SvfCoeffs::bell(double freq, double k, double gain, double sampleRate)
+{
+    const auto a = std::sqrt(gain);
+    const auto ka = k / a;
+    return make(prewarp(freq, sampleRate), ka, 1.0, ka * (gain - 1.0), 0.0);
+}
+
+SvfCoeffs SvfCoeffs::lowShelf(double freq, double k, double gain, double sampleRate)
+{
+    const auto a = std::sqrt(gain);
+    return make(prewarp(freq / std::sqrt(a), sampleRate), k, 1.0, k * (a - 1.0), gain - 1.0);
+}
+
+SvfCoeffs SvfCoeffs::highShelf(double freq, double k, double gain, double sampleRate)
+{
+    const auto a = std::sqrt(gain);
+    return make(prewarp(freq * std::sqrt(a), sampleRate), k, gain, k * (1.0 - a) * a, 1.0 - gain);
+}
+
+SvfCoeffs SvfCoeffs::lowPass1(double freq, double sampleRate)
+{
+    return make(prewarp(freq, sampleRate), 0.0, 0.0, 0.0, 1.0, true);
+}
+
+SvfCoeffs SvfCoeffs::highPass1(double freq, double sampleRate)
+{
+    return make(prewarp(freq, sampleRate), 0.0, 1.0, 0.0, -1.0, true);
+}
+
+SvfCoeffs SvfCoeffs::lowShelf1(double freq, double gain, double sampleRate)
+{
+    return make(prewarp(freq / std::sqrt(gain), sampleRate), 0.0, 1.0, 0.0, gain - 1.0, true);
+}
+
+SvfCoeffs SvfCoeffs::highShelf1(double freq, double gain, double sampleRate)
+{
+    return make(prewarp(freq * std::sqrt(gain), sampleRate), 0.0, gain, 0.0, 1.0 - gain, true);
+}
+
+double SvfCoeffs::getButterworthDamping(int pair, int order)
+{
+    return 2.0 * std::sin((2 * pair - 1) * juce::MathConstants<double>::pi / (2.0 * order));
+}
+
+SvfCascade::SvfCascade(int maxsections)
+    : maxSections(maxsections), current(static_cast<size_t> (maxsections)), target(static_cast<size_t> (maxsections))
+{
+    setMaxChannels(2);
+}
+
+void SvfCascade::setMaxChannels(int numChannels)
+{
+    maxChannels = numChannels;
+    state.assign(static_cast<size_t> (numChannels * maxSections * 2), 0.0);
+}
+
+BiquadCoeffs SvfCoeffs::toBiquad() const
+{
+    BiquadCoeffs c;
+
+    // lp = g (1 + z^-1) / ((1 + g) + (g - 1) z^-1)
+    if (firstOrder)
+    {
+        const auto d0 = 1.0 + g;
+        c.b0 = (m0 * d0 + m2 * g) / d0;
+        c.b1 = (m0 * (g - 1.0) + m2 * g) / d0;
+        c.a1 = (g - 1.0) / d0;
+        return c;
+    }
+
+    // bp = g (1 - z^-2) / d, lp = g^2 (1 + z^-1)^2 / d
+    const auto g2 = g * g;
+    const auto d0 = 1.0 + g * k + g2;
+    const auto d1 = 2.0 * (g2 - 1.0);
+    const auto d2 = 1.0 - g * k + g2;
+    c.b0 = (m0 * d0 + m1 * g + m2 * g2) / d0;
+    c.b1 = (m0 * d1 + 2.0 * m2 * g2) / d0;
+    c.b2 = (m0 * d2 - m1 * g + m2 * g2) / d0;
+    c.a1 = d1 / d0;
+    c.a2 = d2 / d0;
+    return c;
+}
+
+void SvfCascade::setCoefficients(const SvfCoeffs* newCoeffs, int numsections)
+{
+    jassert(numsections <= maxSections);
+    numsections = juce::jmin(numsections, maxSections);
+    auto sameLayout = numsections == numSections;
+
+    // a ramp in progress continues from where it is
+    if (rampPending)
+    {
+        const auto t = static_cast<double> (rampDone) / rampLength;
+
+        for (int s = 0; s < numSections; ++s)
+        {
+            auto& from = current[static_cast<size_t> (s)];
+            const auto& to = target[static_cast<size_t> (s)];
+            from.g += t * (to.g - from.g);
+            from.k += t * (to.k - from.k);
+            from.m0 += t * (to.m0 - from.m0);
+            from.m1 += t * (to.m1 - from.m1);
+            from.m2 += t * (to.m2 - from.m2);
+        }
+    }
+
+    for (int s = 0; s < numsections; ++s)
+    {
+        sameLayout = sameLayout && current[static_cast<size_t> (s)].firstOrder == newCoeffs[s].firstOrder;
+        target[static_cast<size_t> (s)] = newCoeffs[s];
+    }
+
+    numSections = numsections;
+    rampDone = 0;
+
+    if (sameLayout)
+    {
+        rampPending = true;
+    }
+    else
+    {
+        std::copy(target.begin(), target.begin() + numsections, current.begin());
+        rampPending = false;
+    }
+}
+
+void SvfCascade::reset()
+{
+    std::fill(state.begin(), state.end(), 0.0);
+}
+
+void SvfCascade::copyFrom(const SvfCascade& other)
+{
+    jassert(maxSections == other.maxSections && state.size() == other.state.size());
+
+    numSections = other.numSections;
+    rampPending = other.rampPending;
+    rampDone = other.rampDone;
+    std::copy(other.current.begin(), other.current.end(), current.begin());
+    std::copy(other.target.begin(), other.target.end(), target.begin());
+    std::copy(other.state.begin(), other.state.begin() + static_cast<std::ptrdiff_t> (juce::jmin(state.size(), other.state.size())), state.begin());
+}
+
+void SvfCascade::copyStateFrom(const SvfCascade& other)
+{
+    jassert(maxSections == other.maxSections && state.size() == other.state.size());
+    std::copy(other.state.begin(), other.state.begin() + static_cast<std::ptrdiff_t> (juce::jmin(state.size(), other.state.size())), state.begin());
+}
+
+void SvfCascade::process(double* const* channels, int numChannels, int numSamples)
+{
+    numChannels = juce::jmin(numChannels, maxChannels);
+    auto start = 0;
+
+    if (rampPending)
+    {
+        start = juce::jmin(numSamples, rampLength - rampDone);
+
+        for (int s = 0; s < numSections; ++s)
+            processSection<true>(s, channels, numChannels, 0, start);
+
+        rampDone += start;
+
+        if (rampDone >= rampLength)
+        {
+            std::copy(target.begin(), target.begin() + numSections, current.begin());
+            rampPending = false;
+        }
+    }
+
+    if (start < numSamples)
+        for (int s = 0; s < numSections; ++s)
+            processSection<false>(s, channels, numChannels, start, numSamples);
+}
+
+template <bool ramp>
+void SvfCascade::processSection(int section, double* const* channels, int numChannels, int start, int end)
+{
+    const auto from = current[static_cast<size_t> (section)];
+    const auto to = target[static_cast<size_t> (section)];
+    const auto step = 1.0 / rampLength;
+    const auto rampOffset = rampDone - start + 1;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto data = channels[ch];
+        auto z = state.data() + (ch * maxSections + section) * 2;
+        auto ic1 = z[0];
+        auto ic2 = z[1];
+        auto c = from;
+
+        if (from.firstOrder)
+        {
+            auto a = c.g / (1.0 + c.g);
+
+            for (int i = start; i < end; ++i)
+            {
+                if (ramp)
+                {
+                    const auto t = (i + rampOffset) * step;
+                    c.g = from.g + t * (to.g - from.g);
+                    c.m0 = from.m0 + t * (to.m0 - from.m0);
+                    c.m2 = from.m2 + t * (to.m2 - from.m2);
+                    a = c.g / (1.0 + c.g);
+                }
+
+                const auto x = data[i];
+                const auto v = a * (x - ic1);
+                const auto lp = v + ic1;
+                ic1 = lp + v;
+                data[i] = c.m0 * x + c.m2 * lp;
+            }
+        }
+        else
+        {
+            auto a1 = 1.0 / (1.0 + c.g * (c.g + c.k));
+            auto a2 = c.g * a1;
+            auto a3 = c.g * a2;
+
+            for (int i = start; i < end; ++i)
+            {
+                if (ramp)
+                {
+                    const auto t = (i + rampOffset) * step;
+                    c.g = from.g + t * (to.g - from.g);
+                    c.k = from.k + t * (to.k - from.k);
+                    c.m0 = from.m0 + t * (to.m0 - from.m0);
+                    c.m1 = from.m1 + t * (to.m1 - from.m1);
+                    c.m2 = from.m2 + t * (to.m2 - from.m2);
+                    a1 = 1.0 / (1.0 + c.g * (c.g + c.k));
+                    a2 = c.g * a1;
+                    a3 = c.g * a2;
+                }
+
+                const auto x = data[i];
+                const auto v3 = x - ic2;
+                const auto v1 = a1 * ic1 + a2 * v3;
+                const auto v2 = ic2 + a2 * ic1 + a3 * v3;
+                ic1 = 2.0 * v1 - ic1;
+                ic2 = 2.0 * v2 - ic2;
+                data[i] = c.m0 * x + c.m1 * v1 + c.m2 * v2;
+            }
+        }
+
+        z[0] = ic1;
+        z[1] = ic2;
+    }
+}
+
+int SvfCascade::getNumSections() const
+{
+    return numSections;
+}
+
+size_t SvfCascade::getMemoryBytes() const
+{
+    return sizeof(SvfCascade) + (current.capacity() + target.capacity()) * sizeof(SvfCoeffs) + state.capacity() * sizeof(double);
+}
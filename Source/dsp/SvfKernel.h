@@ -0,0 +1,91 @@
+#pragma once
+
+#include "BiquadKernel.h"
+
+#include "JuceHeader.h"
+
+// One section of a topology-preserving transform state variable filter
+// (trapezoidal integrators, after Zavalishin and Simper). The output mixes
+// input, band pass and low pass: y = m0 * x + m1 * bp + m2 * lp. First order
+// sections have a single integrator and use m0 and m2 only.
+//
+// The factories take the frequency in Hz and the linear gain of the section
+// at DC (low shelves), Nyquist (high shelves) or the centre (bells). Shelves
+// put their poles so the half gain point lands on the frequency.
+struct SvfCoeffs
+{
+    double g = 0.0;
+    double k = 2.0;
+    double m0 = 1.0;
+    double m1 = 0.0;
+    double m2 = 0.0;
+    bool firstOrder = false;
+
+    static SvfCoeffs lowPass(double freq, double k, double sampleRate);
+    static SvfCoeffs highPass(double freq, double k, double sampleRate);
+    static SvfCoeffs bell(double freq, double k, double gain, double sampleRate);
+    static SvfCoeffs lowShelf(double freq, double k, double gain, double sampleRate);
+    static SvfCoeffs highShelf(double freq, double k, double gain, double sampleRate);
+
+    static SvfCoeffs lowPass1(double freq, double sampleRate);
+    static SvfCoeffs highPass1(double freq, double sampleRate);
+    static SvfCoeffs lowShelf1(double freq, double gain, double sampleRate);
+    static SvfCoeffs highShelf1(double freq, double gain, double sampleRate);
+
+    // Damping of pole pair 1 to numPairs of a Butterworth filter of the order.
+    static double getButterworthDamping(int pair, int order);
+
+    // The direct form section with the same response, for code that works on
+    // biquads. Only the state behaves differently under modulation.
+    BiquadCoeffs toBiquad() const;
+};
+
+// SVF sections for any number of channels. New coefficients are reached
+// with a linear ramp of g, k and the mix over rampLength samples, whatever
+// the block size, recomputing the solver gains every sample: the topology
+// stays stable under any modulation, so automation needs no redesign and
+// makes no transients. A change in the section layout (count or order)
+// switches at once.
+class SvfCascade
+{
+public:
+
+    static constexpr int rampLength = 32;
+
+    explicit SvfCascade(int maxsections);
+
+    // Allocates the filter state, not realtime safe.
+    void setMaxChannels(int numChannels);
+
+    void setCoefficients(const SvfCoeffs* newCoeffs, int numsections);
+    void reset();
+
+    // Takes over coefficients and state of a cascade with the same
+    // capacity, doesn't allocate.
+    void copyFrom(const SvfCascade& other);
+
+    // Takes over only the state, the coefficients stay. Same capacity,
+    // doesn't allocate.
+    void copyStateFrom(const SvfCascade& other);
+
+    void process(double* const* channels, int numChannels, int numSamples);
+
+    int getNumSections() const;
+    size_t getMemoryBytes() const;
+
+private:
+
+    template <bool ramp>
+    void processSection(int section, double* const* channels, int numChannels, int start, int end);
+
+    int maxSections;
+    int numSections = 0;
+    int maxChannels = 0;
+    bool rampPending = false;
+    int rampDone = 0;
+    std::vector<SvfCoeffs> current;
+    std::vector<SvfCoeffs> target;
+
+    // [channel][section][ic1, ic2]
+    std::vector<double> state;
+};
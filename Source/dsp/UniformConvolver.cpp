@@ -0,0 +1,222 @@
+#include "UniformConvolver.h"
+
+UniformConvolver::UniformConvolver() = default;
+UniformConvolver::~UniformConvolver() = default;
+
+void UniformConvolver::prepare(int numChannels, int partitionsize, int maxKernelLength, int maxkernels, int maxPaths)
+{
+    jassert(juce::isPowerOfTwo(partitionsize));
+
+    partitionSize = partitionsize;
+    numBins = partitionSize + 1;
+    maxPartitions = juce::jmax(1, (maxKernelLength + partitionSize - 1) / partitionSize);
+    maxKernels = maxkernels;
+
+    const auto fftOrder = juce::roundToInt(std::log2(2 * partitionSize));
+    fft = std::make_unique<juce::dsp::FFT>(fftOrder);
+    writerFft = std::make_unique<juce::dsp::FFT>(fftOrder);
+
+    const auto spectrumSize = static_cast<size_t> (2 * numBins);
+    prepareKernelSets(static_cast<size_t> (maxKernels * maxPartitions) * spectrumSize, 1, maxPaths);
+    activeSet = -1;
+
+    channelStates.resize(static_cast<size_t> (numChannels));
+
+    for (auto& state : channelStates)
+    {
+        state.frame.assign(static_cast<size_t> (2 * partitionSize), 0.f);
+        state.spectra.assign(static_cast<size_t> (maxPartitions) * spectrumSize, 0.f);
+        state.inFifo.assign(static_cast<size_t> (partitionSize), 0.0);
+        state.outFifo.assign(static_cast<size_t> (partitionSize), 0.0);
+    }
+
+    // the real-only transforms work on twice the transform size
+    fftBuffer.assign(static_cast<size_t> (4 * partitionSize), 0.f);
+    writerBuffer.assign(fftBuffer.size(), 0.f);
+    outBuffer.assign(static_cast<size_t> (partitionSize), 0.f);
+    fadeBuffer.assign(outBuffer.size(), 0.f);
+    reset();
+}
+
+void UniformConvolver::reset()
+{
+    for (auto& state : channelStates)
+    {
+        std::fill(state.frame.begin(), state.frame.end(), 0.f);
+        std::fill(state.spectra.begin(), state.spectra.end(), 0.f);
+        std::fill(state.inFifo.begin(), state.inFifo.end(), 0.0);
+        std::fill(state.outFifo.begin(), state.outFifo.end(), 0.0);
+    }
+
+    spectrumPos = 0;
+    fifoPos = 0;
+}
+
+int UniformConvolver::getLatency() const
+{
+    return partitionSize;
+}
+
+int UniformConvolver::getPartitionSize() const
+{
+    return partitionSize;
+}
+
+size_t UniformConvolver::getMemoryBytes() const
+{
+    auto numFloats = fftBuffer.capacity() + writerBuffer.capacity() + outBuffer.capacity() + fadeBuffer.capacity();
+    auto numDoubles = static_cast<size_t> (0);
+
+    for (const auto& state : channelStates)
+    {
+        numFloats += state.frame.capacity() + state.spectra.capacity();
+        numDoubles += state.inFifo.capacity() + state.outFifo.capacity();
+    }
+
+    return sizeof(UniformConvolver) + getKernelSetBytes() + numFloats * sizeof(float) + numDoubles * sizeof(double);
+}
+
+size_t UniformConvolver::getKernelOffset(int kernel, int partition) const
+{
+    return static_cast<size_t> ((kernel * maxPartitions + partition) * 2 * numBins);
+}
+
+void UniformConvolver::setKernel(int index, const float* taps, int numTaps)
+{
+    jassert(index < maxKernels);
+    auto& set = getWritingSet();
+    numTaps = juce::jmin(numTaps, maxPartitions * partitionSize);
+
+    for (int p = 0; p < maxPartitions; ++p)
+    {
+        const auto first = p * partitionSize;
+        const auto count = juce::jlimit(0, partitionSize, numTaps - first);
+
+        std::fill(writerBuffer.begin(), writerBuffer.end(), 0.f);
+        std::copy(taps + first, taps + first + count, writerBuffer.begin());
+        writerFft->performRealOnlyForwardTransform(writerBuffer.data(), true);
+        std::copy(writerBuffer.begin(), writerBuffer.begin() + 2 * numBins, set.spectra.begin() + static_cast<std::ptrdiff_t> (getKernelOffset(index, p)));
+    }
+
+    set.numPartitions[0] = juce::jmax(set.numPartitions[0], (numTaps + partitionSize - 1) / partitionSize);
+}
+
+void UniformConvolver::process(double* const* channels, int numChannels, int numSamples)
+{
+    numChannels = juce::jmin(numChannels, static_cast<int> (channelStates.size()));
+
+    for (int pos = 0; pos < numSamples;)
+    {
+        const auto n = juce::jmin(numSamples - pos, partitionSize - fifoPos);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto& state = channelStates[static_cast<size_t> (ch)];
+            std::copy(channels[ch] + pos, channels[ch] + pos + n, state.inFifo.begin() + fifoPos);
+            std::copy(state.outFifo.begin() + fifoPos, state.outFifo.begin() + fifoPos + n, channels[ch] + pos);
+        }
+
+        fifoPos += n;
+        pos += n;
+
+        if (fifoPos == partitionSize)
+        {
+            processPartition(numChannels);
+            fifoPos = 0;
+        }
+    }
+}
+
+void UniformConvolver::processPartition(int numChannels)
+{
+    const auto spectrumSize = static_cast<size_t> (2 * numBins);
+    spectrumPos = spectrumPos + 1 == maxPartitions ? 0 : spectrumPos + 1;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto& state = channelStates[static_cast<size_t> (ch)];
+
+        // the frame holds the previous partition and the new one
+        std::copy(state.frame.begin() + partitionSize, state.frame.end(), state.frame.begin());
+
+        for (int i = 0; i < partitionSize; ++i)
+            state.frame[static_cast<size_t> (partitionSize + i)] = static_cast<float> (state.inFifo[static_cast<size_t> (i)]);
+
+        std::copy(state.frame.begin(), state.frame.end(), fftBuffer.begin());
+        std::fill(fftBuffer.begin() + 2 * partitionSize, fftBuffer.end(), 0.f);
+        fft->performRealOnlyForwardTransform(fftBuffer.data(), true);
+        std::copy(fftBuffer.begin(), fftBuffer.begin() + static_cast<std::ptrdiff_t> (spectrumSize),
+                  state.spectra.begin() + static_cast<std::ptrdiff_t> (static_cast<size_t> (spectrumPos) * spectrumSize));
+    }
+
+    // a new kernel set starts at a partition boundary
+    const auto fadeFrom = activeSet;
+    const auto next = takePendingSet();
+
+    if (next >= 0)
+        activeSet = next;
+
+    const auto fading = next >= 0;
+
+    for (int out = 0; out < numChannels; ++out)
+    {
+        if (activeSet >= 0)
+            convolveOutput(sets[activeSet], out, numChannels, outBuffer.data());
+        else
+            std::fill(outBuffer.begin(), outBuffer.end(), 0.f);
+
+        if (fading)
+        {
+            if (fadeFrom >= 0)
+                convolveOutput(sets[fadeFrom], out, numChannels, fadeBuffer.data());
+            else
+                std::fill(fadeBuffer.begin(), fadeBuffer.end(), 0.f);
+
+            for (int i = 0; i < partitionSize; ++i)
+            {
+                const auto t = (static_cast<float> (i) + 0.5f) / static_cast<float> (partitionSize);
+                outBuffer[static_cast<size_t> (i)] = fadeBuffer[static_cast<size_t> (i)] + t * (outBuffer[static_cast<size_t> (i)] - fadeBuffer[static_cast<size_t> (i)]);
+            }
+        }
+
+        auto& outFifo = channelStates[static_cast<size_t> (out)].outFifo;
+
+        for (int i = 0; i < partitionSize; ++i)
+            outFifo[static_cast<size_t> (i)] = static_cast<double> (outBuffer[static_cast<size_t> (i)]);
+    }
+
+    if (fading && fadeFrom >= 0)
+        freeSet(fadeFrom);
+}
+
+void UniformConvolver::convolveOutput(const KernelSet& set, int output, int numChannels, float* dst)
+{
+    const auto spectrumSize = static_cast<size_t> (2 * numBins);
+    std::fill(fftBuffer.begin(), fftBuffer.end(), 0.f);
+    auto acc = fftBuffer.data();
+
+    for (const auto& path : set.paths)
+    {
+        if (path.output != output || path.input >= numChannels)
+            continue;
+
+        const auto& inputSpectra = channelStates[static_cast<size_t> (path.input)].spectra;
+
+        for (int p = 0; p < set.numPartitions[0]; ++p)
+        {
+            const auto pos = spectrumPos - p < 0 ? spectrumPos - p + maxPartitions : spectrumPos - p;
+            const auto x = inputSpectra.data() + static_cast<size_t> (pos) * spectrumSize;
+            const auto h = set.spectra.data() + getKernelOffset(path.kernel, p);
+
+            for (int k = 0; k < 2 * numBins; k += 2)
+            {
+                acc[k] += x[k] * h[k] - x[k + 1] * h[k + 1];
+                acc[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+            }
+        }
+    }
+
+    // overlap-save: the second half of the frame is free of wrap-around
+    fft->performRealOnlyInverseTransform(acc);
+    std::copy(acc + partitionSize, acc + 2 * partitionSize, dst);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "PartitionedConvolver.h"
+
+// Uniformly partitioned overlap-save convolution. All work happens on the
+// audio thread in partitions of partitionSize samples, which is also the
+// latency on top of the kernels' own; a new kernel set starts at the next
+// partition and crossfades over it.
+class UniformConvolver : public PartitionedConvolver
+{
+public:
+
+    UniformConvolver();
+    ~UniformConvolver() override;
+
+    void prepare(int numChannels, int partitionSize, int maxKernelLength, int maxKernels, int maxPaths) override;
+    void reset() override;
+
+    int getLatency() const override;
+    int getPartitionSize() const override;
+    size_t getMemoryBytes() const override;
+
+    void setKernel(int index, const float* taps, int numTaps) override;
+    void process(double* const* channels, int numChannels, int numSamples) override;
+
+private:
+
+    struct ChannelState
+    {
+        std::vector<float> frame;
+        std::vector<float> spectra;
+        std::vector<double> inFifo;
+        std::vector<double> outFifo;
+    };
+
+    void processPartition(int numChannels);
+    void convolveOutput(const KernelSet& set, int output, int numChannels, float* dst);
+
+    // kernel set spectra are [kernel][partition][bin re, im]
+    size_t getKernelOffset(int kernel, int partition) const;
+
+    int partitionSize = 0;
+    int numBins = 0;
+    int maxPartitions = 0;
+    int maxKernels = 0;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::unique_ptr<juce::dsp::FFT> writerFft;
+    int activeSet = -1;
+
+    std::vector<ChannelState> channelStates;
+    int spectrumPos = 0;
+    int fifoPos = 0;
+    std::vector<float> fftBuffer;
+    std::vector<float> writerBuffer;
+    std::vector<float> outBuffer;
+    std::vector<float> fadeBuffer;
+};
@@ -2,6 +2,14 @@
 #include "../PluginEditor.h"
 #include "AFEQLookAndFeel.h"
 
+// Single changes are gestures too, each becomes one undo step.
+static void setAsGesture(juce::AudioProcessorParameter* param, float value)
+{
+    param->beginChangeGesture();
+    param->setValueNotifyingHost(value);
+    param->endChangeGesture();
+}
+
 EQView::EQView(AFEQAudioProcessorEditor& afeqeditor, EqBandDspGroup& dspBands)
     :afeqEditor(afeqeditor)
 {
@@ -94,19 +102,27 @@ void EQView::mouseDoubleClick(const juce::MouseEvent& e)
 
     if (newBand != nullptr)
     {
-        newBand->getDsp().getBandParams().enabledParam->setValueNotifyingHost(1.f);
-        newBand->getDsp().getBandParams().routingParam->setValueNotifyingHost(0.f);
         const auto p = e.getPosition().toFloat();
         const auto newFreq = viewRange.getFreqForX(p.getX());
         const auto newGain = viewRange.getGainForY(p.getY());
+        auto ep = newBand->getDsp().getBandParams().enabledParam;
+        auto rp = newBand->getDsp().getBandParams().routingParam;
         auto fp = newBand->getDsp().getBandParams().freqParam;
         auto gp = newBand->getDsp().getBandParams().gainParam;
         const auto freqVal = fp->getNormalisableRange().convertTo0to1(newFreq);
         const auto gainVal = gp->getNormalisableRange().convertTo0to1(newGain);
+
+        // overlapping gestures, so a single undo removes the band again
+        ep->beginChangeGesture();
+        rp->beginChangeGesture();
         fp->beginChangeGesture();
         gp->beginChangeGesture();
+        ep->setValueNotifyingHost(1.f);
+        rp->setValueNotifyingHost(0.f);
         fp->setValueNotifyingHost(freqVal);
         gp->setValueNotifyingHost(gainVal);
+        ep->endChangeGesture();
+        rp->endChangeGesture();
         fp->endChangeGesture();
         gp->endChangeGesture();
 
@@ -200,11 +216,12 @@ void EQView::mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDet
     const auto dir = (wheel.deltaY > 0 ? 1.f : -1.f) * (wheel.isReversed ? -1.f : 1.f);
     const auto val = e.mods.isShiftDown() ? 0.005f : 0.05f;
     auto qp = dynamic_cast<juce::AudioProcessorParameter*> (band->getDsp().getBandParams().qParam);
-    qp->setValueNotifyingHost(juce::jlimit(0.f, 1.f, qp->getValue() + val * dir));
+    setAsGesture(qp, juce::jlimit(0.f, 1.f, qp->getValue() + val * dir));
 }
 
 void EQView::timerCallback()
 {
+    afeqEditor.refreshAfterParameterEvents();
     repaint();
 }
 
@@ -445,6 +462,104 @@ std::unique_ptr<juce::PopupMenu> EQView::getAnalyserMenu()
     men->addSubMenu("Analyser Range Min", rangeMinMenu);
     men->addSubMenu("Analyser Range Length", rangeLenMenu);
 
+    men->addSeparator();
+    men->addSubMenu("Snapshots", getSnapshotMenu());
+    men->addSubMenu("Processing", getProcessingMenu());
+
+    return men;
+}
+
+juce::PopupMenu EQView::getProcessingMenu()
+{
+    using Options = AFEQAudioProcessor::ProcessingOptions;
+    auto& proc = afeqEditor.getAudioProcessor();
+    const auto cur = proc.getProcessingOptions();
+
+    // each choice re-prepares the processor with the changed options
+    const auto setOption = [&proc](auto&& change) {
+        return [&proc, change]() {
+            auto o = proc.getProcessingOptions();
+            change(o);
+            proc.setProcessingOptions(o);
+        };
+    };
+
+    juce::PopupMenu men;
+    juce::PopupMenu workersMenu;
+    juce::PopupMenu oversamplingMenu;
+    juce::PopupMenu linearPhaseMenu;
+
+    for (auto n : { 0, 1, 2, 4 })
+        workersMenu.addItem(n == 0 ? juce::String("Off") : juce::String(n), true, cur.numWorkers == n,
+            setOption([n](Options& o) { o.numWorkers = n; }));
+
+    for (auto factor : { 1, 2, 4, 8 })
+        oversamplingMenu.addItem(factor == 1 ? juce::String("Off") : juce::String(factor) + "x", true, cur.oversamplingFactor == factor,
+            setOption([factor](Options& o) { o.oversamplingFactor = factor; }));
+
+    oversamplingMenu.addSeparator();
+    oversamplingMenu.addItem("Linear Phase Filters", true, cur.oversamplingLinearPhase,
+        setOption([](Options& o) { o.oversamplingLinearPhase = ! o.oversamplingLinearPhase; }));
+
+    linearPhaseMenu.addItem("Off", true, ! cur.linearPhaseEnabled,
+        setOption([](Options& o) { o.linearPhaseEnabled = false; }));
+
+    for (auto size : { 256, 512, 2048, 8192 })
+        linearPhaseMenu.addItem(juce::String(size) + " Samples", true, cur.linearPhaseEnabled && cur.linearPhasePartitionSize == size,
+            setOption([size](Options& o) { o.linearPhaseEnabled = true; o.linearPhasePartitionSize = size; }));
+
+    linearPhaseMenu.addSeparator();
+    linearPhaseMenu.addItem("Non-Uniform Partitions", true, cur.linearPhaseNonUniform,
+        setOption([](Options& o) { o.linearPhaseNonUniform = ! o.linearPhaseNonUniform; }));
+
+    men.addSubMenu("Worker Threads", workersMenu);
+    men.addSubMenu("Oversampling", oversamplingMenu);
+    men.addSubMenu("Linear Phase", linearPhaseMenu);
+    men.addItem("Multirate", true, cur.multirateEnabled,
+        setOption([](Options& o) { o.multirateEnabled = ! o.multirateEnabled; }));
+    men.addItem("SVF Engine for All Bands", true, cur.svfEngineEnabled,
+        setOption([](Options& o) { o.svfEngineEnabled = ! o.svfEngineEnabled; }));
+    men.addItem("Parallel Form", true, cur.parallelFormEnabled,
+        setOption([](Options& o) { o.parallelFormEnabled = ! o.parallelFormEnabled; }));
+
+    return men;
+}
+
+juce::PopupMenu EQView::getSnapshotMenu()
+{
+    auto& proc = afeqEditor.getAudioProcessor();
+    const auto morphing = proc.isMorphing();
+
+    juce::PopupMenu men;
+    juce::PopupMenu storeMenu;
+    juce::PopupMenu morphMenu;
+
+    for (int slot = 0; slot < SnapshotBank::numSlots; ++slot)
+    {
+        const auto name = "Slot " + juce::String(slot + 1);
+        storeMenu.addItem(name, true, proc.isSnapshotStored(slot), [&proc, slot]() { proc.storeSnapshot(slot); });
+        men.addItem("Recall " + name, proc.isSnapshotStored(slot), false, [&proc, slot]() { proc.recallSnapshot(slot); });
+    }
+
+    // the Morph parameter moves from the first slot to the second
+    morphMenu.addItem("Off", true, ! morphing, [&proc]() { proc.clearMorph(); });
+
+    for (int a = 0; a < SnapshotBank::numSlots; ++a)
+    {
+        for (int b = 0; b < SnapshotBank::numSlots; ++b)
+        {
+            if (a == b)
+                continue;
+
+            const auto ticked = morphing && proc.getMorphSlotA() == a && proc.getMorphSlotB() == b;
+            morphMenu.addItem("Slot " + juce::String(a + 1) + " to " + juce::String(b + 1),
+                proc.isSnapshotStored(a) && proc.isSnapshotStored(b), ticked, [&proc, a, b]() { proc.setMorphSlots(a, b); });
+        }
+    }
+
+    men.addSeparator();
+    men.addSubMenu("Store", storeMenu);
+    men.addSubMenu("Morph", morphMenu);
     return men;
 }
 
@@ -468,7 +583,7 @@ std::unique_ptr<juce::PopupMenu> EQView::getBandMenu(EQBand* band)
         const auto name = BandParams::getGroupNameForType(o) + " " + BandParams::getNameForType(o);
         menuType.addItem(name, true, i == static_cast<int> (type),
             [&dsp, val]() {
-            dsp.getBandParams().typeParam->setValueNotifyingHost(val);
+            setAsGesture(dsp.getBandParams().typeParam, val);
         });
     }
 
@@ -477,7 +592,7 @@ std::unique_ptr<juce::PopupMenu> EQView::getBandMenu(EQBand* band)
         auto val = (i / (static_cast<float> (BandParams::routeNumRoutings) - 1.f));
         menuRouting.addItem(BandParams::getNameForRouting(static_cast<BandParams::Routing> (i)), true, i == static_cast<int> (routing),
             [&dsp, val]() {
-            dsp.getBandParams().routingParam->setValueNotifyingHost(val);
+            setAsGesture(dsp.getBandParams().routingParam, val);
         });
     }
 
@@ -486,7 +601,7 @@ std::unique_ptr<juce::PopupMenu> EQView::getBandMenu(EQBand* band)
         auto val = (i / (static_cast<float> (AFEQAudioProcessor::maxOrder) - 1.f));
         menuOrder.addItem(juce::String((i+1)*6) + " dB/Oct", true, i+1 == static_cast<int> (order),
             [&dsp, val]() {
-            dsp.getBandParams().orderParam->setValueNotifyingHost(val);
+            setAsGesture(dsp.getBandParams().orderParam, val);
         });
     }
 
@@ -494,5 +609,42 @@ std::unique_ptr<juce::PopupMenu> EQView::getBandMenu(EQBand* band)
     men->addSubMenu("Routing", menuRouting, true);
     men->addSubMenu("Order", menuOrder, BandParams::hasOrder(type));
 
+    // state variable filters for bands under heavy automation
+    const auto& bp = dsp.getBandParams();
+    const auto svf = bp.getEngine() == BandParams::engineSvf;
+    men->addItem("SVF Engine", type != BandParams::bandVOBandShelf, svf, [&dsp, svf]() {
+        setAsGesture(dsp.getBandParams().engineParam, svf ? 0.f : 1.f);
+    });
+
+    // the gain types can follow the level of their band
+    const auto dynamic = bp.getDynamic();
+    juce::PopupMenu menuThreshold;
+    juce::PopupMenu menuRatio;
+
+    for (int db = -6; db >= -48; db -= 6)
+    {
+        const auto val = bp.thresholdParam->convertTo0to1(static_cast<float> (db));
+        menuThreshold.addItem(juce::String(db) + " dB", true, juce::approximatelyEqual(bp.getThreshold(), static_cast<float> (db)),
+            [&dsp, val]() {
+            setAsGesture(dsp.getBandParams().thresholdParam, val);
+        });
+    }
+
+    for (auto ratio : { 1.5f, 2.f, 3.f, 4.f, 8.f, 20.f })
+    {
+        const auto val = bp.ratioParam->convertTo0to1(ratio);
+        menuRatio.addItem(juce::String(ratio, 1) + ":1", true, juce::approximatelyEqual(bp.getRatio(), ratio),
+            [&dsp, val]() {
+            setAsGesture(dsp.getBandParams().ratioParam, val);
+        });
+    }
+
+    men->addSeparator();
+    men->addItem("Dynamic", BandParams::hasGain(type) && ! svf, dynamic, [&dsp, dynamic]() {
+        setAsGesture(dsp.getBandParams().dynamicParam, dynamic ? 0.f : 1.f);
+    });
+    men->addSubMenu("Threshold", menuThreshold, dynamic);
+    men->addSubMenu("Ratio", menuRatio, dynamic);
+
     return men;
 }
@@ -38,6 +38,8 @@ private:
     void drawGrid(juce::Graphics& g);
     void drawResponse(juce::Graphics& g, const std::vector<float>& mags);
     std::unique_ptr<juce::PopupMenu> getAnalyserMenu();
+    juce::PopupMenu getProcessingMenu();
+    juce::PopupMenu getSnapshotMenu();
     std::unique_ptr<juce::PopupMenu> getBandMenu(EQBand* band);
     EQViewRange viewRange;
 
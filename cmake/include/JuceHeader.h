@@ -0,0 +1,27 @@
+#pragma once
+
+// Stand-in for the Projucer generated JuceHeader.h, used by the CMake targets.
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_core/juce_core.h>
+#include <juce_data_structures/juce_data_structures.h>
+#include <juce_dsp/juce_dsp.h>
+#include <juce_events/juce_events.h>
+#include <juce_graphics/juce_graphics.h>
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <juce_gui_extra/juce_gui_extra.h>
+
+#if __has_include("BinaryData.h")
+ #include "BinaryData.h"
+#endif
+
+#if ! JUCE_DONT_DECLARE_PROJECTINFO
+namespace ProjectInfo
+{
+    const char* const  projectName    = "AFEQ";
+    const char* const  companyName    = "Inferior Sound";
+    const char* const  versionString  = AFEQ_VERSION_STRING;
+}
+#endif
@@ -0,0 +1,145 @@
+// Checks the partitioned convolvers against direct convolution: two channels
+// through three paths, one of them crossing from the first channel into the
+// second, for several partition and block sizes, including blocks that
+// don't divide the partition. The output has to equal the direct
+// convolution delayed by the reported latency, after the first partition,
+// over which the uniform convolver fades the first kernel set in. The
+// non-uniform convolver runs its stages inline here, so no block comes late.
+//
+// Exits with 1 on a mismatch.
+
+#include <JuceHeader.h>
+#include "dsp/UniformConvolver.h"
+#include "dsp/NonUniformConvolver.h"
+
+#include <iostream>
+
+namespace
+{
+    constexpr int numChannels = 2;
+    constexpr int kernelLength = 3000;
+    constexpr int numSamples = 12000;
+
+    using Signal = std::vector<std::vector<double>>;
+
+    const std::vector<PartitionedConvolver::Path> paths { { 0, 0, 0 }, { 1, 1, 1 }, { 0, 1, 0 } };
+
+    std::vector<std::vector<float>> makeKernels()
+    {
+        juce::Random rnd(7);
+        std::vector<std::vector<float>> kernels(2, std::vector<float>(kernelLength));
+
+        // decaying noise, as the linear phase kernels are mostly
+        for (auto& k : kernels)
+            for (int i = 0; i < kernelLength; ++i)
+                k[static_cast<size_t> (i)] = (rnd.nextFloat() - 0.5f) * 0.1f * std::exp(-4.f * static_cast<float> (i) / kernelLength);
+
+        return kernels;
+    }
+
+    Signal makeInput()
+    {
+        juce::Random rnd(3);
+        Signal input(numChannels, std::vector<double>(numSamples));
+
+        for (auto& ch : input)
+            for (auto& x : ch)
+                x = rnd.nextDouble() - 0.5;
+
+        return input;
+    }
+
+    Signal convolveDirect(const Signal& input, const std::vector<std::vector<float>>& kernels)
+    {
+        Signal output(numChannels, std::vector<double>(numSamples, 0.0));
+
+        for (const auto& p : paths)
+        {
+            const auto& in = input[static_cast<size_t> (p.input)];
+            const auto& k = kernels[static_cast<size_t> (p.kernel)];
+            auto& out = output[static_cast<size_t> (p.output)];
+
+            for (int i = 0; i < numSamples; ++i)
+                for (int j = 0; j < kernelLength && j <= i; ++j)
+                    out[static_cast<size_t> (i)] += in[static_cast<size_t> (i - j)] * k[static_cast<size_t> (j)];
+        }
+
+        return output;
+    }
+
+    Signal convolve(PartitionedConvolver& conv, int partitionSize, int blockSize, const Signal& input,
+                    const std::vector<std::vector<float>>& kernels)
+    {
+        conv.prepare(numChannels, partitionSize, kernelLength, static_cast<int> (kernels.size()), static_cast<int> (paths.size()));
+        conv.beginKernels();
+
+        for (size_t k = 0; k < kernels.size(); ++k)
+            conv.setKernel(static_cast<int> (k), kernels[k].data(), kernelLength);
+
+        conv.setPaths(paths);
+        conv.publishKernels();
+
+        auto output = input;
+
+        for (int pos = 0; pos < numSamples; pos += blockSize)
+        {
+            double* channels[numChannels] = { output[0].data() + pos, output[1].data() + pos };
+            conv.process(channels, numChannels, juce::jmin(blockSize, numSamples - pos));
+        }
+
+        return output;
+    }
+
+    double getMaxError(const Signal& output, const Signal& reference, int latency, int partitionSize)
+    {
+        auto maxError = 0.0;
+
+        for (size_t ch = 0; ch < output.size(); ++ch)
+            for (int i = latency + partitionSize; i < numSamples; ++i)
+                maxError = juce::jmax(maxError, std::abs(output[ch][static_cast<size_t> (i)] - reference[ch][static_cast<size_t> (i - latency)]));
+
+        return maxError;
+    }
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    const auto kernels = makeKernels();
+    const auto input = makeInput();
+    const auto reference = convolveDirect(input, kernels);
+    auto failed = false;
+
+    for (const auto nonUniform : { false, true })
+    {
+        for (const auto partitionSize : { 64, 512 })
+        {
+            for (const auto blockSize : { 1, 37, 512, 1024 })
+            {
+                std::unique_ptr<PartitionedConvolver> conv;
+
+                if (nonUniform)
+                {
+                    auto nuc = std::make_unique<NonUniformConvolver>();
+                    nuc->setUseBackgroundThreads(false);
+                    conv = std::move(nuc);
+                }
+                else
+                {
+                    conv = std::make_unique<UniformConvolver>();
+                }
+
+                const auto output = convolve(*conv, partitionSize, blockSize, input, kernels);
+                const auto maxError = getMaxError(output, reference, conv->getLatency(), partitionSize);
+                const auto ok = maxError < 1e-5;
+                failed = failed || ! ok;
+
+                std::cout << (ok ? "PASSED " : "FAILED ") << (nonUniform ? "non-uniform" : "uniform") << " partitions of "
+                          << partitionSize << ", blocks of " << blockSize << ": differs from direct convolution by "
+                          << maxError << std::endl;
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+// Checks ParallelForm::design against the cascade it expands: for cascades of
+// bells and shelves, and for an order 8 Butterworth high pass, the parallel
+// form has to reproduce the cascade's output for an impulse followed by noise
+// to 1e-8 of its peak. Cascades with repeated poles (a section used twice)
+// or nearly coinciding ones have to fall back.
+//
+// Exits with 1 on a mismatch.
+
+#include <JuceHeader.h>
+#include "dsp/ParallelForm.h"
+
+#include <iostream>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numSamples = 16384;
+    constexpr int maxSections = 16;
+
+    // RBJ cookbook designs
+    BiquadCoeffs makeBiquad(double b0, double b1, double b2, double a0, double a1, double a2)
+    {
+        return { b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0 };
+    }
+
+    BiquadCoeffs makeBell(double freq, double q, double gainDb)
+    {
+        const auto a = std::pow(10.0, gainDb / 40.0);
+        const auto w = juce::MathConstants<double>::twoPi * freq / sampleRate;
+        const auto alpha = std::sin(w) / (2.0 * q);
+        return makeBiquad(1.0 + alpha * a, -2.0 * std::cos(w), 1.0 - alpha * a, 1.0 + alpha / a, -2.0 * std::cos(w), 1.0 - alpha / a);
+    }
+
+    BiquadCoeffs makeShelf(double freq, double gainDb, bool high)
+    {
+        const auto a = std::pow(10.0, gainDb / 40.0);
+        const auto w = juce::MathConstants<double>::twoPi * freq / sampleRate;
+        const auto c = std::cos(w);
+        const auto beta = std::sin(w) * std::sqrt(a);
+        const auto s = high ? -1.0 : 1.0;
+
+        return makeBiquad(a * ((a + 1.0) - s * (a - 1.0) * c + beta), 2.0 * s * a * ((a - 1.0) - s * (a + 1.0) * c),
+                          a * ((a + 1.0) - s * (a - 1.0) * c - beta), (a + 1.0) + s * (a - 1.0) * c + beta,
+                          -2.0 * s * ((a - 1.0) + s * (a + 1.0) * c), (a + 1.0) + s * (a - 1.0) * c - beta);
+    }
+
+    BiquadCoeffs makeHighPass(double freq, double q)
+    {
+        const auto w = juce::MathConstants<double>::twoPi * freq / sampleRate;
+        const auto c = std::cos(w);
+        const auto alpha = std::sin(w) / (2.0 * q);
+        return makeBiquad(0.5 * (1.0 + c), -(1.0 + c), 0.5 * (1.0 + c), 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+    }
+
+    std::vector<double> makeInput()
+    {
+        juce::Random rnd(5);
+        std::vector<double> input(numSamples, 0.0);
+        input[0] = 1.0;
+
+        for (int i = numSamples / 4; i < numSamples; ++i)
+            input[static_cast<size_t> (i)] = rnd.nextDouble() - 0.5;
+
+        return input;
+    }
+
+    std::vector<double> runCascade(const std::vector<BiquadCoeffs>& cascade, std::vector<double> x)
+    {
+        for (const auto& c : cascade)
+        {
+            auto z1 = 0.0;
+            auto z2 = 0.0;
+
+            for (auto& v : x)
+            {
+                const auto y = c.b0 * v + z1;
+                z1 = c.b1 * v - c.a1 * y + z2;
+                z2 = c.b2 * v - c.a2 * y;
+                v = y;
+            }
+        }
+
+        return x;
+    }
+
+    bool checkMatch(const juce::String& name, const std::vector<BiquadCoeffs>& cascade)
+    {
+        ParallelForm form(maxSections);
+        form.setMaxChannels(1);
+        const auto designed = form.design(cascade.data(), static_cast<int> (cascade.size()));
+
+        const auto input = makeInput();
+        const auto reference = runCascade(cascade, input);
+        auto output = input;
+
+        // in uneven blocks, as the audio thread calls it
+        for (int pos = 0; pos < numSamples; pos += 301)
+        {
+            double* channel = output.data() + pos;
+            form.process(&channel, 1, juce::jmin(301, numSamples - pos));
+        }
+
+        auto peak = 0.0;
+        auto maxError = 0.0;
+
+        for (size_t i = 0; i < output.size(); ++i)
+        {
+            peak = juce::jmax(peak, std::abs(reference[i]));
+            maxError = juce::jmax(maxError, std::abs(output[i] - reference[i]));
+        }
+
+        const auto relativeError = maxError / peak;
+        const auto ok = designed && relativeError <= 1e-8;
+
+        std::cout << (ok ? "PASSED " : "FAILED ") << name << ": " << form.getNumSections() << " sections, "
+                  << (designed ? "error " : "not designed, error ") << relativeError << " of the peak" << std::endl;
+        return ok;
+    }
+
+    bool checkFallback(const juce::String& name, const std::vector<BiquadCoeffs>& cascade)
+    {
+        ParallelForm form(maxSections);
+        form.setMaxChannels(1);
+        const auto ok = ! form.design(cascade.data(), static_cast<int> (cascade.size())) && form.getNumSections() == 0;
+
+        std::cout << (ok ? "PASSED " : "FAILED ") << name << " falls back" << std::endl;
+        return ok;
+    }
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    auto ok = true;
+
+    std::vector<BiquadCoeffs> bells;
+
+    for (int i = 0; i < 10; ++i)
+        bells.push_back(makeBell(60.0 * std::pow(1.8, i), 0.7 + 0.3 * i, i % 2 == 0 ? 6.0 : -4.5));
+
+    ok = checkMatch("10 bells", bells) && ok;
+
+    auto shelves = bells;
+    shelves.resize(6);
+    shelves.push_back(makeShelf(120.0, 4.0, false));
+    shelves.push_back(makeShelf(8000.0, -3.0, true));
+    ok = checkMatch("6 bells and 2 shelves", shelves) && ok;
+
+    // Butterworth: the sections' Qs of order 8
+    std::vector<BiquadCoeffs> highPass;
+
+    for (int k = 0; k < 4; ++k)
+        highPass.push_back(makeHighPass(80.0, 1.0 / (2.0 * std::cos(juce::MathConstants<double>::pi * (2 * k + 1) / 16.0))));
+
+    ok = checkMatch("order 8 high pass", highPass) && ok;
+
+    auto twice = bells;
+    twice.push_back(bells[3]);
+    ok = checkFallback("a bell used twice", twice) && ok;
+
+    auto close = bells;
+    close.push_back(makeBell(60.0 * std::pow(1.8, 3) * (1.0 + 1e-9), 0.7 + 0.9, -4.5));
+    ok = checkFallback("nearly coinciding poles", close) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+// Checks the binary PluginState format: a state with snapshots and a morph
+// reads back as written, states with the band records of versions 1 (16
+// bytes) and 3 (33 bytes) still load with defaults for the later fields, and
+// a wrong checksum or snapshot and morph data cut short are rejected.
+//
+// Exits with 1 on a mismatch.
+
+#include <JuceHeader.h>
+#include "PluginState.h"
+
+#include <iostream>
+
+namespace
+{
+    constexpr int numBands = 12;
+
+    PluginState::Band makeBand(int i)
+    {
+        PluginState::Band b;
+        b.enabled = i % 3 != 0;
+        b.type = i % BandParams::bandNumTypes;
+        b.routing = i % 5;
+        b.order = 1 + i % 8;
+        b.freq = 40.f * static_cast<float> (i + 1);
+        b.gain = static_cast<float> (i) - 6.f;
+        b.q = 0.5f + 0.25f * static_cast<float> (i);
+        b.dynamic = i % 2 == 0;
+        b.threshold = -30.f + static_cast<float> (i);
+        b.ratio = 1.5f + static_cast<float> (i);
+        b.attack = 2.f + static_cast<float> (i);
+        b.release = 50.f + static_cast<float> (i);
+        b.engine = i % 2;
+        return b;
+    }
+
+    PluginState makeState()
+    {
+        PluginState ps;
+
+        for (int i = 0; i < numBands; ++i)
+            ps.bands.push_back(makeBand(i));
+
+        ps.scale = 1.25f;
+        ps.analyser = 2;
+        ps.workers = 4;
+        ps.multirate = true;
+        ps.oversampling = 8;
+        ps.nonUniform = true;
+        ps.partitionSize = 2048;
+        ps.svf = true;
+        ps.parallel = true;
+
+        // slot 1 stays empty
+        for (int slot = 0; slot < 4; ++slot)
+        {
+            ps.snapshots.emplace_back();
+
+            if (slot != 1)
+                for (int i = 0; i < numBands; ++i)
+                    ps.snapshots.back().push_back(makeBand(i + slot));
+        }
+
+        ps.morph = 0.75f;
+        ps.morphA = 0;
+        ps.morphB = 2;
+        return ps;
+    }
+
+    // Sets the payload size and the checksum for the bytes before it.
+    void seal(juce::MemoryBlock& data)
+    {
+        const auto payloadSize = static_cast<int> (data.getSize()) - 10;
+        auto bytes = static_cast<char*> (data.getData());
+        std::memcpy(bytes + 6, &payloadSize, 4);
+
+        juce::MemoryOutputStream out(data, true);
+        out.writeInt(static_cast<int> (PluginState::crc32(data.getData(), data.getSize())));
+    }
+
+    // A state as an older version wrote it, with records of the given size.
+    juce::MemoryBlock writeOldState(int version, int recordSize, const std::vector<PluginState::Band>& bands)
+    {
+        juce::MemoryBlock data;
+
+        // the stream sets the block size when it goes
+        {
+            juce::MemoryOutputStream out(data, false);
+            out.writeInt(static_cast<int> (PluginState::magic));
+            out.writeShort(static_cast<short> (version));
+            out.writeInt(0);
+            out.writeFloat(1.5f);
+            out.writeByte(1);
+            out.writeByte(0);
+            out.writeByte(2);
+            out.writeByte(0);
+            out.writeShort(512);
+            out.writeByte(static_cast<char> (bands.size()));
+            out.writeByte(static_cast<char> (recordSize));
+
+            for (const auto& b : bands)
+            {
+                out.writeByte(static_cast<char> (b.enabled ? 1 : 0));
+                out.writeByte(static_cast<char> (b.type));
+                out.writeByte(static_cast<char> (b.routing));
+                out.writeByte(static_cast<char> (b.order));
+                out.writeFloat(b.freq);
+                out.writeFloat(b.gain);
+                out.writeFloat(b.q);
+
+                if (recordSize == 33)
+                {
+                    out.writeByte(static_cast<char> (b.dynamic ? 1 : 0));
+                    out.writeFloat(b.threshold);
+                    out.writeFloat(b.ratio);
+                    out.writeFloat(b.attack);
+                    out.writeFloat(b.release);
+                }
+            }
+
+            // no snapshots and no morph
+            if (version >= 2)
+            {
+                out.writeByte(0);
+                out.writeFloat(0.f);
+                out.writeByte(-1);
+                out.writeByte(-1);
+            }
+        }
+
+        seal(data);
+        return data;
+    }
+
+    bool report(bool ok, const juce::String& what)
+    {
+        std::cout << (ok ? "PASSED " : "FAILED ") << what << std::endl;
+        return ok;
+    }
+
+    bool testRoundTrip()
+    {
+        const auto ps = makeState();
+        juce::MemoryBlock data;
+        ps.writeTo(data);
+
+        PluginState read;
+        const auto ok = PluginState::isBinaryState(data.getData(), static_cast<int> (data.getSize()))
+            && read.readFrom(data.getData(), static_cast<int> (data.getSize()))
+            && read.bands == ps.bands && read.snapshots == ps.snapshots
+            && read.scale == ps.scale && read.analyser == ps.analyser && read.workers == ps.workers
+            && read.multirate == ps.multirate && read.oversampling == ps.oversampling
+            && read.oversamplingLinearPhase == ps.oversamplingLinearPhase && read.linearPhase == ps.linearPhase
+            && read.partitionSize == ps.partitionSize && read.nonUniform == ps.nonUniform
+            && read.svf == ps.svf && read.parallel == ps.parallel
+            && read.morph == ps.morph && read.morphA == ps.morphA && read.morphB == ps.morphB;
+
+        return report(ok, "round trip of " + juce::String(static_cast<int> (data.getSize())) + " bytes");
+    }
+
+    bool testOldRecords(int version, int recordSize)
+    {
+        std::vector<PluginState::Band> bands;
+
+        for (int i = 0; i < numBands; ++i)
+            bands.push_back(makeBand(i));
+
+        const auto data = writeOldState(version, recordSize, bands);
+        PluginState read;
+        auto ok = read.readFrom(data.getData(), static_cast<int> (data.getSize()))
+            && read.bands.size() == bands.size() && read.snapshots.empty() && read.morphA == -1
+            && read.scale == 1.5f && read.oversampling == 2;
+
+        const PluginState::Band defaults;
+
+        for (size_t i = 0; ok && i < bands.size(); ++i)
+        {
+            const auto& a = read.bands[i];
+            const auto& b = bands[i];
+            ok = a.enabled == b.enabled && a.type == b.type && a.routing == b.routing && a.order == b.order
+                && a.freq == b.freq && a.gain == b.gain && a.q == b.q && a.engine == defaults.engine;
+
+            if (recordSize == 33)
+                ok = ok && a.dynamic == b.dynamic && a.threshold == b.threshold && a.ratio == b.ratio
+                    && a.attack == b.attack && a.release == b.release;
+            else
+                ok = ok && a.dynamic == defaults.dynamic && a.threshold == defaults.threshold;
+        }
+
+        return report(ok, "version " + juce::String(version) + " with " + juce::String(recordSize) + " byte records");
+    }
+
+    bool testChecksum()
+    {
+        juce::MemoryBlock data;
+        makeState().writeTo(data);
+
+        auto ok = true;
+
+        // a flipped bit in the options, the records and the morph
+        for (auto pos : { 12, 40, static_cast<int> (data.getSize()) - 6 })
+        {
+            auto copy = data;
+            static_cast<char*> (copy.getData())[pos] ^= 0x10;
+            PluginState read;
+            ok = ok && ! read.readFrom(copy.getData(), static_cast<int> (copy.getSize()));
+        }
+
+        return report(ok, "checksum mismatch rejected");
+    }
+
+    bool testTruncated()
+    {
+        juce::MemoryBlock data;
+        makeState().writeTo(data);
+
+        // with the size and checksum fixed up, only the counts tell that data is missing
+        const auto payloadEnd = static_cast<int> (data.getSize()) - 4;
+        const auto snapshotsStart = 10 + 12 + numBands * 34;
+        auto ok = true;
+
+        for (int end = snapshotsStart + 2; end < payloadEnd; end += 7)
+        {
+            juce::MemoryBlock copy(data);
+            copy.setSize(static_cast<size_t> (end));
+            seal(copy);
+
+            PluginState read;
+            ok = ok && ! read.readFrom(copy.getData(), static_cast<int> (copy.getSize()));
+        }
+
+        // cut without fixing up
+        for (int end = 0; end < static_cast<int> (data.getSize()); end += 13)
+        {
+            PluginState read;
+            ok = ok && ! read.readFrom(data.getData(), end);
+        }
+
+        return report(ok, "truncated snapshot and morph data rejected");
+    }
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    auto ok = testRoundTrip();
+    ok = testOldRecords(1, 16) && ok;
+    ok = testOldRecords(3, 33) && ok;
+    ok = testChecksum() && ok;
+    ok = testTruncated() && ok;
+    return ok ? 0 : 1;
+}
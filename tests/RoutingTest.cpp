@@ -0,0 +1,102 @@
+// Checks that the worker pool's channel groups process the band routings like
+// the inline band chain: on a 7.1.4 bus, with bands routed to the stereo pair
+// and one routed to the surrounds, both outputs have to match.
+//
+// Exits with 1 on a mismatch.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+#include <iostream>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    constexpr int numBlocks = 40;
+
+    juce::AudioBuffer<double> render(int numWorkers, int routing)
+    {
+        AFEQAudioProcessor proc;
+        const auto layout = juce::AudioChannelSet::create7point1point4();
+        juce::AudioProcessor::BusesLayout buses;
+        buses.inputBuses.add(layout);
+        buses.outputBuses.add(layout);
+        proc.setBusesLayout(buses);
+
+        auto state = proc.captureState();
+        state.workers = numWorkers;
+        state.analyser = AFEQAudioProcessor::kAnalyserDisabled;
+
+        auto& band = state.bands[0];
+        band.enabled = true;
+        band.type = BandParams::bandPeak;
+        band.routing = routing;
+        band.freq = 1000.f;
+        band.gain = 12.f;
+        band.q = 2.f;
+
+        auto& surrounds = state.bands[1];
+        surrounds.enabled = true;
+        surrounds.type = BandParams::bandHighShelf;
+        surrounds.routing = BandParams::routeSurrounds;
+        surrounds.freq = 4000.f;
+        surrounds.gain = -6.f;
+
+        proc.applyState(state);
+
+        // the bands design in the block, as in a render
+        proc.setNonRealtime(true);
+        proc.prepareToPlay(sampleRate, blockSize);
+
+        const auto numChannels = layout.size();
+        juce::AudioBuffer<double> output(numChannels, numBlocks * blockSize);
+        juce::AudioBuffer<double> buffer(numChannels, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random rnd(1);
+
+        for (int blk = 0; blk < numBlocks; ++blk)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int i = 0; i < blockSize; ++i)
+                    buffer.setSample(ch, i, rnd.nextDouble() - 0.5);
+
+            proc.processBlock(buffer, midi);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                output.copyFrom(ch, blk * blockSize, buffer, ch, 0, blockSize);
+        }
+
+        proc.releaseResources();
+        return output;
+    }
+
+    double getMaxDifference(const juce::AudioBuffer<double>& a, const juce::AudioBuffer<double>& b)
+    {
+        auto maxDiff = 0.0;
+
+        for (int ch = 0; ch < a.getNumChannels(); ++ch)
+            for (int i = 0; i < a.getNumSamples(); ++i)
+                maxDiff = juce::jmax(maxDiff, std::abs(a.getSample(ch, i) - b.getSample(ch, i)));
+
+        return maxDiff;
+    }
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    auto failed = false;
+
+    for (const auto routing : { BandParams::routeLeft, BandParams::routeRight, BandParams::routeMid, BandParams::routeSide })
+    {
+        const auto maxDiff = getMaxDifference(render(0, routing), render(2, routing));
+        const auto ok = maxDiff < 1e-9;
+        failed = failed || ! ok;
+
+        std::cout << (ok ? "PASSED " : "FAILED ") << BandParams::getNameForRouting(routing) << " on 7.1.4: workers differ from inline by "
+                  << maxDiff << std::endl;
+    }
+
+    return failed ? 1 : 0;
+}
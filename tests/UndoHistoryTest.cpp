@@ -0,0 +1,158 @@
+// Checks UndoHistory: overlapping gestures record one step when the last of
+// them ends, quick gestures on the same parameters merge into one step while
+// one after coalesceMs or on other parameters doesn't, a merged step back at
+// its start is dropped, and a long history stays within its memory budget
+// with the oldest steps dropped and the rest still undoing in order.
+//
+// Exits with 1 on a mismatch.
+
+#include <JuceHeader.h>
+#include "UndoHistory.h"
+
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    constexpr int numBands = 12;
+
+    bool report(bool ok, const juce::String& what)
+    {
+        std::cout << (ok ? "PASSED " : "FAILED ") << what << std::endl;
+        return ok;
+    }
+
+    bool testOverlap()
+    {
+        UndoHistory history;
+        UndoHistory::Bands bands(numBands);
+        const auto start = bands;
+
+        // frequency and gain of a dragged band
+        history.beginGesture(bands);
+        bands[2].freq = 500.f;
+        history.beginGesture(bands);
+        bands[2].gain = 3.f;
+        history.endGesture(bands);
+
+        auto ok = history.isInGesture() && history.getNumUndoSteps() == 0 && ! history.undo(bands);
+
+        bands[2].freq = 700.f;
+        history.endGesture(bands);
+        ok = ok && ! history.isInGesture() && history.getNumUndoSteps() == 1;
+
+        const auto end = bands;
+        ok = ok && history.undo(bands) && bands == start && history.redo(bands) && bands == end;
+
+        return report(ok, "overlapping gestures record one step");
+    }
+
+    void edit(UndoHistory& history, UndoHistory::Bands& bands, const std::function<void(UndoHistory::Bands&)>& change)
+    {
+        history.beginGesture(bands);
+        change(bands);
+        history.endGesture(bands);
+    }
+
+    bool testCoalescing()
+    {
+        UndoHistory history;
+        UndoHistory::Bands bands(numBands);
+        const auto start = bands;
+
+        // mouse wheel ticks
+        for (int i = 0; i < 3; ++i)
+            edit(history, bands, [](UndoHistory::Bands& b) { b[0].q += 0.5f; });
+
+        auto ok = history.getNumUndoSteps() == 1;
+
+        // other parameters start a step of their own
+        edit(history, bands, [](UndoHistory::Bands& b) { b[0].gain += 1.f; });
+        ok = ok && history.getNumUndoSteps() == 2;
+
+        // as do the same ones after another step, or later than coalesceMs
+        edit(history, bands, [](UndoHistory::Bands& b) { b[0].q += 0.5f; });
+        ok = ok && history.getNumUndoSteps() == 3;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int> (UndoHistory::coalesceMs) + 100));
+        edit(history, bands, [](UndoHistory::Bands& b) { b[0].q += 0.5f; });
+        ok = ok && history.getNumUndoSteps() == 4;
+
+        for (int i = 0; i < 4; ++i)
+            ok = ok && history.undo(bands);
+
+        ok = ok && bands == start;
+        return report(ok, "quick gestures on the same parameters merge");
+    }
+
+    bool testReturnToStart()
+    {
+        UndoHistory history;
+        UndoHistory::Bands bands(numBands);
+
+        edit(history, bands, [](UndoHistory::Bands& b) { b[1].freq = 200.f; });
+        const auto before = bands;
+
+        edit(history, bands, [](UndoHistory::Bands& b) { b[4].gain = 2.f; });
+        edit(history, bands, [](UndoHistory::Bands& b) { b[4].gain = 0.f; });
+
+        auto ok = history.getNumUndoSteps() == 1 && bands == before;
+
+        // nothing to merge with after the drop
+        edit(history, bands, [](UndoHistory::Bands& b) { b[4].gain = 1.f; });
+        ok = ok && history.getNumUndoSteps() == 2;
+
+        return report(ok, "a merged step back at its start is dropped");
+    }
+
+    bool testTrim()
+    {
+        constexpr int numSteps = 2000;
+        constexpr size_t maxBytes = 64 * 1024;
+
+        UndoHistory history(maxBytes);
+        UndoHistory::Bands bands(numBands);
+        std::vector<UndoHistory::Bands> states { bands };
+        auto ok = true;
+
+        // each step changes all fields of another band, so none merge
+        for (int i = 0; i < numSteps; ++i)
+        {
+            edit(history, bands, [i](UndoHistory::Bands& b) {
+                auto& band = b[static_cast<size_t> (i % numBands)];
+                band.enabled = ! band.enabled;
+                band.type = (band.type + 1) % BandParams::bandNumTypes;
+                band.freq += 10.f;
+                band.gain += 0.5f;
+                band.q += 0.1f;
+                band.threshold -= 1.f;
+                band.ratio += 0.25f;
+            });
+
+            states.push_back(bands);
+            ok = ok && history.getMemoryBytes() <= maxBytes;
+        }
+
+        const auto numKept = history.getNumUndoSteps();
+        const auto usedBytes = history.getMemoryBytes();
+        ok = ok && numKept > 0 && numKept < numSteps;
+
+        for (int i = 0; i < numKept; ++i)
+            ok = ok && history.undo(bands) && bands == states[static_cast<size_t> (numSteps - i - 1)];
+
+        ok = ok && ! history.undo(bands);
+
+        return report(ok, juce::String(numKept) + " of " + juce::String(numSteps) + " steps kept in "
+                              + juce::String(static_cast<int> (usedBytes)) + " bytes");
+    }
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    auto ok = testOverlap();
+    ok = testCoalescing() && ok;
+    ok = testReturnToStart() && ok;
+    ok = testTrim() && ok;
+    return ok ? 0 : 1;
+}
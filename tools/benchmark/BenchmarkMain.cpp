@@ -0,0 +1,974 @@
+// Headless benchmark of the AFEQ DSP. Prints one JSON document with the cost of
+// every case in ns per sample frame (all channels), or ns per call where a case
+// does not process audio.
+//
+// Usage: afeq_benchmark [--quick] [--filter <substring>] [--out <file.json>]
+
+#include <JuceHeader.h>
+#include "dsp/EqBandDsp.h"
+#include "dsp/FFTAnalyser.h"
+#include "dsp/NonUniformConvolver.h"
+#include "dsp/ParallelForm.h"
+#include "dsp/UniformConvolver.h"
+#include "PluginProcessor.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numChannels = 2;
+    constexpr int signalLength = 1 << 16;
+    const int blockSizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        double minSecondsPerCase = 0.01;
+        juce::String filter;
+        juce::File outFile;
+    };
+
+    // Parameters of one band, owned here since there is no processor.
+    struct BandParameters
+    {
+        explicit BandParameters(BandParams& bp)
+        {
+            const auto types = BandParams::getTypeNames();
+            const auto routings = BandParams::getRoutingNames();
+
+            enabled = std::make_unique<juce::AudioParameterBool>(juce::ParameterID("enabled", 1), "enabled", false);
+            type = std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("type", 1), "type", types, 0);
+            routing = std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("routing", 1), "routing", routings, 0);
+            freq = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("freq", 1), "freq", juce::NormalisableRange<float>(20.f, 20e3f), 1000.f);
+            gain = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("gain", 1), "gain", juce::NormalisableRange<float>(-24.f, 24.f), 0.f);
+            q = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("q", 1), "q", juce::NormalisableRange<float>(0.1f, 10.f), 0.707f);
+            order = std::make_unique<juce::AudioParameterInt>(juce::ParameterID("order", 1), "order", 1, bp.maxOrder, 2);
+            dynamic = std::make_unique<juce::AudioParameterBool>(juce::ParameterID("dynamic", 1), "dynamic", false);
+            threshold = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("threshold", 1), "threshold", juce::NormalisableRange<float>(-60.f, 0.f), -20.f);
+            ratio = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("ratio", 1), "ratio", juce::NormalisableRange<float>(1.f, 20.f), 2.f);
+            attack = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("attack", 1), "attack", juce::NormalisableRange<float>(0.1f, 200.f), 10.f);
+            release = std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("release", 1), "release", juce::NormalisableRange<float>(5.f, 2000.f), 100.f);
+            engine = std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("engine", 1), "engine", BandParams::getEngineNames(), 0);
+
+            bp.enabledParam = enabled.get();
+            bp.typeParam = type.get();
+            bp.routingParam = routing.get();
+            bp.freqParam = freq.get();
+            bp.gainParam = gain.get();
+            bp.qParam = q.get();
+            bp.orderParam = order.get();
+            bp.dynamicParam = dynamic.get();
+            bp.thresholdParam = threshold.get();
+            bp.ratioParam = ratio.get();
+            bp.attackParam = attack.get();
+            bp.releaseParam = release.get();
+            bp.engineParam = engine.get();
+        }
+
+        std::unique_ptr<juce::AudioParameterBool> enabled;
+        std::unique_ptr<juce::AudioParameterChoice> type;
+        std::unique_ptr<juce::AudioParameterChoice> routing;
+        std::unique_ptr<juce::AudioParameterFloat> freq;
+        std::unique_ptr<juce::AudioParameterFloat> gain;
+        std::unique_ptr<juce::AudioParameterFloat> q;
+        std::unique_ptr<juce::AudioParameterInt> order;
+        std::unique_ptr<juce::AudioParameterBool> dynamic;
+        std::unique_ptr<juce::AudioParameterFloat> threshold;
+        std::unique_ptr<juce::AudioParameterFloat> ratio;
+        std::unique_ptr<juce::AudioParameterFloat> attack;
+        std::unique_ptr<juce::AudioParameterFloat> release;
+        std::unique_ptr<juce::AudioParameterChoice> engine;
+    };
+
+    struct Chain
+    {
+        Chain(int numBands, int blockSize, double rate = sampleRate)
+            : freqResBase(300, 20.f, 20e3f)
+        {
+            freqResBase.setSampleRate(static_cast<float> (rate));
+
+            for (int i = 0; i < numBands; ++i)
+            {
+                auto band = bands.add(std::make_unique<EqBandDsp>(8, freqResBase, i + 1));
+                params.add(std::make_unique<BandParameters>(band->getBandParams()));
+                band->setBlockSize(blockSize);
+                band->setSampleRate(rate);
+            }
+        }
+
+        void setBand(int index, BandParams::Type type, int order, BandParams::Routing routing, float freq)
+        {
+            auto& p = *params[index];
+            *p.enabled = true;
+            *p.type = static_cast<int> (type);
+            *p.routing = static_cast<int> (routing);
+            *p.order = order;
+            *p.freq = freq;
+            *p.gain = 6.f;
+            *p.q = 1.f;
+        }
+
+        void setChannelLayout(const juce::AudioChannelSet& layout)
+        {
+            for (auto b : bands)
+                b->setChannelLayout(layout);
+        }
+
+        void process(double* chL, double* chR, int numSamples)
+        {
+            for (auto b : bands)
+                b->processBlock(chL, chR, numSamples);
+        }
+
+        void process(double* const* channels, int numChans, int numSamples)
+        {
+            for (auto b : bands)
+                b->processBlock(channels, numChans, numSamples);
+        }
+
+        FreqResponseBase freqResBase;
+        EqBandDspGroup bands;
+        juce::OwnedArray<BandParameters> params;
+    };
+
+    struct Signal
+    {
+        Signal()
+            : noise(numChannels, signalLength), work(numChannels, signalLength), workFloat(numChannels, signalLength)
+        {
+            juce::Random rnd(1234);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int i = 0; i < signalLength; ++i)
+                    noise.setSample(ch, i, 0.25 * (2.0 * rnd.nextDouble() - 1.0));
+        }
+
+        void reset()
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                work.copyFrom(ch, 0, noise, ch, 0, signalLength);
+
+                for (int i = 0; i < signalLength; ++i)
+                    workFloat.setSample(ch, i, static_cast<float> (noise.getSample(ch, i)));
+            }
+        }
+
+        juce::AudioBuffer<double> noise;
+        juce::AudioBuffer<double> work;
+        juce::AudioBuffer<float> workFloat;
+    };
+
+    // Runs passes over the test signal until enough time was measured and
+    // returns nanoseconds per processed sample frame.
+    template <typename ProcessFn>
+    double measure(const Options& opt, Signal& signal, ProcessFn&& process)
+    {
+        signal.reset();
+        process();
+
+        double seconds = 0.0;
+        juce::int64 frames = 0;
+
+        while (seconds < opt.minSecondsPerCase)
+        {
+            signal.reset();
+            const auto start = Clock::now();
+            process();
+            seconds += std::chrono::duration<double>(Clock::now() - start).count();
+            frames += signalLength;
+        }
+
+        return 1e9 * seconds / static_cast<double> (frames);
+    }
+
+    // Mirrors the float path of AFEQAudioProcessor: convert, process in double, convert back.
+    void processFloat(Chain& chain, juce::AudioBuffer<float>& io, juce::AudioBuffer<double>& temp, int blockSize)
+    {
+        for (int pos = 0; pos < signalLength; pos += blockSize)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto in = io.getReadPointer(ch, pos);
+                auto out = temp.getWritePointer(ch);
+
+                for (int i = 0; i < blockSize; ++i)
+                    out[i] = static_cast<double> (in[i]);
+            }
+
+            chain.process(temp.getWritePointer(0), temp.getWritePointer(1), blockSize);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto in = temp.getReadPointer(ch);
+                auto out = io.getWritePointer(ch, pos);
+
+                for (int i = 0; i < blockSize; ++i)
+                    out[i] = static_cast<float> (in[i]);
+            }
+        }
+    }
+
+    void processDouble(Chain& chain, juce::AudioBuffer<double>& io, int blockSize)
+    {
+        for (int pos = 0; pos < signalLength; pos += blockSize)
+            chain.process(io.getWritePointer(0, pos), io.getWritePointer(1, pos), blockSize);
+    }
+
+    class Benchmark
+    {
+    public:
+
+        explicit Benchmark(const Options& o) : opt(o) {}
+
+        void add(const juce::String& group, const juce::String& name, juce::DynamicObject::Ptr config, const juce::String& unit, double value)
+        {
+            if (opt.filter.isNotEmpty() && ! (group + "/" + name).contains(opt.filter))
+                return;
+
+            config->setProperty("group", group);
+            config->setProperty("name", name);
+            config->setProperty(unit, value);
+            results.add(juce::var(config.get()));
+            std::cerr << group << "/" << name << ": " << value << " " << unit << std::endl;
+        }
+
+        bool wants(const juce::String& group, const juce::String& name) const
+        {
+            return opt.filter.isEmpty() || (group + "/" + name).contains(opt.filter);
+        }
+
+        void runBandCases()
+        {
+            for (int t = 0; t < BandParams::bandNumTypes; ++t)
+            {
+                const auto type = static_cast<BandParams::Type> (t);
+                BandParams limits;
+                const auto minOrder = limits.getMinOrderForType(type);
+                const auto maxOrder = limits.getMaxOrderForType(type);
+
+                for (int order = minOrder; order <= maxOrder; ++order)
+                    for (int r = 0; r < BandParams::routeNumRoutings; ++r)
+                        for (auto blockSize : blockSizes)
+                            for (auto useDouble : { false, true })
+                            {
+                                const auto routing = static_cast<BandParams::Routing> (r);
+                                const auto name = BandParams::getTypeNames()[t] + " o" + juce::String(order) + " "
+                                    + BandParams::getNameForRouting(routing) + " b" + juce::String(blockSize) + (useDouble ? " double" : " float");
+
+                                if (! wants("band", name))
+                                    continue;
+
+                                Chain chain(1, blockSize);
+                                chain.setBand(0, type, order, routing, 1000.f);
+
+                                juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                                config->setProperty("type", BandParams::getTypeNames()[t]);
+                                config->setProperty("order", order);
+                                config->setProperty("routing", BandParams::getNameForRouting(routing));
+                                config->setProperty("blockSize", blockSize);
+                                config->setProperty("precision", useDouble ? "double" : "float");
+                                add("band", name, config, "nsPerSample", runChain(chain, blockSize, useDouble));
+                            }
+            }
+        }
+
+        void runBandCountCases()
+        {
+            for (int numBands = 1; numBands <= 12; ++numBands)
+                for (auto blockSize : blockSizes)
+                    for (auto useDouble : { false, true })
+                    {
+                        const auto name = juce::String(numBands) + " bands b" + juce::String(blockSize) + (useDouble ? " double" : " float");
+
+                        if (! wants("bands", name))
+                            continue;
+
+                        Chain chain(12, blockSize);
+
+                        for (int i = 0; i < numBands; ++i)
+                            chain.setBand(i, BandParams::bandPeak, 2, BandParams::routeStereo, 40.f * std::pow(2.f, 0.8f * i));
+
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("enabledBands", numBands);
+                        config->setProperty("blockSize", blockSize);
+                        config->setProperty("precision", useDouble ? "double" : "float");
+                        add("bands", name, config, "nsPerSample", runChain(chain, blockSize, useDouble));
+                    }
+        }
+
+        // 12 stereo bells and shelves, static and in the dynamic mode with a
+        // threshold the noise stays above, plus the ratio of both costs.
+        void runDynamicCases()
+        {
+            for (auto blockSize : { 64, 256, 1024 })
+            {
+                const auto suffix = " b" + juce::String(blockSize);
+                double cost[2] = {};
+
+                for (auto dynamic : { false, true })
+                {
+                    const auto name = juce::String(dynamic ? "12 dynamic" : "12 static") + suffix;
+
+                    if (! wants("dynamic", name) && ! wants("dynamic", "relative" + suffix))
+                        continue;
+
+                    Chain chain(12, blockSize);
+
+                    for (int i = 0; i < 12; ++i)
+                    {
+                        const auto type = i == 0 ? BandParams::bandLoShelf : i == 11 ? BandParams::bandVOHiShelf : BandParams::bandPeak;
+                        chain.setBand(i, type, 2, BandParams::routeStereo, 40.f * std::pow(2.f, 0.8f * i));
+                        auto& p = *chain.params[i];
+                        *p.dynamic = dynamic;
+                        *p.threshold = -50.f;
+                        *p.ratio = 4.f;
+                        *p.attack = 1.f;
+                    }
+
+                    juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                    config->setProperty("dynamic", dynamic);
+                    config->setProperty("blockSize", blockSize);
+                    cost[dynamic ? 1 : 0] = runChain(chain, blockSize, true);
+                    add("dynamic", name, config, "nsPerSample", cost[dynamic ? 1 : 0]);
+                }
+
+                if (cost[0] > 0.0 && cost[1] > 0.0)
+                {
+                    juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                    config->setProperty("blockSize", blockSize);
+                    add("dynamic", "relative" + suffix, config, "dynamicOverStatic", cost[1] / cost[0]);
+                }
+            }
+        }
+
+        // The cascade of every band order (one section per two orders) on 1, 2
+        // and 4 channels, on the kernels compiled for the section and channel
+        // count and on the tiled loop, plus the speedup. The sections are
+        // allpasses, so the repeated passes over the buffer keep their level.
+        void runKernelCases()
+        {
+            for (int order = 1; order <= 8; ++order)
+                for (auto numLanes : { 1, 2, 4 })
+                {
+                    const auto numSections = (order + 1) / 2;
+                    const auto suffix = " o" + juce::String(order) + " c" + juce::String(numLanes);
+                    double cost[2] = {};
+
+                    for (auto fixed : { false, true })
+                    {
+                        const auto name = juce::String(fixed ? "fixed" : "tiled") + suffix;
+
+                        if (! wants("kernel", name) && ! wants("kernel", "speedup" + suffix))
+                            continue;
+
+                        std::vector<BiquadCoeffs> coeffs(static_cast<size_t> (numSections));
+
+                        for (int s = 0; s < numSections; ++s)
+                        {
+                            auto& c = coeffs[static_cast<size_t> (s)];
+                            const auto r = 0.95;
+                            c.a1 = -2.0 * r * std::cos(0.05 * (s + 1));
+                            c.a2 = r * r;
+                            c.b0 = c.a2;
+                            c.b1 = c.a1;
+                            c.b2 = 1.0;
+                        }
+
+                        MultiChannelCascade cascade(8);
+                        cascade.setMaxChannels(numLanes);
+                        cascade.setFixedKernelsEnabled(fixed);
+                        cascade.setCoefficients(coeffs.data(), numSections);
+
+                        juce::AudioBuffer<double> io(numLanes, signalLength);
+
+                        for (int ch = 0; ch < numLanes; ++ch)
+                            io.copyFrom(ch, 0, signal.noise, ch % numChannels, 0, signalLength);
+
+                        std::vector<double*> channels(static_cast<size_t> (numLanes));
+
+                        cost[fixed ? 1 : 0] = measure(opt, signal, [&]() {
+                            for (int pos = 0; pos < signalLength; pos += 256)
+                            {
+                                for (int ch = 0; ch < numLanes; ++ch)
+                                    channels[static_cast<size_t> (ch)] = io.getWritePointer(ch, pos);
+
+                                cascade.process(channels.data(), numLanes, 256);
+                            }
+                        });
+
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("order", order);
+                        config->setProperty("sections", numSections);
+                        config->setProperty("channels", numLanes);
+                        config->setProperty("kernel", fixed ? "fixed" : "tiled");
+                        add("kernel", name, config, "nsPerSample", cost[fixed ? 1 : 0]);
+                    }
+
+                    if (cost[0] > 0.0 && cost[1] > 0.0)
+                    {
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("order", order);
+                        config->setProperty("channels", numLanes);
+                        add("kernel", "speedup" + suffix, config, "tiledOverFixed", cost[0] / cost[1]);
+                    }
+                }
+        }
+
+        // Peak sections from 30 Hz to 18 kHz, alternately +6 and -6 dB, on 1 and
+        // 2 channels as a cascade and as a parallel form, plus the speedup.
+        void runParallelCases()
+        {
+            for (auto numSections : { 4, 12, 24, 48 })
+                for (auto numLanes : { 1, 2 })
+                {
+                    const auto suffix = " s" + juce::String(numSections) + " c" + juce::String(numLanes);
+                    double cost[2] = {};
+
+                    std::vector<BiquadCoeffs> coeffs(static_cast<size_t> (numSections));
+
+                    for (int s = 0; s < numSections; ++s)
+                    {
+                        const auto freq = 30.0 * std::pow(600.0, (s + 0.5) / numSections);
+                        // square root of the peak gain, Q of 1
+                        const auto a = juce::Decibels::decibelsToGain(s % 2 == 0 ? 3.0 : -3.0);
+                        const auto w = juce::MathConstants<double>::twoPi * freq / sampleRate;
+                        const auto alpha = 0.5 * std::sin(w);
+                        const auto a0 = 1.0 + alpha / a;
+                        auto& c = coeffs[static_cast<size_t> (s)];
+                        c.b0 = (1.0 + alpha * a) / a0;
+                        c.b1 = -2.0 * std::cos(w) / a0;
+                        c.b2 = (1.0 - alpha * a) / a0;
+                        c.a1 = c.b1;
+                        c.a2 = (1.0 - alpha / a) / a0;
+                    }
+
+                    for (auto parallel : { false, true })
+                    {
+                        const auto name = juce::String(parallel ? "parallel" : "cascade") + suffix;
+
+                        if (! wants("parallel", name) && ! wants("parallel", "speedup" + suffix))
+                            continue;
+
+                        MultiChannelCascade cascade(numSections);
+                        cascade.setMaxChannels(numLanes);
+                        cascade.setCoefficients(coeffs.data(), numSections);
+
+                        ParallelForm form(numSections);
+                        form.setMaxChannels(numLanes);
+
+                        if (parallel && ! form.design(coeffs.data(), numSections))
+                        {
+                            std::cerr << "parallel form failed for " << name << std::endl;
+                            continue;
+                        }
+
+                        std::vector<double*> channels(static_cast<size_t> (numLanes));
+
+                        cost[parallel ? 1 : 0] = measure(opt, signal, [&]() {
+                            for (int pos = 0; pos < signalLength; pos += 256)
+                            {
+                                for (int ch = 0; ch < numLanes; ++ch)
+                                    channels[static_cast<size_t> (ch)] = signal.work.getWritePointer(ch, pos);
+
+                                if (parallel)
+                                    form.process(channels.data(), numLanes, 256);
+                                else
+                                    cascade.process(channels.data(), numLanes, 256);
+                            }
+                        });
+
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("sections", numSections);
+                        config->setProperty("channels", numLanes);
+                        config->setProperty("form", parallel ? "parallel" : "cascade");
+                        add("parallel", name, config, "nsPerSample", cost[parallel ? 1 : 0]);
+                    }
+
+                    if (cost[0] > 0.0 && cost[1] > 0.0)
+                    {
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("sections", numSections);
+                        config->setProperty("channels", numLanes);
+                        add("parallel", "speedup" + suffix, config, "cascadeOverParallel", cost[0] / cost[1]);
+                    }
+                }
+        }
+
+        // 12 stereo bells and shelves on the biquad and the SVF engine, static and
+        // with frequency and gain of every band automated in every block.
+        void runSvfCases()
+        {
+            for (auto blockSize : { 16, 64, 256 })
+                for (auto automated : { false, true })
+                    for (auto svf : { false, true })
+                    {
+                        const auto name = juce::String(svf ? "svf" : "biquad") + (automated ? " automated" : " static") + " b" + juce::String(blockSize);
+
+                        if (! wants("svf", name))
+                            continue;
+
+                        Chain chain(12, blockSize);
+
+                        for (int i = 0; i < 12; ++i)
+                        {
+                            const auto type = i == 0 ? BandParams::bandLoShelf : i == 11 ? BandParams::bandVOHiShelf : BandParams::bandPeak;
+                            chain.setBand(i, type, 2, BandParams::routeStereo, 40.f * std::pow(2.f, 0.8f * i));
+                            *chain.params[i]->engine = svf ? BandParams::engineSvf : BandParams::engineBiquad;
+                        }
+
+                        int block = 0;
+
+                        const auto value = measure(opt, signal, [&]() {
+                            for (int pos = 0; pos < signalLength; pos += blockSize, ++block)
+                            {
+                                if (automated)
+                                {
+                                    for (int i = 0; i < 12; ++i)
+                                    {
+                                        const auto lfo = std::sin(0.01f * static_cast<float> (block) + static_cast<float> (i));
+                                        *chain.params[i]->freq = 40.f * std::pow(2.f, 0.8f * i + 0.5f * lfo);
+                                        *chain.params[i]->gain = 6.f * lfo;
+                                    }
+                                }
+
+                                chain.process(signal.work.getWritePointer(0, pos), signal.work.getWritePointer(1, pos), blockSize);
+                            }
+                        });
+
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("engine", svf ? "svf" : "biquad");
+                        config->setProperty("automated", automated);
+                        config->setProperty("blockSize", blockSize);
+                        add("svf", name, config, "nsPerSample", value);
+                    }
+        }
+
+        // A 7.1.4 bed with 12 peak bands on all channels, once as one multichannel
+        // chain and once as six stereo chains, in ns per frame of all 12 channels.
+        void runBedCases()
+        {
+            const auto layout = juce::AudioChannelSet::create7point1point4();
+            const auto numBedChannels = layout.size();
+            juce::AudioBuffer<double> bed(numBedChannels, signalLength);
+
+            for (auto blockSize : blockSizes)
+                for (auto split : { false, true })
+                {
+                    const auto name = juce::String(split ? "6x stereo" : "1x 7.1.4") + " b" + juce::String(blockSize);
+
+                    if (! wants("bed", name))
+                        continue;
+
+                    juce::OwnedArray<Chain> chains;
+
+                    for (int c = 0; c < (split ? numBedChannels / 2 : 1); ++c)
+                    {
+                        auto chain = chains.add(std::make_unique<Chain>(12, blockSize));
+
+                        if (! split)
+                            chain->setChannelLayout(layout);
+
+                        for (int i = 0; i < 12; ++i)
+                            chain->setBand(i, BandParams::bandPeak, 2, BandParams::routeStereo, 40.f * std::pow(2.f, 0.8f * i));
+                    }
+
+                    // the reset of the bed is timed too, it's the same for both variants
+                    const auto nsPerSample = measure(opt, signal, [&]() {
+                        for (int ch = 0; ch < numBedChannels; ++ch)
+                            bed.copyFrom(ch, 0, signal.noise, ch % numChannels, 0, signalLength);
+
+                        for (int pos = 0; pos < signalLength; pos += blockSize)
+                        {
+                            double* channels[64];
+
+                            for (int ch = 0; ch < numBedChannels; ++ch)
+                                channels[ch] = bed.getWritePointer(ch, pos);
+
+                            if (split)
+                                for (int c = 0; c < chains.size(); ++c)
+                                    chains[c]->process(channels[2 * c], channels[2 * c + 1], blockSize);
+                            else
+                                chains[0]->process(channels, numBedChannels, blockSize);
+                        }
+                    });
+
+                    juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                    config->setProperty("layout", layout.getDescription());
+                    config->setProperty("instances", chains.size());
+                    config->setProperty("blockSize", blockSize);
+                    add("bed", name, config, "nsPerSample", nsPerSample);
+                }
+        }
+
+        // 12 peak bands inside the oversampling of AFEQAudioProcessor, per
+        // factor and filter type, in ns per frame at the host rate. Factor 1 is
+        // the chain alone.
+        void runOversamplingCases()
+        {
+            for (auto factor : { 1, 2, 4, 8 })
+                for (auto linearPhase : { false, true })
+                    for (auto blockSize : { 64, 512 })
+                    {
+                        if (factor == 1 && linearPhase)
+                            continue;
+
+                        const auto name = juce::String(factor) + "x " + (linearPhase ? "fir" : "iir") + " b" + juce::String(blockSize);
+
+                        if (! wants("oversampling", name))
+                            continue;
+
+                        Chain chain(12, blockSize * factor, sampleRate * factor);
+
+                        for (int i = 0; i < 12; ++i)
+                            chain.setBand(i, BandParams::bandPeak, 2, BandParams::routeStereo, 40.f * std::pow(2.f, 0.8f * i));
+
+                        const auto filterType = linearPhase ? juce::dsp::Oversampling<double>::filterHalfBandFIREquiripple
+                                                            : juce::dsp::Oversampling<double>::filterHalfBandPolyphaseIIR;
+                        juce::dsp::Oversampling<double> oversampling(numChannels, static_cast<size_t> (juce::roundToInt(std::log2(factor))),
+                                                                     filterType, true, true);
+                        oversampling.initProcessing(static_cast<size_t> (blockSize));
+
+                        const auto nsPerSample = measure(opt, signal, [&]() {
+                            for (int pos = 0; pos < signalLength; pos += blockSize)
+                            {
+                                juce::dsp::AudioBlock<double> block(signal.work.getArrayOfWritePointers(), numChannels,
+                                                                    static_cast<size_t> (pos), static_cast<size_t> (blockSize));
+
+                                if (factor == 1)
+                                {
+                                    chain.process(block.getChannelPointer(0), block.getChannelPointer(1), blockSize);
+                                    continue;
+                                }
+
+                                auto upBlock = oversampling.processSamplesUp(block);
+                                chain.process(upBlock.getChannelPointer(0), upBlock.getChannelPointer(1), static_cast<int> (upBlock.getNumSamples()));
+                                oversampling.processSamplesDown(block);
+                            }
+                        });
+
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("factor", factor);
+                        config->setProperty("filter", linearPhase ? "FIR equiripple" : "IIR polyphase");
+                        config->setProperty("latency", factor == 1 ? 0.0 : oversampling.getLatencyInSamples());
+                        config->setProperty("blockSize", blockSize);
+                        add("oversampling", name, config, "nsPerSample", nsPerSample);
+                    }
+        }
+
+        // Long FIR kernels, one per channel. The non-uniform engine runs its
+        // background stages inline here, which gives its total cost; what stays
+        // on the audio thread with the threads keeping up is the first stage,
+        // measured as a uniform convolution of the head of the kernel.
+        void runConvolutionCases()
+        {
+            const int blockSize = 256;
+
+            for (auto numTaps : { 4096, 16384, 65536 })
+                for (auto nonUniform : { false, true })
+                    for (auto partitionSize : { 64, 256, 1024, 4096 })
+                    {
+                        if (nonUniform && partitionSize > 256)
+                            continue;
+
+                        const auto name = juce::String(nonUniform ? "non-uniform" : "uniform") + " p" + juce::String(partitionSize)
+                            + " " + juce::String(numTaps) + " taps";
+
+                        if (! wants("convolution", name))
+                            continue;
+
+                        juce::Random rnd(99);
+                        std::vector<float> kernel(static_cast<size_t> (numTaps));
+
+                        for (int i = 0; i < numTaps; ++i)
+                            kernel[static_cast<size_t> (i)] = (2.f * rnd.nextFloat() - 1.f) * std::exp(-4.f * static_cast<float> (i) / static_cast<float> (numTaps));
+
+                        const auto run = [&](PartitionedConvolver& convolver, int kernelLength) {
+                            convolver.prepare(numChannels, partitionSize, kernelLength, numChannels, numChannels);
+                            convolver.beginKernels();
+                            std::vector<PartitionedConvolver::Path> paths;
+
+                            for (int ch = 0; ch < numChannels; ++ch)
+                            {
+                                convolver.setKernel(ch, kernel.data(), kernelLength);
+                                paths.push_back({ ch, ch, ch });
+                            }
+
+                            convolver.setPaths(paths);
+                            convolver.publishKernels();
+
+                            return measure(opt, signal, [&]() {
+                                for (int pos = 0; pos < signalLength; pos += blockSize)
+                                {
+                                    double* channels[numChannels];
+
+                                    for (int ch = 0; ch < numChannels; ++ch)
+                                        channels[ch] = signal.work.getWritePointer(ch, pos);
+
+                                    convolver.process(channels, numChannels, blockSize);
+                                }
+                            });
+                        };
+
+                        juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                        config->setProperty("taps", numTaps);
+                        config->setProperty("partitionSize", partitionSize);
+                        config->setProperty("latency", partitionSize);
+                        config->setProperty("blockSize", blockSize);
+
+                        if (nonUniform)
+                        {
+                            NonUniformConvolver convolver;
+                            convolver.setUseBackgroundThreads(false);
+                            const auto nsPerSample = run(convolver, numTaps);
+
+                            juce::StringArray stageSizes;
+
+                            for (int i = 0; i < convolver.getNumStages(); ++i)
+                                stageSizes.add(juce::String(convolver.getStageSize(i)));
+
+                            const auto headLength = convolver.getNumStages() > 1 ? convolver.getStageFirstTap(1) : numTaps;
+                            UniformConvolver head;
+                            config->setProperty("stages", stageSizes.joinIntoString(" "));
+                            config->setProperty("audioThreadNsPerSample", run(head, headLength));
+                            add("convolution", name, config, "nsPerSample", nsPerSample);
+                        }
+                        else
+                        {
+                            UniformConvolver convolver;
+                            const auto nsPerSample = run(convolver, numTaps);
+                            config->setProperty("audioThreadNsPerSample", nsPerSample);
+                            add("convolution", name, config, "nsPerSample", nsPerSample);
+                        }
+                    }
+        }
+
+        void runAnalyserCases()
+        {
+            const int fftOrder = 13;
+            juce::dsp::FFT fft(fftOrder);
+            std::vector<float> fftBuffer(static_cast<size_t> (1 << (fftOrder + 1)));
+
+            for (auto blockSize : blockSizes)
+                for (auto useDouble : { false, true })
+                {
+                    const auto name = "b" + juce::String(blockSize) + (useDouble ? " double" : " float");
+
+                    if (! wants("analyser", name))
+                        continue;
+
+                    FFTAnalyser analyser;
+                    analyser.prepare(FFTAnalyser::getPlan(fftOrder, 4, 61, 0.3f, static_cast<int> (sampleRate)));
+                    analyser.performFFT = [&](float* data, int size) {
+                        juce::FloatVectorOperations::copy(fftBuffer.data(), data, size);
+                        fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+                        juce::FloatVectorOperations::copy(data, fftBuffer.data(), size);
+                    };
+
+                    const auto nsPerSample = measure(opt, signal, [&]() {
+                        for (int pos = 0; pos < signalLength; pos += blockSize)
+                        {
+                            if (useDouble)
+                                analyser.processBlock(signal.work.getReadPointer(0, pos), signal.work.getReadPointer(1, pos), blockSize);
+                            else
+                                analyser.processBlock(signal.workFloat.getReadPointer(0, pos), signal.workFloat.getReadPointer(1, pos), blockSize);
+                        }
+                    });
+
+                    juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                    config->setProperty("blockSize", blockSize);
+                    config->setProperty("precision", useDouble ? "double" : "float");
+                    add("analyser", name, config, "nsPerSample", nsPerSample);
+                }
+        }
+
+        void runResponseCases()
+        {
+            for (int t = 0; t < BandParams::bandNumTypes; ++t)
+            {
+                const auto type = static_cast<BandParams::Type> (t);
+                const auto order = BandParams::hasOrder(type) ? 8 : 2;
+                const auto name = BandParams::getTypeNames()[t] + " o" + juce::String(order);
+
+                if (! wants("response", name))
+                    continue;
+
+                Chain chain(1, 16);
+                chain.setBand(0, type, order, BandParams::routeStereo, 1000.f);
+                auto& band = *chain.bands[0];
+                band.syncParameters();
+
+                int numCalls = 0;
+                const auto start = Clock::now();
+                double seconds = 0.0;
+
+                while (seconds < opt.minSecondsPerCase)
+                {
+                    band.updateResponse();
+                    ++numCalls;
+                    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                }
+
+                juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                config->setProperty("type", BandParams::getTypeNames()[t]);
+                config->setProperty("order", order);
+                config->setProperty("numPoints", static_cast<int> (band.getResponse().size()));
+                add("response", name, config, "nsPerCall", 1e9 * seconds / numCalls);
+            }
+        }
+
+        // Saving and restoring a complete processor state with half of the
+        // bands in use, in the binary format and in the XML format of earlier
+        // versions.
+        void runStateCases()
+        {
+            auto any = false;
+
+            for (auto name : { "xml save", "xml load", "binary save", "binary load" })
+                any |= wants("state", name);
+
+            if (! any)
+                return;
+
+            juce::ScopedJuceInitialiser_GUI juceInit;
+            AFEQAudioProcessor processor;
+            auto ps = processor.captureState();
+
+            for (size_t i = 0; i < ps.bands.size(); i += 2)
+            {
+                auto& b = ps.bands[i];
+                b.enabled = true;
+                b.type = static_cast<int> (i) % BandParams::bandNumTypes;
+                b.freq = 50.f * static_cast<float> (i + 1);
+                b.gain = 3.f;
+                b.q = 1.5f;
+            }
+
+            processor.applyState(ps);
+
+            const auto time = [this](const std::function<void()>& fn) {
+                int numCalls = 0;
+                const auto start = Clock::now();
+                double seconds = 0.0;
+
+                while (seconds < opt.minSecondsPerCase)
+                {
+                    fn();
+                    ++numCalls;
+                    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                }
+
+                return 1e9 * seconds / numCalls;
+            };
+
+            for (auto binary : { false, true })
+            {
+                const juce::String format(binary ? "binary" : "xml");
+                juce::MemoryBlock data;
+
+                const auto save = [&]() {
+                    data.reset();
+
+                    if (binary)
+                        processor.getStateInformation(data);
+                    else
+                        processor.getXmlStateInformation(data);
+                };
+
+                save();
+                const auto bytes = static_cast<int> (data.getSize());
+
+                if (wants("state", format + " save"))
+                {
+                    juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                    config->setProperty("bytes", bytes);
+                    add("state", format + " save", config, "nsPerCall", time(save));
+                }
+
+                if (wants("state", format + " load"))
+                {
+                    juce::DynamicObject::Ptr config = new juce::DynamicObject();
+                    config->setProperty("bytes", bytes);
+                    add("state", format + " load", config, "nsPerCall",
+                        time([&]() { processor.setStateInformation(data.getData(), bytes); }));
+                }
+            }
+        }
+
+        juce::String toJson() const
+        {
+            juce::DynamicObject::Ptr root = new juce::DynamicObject();
+            root->setProperty("version", ProjectInfo::versionString);
+            root->setProperty("sampleRate", sampleRate);
+            root->setProperty("channels", numChannels);
+            root->setProperty("results", results);
+            return juce::JSON::toString(juce::var(root.get()));
+        }
+
+    private:
+
+        double runChain(Chain& chain, int blockSize, bool useDouble)
+        {
+            juce::AudioBuffer<double> temp(numChannels, blockSize);
+
+            return measure(opt, signal, [&]() {
+                if (useDouble)
+                    processDouble(chain, signal.work, blockSize);
+                else
+                    processFloat(chain, signal.workFloat, temp, blockSize);
+            });
+        }
+
+        const Options& opt;
+        Signal signal;
+        juce::Array<juce::var> results;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedNoDenormals noDenormals;
+    Options opt;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(argv[i]);
+
+        if (arg == "--quick")
+            opt.minSecondsPerCase = 0.001;
+        else if (arg == "--filter" && i + 1 < argc)
+            opt.filter = argv[++i];
+        else if (arg == "--out" && i + 1 < argc)
+            opt.outFile = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: afeq_benchmark [--quick] [--filter <substring>] [--out <file.json>]" << std::endl;
+            return 1;
+        }
+    }
+
+    Benchmark bench(opt);
+    bench.runBandCases();
+    bench.runBandCountCases();
+    bench.runDynamicCases();
+    bench.runSvfCases();
+    bench.runKernelCases();
+    bench.runParallelCases();
+    bench.runBedCases();
+    bench.runOversamplingCases();
+    bench.runConvolutionCases();
+    bench.runAnalyserCases();
+    bench.runResponseCases();
+    bench.runStateCases();
+
+    const auto json = bench.toJson();
+
+    if (opt.outFile != juce::File())
+        return opt.outFile.replaceWithText(json) ? 0 : 1;
+
+    std::cout << json << std::endl;
+    return 0;
+}
@@ -0,0 +1,329 @@
+#include "MappedAudio.h"
+
+#include <cstring>
+
+namespace MappedAudio
+{
+    namespace
+    {
+        constexpr int getBytesPerSample(SampleType type)
+        {
+            return type == SampleType::int16 ? 2 : type == SampleType::int24 ? 3 : 4;
+        }
+
+        template <SampleType type>
+        double decode(const char* p)
+        {
+            if constexpr (type == SampleType::int16)
+                return static_cast<juce::int16> (juce::ByteOrder::littleEndianShort(p)) * (1.0 / 32768.0);
+            else if constexpr (type == SampleType::int24)
+                return juce::ByteOrder::littleEndian24Bit(p) * (1.0 / 8388608.0);
+            else if constexpr (type == SampleType::int32)
+                return static_cast<juce::int32> (juce::ByteOrder::littleEndianInt(p)) * (1.0 / 2147483648.0);
+            else
+            {
+                const auto bits = juce::ByteOrder::littleEndianInt(p);
+                float v;
+                std::memcpy(&v, &bits, sizeof(float));
+                return v;
+            }
+        }
+
+        template <SampleType type>
+        void encode(double v, char* p)
+        {
+            if constexpr (type == SampleType::int16)
+            {
+                const auto bits = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint16> (static_cast<juce::int16> (
+                    juce::jlimit(-32768.0, 32767.0, std::round(v * 32768.0)))));
+                std::memcpy(p, &bits, 2);
+            }
+            else if constexpr (type == SampleType::int24)
+            {
+                juce::ByteOrder::littleEndian24BitToChars(static_cast<int> (juce::jlimit(-8388608.0, 8388607.0, std::round(v * 8388608.0))), p);
+            }
+            else if constexpr (type == SampleType::int32)
+            {
+                const auto bits = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint32> (static_cast<juce::int32> (
+                    juce::jlimit(-2147483648.0, 2147483647.0, std::round(v * 2147483648.0)))));
+                std::memcpy(p, &bits, 4);
+            }
+            else
+            {
+                const auto f = static_cast<float> (v);
+                juce::uint32 bits;
+                std::memcpy(&bits, &f, sizeof(float));
+                bits = juce::ByteOrder::swapIfBigEndian(bits);
+                std::memcpy(p, &bits, 4);
+            }
+        }
+
+        // Mono and stereo get the channel count as a template parameter, so the
+        // interleaved loops have a constant stride and are vectorised.
+        template <SampleType type, int fixedChannels>
+        void decodeFrames(const char* src, double* const* dest, int destOffset, int runtimeChannels, int numSamples)
+        {
+            constexpr auto bytes = getBytesPerSample(type);
+            const auto numChannels = fixedChannels > 0 ? fixedChannels : runtimeChannels;
+            const auto stride = numChannels * bytes;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto out = dest[ch] + destOffset;
+                const auto in = src + ch * bytes;
+
+                for (int i = 0; i < numSamples; ++i)
+                    out[i] = decode<type>(in + i * stride);
+            }
+        }
+
+        template <SampleType type, int fixedChannels>
+        void encodeFrames(const double* const* src, int srcOffset, char* dest, int runtimeChannels, int numSamples)
+        {
+            constexpr auto bytes = getBytesPerSample(type);
+            const auto numChannels = fixedChannels > 0 ? fixedChannels : runtimeChannels;
+            const auto stride = numChannels * bytes;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto in = src[ch] + srcOffset;
+                auto out = dest + ch * bytes;
+
+                for (int i = 0; i < numSamples; ++i)
+                    encode<type>(in[i], out + i * stride);
+            }
+        }
+
+        template <SampleType type>
+        void decodeFrames(const char* src, double* const* dest, int destOffset, int numChannels, int numSamples)
+        {
+            if (numChannels == 1)
+                decodeFrames<type, 1>(src, dest, destOffset, numChannels, numSamples);
+            else if (numChannels == 2)
+                decodeFrames<type, 2>(src, dest, destOffset, numChannels, numSamples);
+            else
+                decodeFrames<type, 0>(src, dest, destOffset, numChannels, numSamples);
+        }
+
+        template <SampleType type>
+        void encodeFrames(const double* const* src, int srcOffset, char* dest, int numChannels, int numSamples)
+        {
+            if (numChannels == 1)
+                encodeFrames<type, 1>(src, srcOffset, dest, numChannels, numSamples);
+            else if (numChannels == 2)
+                encodeFrames<type, 2>(src, srcOffset, dest, numChannels, numSamples);
+            else
+                encodeFrames<type, 0>(src, srcOffset, dest, numChannels, numSamples);
+        }
+
+        bool isTag(const char* p, const char* tag)
+        {
+            return std::memcmp(p, tag, 4) == 0;
+        }
+    }
+
+    //==============================================================================
+    std::unique_ptr<Reader> Reader::open(const juce::File& file)
+    {
+        auto map = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+        const auto base = static_cast<const char*> (map->getData());
+        const auto size = static_cast<juce::int64> (map->getSize());
+
+        if (base == nullptr || size < 12)
+            return nullptr;
+
+        const auto isRF64 = isTag(base, "RF64");
+
+        if ((! isRF64 && ! isTag(base, "RIFF")) || ! isTag(base + 8, "WAVE"))
+            return nullptr;
+
+        const char* fmt = nullptr;
+        const char* dataChunk = nullptr;
+        juce::int64 fmtSize = 0;
+        juce::int64 dataSize = 0;
+        juce::int64 dataSize64 = -1;
+
+        for (juce::int64 pos = 12; pos + 8 <= size;)
+        {
+            const auto chunk = base + pos;
+            const auto chunkSize = static_cast<juce::int64> (juce::ByteOrder::littleEndianInt(chunk + 4));
+
+            if (isTag(chunk, "ds64") && chunkSize >= 16)
+            {
+                dataSize64 = static_cast<juce::int64> (juce::ByteOrder::littleEndianInt64(chunk + 16));
+            }
+            else if (isTag(chunk, "fmt "))
+            {
+                fmt = chunk + 8;
+                fmtSize = chunkSize;
+            }
+            else if (isTag(chunk, "data"))
+            {
+                dataChunk = chunk + 8;
+                dataSize = isRF64 && chunkSize == 0xffffffff && dataSize64 >= 0 ? dataSize64 : chunkSize;
+                break;
+            }
+
+            pos += 8 + chunkSize + (chunkSize & 1);
+        }
+
+        if (fmt == nullptr || dataChunk == nullptr || fmtSize < 16 || (fmt - base) + fmtSize > size)
+            return nullptr;
+
+        auto tag = juce::ByteOrder::littleEndianShort(fmt);
+        const auto numChannels = static_cast<int> (juce::ByteOrder::littleEndianShort(fmt + 2));
+        const auto blockAlign = static_cast<int> (juce::ByteOrder::littleEndianShort(fmt + 12));
+        const auto bitsPerSample = juce::ByteOrder::littleEndianShort(fmt + 14);
+
+        // WAVE_FORMAT_EXTENSIBLE, the sub format GUID starts with the actual tag
+        if (tag == 0xfffe && fmtSize >= 40)
+            tag = juce::ByteOrder::littleEndianShort(fmt + 24);
+
+        std::unique_ptr<Reader> reader(new Reader());
+
+        if (tag == 1 && bitsPerSample == 16)
+            reader->type = SampleType::int16;
+        else if (tag == 1 && bitsPerSample == 24)
+            reader->type = SampleType::int24;
+        else if (tag == 1 && bitsPerSample == 32)
+            reader->type = SampleType::int32;
+        else if (tag == 3 && bitsPerSample == 32)
+            reader->type = SampleType::float32;
+        else
+            return nullptr;
+
+        if (numChannels < 1 || blockAlign != numChannels * getBytesPerSample(reader->type))
+            return nullptr;
+
+        reader->numChannels = numChannels;
+        reader->sampleRate = static_cast<double> (juce::ByteOrder::littleEndianInt(fmt + 4));
+        reader->lengthInSamples = juce::jmin(dataSize, size - (dataChunk - base)) / blockAlign;
+        reader->data = dataChunk;
+        reader->map = std::move(map);
+        return reader;
+    }
+
+    void Reader::read(double* const* dest, juce::int64 startSample, int numSamples) const
+    {
+        // silence before and after the data
+        const auto first = static_cast<int> (juce::jlimit<juce::int64>(0, numSamples, -startSample));
+        const auto last = static_cast<int> (juce::jlimit<juce::int64>(first, numSamples, lengthInSamples - startSample));
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            std::fill(dest[ch], dest[ch] + first, 0.0);
+            std::fill(dest[ch] + last, dest[ch] + numSamples, 0.0);
+        }
+
+        if (last <= first)
+            return;
+
+        const auto src = data + (startSample + first) * numChannels * getBytesPerSample(type);
+
+        switch (type)
+        {
+        case SampleType::int16:
+            decodeFrames<SampleType::int16>(src, dest, first, numChannels, last - first);
+            break;
+        case SampleType::int24:
+            decodeFrames<SampleType::int24>(src, dest, first, numChannels, last - first);
+            break;
+        case SampleType::int32:
+            decodeFrames<SampleType::int32>(src, dest, first, numChannels, last - first);
+            break;
+        case SampleType::float32:
+            decodeFrames<SampleType::float32>(src, dest, first, numChannels, last - first);
+            break;
+        }
+    }
+
+    //==============================================================================
+    bool Writer::supportsBitDepth(int bitDepth)
+    {
+        return bitDepth == 16 || bitDepth == 24 || bitDepth == 32;
+    }
+
+    std::unique_ptr<Writer> Writer::create(const juce::File& file, int numChannels, double sampleRate,
+                                           int bitDepth, juce::int64 lengthInSamples)
+    {
+        if (! supportsBitDepth(bitDepth) || numChannels < 1)
+            return nullptr;
+
+        std::unique_ptr<Writer> writer(new Writer());
+        writer->type = bitDepth == 16 ? SampleType::int16 : bitDepth == 24 ? SampleType::int24 : SampleType::float32;
+        writer->numChannels = numChannels;
+        writer->lengthInSamples = lengthInSamples;
+
+        // RIFF header, JUNK or ds64, fmt and the data chunk header
+        constexpr juce::int64 headerSize = 80;
+        const auto blockAlign = numChannels * getBytesPerSample(writer->type);
+        const auto dataSize = lengthInSamples * blockAlign;
+        const auto fileSize = headerSize + dataSize + (dataSize & 1);
+        const auto isRF64 = fileSize - 8 > 0xffffffff;
+
+        file.deleteFile();
+
+        {
+            juce::FileOutputStream out(file);
+
+            if (out.failedToOpen() || ! out.setPosition(fileSize - 1) || ! out.writeByte(0))
+                return nullptr;
+        }
+
+        writer->map = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readWrite);
+        const auto base = static_cast<char*> (writer->map->getData());
+
+        if (base == nullptr || static_cast<juce::int64> (writer->map->getSize()) != fileSize)
+            return nullptr;
+
+        const auto toUInt32 = [](juce::int64 v) { return static_cast<int> (static_cast<juce::uint32> (v)); };
+
+        // The JUNK chunk reserves the space of ds64, as recommended for files that may exceed 4 GB.
+        juce::MemoryOutputStream header(base, static_cast<size_t> (headerSize));
+        header.write(isRF64 ? "RF64" : "RIFF", 4);
+        header.writeInt(isRF64 ? -1 : toUInt32(fileSize - 8));
+        header.write("WAVE", 4);
+        header.write(isRF64 ? "ds64" : "JUNK", 4);
+        header.writeInt(28);
+        header.writeInt64(isRF64 ? fileSize - 8 : 0);
+        header.writeInt64(isRF64 ? dataSize : 0);
+        header.writeInt64(isRF64 ? lengthInSamples : 0);
+        header.writeInt(0);
+        header.write("fmt ", 4);
+        header.writeInt(16);
+        header.writeShort(writer->type == SampleType::float32 ? 3 : 1);
+        header.writeShort(static_cast<short> (numChannels));
+        header.writeInt(juce::roundToInt(sampleRate));
+        header.writeInt(juce::roundToInt(sampleRate) * blockAlign);
+        header.writeShort(static_cast<short> (blockAlign));
+        header.writeShort(static_cast<short> (bitDepth));
+        header.write("data", 4);
+        header.writeInt(isRF64 ? -1 : toUInt32(dataSize));
+        jassert(header.getPosition() == headerSize);
+
+        writer->data = base + headerSize;
+        return writer;
+    }
+
+    void Writer::write(const double* const* src, int srcOffset, juce::int64 startSample, int numSamples)
+    {
+        jassert(startSample >= 0 && startSample + numSamples <= lengthInSamples);
+        const auto dest = data + startSample * numChannels * getBytesPerSample(type);
+
+        switch (type)
+        {
+        case SampleType::int16:
+            encodeFrames<SampleType::int16>(src, srcOffset, dest, numChannels, numSamples);
+            break;
+        case SampleType::int24:
+            encodeFrames<SampleType::int24>(src, srcOffset, dest, numChannels, numSamples);
+            break;
+        case SampleType::int32:
+            encodeFrames<SampleType::int32>(src, srcOffset, dest, numChannels, numSamples);
+            break;
+        case SampleType::float32:
+            encodeFrames<SampleType::float32>(src, srcOffset, dest, numChannels, numSamples);
+            break;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Memory-mapped access to uncompressed WAV and RF64 files. Samples are
+// converted between the mapped PCM and the renderer's double buffers in one
+// pass, without the intermediate copies of the stream based readers and
+// writers. Other formats go through juce_audio_formats.
+namespace MappedAudio
+{
+    enum class SampleType
+    {
+        int16,
+        int24,
+        int32,
+        float32
+    };
+
+    class Reader
+    {
+    public:
+
+        // Returns nullptr if the file is not a WAV or RF64 file with 16, 24 or 32
+        // bit PCM or 32 bit float data.
+        static std::unique_ptr<Reader> open(const juce::File& file);
+
+        int getNumChannels() const { return numChannels; }
+        double getSampleRate() const { return sampleRate; }
+        juce::int64 getLengthInSamples() const { return lengthInSamples; }
+
+        // Frames outside the file read as silence. Safe to call from several threads.
+        void read(double* const* dest, juce::int64 startSample, int numSamples) const;
+
+    private:
+
+        Reader() = default;
+
+        std::unique_ptr<juce::MemoryMappedFile> map;
+        const char* data = nullptr;
+        SampleType type = SampleType::int16;
+        int numChannels = 0;
+        double sampleRate = 0.0;
+        juce::int64 lengthInSamples = 0;
+    };
+
+    class Writer
+    {
+    public:
+
+        // Creates a WAV file of the final size and maps it. Files above 4 GB are
+        // written as RF64. The bit depth is 16, 24 or 32 (float).
+        static std::unique_ptr<Writer> create(const juce::File& file, int numChannels, double sampleRate,
+                                              int bitDepth, juce::int64 lengthInSamples);
+
+        static bool supportsBitDepth(int bitDepth);
+
+        int getNumChannels() const { return numChannels; }
+
+        // Writes numSamples frames, starting at srcOffset in src, to an absolute
+        // position. Several threads may write disjoint ranges at the same time.
+        void write(const double* const* src, int srcOffset, juce::int64 startSample, int numSamples);
+
+    private:
+
+        Writer() = default;
+
+        std::unique_ptr<juce::MemoryMappedFile> map;
+        char* data = nullptr;
+        SampleType type = SampleType::int16;
+        int numChannels = 0;
+        juce::int64 lengthInSamples = 0;
+    };
+}
@@ -0,0 +1,361 @@
+#include "PipeRender.h"
+#include "Render.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if JUCE_WINDOWS
+ #include <fcntl.h>
+ #include <io.h>
+#else
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+namespace PipeRender
+{
+    namespace
+    {
+        // A time in samples since the start of the stream, or -1 for the next block.
+        struct ParameterChange
+        {
+            int index;
+            float value;
+            juce::int64 time;
+        };
+
+        // Single producer, single consumer queue from the control thread to the
+        // processing loop. Changes are dropped when it is full.
+        class ControlQueue
+        {
+        public:
+
+            void push(const ParameterChange& change)
+            {
+                const auto scope = fifo.write(1);
+
+                if (scope.blockSize1 == 0)
+                    ++numDropped;
+                else
+                    changes[static_cast<size_t> (scope.startIndex1)] = change;
+            }
+
+            template <typename Callback>
+            void popAll(Callback&& callback)
+            {
+                const auto scope = fifo.read(fifo.getNumReady());
+                scope.forEach([&](int index) { callback(changes[static_cast<size_t> (index)]); });
+            }
+
+            void countDropped()
+            {
+                ++numDropped;
+            }
+
+            int getNumDropped() const
+            {
+                return numDropped.load();
+            }
+
+        private:
+
+            static constexpr int capacity = 1024;
+            juce::AbstractFifo fifo { capacity };
+            std::array<ParameterChange, capacity> changes {};
+            std::atomic<int> numDropped { 0 };
+        };
+
+        // Follows the control file like tail -f. It is opened non-blocking, so a
+        // FIFO without a writer doesn't stall the thread and new writers are
+        // picked up without reopening.
+        class ControlReader : public juce::Thread
+        {
+        public:
+
+            ControlReader(const juce::File& file, juce::AudioProcessorValueTreeState& parameters, ControlQueue& changes)
+                : juce::Thread("AFEQ control"), controlFile(file), apvts(parameters), queue(changes)
+            {
+            }
+
+            ~ControlReader() override
+            {
+                stopThread(1000);
+            }
+
+            void run() override
+            {
+                std::FILE* in = nullptr;
+                char chunk[512];
+                juce::String pending;
+
+                while (! threadShouldExit())
+                {
+                    if (in == nullptr)
+                        in = open();
+
+                    if (in != nullptr && std::fgets(chunk, sizeof(chunk), in) != nullptr)
+                    {
+                        pending += juce::String::fromUTF8(chunk);
+
+                        if (pending.endsWithChar('\n'))
+                        {
+                            handleLine(pending);
+                            pending.clear();
+                        }
+
+                        continue;
+                    }
+
+                    if (in != nullptr)
+                        std::clearerr(in);
+
+                    wait(10);
+                }
+
+                if (in != nullptr)
+                    std::fclose(in);
+            }
+
+        private:
+
+            std::FILE* open() const
+            {
+                const auto path = controlFile.getFullPathName();
+
+               #if JUCE_WINDOWS
+                return _wfopen(path.toWideCharPointer(), L"r");
+               #else
+                const auto fd = ::open(path.toRawUTF8(), O_RDONLY | O_NONBLOCK);
+                return fd < 0 ? nullptr : fdopen(fd, "r");
+               #endif
+            }
+
+            void handleLine(const juce::String& line)
+            {
+                const auto text = line.trim();
+
+                if (text.isEmpty() || text.startsWithChar('#'))
+                    return;
+
+                // "Band 3 Gain = -4.5" or "Band 3 Gain = -4.5 @ 96000"
+                const auto id = text.upToFirstOccurrenceOf("=", false, false).trim();
+                const auto assignment = text.fromFirstOccurrenceOf("=", false, false);
+                const auto value = assignment.upToFirstOccurrenceOf("@", false, false).trim();
+                const auto time = assignment.containsChar('@') ? assignment.fromFirstOccurrenceOf("@", false, false).trim() : juce::String();
+                auto param = apvts.getParameter(id);
+
+                if (param == nullptr || value.isEmpty() || (time.isNotEmpty() && ! time.containsOnly("0123456789")))
+                {
+                    std::cerr << "control: cannot apply \"" << text << "\"" << std::endl;
+                    return;
+                }
+
+                queue.push({ param->getParameterIndex(), param->getValueForText(value), time.isEmpty() ? -1 : time.getLargeIntValue() });
+            }
+
+            juce::File controlFile;
+            juce::AudioProcessorValueTreeState& apvts;
+            ControlQueue& queue;
+        };
+
+        int getBytesPerSample(SampleFormat format)
+        {
+            return format == s16 ? 2 : format == s24 ? 3 : 4;
+        }
+
+        void deinterleave(const char* src, juce::AudioBuffer<float>& dest, int numSamples, SampleFormat format)
+        {
+            const auto numChannels = dest.getNumChannels();
+            const auto bytesPerSample = getBytesPerSample(format);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto out = dest.getWritePointer(ch);
+                auto in = src + ch * bytesPerSample;
+
+                for (int i = 0; i < numSamples; ++i, in += numChannels * bytesPerSample)
+                {
+                    if (format == s16)
+                        out[i] = static_cast<float> (static_cast<juce::int16> (juce::ByteOrder::littleEndianShort(in))) / 32768.f;
+                    else if (format == s24)
+                        out[i] = static_cast<float> (juce::ByteOrder::littleEndian24Bit(in)) / 8388608.f;
+                    else
+                    {
+                        const auto bits = juce::ByteOrder::littleEndianInt(in);
+                        std::memcpy(out + i, &bits, sizeof(float));
+                    }
+                }
+            }
+        }
+
+        void interleave(const juce::AudioBuffer<float>& src, char* dest, int numSamples, SampleFormat format)
+        {
+            const auto numChannels = src.getNumChannels();
+            const auto bytesPerSample = getBytesPerSample(format);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto in = src.getReadPointer(ch);
+                auto out = dest + ch * bytesPerSample;
+
+                for (int i = 0; i < numSamples; ++i, out += numChannels * bytesPerSample)
+                {
+                    if (format == s16)
+                    {
+                        const auto v = static_cast<juce::int16> (juce::jlimit(-32768, 32767, juce::roundToInt(in[i] * 32768.f)));
+                        const auto bits = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint16> (v));
+                        std::memcpy(out, &bits, 2);
+                    }
+                    else if (format == s24)
+                    {
+                        juce::ByteOrder::littleEndian24BitToChars(juce::jlimit(-8388608, 8388607, juce::roundToInt(in[i] * 8388608.f)), out);
+                    }
+                    else
+                    {
+                        juce::uint32 bits;
+                        std::memcpy(&bits, in + i, sizeof(float));
+                        bits = juce::ByteOrder::swapIfBigEndian(bits);
+                        std::memcpy(out, &bits, sizeof(float));
+                    }
+                }
+            }
+        }
+
+        // Blocks until the buffer is full or the input ends.
+        size_t readFully(char* dest, size_t numBytes)
+        {
+            size_t numRead = 0;
+
+            while (numRead < numBytes)
+            {
+                const auto n = std::fread(dest + numRead, 1, numBytes - numRead, stdin);
+
+                if (n == 0)
+                    break;
+
+                numRead += n;
+            }
+
+            return numRead;
+        }
+    }
+
+    bool parseFormat(const juce::String& name, SampleFormat& format)
+    {
+        if (name == "s16")
+            format = s16;
+        else if (name == "s24")
+            format = s24;
+        else if (name == "f32")
+            format = f32;
+        else
+            return false;
+
+        return true;
+    }
+
+    int run(const Options& opt, const juce::MemoryBlock& stateData)
+    {
+       #if JUCE_WINDOWS
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+       #endif
+
+        const auto frameBytes = static_cast<size_t> (getBytesPerSample(opt.format) * opt.numChannels);
+        const auto blockSeconds = opt.blockSize / opt.sampleRate;
+
+        auto processor = Render::createProcessor(stateData, opt.numChannels, opt.sampleRate, opt.blockSize);
+
+        std::vector<char> io(frameBytes * static_cast<size_t> (opt.blockSize));
+        juce::AudioBuffer<float> buffer(opt.numChannels, opt.blockSize);
+        juce::MidiBuffer midi;
+        ControlQueue queue;
+        std::unique_ptr<ControlReader> control;
+
+        // changes for later blocks, in order of arrival
+        std::vector<ParameterChange> scheduled;
+        scheduled.reserve(1024);
+        juce::int64 streamPos = 0;
+
+        if (opt.controlFile != juce::File())
+        {
+            control = std::make_unique<ControlReader>(opt.controlFile, processor->getAPValueTreeState(), queue);
+            control->startThread();
+        }
+
+        juce::int64 numBlocks = 0;
+        juce::int64 numLate = 0;
+        double maxSeconds = 0.0;
+        double totalSeconds = 0.0;
+
+        std::setvbuf(stdout, nullptr, _IONBF, 0);
+
+        for (;;)
+        {
+            const auto numBytes = readFully(io.data(), io.size());
+            const auto numSamples = static_cast<int> (numBytes / frameBytes);
+
+            if (numSamples == 0)
+                break;
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+
+            queue.popAll([&](ParameterChange change) {
+                change.time = change.time < 0 ? streamPos : change.time;
+
+                if (scheduled.size() < scheduled.capacity())
+                    scheduled.push_back(change);
+                else
+                    queue.countDropped();
+            });
+
+            // the processor splits the block at the changes, later ones keep their order
+            size_t numKept = 0;
+
+            for (const auto& c : scheduled)
+            {
+                if (c.time >= streamPos + numSamples)
+                    scheduled[numKept++] = c;
+                else if (! processor->addParameterEvent(c.index, c.value, static_cast<int> (juce::jmax(static_cast<juce::int64> (0), c.time - streamPos))))
+                    queue.countDropped();
+            }
+
+            scheduled.resize(numKept);
+
+            deinterleave(io.data(), buffer, numSamples, opt.format);
+
+            juce::AudioBuffer<float> block(buffer.getArrayOfWritePointers(), opt.numChannels, numSamples);
+            processor->processBlock(block, midi);
+
+            interleave(buffer, io.data(), numSamples, opt.format);
+            streamPos += numSamples;
+
+            const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+            maxSeconds = juce::jmax(maxSeconds, seconds);
+            totalSeconds += seconds;
+            numLate += seconds > blockSeconds ? 1 : 0;
+            ++numBlocks;
+
+            // the reader went away
+            if (std::fwrite(io.data(), frameBytes, static_cast<size_t> (numSamples), stdout) != static_cast<size_t> (numSamples))
+                break;
+
+            if (numBytes < io.size())
+                break;
+        }
+
+        control.reset();
+
+        if (! opt.quiet && numBlocks > 0)
+            std::cerr << "blocks:           " << numBlocks << " of " << opt.blockSize << " samples, " << opt.numChannels << " channels" << std::endl
+                      << "block time:       " << juce::String(1e6 * totalSeconds / static_cast<double> (numBlocks), 1) << " us mean, "
+                      << juce::String(1e6 * maxSeconds, 1) << " us max of " << juce::String(1e6 * blockSeconds, 1) << " us" << std::endl
+                      << "late blocks:      " << numLate << std::endl
+                      << "dropped changes:  " << queue.getNumDropped() << std::endl
+                      << "latency:          " << processor->getLatencySamples() << " samples" << std::endl;
+
+        return 0;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Streaming mode of the renderer: raw interleaved PCM from stdin is processed
+// in fixed blocks and written to stdout. All buffers and processors are
+// allocated up front, so memory use and the work per block are constant.
+//
+// Parameters can be changed while running through a control file or FIFO
+// with lines of the form "<parameter id> = <value>", e.g. "Band 3 Gain = -4.5".
+// Values are given as displayed, choices by name. They are applied at the next
+// block border to all channels.
+namespace PipeRender
+{
+    enum SampleFormat
+    {
+        s16,
+        s24,
+        f32
+    };
+
+    struct Options
+    {
+        int numChannels = 2;
+        double sampleRate = 48000.0;
+        int blockSize = 256;
+        SampleFormat format = f32;
+        juce::File controlFile;
+        bool quiet = false;
+    };
+
+    bool parseFormat(const juce::String& name, SampleFormat& format);
+
+    // Returns the process exit code.
+    int run(const Options& opt, const juce::MemoryBlock& stateData);
+}
@@ -0,0 +1,268 @@
+#include "Render.h"
+
+namespace Render
+{
+    namespace
+    {
+        class MappedSource : public Source
+        {
+        public:
+
+            explicit MappedSource(std::unique_ptr<MappedAudio::Reader> r) : reader(std::move(r)) {}
+
+            void read(juce::AudioBuffer<double>& dest, juce::int64 startSample, int numSamples) override
+            {
+                reader->read(dest.getArrayOfWritePointers(), startSample, numSamples);
+            }
+
+        private:
+
+            std::unique_ptr<MappedAudio::Reader> reader;
+        };
+
+        class StreamSource : public Source
+        {
+        public:
+
+            explicit StreamSource(std::unique_ptr<juce::AudioFormatReader> r) : reader(std::move(r)) {}
+
+            void read(juce::AudioBuffer<double>& dest, juce::int64 startSample, int numSamples) override
+            {
+                floatBuffer.setSize(dest.getNumChannels(), numSamples, false, false, true);
+                reader->read(&floatBuffer, 0, numSamples, startSample, true, true);
+
+                for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+                {
+                    const auto in = floatBuffer.getReadPointer(ch);
+                    auto out = dest.getWritePointer(ch);
+
+                    for (int i = 0; i < numSamples; ++i)
+                        out[i] = static_cast<double> (in[i]);
+                }
+            }
+
+        private:
+
+            std::unique_ptr<juce::AudioFormatReader> reader;
+            juce::AudioBuffer<float> floatBuffer;
+        };
+
+        class MappedSink : public Sink
+        {
+        public:
+
+            explicit MappedSink(std::shared_ptr<MappedAudio::Writer> w) : writer(std::move(w)) {}
+
+            bool write(const juce::AudioBuffer<double>& src, int srcOffset, juce::int64 startSample, int numSamples) override
+            {
+                writer->write(src.getArrayOfReadPointers(), srcOffset, startSample, numSamples);
+                return true;
+            }
+
+        private:
+
+            std::shared_ptr<MappedAudio::Writer> writer;
+        };
+
+        class StreamSink : public Sink
+        {
+        public:
+
+            explicit StreamSink(std::unique_ptr<juce::AudioFormatWriter> w) : writer(std::move(w)) {}
+
+            bool write(const juce::AudioBuffer<double>& src, int srcOffset, juce::int64 startSample, int numSamples) override
+            {
+                jassert(nextSample < 0 || startSample == nextSample);
+                nextSample = startSample + numSamples;
+
+                floatBuffer.setSize(src.getNumChannels(), numSamples, false, false, true);
+
+                for (int ch = 0; ch < src.getNumChannels(); ++ch)
+                {
+                    const auto in = src.getReadPointer(ch, srcOffset);
+                    auto out = floatBuffer.getWritePointer(ch);
+
+                    for (int i = 0; i < numSamples; ++i)
+                        out[i] = static_cast<float> (in[i]);
+                }
+
+                return writer->writeFromAudioSampleBuffer(floatBuffer, 0, numSamples);
+            }
+
+            bool flush() override
+            {
+                return writer->flush();
+            }
+
+        private:
+
+            std::unique_ptr<juce::AudioFormatWriter> writer;
+            juce::AudioBuffer<float> floatBuffer;
+            juce::int64 nextSample = -1;
+        };
+    }
+
+    std::unique_ptr<Source> openSource(const juce::File& file, juce::AudioFormatManager& formats, bool allowMapping)
+    {
+        if (allowMapping)
+            if (auto mapped = MappedAudio::Reader::open(file))
+                return std::make_unique<MappedSource>(std::move(mapped));
+
+        if (auto reader = std::unique_ptr<juce::AudioFormatReader>(formats.createReaderFor(file)))
+            return std::make_unique<StreamSource>(std::move(reader));
+
+        return nullptr;
+    }
+
+    std::unique_ptr<Sink> createSink(std::shared_ptr<MappedAudio::Writer> writer)
+    {
+        return std::make_unique<MappedSink>(std::move(writer));
+    }
+
+    std::unique_ptr<Sink> createSink(std::unique_ptr<juce::AudioFormatWriter> writer)
+    {
+        return std::make_unique<StreamSink>(std::move(writer));
+    }
+
+    std::unique_ptr<AFEQAudioProcessor> createProcessor(const juce::MemoryBlock& stateData, int numChannels,
+                                                        double sampleRate, int blockSize)
+    {
+        auto proc = std::make_unique<AFEQAudioProcessor>();
+        proc->setStateInformation(stateData.getData(), static_cast<int> (stateData.getSize()));
+        proc->analyserProc = AFEQAudioProcessor::kAnalyserDisabled;
+        proc->setNonRealtime(true);
+        proc->setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+        proc->prepareToPlay(sampleRate, blockSize);
+        return proc;
+    }
+
+    juce::String renderRange(Source& source, Sink& sink, const juce::MemoryBlock& stateData, int numChannels, double sampleRate,
+                             int blockSize, juce::int64 start, juce::int64 end, juce::int64 preRoll)
+    {
+        auto proc = createProcessor(stateData, numChannels, sampleRate, blockSize);
+
+        // The oversampling, multirate and linear phase modes delay the output.
+        // The input is read that much further, past the end of the file it
+        // reads as silence, and the output is written that much earlier, so
+        // the head is dropped and the tail flushed.
+        const auto latency = static_cast<juce::int64> (proc->getLatencySamples());
+
+        // The double path of the processor, so samples are converted once on the way in and once on the way out.
+        juce::AudioBuffer<double> buffer(numChannels, blockSize);
+        juce::MidiBuffer midi;
+
+        for (auto pos = juce::jmax<juce::int64>(0, start - preRoll); pos < end + latency;)
+        {
+            const auto numSamples = static_cast<int> (juce::jmin<juce::int64>(blockSize, end + latency - pos));
+            const auto outPos = pos - latency;
+            const auto skip = static_cast<int> (juce::jlimit<juce::int64>(0, numSamples, start - outPos));
+            juce::AudioBuffer<double> block(buffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+            source.read(block, pos, numSamples);
+            proc->processBlock(block, midi);
+
+            if (skip < numSamples && ! sink.write(block, skip, outPos + skip, numSamples - skip))
+                return "write failed";
+
+            pos += numSamples;
+        }
+
+        proc->releaseResources();
+        return sink.flush() ? juce::String() : juce::String("write failed");
+    }
+
+    juce::int64 estimatePreRoll(const juce::MemoryBlock& stateData, double sampleRate, int numChannels, double errorBound)
+    {
+        // Windows of 100 ms hold two periods of the lowest band frequency, so
+        // the absolute sum per window decays smoothly even for resonant poles.
+        const auto windowSize = juce::jmax(256, static_cast<int> (sampleRate / 10.0));
+        const auto maxWindows = static_cast<int> (60.0 * sampleRate / windowSize);
+
+        // every input channel may be at full scale
+        const auto bound = errorBound / numChannels;
+        juce::int64 preRoll = 0;
+
+        // A dynamic band's gain follows the level of everything before, which
+        // the impulse response doesn't show.
+        {
+            auto proc = createProcessor(stateData, numChannels, sampleRate, windowSize);
+
+            for (auto b : proc->eqBands)
+            {
+                const auto& bp = b->getBandParamsConst();
+
+                if (bp.enabledParam->get() && bp.dynamicParam->get() && BandParams::hasGain(bp.getType()))
+                    return -1;
+            }
+        }
+
+        for (int inCh = 0; inCh < numChannels; ++inCh)
+        {
+            auto proc = createProcessor(stateData, numChannels, sampleRate, windowSize);
+            juce::AudioBuffer<double> buffer(numChannels, windowSize);
+            juce::MidiBuffer midi;
+
+            // l1 norm of the impulse response per window, all outputs
+            std::vector<double> sums;
+            auto decay = 0.0;
+            auto prevDecay = 0.0;
+            int numStable = 0;
+
+            while (static_cast<int> (sums.size()) < maxWindows && numStable < 3)
+            {
+                buffer.clear();
+
+                if (sums.empty())
+                    buffer.setSample(inCh, 0, 1.0);
+
+                proc->processBlock(buffer, midi);
+
+                auto sum = 0.0;
+                for (int ch = 0; ch < numChannels; ++ch)
+                    for (int i = 0; i < windowSize; ++i)
+                        sum += std::abs(buffer.getSample(ch, i));
+
+                sums.push_back(sum);
+
+                // nothing left, e.g. all bands disabled
+                if (sum < std::numeric_limits<double>::min())
+                    break;
+
+                if (sums.size() >= 3)
+                {
+                    // log ratio of successive windows, the pole radius is exp(decay / windowSize)
+                    decay = std::log(sum / sums[sums.size() - 2]);
+                    numStable = decay < 0.0 && std::abs(decay - prevDecay) < 0.01 * std::abs(decay) ? numStable + 1 : 0;
+                    prevDecay = decay;
+                }
+            }
+
+            const auto last = sums.size() - 1;
+            const auto finite = sums[last] < std::numeric_limits<double>::min();
+
+            if (! finite && decay >= 0.0)
+                return -1;
+
+            // Tail beyond the simulated windows, geometric with the decay of the dominant poles.
+            const auto ratio = finite ? 0.0 : std::exp(decay);
+            const auto remainder = finite ? 0.0 : sums[last] * ratio / (1.0 - ratio);
+
+            // smallest window index from which on the remaining l1 norm is within the bound
+            auto tail = remainder;
+            auto firstWindow = static_cast<juce::int64> (sums.size());
+
+            for (auto w = static_cast<juce::int64> (last); w >= 0 && tail + sums[static_cast<size_t> (w)] < bound; --w)
+            {
+                tail += sums[static_cast<size_t> (w)];
+                firstWindow = w;
+            }
+
+            if (firstWindow == static_cast<juce::int64> (sums.size()) && remainder >= bound)
+                firstWindow += static_cast<juce::int64> (std::ceil(std::log(bound / remainder) / std::log(ratio)));
+
+            preRoll = juce::jmax(preRoll, firstWindow * windowSize);
+        }
+
+        return preRoll;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "MappedAudio.h"
+
+// Building blocks of the batch renderer, shared by whole file and chunked renders.
+namespace Render
+{
+    // Input samples for renderRange.
+    class Source
+    {
+    public:
+        virtual ~Source() = default;
+        virtual void read(juce::AudioBuffer<double>& dest, juce::int64 startSample, int numSamples) = 0;
+    };
+
+    // Output samples of renderRange. Positions are absolute in the output file,
+    // streaming sinks only accept them in order.
+    class Sink
+    {
+    public:
+        virtual ~Sink() = default;
+        virtual bool write(const juce::AudioBuffer<double>& src, int srcOffset, juce::int64 startSample, int numSamples) = 0;
+        virtual bool flush() { return true; }
+    };
+
+    // Memory-mapped if allowed and the file is uncompressed WAV or RF64,
+    // otherwise through juce_audio_formats. Returns nullptr if the file can't be read.
+    std::unique_ptr<Source> openSource(const juce::File& file, juce::AudioFormatManager& formats, bool allowMapping);
+
+    std::unique_ptr<Sink> createSink(std::shared_ptr<MappedAudio::Writer> writer);
+    std::unique_ptr<Sink> createSink(std::unique_ptr<juce::AudioFormatWriter> writer);
+
+    // A processor with the given state, prepared for offline rendering.
+    std::unique_ptr<AFEQAudioProcessor> createProcessor(const juce::MemoryBlock& stateData, int numChannels,
+                                                        double sampleRate, int blockSize);
+
+    // Renders the samples [start, end) of the source into the sink. The
+    // processor starts preRoll samples earlier so its filter state has
+    // converged at start; that output is discarded. The output is aligned with
+    // the input for processors with latency. Returns an error message, or an
+    // empty string on success.
+    juce::String renderRange(Source& source, Sink& sink, const juce::MemoryBlock& stateData, int numChannels, double sampleRate,
+                             int blockSize, juce::int64 start, juce::int64 end, juce::int64 preRoll);
+
+    // Number of samples after which a processor that started from silence
+    // differs from one that has seen the whole signal by less than errorBound,
+    // for any input within full scale. Measured on the impulse response of the
+    // chain: the decay rate of the dominant poles is estimated from the tail
+    // and extrapolated, so slowly decaying tails don't have to be simulated in
+    // full. Returns -1 when the response doesn't decay, and for chains with a
+    // dynamic band, whose gain depends on the level of the whole signal so far.
+    juce::int64 estimatePreRoll(const juce::MemoryBlock& stateData, double sampleRate, int numChannels, double errorBound);
+}
@@ -0,0 +1,618 @@
+// Offline batch renderer. Applies an AFEQ state, as saved by the plugin or as
+// XML, to a set of audio files without a host. Files are spread over a work
+// stealing thread pool, every worker renders with its own processor and streams
+// the file through it in large blocks.
+//
+// Long files can be split into chunks that render in parallel. Each chunk
+// starts early by a pre-roll after which the filter state has converged, so the
+// joined output matches a serial render within --max-error (dBFS, for input
+// within full scale). --verify renders chunked files serially and checks that.
+// Presets with a dynamic band render every file in one piece: the band's gain
+// depends on the level of everything before, so no pre-roll is safe.
+//
+// Uncompressed WAV and RF64 files are memory-mapped, see MappedAudio.h, unless
+// --no-mmap is given. Chunks of a mapped output write straight into it.
+//
+// With --pipe it streams raw PCM from stdin to stdout instead, see PipeRender.h.
+//
+// Usage: afeq_render --state <preset> --out-dir <dir> [--threads N] [--block 16384]
+//                    [--format wav|aiff|flac] [--bits 16|24|32] [--chunks N] [--max-error -120]
+//                    [--verify] [--no-mmap] [--quiet] <files or dirs...>
+//        afeq_render --state <preset> --pipe [--channels 2] [--rate 48000] [--block 256]
+//                    [--sample-format s16|s24|f32] [--control <file or fifo>] [--quiet]
+
+#include <JuceHeader.h>
+#include "PipeRender.h"
+#include "PluginState.h"
+#include "Render.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    const juce::String audioFileWildcard = "*.wav;*.aif;*.aiff;*.flac";
+
+    struct Options
+    {
+        juce::File stateFile;
+        juce::File outDir;
+        juce::Array<juce::File> inputs;
+        int numThreads = juce::SystemStats::getNumCpus();
+        int blockSize = 0;
+        juce::String format;
+        int bitDepth = 0;
+        int numChunks = 0;
+        double maxErrorDb = -120.0;
+        bool verify = false;
+        bool quiet = false;
+        bool pipe = false;
+        bool mapFiles = true;
+        PipeRender::Options pipeOptions;
+    };
+
+    // One input file and everything known about it before rendering.
+    struct FileJob
+    {
+        juce::File in;
+        juce::File out;
+        juce::String outExtension;
+        double sampleRate = 0.0;
+        int numChannels = 0;
+        int bitDepth = 0;
+        juce::int64 length = 0;
+        juce::StringPairArray metadata;
+        int numChunks = 1;
+        juce::int64 preRoll = 0;
+        std::shared_ptr<MappedAudio::Writer> mappedOut;
+        double renderSeconds = 0.0;
+        double maxDifference = -1.0;
+        juce::String error;
+    };
+
+    // Samples [start, end) of one file.
+    struct ChunkTask
+    {
+        int fileIndex;
+        int chunkIndex;
+        juce::int64 start;
+        juce::int64 end;
+    };
+
+    bool parseOptions(int argc, char* argv[], Options& opt)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const juce::String arg(argv[i]);
+            const auto hasValue = i + 1 < argc;
+            const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+            if (arg == "--quiet")
+                opt.quiet = true;
+            else if (arg == "--pipe")
+                opt.pipe = true;
+            else if (arg == "--no-mmap")
+                opt.mapFiles = false;
+            else if (arg == "--channels" && hasValue)
+                opt.pipeOptions.numChannels = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--rate" && hasValue)
+                opt.pipeOptions.sampleRate = juce::String(argv[++i]).getDoubleValue();
+            else if (arg == "--control" && hasValue)
+                opt.pipeOptions.controlFile = cwd.getChildFile(argv[++i]);
+            else if (arg == "--sample-format" && hasValue)
+            {
+                if (! PipeRender::parseFormat(juce::String(argv[++i]).toLowerCase(), opt.pipeOptions.format))
+                    return false;
+            }
+            else if (arg == "--verify")
+                opt.verify = true;
+            else if (arg == "--chunks" && hasValue)
+                opt.numChunks = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--max-error" && hasValue)
+                opt.maxErrorDb = juce::String(argv[++i]).getDoubleValue();
+            else if (arg == "--state" && hasValue)
+                opt.stateFile = cwd.getChildFile(argv[++i]);
+            else if (arg == "--out-dir" && hasValue)
+                opt.outDir = cwd.getChildFile(argv[++i]);
+            else if (arg == "--threads" && hasValue)
+                opt.numThreads = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--block" && hasValue)
+                opt.blockSize = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--format" && hasValue)
+                opt.format = juce::String(argv[++i]).toLowerCase();
+            else if (arg == "--bits" && hasValue)
+                opt.bitDepth = juce::String(argv[++i]).getIntValue();
+            else if (arg.startsWith("--"))
+                return false;
+            else
+                opt.inputs.add(cwd.getChildFile(arg));
+        }
+
+        if (opt.pipe)
+        {
+            opt.pipeOptions.blockSize = opt.blockSize > 0 ? opt.blockSize : opt.pipeOptions.blockSize;
+            opt.pipeOptions.quiet = opt.quiet;
+
+            return opt.stateFile != juce::File() && opt.inputs.isEmpty() && opt.pipeOptions.blockSize > 0
+                && opt.pipeOptions.numChannels > 0 && opt.pipeOptions.sampleRate > 40000.0;
+        }
+
+        opt.blockSize = opt.blockSize > 0 ? opt.blockSize : 16384;
+
+        return opt.stateFile != juce::File() && opt.outDir != juce::File() && ! opt.inputs.isEmpty()
+            && opt.numThreads > 0 && opt.blockSize > 0 && opt.numChunks >= 0 && opt.maxErrorDb < 0.0
+            && (opt.format.isEmpty() || opt.format == "wav" || opt.format == "aiff" || opt.format == "flac");
+    }
+
+    // Loads a state in the binary format of getStateInformation, the binary XML
+    // of earlier versions, or as XML with either the AFEQSTATE root or only the
+    // parameter tree.
+    bool loadState(const juce::File& file, juce::MemoryBlock& stateData, juce::String& error)
+    {
+        if (! file.loadFileAsData(stateData))
+        {
+            error = "cannot read " + file.getFullPathName();
+            return false;
+        }
+
+        const auto text = stateData.toString().trimStart();
+
+        if (text.startsWithChar('<'))
+        {
+            auto xml = juce::parseXML(text);
+
+            if (xml != nullptr && xml->hasTagName("STATE"))
+            {
+                auto wrapper = std::make_unique<juce::XmlElement>("AFEQSTATE");
+                wrapper->addChildElement(xml.release());
+                xml = std::move(wrapper);
+            }
+
+            if (xml == nullptr || ! xml->hasTagName("AFEQSTATE"))
+            {
+                error = file.getFileName() + " is not an AFEQ state";
+                return false;
+            }
+
+            stateData.reset();
+            juce::AudioProcessor::copyXmlToBinary(*xml, stateData);
+            return true;
+        }
+
+        if (PluginState::isBinaryState(stateData.getData(), static_cast<int> (stateData.getSize())))
+        {
+            PluginState ps;
+
+            if (ps.readFrom(stateData.getData(), static_cast<int> (stateData.getSize())))
+                return true;
+
+            error = file.getFileName() + " is damaged or from a newer version";
+            return false;
+        }
+
+        const auto xml = juce::AudioProcessor::getXmlFromBinary(stateData.getData(), static_cast<int> (stateData.getSize()));
+
+        if (xml == nullptr || ! xml->hasTagName("AFEQSTATE"))
+        {
+            error = file.getFileName() + " is not an AFEQ state";
+            return false;
+        }
+
+        return true;
+    }
+
+    juce::Array<juce::File> collectFiles(const juce::Array<juce::File>& inputs)
+    {
+        juce::Array<juce::File> files;
+
+        for (const auto& in : inputs)
+        {
+            if (in.isDirectory())
+                files.addArray(in.findChildFiles(juce::File::findFiles, true, audioFileWildcard));
+            else
+                files.add(in);
+        }
+
+        return files;
+    }
+
+    juce::AudioFormat* findOutputFormat(juce::AudioFormatManager& formats, const juce::File& in, const Options& opt)
+    {
+        if (opt.format.isEmpty())
+            return formats.findFormatForFileExtension(in.getFileExtension());
+
+        return formats.findFormatForFileExtension(opt.format == "aiff" ? ".aiff" : "." + opt.format);
+    }
+
+    int chooseBitDepth(juce::AudioFormat& format, int requested)
+    {
+        const auto possible = format.getPossibleBitDepths();
+
+        if (possible.contains(requested))
+            return requested;
+
+        // the closest depth that doesn't lose resolution, else the largest one
+        for (const auto bits : possible)
+            if (bits >= requested)
+                return bits;
+
+        return possible.isEmpty() ? 16 : possible.getLast();
+    }
+
+    // Opens the input and checks that it can be rendered.
+    juce::String planFile(FileJob& job, juce::AudioFormatManager& formats, const Options& opt)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(job.in));
+
+        if (reader == nullptr)
+            return "cannot open";
+
+        job.numChannels = static_cast<int> (reader->numChannels);
+        job.sampleRate = reader->sampleRate;
+        job.length = reader->lengthInSamples;
+        job.metadata = reader->metadataValues;
+
+        if (job.numChannels < 1)
+            return "no audio channels";
+
+        if (job.sampleRate <= 40000.0)
+            return "sample rates below 40 kHz are not supported";
+
+        auto format = findOutputFormat(formats, job.in, opt);
+
+        if (format == nullptr)
+            return "no output format";
+
+        job.outExtension = format->getFileExtensions()[0];
+        job.out = opt.outDir.getChildFile(job.in.getFileNameWithoutExtension() + job.outExtension);
+        job.bitDepth = chooseBitDepth(*format, opt.bitDepth > 0 ? opt.bitDepth : static_cast<int> (reader->bitsPerSample));
+
+        if (job.out == job.in)
+            return "output would overwrite the input";
+
+        return {};
+    }
+
+    juce::File getPartFile(const FileJob& job, int chunkIndex)
+    {
+        return job.out.getSiblingFile("." + job.out.getFileNameWithoutExtension() + ".part" + juce::String(chunkIndex) + ".wav");
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(juce::AudioFormatManager& formats, const juce::File& file, const juce::String& extension,
+                                                          double sampleRate, int numChannels, int bitDepth, const juce::StringPairArray& metadata)
+    {
+        auto format = formats.findFormatForFileExtension(extension);
+        file.deleteFile();
+        auto stream = file.createOutputStream();
+
+        if (format == nullptr || stream == nullptr)
+            return nullptr;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), sampleRate,
+            static_cast<unsigned int> (numChannels), bitDepth, metadata, 0));
+
+        // on failure the stream is still ours
+        if (writer != nullptr)
+            stream.release();
+
+        return writer;
+    }
+
+    // Mapped WAV output has no metadata chunks, files with metadata keep the stream writer.
+    bool canMapOutput(const FileJob& job, const Options& opt)
+    {
+        return opt.mapFiles && job.outExtension == ".wav" && job.metadata.size() == 0 && MappedAudio::Writer::supportsBitDepth(job.bitDepth);
+    }
+
+    juce::String renderChunk(const FileJob& job, const ChunkTask& task, juce::AudioFormatManager& formats,
+                             const juce::MemoryBlock& stateData, const Options& opt)
+    {
+        auto source = Render::openSource(job.in, formats, opt.mapFiles);
+
+        if (source == nullptr)
+            return "cannot open";
+
+        std::unique_ptr<Render::Sink> sink;
+
+        if (job.mappedOut != nullptr)
+        {
+            sink = Render::createSink(job.mappedOut);
+        }
+        else if (job.numChunks == 1 && canMapOutput(job, opt))
+        {
+            if (auto mapped = MappedAudio::Writer::create(job.out, job.numChannels, job.sampleRate, job.bitDepth, job.length))
+                sink = Render::createSink(std::shared_ptr<MappedAudio::Writer>(std::move(mapped)));
+        }
+        else
+        {
+            // Parts are 32 bit float, the output bit depth is applied when they are joined.
+            auto writer = job.numChunks > 1
+                ? createWriter(formats, getPartFile(job, task.chunkIndex), ".wav", job.sampleRate, job.numChannels, 32, {})
+                : createWriter(formats, job.out, job.outExtension, job.sampleRate, job.numChannels, job.bitDepth, job.metadata);
+
+            if (writer != nullptr)
+                sink = Render::createSink(std::move(writer));
+        }
+
+        if (sink == nullptr)
+            return "cannot create the output file";
+
+        return Render::renderRange(*source, *sink, stateData, job.numChannels, job.sampleRate, opt.blockSize, task.start, task.end, job.preRoll);
+    }
+
+    juce::String joinParts(const FileJob& job, juce::AudioFormatManager& formats)
+    {
+        const auto writer = createWriter(formats, job.out, job.outExtension, job.sampleRate, job.numChannels, job.bitDepth, job.metadata);
+
+        if (writer == nullptr)
+            return "cannot create the output file";
+
+        for (int c = 0; c < job.numChunks; ++c)
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(getPartFile(job, c)));
+
+            if (reader == nullptr || ! writer->writeFromAudioReader(*reader, 0, -1))
+                return "cannot join part " + juce::String(c);
+        }
+
+        return writer->flush() ? juce::String() : juce::String("write failed");
+    }
+
+    // Renders the file once more in one piece and compares it to the joined chunks.
+    juce::String verifyFile(FileJob& job, juce::AudioFormatManager& formats, const juce::MemoryBlock& stateData, const Options& opt)
+    {
+        const auto serialFile = job.out.getSiblingFile("." + job.out.getFileNameWithoutExtension() + ".serial" + job.outExtension);
+
+        // The reference goes through the stream reader and writer, independent of the mapped path.
+        {
+            auto source = Render::openSource(job.in, formats, false);
+            auto writer = createWriter(formats, serialFile, job.outExtension, job.sampleRate, job.numChannels, job.bitDepth, job.metadata);
+
+            if (source == nullptr || writer == nullptr)
+                return "cannot render the serial reference";
+
+            const auto sink = Render::createSink(std::move(writer));
+            const auto error = Render::renderRange(*source, *sink, stateData, job.numChannels, job.sampleRate, opt.blockSize, 0, job.length, 0);
+
+            if (error.isNotEmpty())
+                return error;
+        }
+
+        std::unique_ptr<juce::AudioFormatReader> chunked(formats.createReaderFor(job.out));
+        std::unique_ptr<juce::AudioFormatReader> serial(formats.createReaderFor(serialFile));
+
+        if (chunked == nullptr || serial == nullptr || chunked->lengthInSamples != serial->lengthInSamples)
+            return "serial reference doesn't match the output length";
+
+        juce::AudioBuffer<float> a(job.numChannels, opt.blockSize);
+        juce::AudioBuffer<float> b(job.numChannels, opt.blockSize);
+        auto maxDifference = 0.0;
+
+        for (juce::int64 pos = 0; pos < job.length; pos += opt.blockSize)
+        {
+            const auto numSamples = static_cast<int> (juce::jmin<juce::int64>(opt.blockSize, job.length - pos));
+            chunked->read(&a, 0, numSamples, pos, true, true);
+            serial->read(&b, 0, numSamples, pos, true, true);
+
+            for (int ch = 0; ch < job.numChannels; ++ch)
+                for (int i = 0; i < numSamples; ++i)
+                    maxDifference = juce::jmax(maxDifference, static_cast<double> (std::abs(a.getSample(ch, i) - b.getSample(ch, i))));
+        }
+
+        serial.reset();
+        serialFile.deleteFile();
+        job.maxDifference = maxDifference;
+
+        // Rounding to the output format can turn any difference into one step.
+        const auto quantisation = std::pow(2.0, 1 - juce::jmin(job.bitDepth, 25));
+        const auto bound = juce::Decibels::decibelsToGain(opt.maxErrorDb, -1000.0) + quantisation;
+
+        if (maxDifference > bound)
+            return "chunked render differs from the serial render by " + juce::String(juce::Decibels::gainToDecibels(maxDifference), 1) + " dB";
+
+        return {};
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+
+    if (! parseOptions(argc, argv, opt))
+    {
+        std::cerr << "Usage: afeq_render --state <preset> --out-dir <dir> [--threads N] [--block 16384]" << std::endl
+                  << "                   [--format wav|aiff|flac] [--bits 16|24|32] [--chunks N] [--max-error -120]" << std::endl
+                  << "                   [--verify] [--no-mmap] [--quiet] <files or dirs...>" << std::endl
+                  << "       afeq_render --state <preset> --pipe [--channels 2] [--rate 48000] [--block 256]" << std::endl
+                  << "                   [--sample-format s16|s24|f32] [--control <file or fifo>] [--quiet]" << std::endl
+                  << "The preset is a saved plugin state or its XML. Without --chunks long files are split" << std::endl
+                  << "when there are fewer files than threads." << std::endl;
+        return 2;
+    }
+
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    juce::MemoryBlock stateData;
+    juce::String error;
+
+    if (! loadState(opt.stateFile, stateData, error))
+    {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+
+    if (opt.pipe)
+        return PipeRender::run(opt.pipeOptions, stateData);
+
+    if (! opt.outDir.createDirectory())
+    {
+        std::cerr << "cannot create " << opt.outDir.getFullPathName() << std::endl;
+        return 2;
+    }
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    // Readers and writers are not shared between threads, every worker has its own formats.
+    juce::OwnedArray<juce::AudioFormatManager> formatManagers;
+
+    for (int i = 0; i < opt.numThreads; ++i)
+        formatManagers.add(std::make_unique<juce::AudioFormatManager>())->registerBasicFormats();
+
+    const auto files = collectFiles(opt.inputs);
+    std::vector<FileJob> jobs(static_cast<size_t> (files.size()));
+    int numValid = 0;
+
+    for (int i = 0; i < files.size(); ++i)
+    {
+        auto& job = jobs[static_cast<size_t> (i)];
+        job.in = files[i];
+        job.error = planFile(job, *formatManagers[0], opt);
+        numValid += job.error.isEmpty() ? 1 : 0;
+    }
+
+    // Split files into chunks when there are not enough files to keep every thread busy.
+    const auto bound = juce::Decibels::decibelsToGain(opt.maxErrorDb, -1000.0);
+    std::map<std::pair<double, int>, juce::int64> preRolls;
+    std::vector<ChunkTask> tasks;
+
+    for (int i = 0; i < files.size(); ++i)
+    {
+        auto& job = jobs[static_cast<size_t> (i)];
+
+        if (job.error.isNotEmpty())
+            continue;
+
+        auto numChunks = opt.numChunks > 0 ? opt.numChunks : (opt.numThreads + numValid - 1) / numValid;
+
+        if (numChunks > 1)
+        {
+            const auto key = std::make_pair(job.sampleRate, job.numChannels);
+
+            if (preRolls.find(key) == preRolls.end())
+                preRolls[key] = Render::estimatePreRoll(stateData, job.sampleRate, job.numChannels, bound);
+
+            job.preRoll = preRolls[key];
+
+            // Every chunk should be clearly longer than its pre-roll, else most of the work is done twice.
+            const auto minChunkLength = opt.numChunks > 0 ? juce::jmax<juce::int64>(1, job.preRoll)
+                                                          : juce::jmax<juce::int64>(8 * job.preRoll, static_cast<juce::int64> (10.0 * job.sampleRate));
+            numChunks = job.preRoll < 0 ? 1 : static_cast<int> (juce::jlimit<juce::int64>(1, numChunks, job.length / minChunkLength));
+        }
+
+        job.numChunks = numChunks;
+        job.preRoll = numChunks > 1 ? job.preRoll : 0;
+
+        // Chunks of a mapped output write straight into their range, nothing to join.
+        if (numChunks > 1 && canMapOutput(job, opt))
+        {
+            job.mappedOut = MappedAudio::Writer::create(job.out, job.numChannels, job.sampleRate, job.bitDepth, job.length);
+
+            if (job.mappedOut == nullptr)
+            {
+                job.error = "cannot create the output file";
+                continue;
+            }
+        }
+
+        for (int c = 0; c < numChunks; ++c)
+            tasks.push_back({ i, c, job.length * c / numChunks, job.length * (c + 1) / numChunks });
+    }
+
+    // Longest chunks first, the pool leaves the short ones for stealing.
+    std::stable_sort(tasks.begin(), tasks.end(), [](const ChunkTask& a, const ChunkTask& b) { return a.end - a.start > b.end - b.start; });
+
+    WorkStealingPool pool(juce::jmin(opt.numThreads, juce::jmax(1, static_cast<int> (tasks.size()))));
+    std::mutex jobLock;
+
+    const auto report = [&jobLock](FileJob& job, const juce::String& taskError, double seconds) {
+        const std::lock_guard<std::mutex> guard(jobLock);
+        job.renderSeconds += seconds;
+
+        if (job.error.isEmpty())
+            job.error = taskError;
+    };
+
+    pool.run(static_cast<int> (tasks.size()), [&](int index, int workerIndex) {
+        const auto& task = tasks[static_cast<size_t> (index)];
+        auto& job = jobs[static_cast<size_t> (task.fileIndex)];
+        const auto taskTicks = juce::Time::getHighResolutionTicks();
+        const auto taskError = renderChunk(job, task, *formatManagers[workerIndex], stateData, opt);
+        report(job, taskError, juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - taskTicks));
+    });
+
+    const auto numStolen = pool.getNumStolen();
+    std::vector<int> chunkedFiles;
+
+    for (int i = 0; i < files.size(); ++i)
+        if (jobs[static_cast<size_t> (i)].numChunks > 1)
+            chunkedFiles.push_back(i);
+
+    pool.run(static_cast<int> (chunkedFiles.size()), [&](int index, int workerIndex) {
+        auto& job = jobs[static_cast<size_t> (chunkedFiles[static_cast<size_t> (index)])];
+
+        if (job.mappedOut != nullptr)
+        {
+            job.mappedOut.reset();
+            return;
+        }
+
+        if (job.error.isEmpty())
+            job.error = joinParts(job, *formatManagers[workerIndex]);
+
+        for (int c = 0; c < job.numChunks; ++c)
+            getPartFile(job, c).deleteFile();
+    });
+
+    const auto wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    if (opt.verify)
+    {
+        pool.run(static_cast<int> (chunkedFiles.size()), [&](int index, int workerIndex) {
+            auto& job = jobs[static_cast<size_t> (chunkedFiles[static_cast<size_t> (index)])];
+
+            if (job.error.isEmpty())
+                job.error = verifyFile(job, *formatManagers[workerIndex], stateData, opt);
+        });
+    }
+
+    double audioSeconds = 0.0;
+    int numFailed = 0;
+
+    for (const auto& job : jobs)
+    {
+        if (job.error.isNotEmpty())
+        {
+            std::cerr << job.in.getFullPathName() << ": " << job.error << std::endl;
+            ++numFailed;
+            continue;
+        }
+
+        const auto seconds = static_cast<double> (job.length) / job.sampleRate;
+        audioSeconds += seconds;
+
+        if (opt.quiet)
+            continue;
+
+        std::cout << job.in.getFileName() << ": " << juce::String(seconds, 1) << " s, "
+                  << juce::String(seconds / job.renderSeconds, 1) << "x realtime per thread";
+
+        if (job.numChunks > 1)
+            std::cout << ", " << job.numChunks << " chunks with " << juce::String(static_cast<double> (job.preRoll) / job.sampleRate, 2) << " s pre-roll";
+
+        if (job.maxDifference >= 0.0)
+            std::cout << ", max difference to serial " << juce::String(juce::Decibels::gainToDecibels(job.maxDifference, -1000.0), 1) << " dB";
+
+        std::cout << std::endl;
+    }
+
+    const auto realtime = wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0;
+
+    std::cout << "files:            " << files.size() - numFailed << " rendered, " << numFailed << " failed" << std::endl
+              << "audio:            " << juce::String(audioSeconds, 1) << " s in " << juce::String(wallSeconds, 2) << " s" << std::endl
+              << "throughput:       " << juce::String(realtime, 1) << "x realtime on " << pool.getNumThreads() << " threads ("
+              << juce::String(realtime / pool.getNumThreads(), 1) << "x per thread, " << tasks.size() << " tasks, " << numStolen << " stolen)" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
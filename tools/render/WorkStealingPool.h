@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a fixed set of tasks on a number of worker threads. The tasks are dealt
+// round-robin into one queue per worker, every worker takes its own tasks from
+// the front and, once it runs dry, steals from the back of the other queues,
+// so a few long tasks don't leave the remaining workers idle.
+class WorkStealingPool
+{
+public:
+
+    using Task = std::function<void(int taskIndex, int workerIndex)>;
+
+    explicit WorkStealingPool(int numthreads)
+        : numThreads(numthreads > 0 ? numthreads : 1)
+    {
+    }
+
+    int getNumThreads() const
+    {
+        return numThreads;
+    }
+
+    // Callers put the expensive tasks first, so the cheap ones are left for stealing.
+    void run(int numTasks, const Task& task)
+    {
+        std::vector<Queue> queues(static_cast<size_t> (numThreads));
+        numStolen = 0;
+
+        for (int i = 0; i < numTasks; ++i)
+            queues[static_cast<size_t> (i % numThreads)].tasks.push_back(i);
+
+        std::vector<std::thread> threads;
+
+        for (int w = 0; w < numThreads; ++w)
+            threads.emplace_back([&queues, &task, w, this]() { work(queues, task, w); });
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    // Number of tasks that were run by another worker than the one they were
+    // assigned to during the last run.
+    int getNumStolen() const
+    {
+        return numStolen.load();
+    }
+
+private:
+
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+
+    void work(std::vector<Queue>& queues, const Task& task, int workerIndex)
+    {
+        auto& own = queues[static_cast<size_t> (workerIndex)];
+
+        for (;;)
+        {
+            auto next = pop(own, true);
+
+            for (int i = 1; next < 0 && i < numThreads; ++i)
+            {
+                next = pop(queues[static_cast<size_t> ((workerIndex + i) % numThreads)], false);
+
+                if (next >= 0)
+                    ++numStolen;
+            }
+
+            if (next < 0)
+                return;
+
+            task(next, workerIndex);
+        }
+    }
+
+    static int pop(Queue& q, bool front)
+    {
+        const std::lock_guard<std::mutex> guard(q.lock);
+
+        if (q.tasks.empty())
+            return -1;
+
+        const auto ret = front ? q.tasks.front() : q.tasks.back();
+
+        if (front)
+            q.tasks.pop_front();
+        else
+            q.tasks.pop_back();
+
+        return ret;
+    }
+
+    int numThreads;
+    std::atomic<int> numStolen { 0 };
+};
@@ -0,0 +1,733 @@
+// Worst-case latency stress test for AFEQAudioProcessor. Drives the processor
+// with randomized parameter automation and analyser toggles, records the
+// duration of every processBlock call and reports percentiles together with
+// heap allocations and mutex locks seen on the audio thread.
+//
+// Exits with 1 when the duration at the checked percentile exceeds the budget.
+//
+// With --editor the callbacks run on their own thread while the main thread
+// runs the message loop with an editor attached, which edits parameters in
+// gestures, selects bands, steps through the undo history and paints.
+//
+// Usage: afeq_stress [--seconds 60] [--rate 48000] [--block 256] [--variable-blocks]
+//                    [--changes-per-block 2] [--budget 0.25] [--percentile 100]
+//                    [--double] [--seed 1] [--channels 2] [--workers 0] [--multirate]
+//                    [--oversampling 1] [--linear-phase] [--linear-phase-eq 0] [--non-uniform]
+//                    [--parallel] [--editor]
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <dlfcn.h>
+ #include <pthread.h>
+#endif
+
+//==============================================================================
+// Audio thread instrumentation: every heap allocation and mutex lock made while
+// the flag is set is counted.
+namespace
+{
+    thread_local bool inAudioCallback = false;
+    std::atomic<juce::int64> audioThreadAllocations { 0 };
+    std::atomic<juce::int64> audioThreadLocks { 0 };
+
+    void* countedAlloc(std::size_t size)
+    {
+        if (inAudioCallback)
+            audioThreadAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        if (auto p = std::malloc(size == 0 ? 1 : size))
+            return p;
+
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { try { return countedAlloc(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { try { return countedAlloc(size); } catch (...) { return nullptr; } }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#if JUCE_LINUX || JUCE_MAC
+// Catches std::mutex and juce::CriticalSection. Spin locks are not detected.
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    using LockFn = int (*)(pthread_mutex_t*);
+    static const auto realLock = reinterpret_cast<LockFn> (dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+
+    if (inAudioCallback)
+        audioThreadLocks.fetch_add(1, std::memory_order_relaxed);
+
+    return realLock(mutex);
+}
+#endif
+
+//==============================================================================
+namespace
+{
+    // Log-linear histogram in the style of HdrHistogram: every power of two is
+    // split into 2^subBucketBits buckets, which keeps the relative error of any
+    // recorded value below 2^-subBucketBits.
+    class LatencyHistogram
+    {
+    public:
+
+        void record(juce::int64 ns)
+        {
+            ns = std::max<juce::int64>(ns, 1);
+            ++counts[static_cast<size_t> (getBucket(ns))];
+            ++total;
+            maxValue = std::max(maxValue, ns);
+        }
+
+        juce::int64 getPercentile(double percentile) const
+        {
+            if (total == 0)
+                return 0;
+
+            if (percentile >= 100.0)
+                return maxValue;
+
+            const auto target = static_cast<juce::int64> (std::ceil(percentile * 0.01 * static_cast<double> (total)));
+            juce::int64 count = 0;
+
+            for (size_t i = 0; i < counts.size(); ++i)
+            {
+                count += counts[i];
+
+                if (count >= target)
+                    return std::min(maxValue, getBucketUpperValue(static_cast<int> (i)));
+            }
+
+            return maxValue;
+        }
+
+        juce::int64 getMax() const { return maxValue; }
+        juce::int64 getTotalCount() const { return total; }
+
+    private:
+
+        static constexpr int subBucketBits = 5;
+        static constexpr int subBuckets = 1 << subBucketBits;
+        static constexpr int numMagnitudes = 40;
+
+        static int getBucket(juce::int64 v)
+        {
+            int magnitude = 0;
+            while ((v >> magnitude) >= subBuckets)
+                ++magnitude;
+
+            const auto sub = static_cast<int> (v >> magnitude);
+            return std::min(magnitude * subBuckets + sub, numMagnitudes * subBuckets - 1);
+        }
+
+        static juce::int64 getBucketUpperValue(int bucket)
+        {
+            const auto magnitude = bucket / subBuckets;
+            const auto sub = bucket % subBuckets;
+            return ((static_cast<juce::int64> (sub) + 1) << magnitude) - 1;
+        }
+
+        std::array<juce::int64, static_cast<size_t> (numMagnitudes * subBuckets)> counts {};
+        juce::int64 total = 0;
+        juce::int64 maxValue = 0;
+    };
+
+    struct Options
+    {
+        double seconds = 60.0;
+        double sampleRate = 48000.0;
+        int blockSize = 256;
+        bool variableBlocks = false;
+        int changesPerBlock = 2;
+        double budget = 0.25;
+        double percentile = 100.0;
+        bool useDouble = false;
+        juce::int64 seed = 1;
+        int numChannels = 2;
+        int numWorkers = 0;
+        bool multirate = false;
+        int oversampling = 1;
+        bool linearPhase = false;
+        int partitionSize = 0;
+        bool nonUniform = false;
+        bool parallel = false;
+        bool withEditor = false;
+    };
+
+    bool parseOptions(int argc, char* argv[], Options& opt)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const juce::String arg(argv[i]);
+            const auto hasValue = i + 1 < argc;
+
+            if (arg == "--variable-blocks")
+                opt.variableBlocks = true;
+            else if (arg == "--double")
+                opt.useDouble = true;
+            else if (arg == "--multirate")
+                opt.multirate = true;
+            else if (arg == "--linear-phase")
+                opt.linearPhase = true;
+            else if (arg == "--non-uniform")
+                opt.nonUniform = true;
+            else if (arg == "--parallel")
+                opt.parallel = true;
+            else if (arg == "--editor")
+                opt.withEditor = true;
+            else if (arg == "--seconds" && hasValue)
+                opt.seconds = juce::String(argv[++i]).getDoubleValue();
+            else if (arg == "--rate" && hasValue)
+                opt.sampleRate = juce::String(argv[++i]).getDoubleValue();
+            else if (arg == "--block" && hasValue)
+                opt.blockSize = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--changes-per-block" && hasValue)
+                opt.changesPerBlock = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--budget" && hasValue)
+                opt.budget = juce::String(argv[++i]).getDoubleValue();
+            else if (arg == "--percentile" && hasValue)
+                opt.percentile = juce::String(argv[++i]).getDoubleValue();
+            else if (arg == "--seed" && hasValue)
+                opt.seed = juce::String(argv[++i]).getLargeIntValue();
+            else if (arg == "--channels" && hasValue)
+                opt.numChannels = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--workers" && hasValue)
+                opt.numWorkers = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--oversampling" && hasValue)
+                opt.oversampling = juce::String(argv[++i]).getIntValue();
+            else if (arg == "--linear-phase-eq" && hasValue)
+                opt.partitionSize = juce::String(argv[++i]).getIntValue();
+            else
+                return false;
+        }
+
+        return opt.seconds > 0.0 && opt.sampleRate > 40000.0 && opt.blockSize > 0 && opt.budget > 0.0
+            && opt.numChannels > 0 && opt.numWorkers >= 0
+            && juce::isPowerOfTwo(opt.oversampling) && opt.oversampling <= 8 && opt.partitionSize >= 0;
+    }
+
+    // Host side automation: a few random parameters per block, occasionally a
+    // burst that redesigns many bands at once, plus analyser toggles.
+    void automate(AFEQAudioProcessor& proc, juce::Random& rnd, int changesPerBlock)
+    {
+        auto& params = proc.getParameters();
+        const auto burst = rnd.nextInt(200) == 0;
+        const auto numChanges = burst ? params.size() / 2 : rnd.nextInt(changesPerBlock + 1);
+
+        for (int i = 0; i < numChanges; ++i)
+            params[rnd.nextInt(params.size())]->setValueNotifyingHost(rnd.nextFloat());
+
+        if (rnd.nextInt(500) == 0)
+            proc.analyserProc = static_cast<AFEQAudioProcessor::AnalyserProcessing> (rnd.nextInt(3));
+    }
+
+    // What a user does in the editor while the host plays: parameter edits in
+    // gestures, band selection, undo and redo, plus a paint of the editor
+    // every few ticks. Runs on the message thread.
+    class EditorSession : private juce::Timer
+    {
+    public:
+
+        EditorSession(AFEQAudioProcessor& p, AFEQAudioProcessorEditor& e, juce::int64 seed)
+            : proc(p), editor(e), rnd(seed)
+        {
+            editor.setSize(800, 600);
+            startTimer(15);
+        }
+
+        ~EditorSession() override
+        {
+            stopTimer();
+        }
+
+        int getNumTicks() const { return numTicks; }
+        int getNumPaints() const { return numPaints; }
+
+    private:
+
+        void timerCallback() override
+        {
+            ++numTicks;
+            auto& params = proc.getParameters();
+
+            if (gestureParam == nullptr)
+            {
+                gestureParam = params[rnd.nextInt(params.size())];
+                gestureParam->beginChangeGesture();
+                gestureSteps = 1 + rnd.nextInt(8);
+            }
+
+            gestureParam->setValueNotifyingHost(rnd.nextFloat());
+
+            if (--gestureSteps == 0)
+            {
+                gestureParam->endChangeGesture();
+                gestureParam = nullptr;
+            }
+
+            if (rnd.nextInt(20) == 0)
+            {
+                const auto band = proc.eqBands[rnd.nextInt(proc.eqBands.size() + 1)];
+                editor.setActiveBand(band != nullptr ? &band->getBandParams() : nullptr);
+            }
+
+            if (gestureParam == nullptr && rnd.nextInt(30) == 0)
+            {
+                if (rnd.nextBool())
+                    proc.undo();
+                else
+                    proc.redo();
+            }
+
+            if (numTicks % 8 == 0)
+            {
+                editor.createComponentSnapshot(editor.getLocalBounds());
+                ++numPaints;
+            }
+        }
+
+        AFEQAudioProcessor& proc;
+        AFEQAudioProcessorEditor& editor;
+        juce::Random rnd;
+        juce::AudioProcessorParameter* gestureParam = nullptr;
+        int gestureSteps = 0;
+        int numTicks = 0;
+        int numPaints = 0;
+    };
+
+    template <typename SampleType>
+    void fillNoise(juce::AudioBuffer<SampleType>& buffer, juce::Random& rnd)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample(ch, i, static_cast<SampleType> (0.5f * (2.f * rnd.nextFloat() - 1.f)));
+    }
+
+    struct RestoreStats
+    {
+        double meanSeconds = 0.0;
+        double maxSeconds = 0.0;
+        double designsPerRestore = 0.0;
+    };
+
+    // Preset browsing: restores random states, each followed by the block in
+    // which the bands pick them up and redesign.
+    template <typename SampleType>
+    RestoreStats measureRestores(AFEQAudioProcessor& proc, juce::AudioBuffer<SampleType>& buffer, juce::Random& rnd)
+    {
+        const int numStates = 50;
+        std::vector<juce::MemoryBlock> states(static_cast<size_t> (numStates));
+
+        for (auto& state : states)
+        {
+            for (auto param : proc.getParameters())
+                param->setValueNotifyingHost(rnd.nextFloat());
+
+            proc.getStateInformation(state);
+        }
+
+        const auto countDesigns = [&proc]() {
+            auto n = 0;
+
+            for (auto b : proc.eqBands)
+                n += b->getNumDesigns();
+
+            return n;
+        };
+
+        juce::MidiBuffer midi;
+        RestoreStats stats;
+        const auto designsBefore = countDesigns();
+
+        for (const auto& state : states)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            proc.setStateInformation(state.getData(), static_cast<int> (state.getSize()));
+            proc.processBlock(buffer, midi);
+            const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            stats.meanSeconds += seconds / numStates;
+            stats.maxSeconds = std::max(stats.maxSeconds, seconds);
+        }
+
+        stats.designsPerRestore = static_cast<double> (countDesigns() - designsBefore) / numStates;
+        return stats;
+    }
+
+    // A/B comparisons: four snapshots of 12 variable order bands at order 8,
+    // recalled in turn. Each recall is timed with its first block and the
+    // design count covers the crossfade until the handover.
+    template <typename SampleType>
+    RestoreStats measureSnapshotSwitches(AFEQAudioProcessor& proc, juce::AudioBuffer<SampleType>& buffer, juce::Random& rnd)
+    {
+        const int numSwitches = 40;
+
+        for (int slot = 0; slot < SnapshotBank::numSlots; ++slot)
+        {
+            auto state = proc.captureState();
+
+            for (auto& b : state.bands)
+            {
+                b.enabled = true;
+                b.type = BandParams::bandVOHiPass + rnd.nextInt(5);
+                b.routing = BandParams::routeStereo;
+                b.freq = 20.f * std::pow(1000.f, rnd.nextFloat());
+                b.gain = 24.f * rnd.nextFloat() - 12.f;
+                b.q = 0.3f + 2.7f * rnd.nextFloat();
+                b.order = AFEQAudioProcessor::maxOrder;
+            }
+
+            proc.applyState(state);
+            proc.storeSnapshot(slot);
+        }
+
+        for (int i = 0; i < 200; ++i)
+        {
+            auto ready = true;
+
+            for (int slot = 0; slot < SnapshotBank::numSlots; ++slot)
+                ready = ready && proc.isSnapshotReady(slot);
+
+            if (ready)
+                break;
+
+            juce::Thread::sleep(10);
+        }
+
+        const auto countDesigns = [&proc]() {
+            auto n = 0;
+
+            for (auto b : proc.eqBands)
+                n += b->getNumDesigns();
+
+            return n;
+        };
+
+        juce::MidiBuffer midi;
+        RestoreStats stats;
+        const auto designsBefore = countDesigns();
+        const auto blocksPerSwitch = 2 + static_cast<int> (0.01 * proc.getSampleRate()) / juce::jmax(1, buffer.getNumSamples());
+
+        for (int i = 0; i < numSwitches; ++i)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            proc.recallSnapshot(i % SnapshotBank::numSlots);
+            proc.processBlock(buffer, midi);
+            const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for (int b = 1; b < blocksPerSwitch; ++b)
+                proc.processBlock(buffer, midi);
+
+            stats.meanSeconds += seconds / numSwitches;
+            stats.maxSeconds = std::max(stats.maxSeconds, seconds);
+        }
+
+        stats.designsPerRestore = static_cast<double> (countDesigns() - designsBefore) / numSwitches;
+        return stats;
+    }
+
+    // Automates the Morph parameter between the first two snapshots, with a
+    // jump every few blocks, and reports the callbacks and band designs.
+    template <typename SampleType>
+    RestoreStats measureMorph(AFEQAudioProcessor& proc, juce::AudioBuffer<SampleType>& buffer, juce::Random& rnd)
+    {
+        const int numBlocks = 400;
+        proc.setMorphSlots(0, 1);
+
+        for (int i = 0; i < 200 && ! proc.isMorphReady(); ++i)
+            juce::Thread::sleep(10);
+
+        auto param = dynamic_cast<juce::AudioParameterFloat*> (proc.getAPValueTreeState().getParameter("Morph"));
+        auto designs = 0;
+
+        for (auto b : proc.eqBands)
+            designs -= b->getNumDesigns();
+
+        juce::MidiBuffer midi;
+        RestoreStats stats;
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            const auto sweep = std::abs(static_cast<float> (i % 100) / 50.f - 1.f);
+            *param = i % 25 == 0 ? rnd.nextFloat() : sweep;
+
+            const auto start = std::chrono::steady_clock::now();
+            proc.processBlock(buffer, midi);
+            const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            stats.meanSeconds += seconds / numBlocks;
+            stats.maxSeconds = std::max(stats.maxSeconds, seconds);
+        }
+
+        for (auto b : proc.eqBands)
+            designs += b->getNumDesigns();
+
+        proc.clearMorph();
+        stats.designsPerRestore = static_cast<double> (designs) / numBlocks;
+        return stats;
+    }
+
+    // With --parallel: twelve static peak bands settle until the parallel form
+    // plays, then one band's frequency is automated for a few blocks. Each
+    // start is timed over the blocks in which the bands catch up on the input
+    // history and fade in; the count is the starts that reached the form.
+    template <typename SampleType>
+    RestoreStats measureAutomationStarts(AFEQAudioProcessor& proc, juce::AudioBuffer<SampleType>& buffer, juce::Random& rnd)
+    {
+        const int numStarts = 20;
+        const int blocksPerStart = 8 + static_cast<int> (0.1 * proc.getSampleRate()) / juce::jmax(1, buffer.getNumSamples());
+
+        auto state = proc.captureState();
+
+        for (auto& b : state.bands)
+        {
+            b.enabled = true;
+            b.type = BandParams::bandPeak;
+            b.routing = BandParams::routeStereo;
+            b.freq = 40.f * std::pow(400.f, rnd.nextFloat());
+            b.gain = 24.f * rnd.nextFloat() - 12.f;
+            b.q = 0.5f + 4.f * rnd.nextFloat();
+            b.order = 2;
+            b.dynamic = false;
+            b.engine = BandParams::engineBiquad;
+        }
+
+        proc.applyState(state);
+
+        juce::MidiBuffer midi;
+        RestoreStats stats;
+        auto param = proc.eqBands[0]->getBandParams().freqParam;
+        auto numTimed = 0;
+
+        for (int i = 0; i < numStarts; ++i)
+        {
+            for (int wait = 0; wait < 200 && ! proc.isParallelFormPlaying(); ++wait)
+            {
+                fillNoise(buffer, rnd);
+                proc.processBlock(buffer, midi);
+                juce::Thread::sleep(1);
+            }
+
+            if (proc.isParallelFormPlaying())
+                stats.designsPerRestore += 1.0;
+
+            for (int b = 0; b < blocksPerStart; ++b)
+            {
+                if (b < blocksPerStart / 2)
+                    param->setValueNotifyingHost(rnd.nextFloat());
+
+                fillNoise(buffer, rnd);
+
+                const auto start = std::chrono::steady_clock::now();
+                proc.processBlock(buffer, midi);
+                const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                stats.meanSeconds += seconds;
+                stats.maxSeconds = std::max(stats.maxSeconds, seconds);
+                ++numTimed;
+            }
+        }
+
+        stats.meanSeconds /= juce::jmax(1, numTimed);
+        return stats;
+    }
+
+    template <typename SampleType>
+    int run(const Options& opt)
+    {
+        const int blockSizes[] = { 32, 64, 128, 256, 441, 512, 1024, 2048 };
+        const auto maxBlockSize = opt.variableBlocks ? std::max(opt.blockSize, 2048) : opt.blockSize;
+
+        AFEQAudioProcessor proc;
+        AFEQAudioProcessor::ProcessingOptions options;
+        options.numWorkers = opt.numWorkers;
+        options.multirateEnabled = opt.multirate;
+        options.oversamplingFactor = opt.oversampling;
+        options.oversamplingLinearPhase = opt.linearPhase;
+        options.linearPhaseEnabled = opt.partitionSize > 0;
+        options.linearPhasePartitionSize = juce::jmax(32, opt.partitionSize);
+        options.linearPhaseNonUniform = opt.nonUniform;
+        options.parallelFormEnabled = opt.parallel;
+        proc.setProcessingOptions(options);
+        proc.setPlayConfigDetails(opt.numChannels, opt.numChannels, opt.sampleRate, maxBlockSize);
+        proc.prepareToPlay(opt.sampleRate, maxBlockSize);
+
+        juce::Random rnd(opt.seed);
+        juce::AudioBuffer<SampleType> buffer(opt.numChannels, maxBlockSize);
+        juce::MidiBuffer midi;
+        LatencyHistogram histogram;
+
+        // Budget usage of every callback in per mille, so fixed and variable
+        // block sizes are checked the same way.
+        LatencyHistogram usage;
+        const auto totalSamples = static_cast<juce::int64> (opt.seconds * opt.sampleRate);
+        juce::int64 worstCallback = 0;
+        juce::int64 overBudget = 0;
+
+        std::unique_ptr<juce::AudioProcessorEditor> editor;
+
+        if (opt.withEditor)
+            editor.reset(proc.createEditorIfNeeded());
+
+        const auto runCallbacks = [&]() {
+            for (juce::int64 pos = 0; pos < totalSamples;)
+            {
+                const auto numSamples = opt.variableBlocks ? juce::jmin(maxBlockSize, blockSizes[rnd.nextInt(juce::numElementsInArray(blockSizes))])
+                                                           : opt.blockSize;
+                buffer.setSize(opt.numChannels, numSamples, false, false, true);
+                fillNoise(buffer, rnd);
+                automate(proc, rnd, opt.changesPerBlock);
+
+                inAudioCallback = true;
+                const auto start = std::chrono::steady_clock::now();
+                proc.processBlock(buffer, midi);
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                inAudioCallback = false;
+
+                const auto budgetNs = opt.budget * 1e9 * numSamples / opt.sampleRate;
+                const auto perMille = static_cast<juce::int64> (1000.0 * static_cast<double> (ns) / budgetNs);
+
+                if (perMille > usage.getMax())
+                    worstCallback = usage.getTotalCount();
+
+                if (perMille > 1000)
+                    ++overBudget;
+
+                histogram.record(ns);
+                usage.record(perMille);
+                pos += numSamples;
+            }
+        };
+
+        auto editorTicks = 0;
+        auto editorPaints = 0;
+
+        if (auto ed = dynamic_cast<AFEQAudioProcessorEditor*> (editor.get()))
+        {
+            // the main thread is the message thread
+            EditorSession session(proc, *ed, opt.seed + 1);
+
+            std::thread audioThread([&runCallbacks]() {
+                runCallbacks();
+                juce::MessageManager::getInstance()->stopDispatchLoop();
+            });
+
+            juce::MessageManager::getInstance()->runDispatchLoop();
+            audioThread.join();
+            editorTicks = session.getNumTicks();
+            editorPaints = session.getNumPaints();
+        }
+        else
+        {
+            runCallbacks();
+        }
+
+        const auto groupTimings = proc.getGroupTimings();
+        const auto footprint = proc.getMemoryFootprint();
+        auto fallbacks = 0;
+
+        for (auto b : proc.eqBands)
+            fallbacks += b->getNumFallbacks();
+
+        const auto restores = measureRestores(proc, buffer, rnd);
+        const auto switches = measureSnapshotSwitches(proc, buffer, rnd);
+        const auto morphs = measureMorph(proc, buffer, rnd);
+        const auto starts = opt.parallel ? measureAutomationStarts(proc, buffer, rnd) : RestoreStats();
+        proc.releaseResources();
+
+        const auto us = [](juce::int64 ns) { return juce::String(static_cast<double> (ns) * 1e-3, 1) + " us"; };
+        const auto blockUs = 1e6 * opt.blockSize / opt.sampleRate;
+
+        std::cout << "callbacks:        " << histogram.getTotalCount() << std::endl
+                  << "block:            " << (opt.variableBlocks ? "variable" : juce::String(opt.blockSize)) << " samples @ " << opt.sampleRate << " Hz"
+                  << " (" << juce::String(blockUs, 1) << " us)" << std::endl
+                  << "p50:              " << us(histogram.getPercentile(50.0)) << std::endl
+                  << "p99:              " << us(histogram.getPercentile(99.0)) << std::endl
+                  << "p99.9:            " << us(histogram.getPercentile(99.9)) << std::endl
+                  << "max:              " << us(histogram.getMax()) << std::endl
+                  << "over budget:      " << overBudget << " callbacks (budget " << opt.budget * 100.0 << "% of each block)" << std::endl
+                  << "worst callback:   #" << worstCallback << " at " << juce::String(0.1 * static_cast<double> (usage.getMax()), 1) << "% of budget" << std::endl
+                  << "allocations:      " << audioThreadAllocations.load() << std::endl
+                  << "mutex locks:      " << audioThreadLocks.load() << std::endl
+                  << "state restore:    " << us(static_cast<juce::int64> (1e9 * restores.meanSeconds)) << " mean, "
+                  << us(static_cast<juce::int64> (1e9 * restores.maxSeconds)) << " max, "
+                  << juce::String(restores.designsPerRestore, 1) << " band designs each" << std::endl
+                  << "snapshot switch:  " << us(static_cast<juce::int64> (1e9 * switches.meanSeconds)) << " mean, "
+                  << us(static_cast<juce::int64> (1e9 * switches.maxSeconds)) << " max, "
+                  << juce::String(switches.designsPerRestore, 1) << " band designs each" << std::endl
+                  << "morph automation: " << us(static_cast<juce::int64> (1e9 * morphs.meanSeconds)) << " mean, "
+                  << us(static_cast<juce::int64> (1e9 * morphs.maxSeconds)) << " max, "
+                  << juce::String(morphs.designsPerRestore, 1) << " band designs per block" << std::endl
+                  << "memory:           " << static_cast<juce::int64> (footprint.instanceBytes) << " bytes instance, "
+                  << static_cast<juce::int64> (footprint.sharedBytes) << " bytes shared tables" << std::endl
+                  << "fit fallbacks:    " << fallbacks << " band designs on the filter instance" << std::endl;
+
+        if (editor != nullptr)
+            std::cout << "editor:           " << editorTicks << " message thread edits, " << editorPaints << " paints" << std::endl;
+
+        if (opt.multirate || opt.oversampling > 1 || opt.partitionSize > 0)
+            std::cout << "latency:          " << proc.getLatencySamples() << " samples" << std::endl;
+
+        if (opt.parallel)
+            std::cout << "automation start: " << us(static_cast<juce::int64> (1e9 * starts.meanSeconds)) << " mean, "
+                      << us(static_cast<juce::int64> (1e9 * starts.maxSeconds)) << " max, "
+                      << static_cast<int> (starts.designsPerRestore) << " of 20 from the parallel form" << std::endl;
+
+        if (opt.nonUniform)
+            std::cout << "late convolution: " << proc.getNumLateConvolutionJobs() << " stage blocks left out" << std::endl;
+
+        if (! groupTimings.empty())
+        {
+            std::cout << "workers:          " << opt.numWorkers << ", missed deadlines: " << proc.getNumMissedDeadlines() << std::endl;
+
+            for (size_t g = 0; g < groupTimings.size(); ++g)
+                std::cout << "group " << g << ":          " << groupTimings[g].numChannels << " channels, "
+                          << us(static_cast<juce::int64> (1e9 * groupTimings[g].meanSeconds)) << " mean, "
+                          << us(static_cast<juce::int64> (1e9 * groupTimings[g].maxSeconds)) << " max" << std::endl;
+        }
+
+        const auto checked = usage.getPercentile(opt.percentile);
+
+        if (checked > 1000)
+        {
+            std::cout << "FAILED: p" << opt.percentile << " of the callbacks used " << juce::String(0.1 * static_cast<double> (checked), 1)
+                      << "% of the budget" << std::endl;
+            return 1;
+        }
+
+        std::cout << "PASSED" << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+
+    if (! parseOptions(argc, argv, opt))
+    {
+        std::cerr << "Usage: afeq_stress [--seconds 60] [--rate 48000] [--block 256] [--variable-blocks]" << std::endl
+                  << "                   [--changes-per-block 2] [--budget 0.25] [--percentile 100]" << std::endl
+                  << "                   [--double] [--seed 1] [--channels 2] [--workers 0] [--multirate]" << std::endl
+                  << "                   [--oversampling 1] [--linear-phase] [--linear-phase-eq 0] [--non-uniform]" << std::endl
+                  << "                   [--parallel] [--editor]" << std::endl
+                  << "The budget is a fraction of the block duration." << std::endl;
+        return 2;
+    }
+
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    return opt.useDouble ? run<double>(opt) : run<float>(opt);
+}